@@ -0,0 +1,275 @@
+// Times gltfLoadFile on a large glTF file, the one given on the command line or a synthetic scene
+// shaped like Bistro (tens of thousands of nodes, meshes and accessors). The nlohmann DOM parse of
+// the same text is timed as well: the previous loader built it before copying every field out.
+
+#include "Foundation/File.hpp"
+#include "Foundation/Gltf.hpp"
+#include "Foundation/Memory.hpp"
+#include "Foundation/Time.hpp"
+
+#include "Externals/json.hpp"
+
+#include "Tests/TestHelpers.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Framework;
+//---------------------------------------------------------------------------//
+static const char* kSyntheticPath = "GltfParserBenchmark.gltf";
+static const uint32_t kIterations = 8;
+static const uint32_t kMeshCount = 25000;
+static const uint32_t kMaterialCount = 400;
+static const uint32_t kAccessorsPerMesh = 5; // 4 attributes and the indices
+static const uint32_t kVertexCount = 1024;
+static const uint32_t kIndexCount = 3072;
+//---------------------------------------------------------------------------//
+struct TextWriter
+{
+  char* m_Data;
+  size_t m_Size;
+  size_t m_Capacity;
+  Allocator* m_Allocator;
+};
+//---------------------------------------------------------------------------//
+static void append(TextWriter& p_Writer, const char* p_Format, ...)
+{
+  va_list args;
+  while (true)
+  {
+    va_start(args, p_Format);
+    const size_t available = p_Writer.m_Capacity - p_Writer.m_Size;
+    const int written = vsnprintf(p_Writer.m_Data + p_Writer.m_Size, available, p_Format, args);
+    va_end(args);
+
+    if ((size_t)written < available)
+    {
+      p_Writer.m_Size += written;
+      return;
+    }
+
+    const size_t capacity = p_Writer.m_Capacity * 2;
+    char* data = (char*)FRAMEWORK_ALLOCA(capacity, p_Writer.m_Allocator);
+    memcpy(data, p_Writer.m_Data, p_Writer.m_Size);
+    FRAMEWORK_FREE(p_Writer.m_Data, p_Writer.m_Allocator);
+    p_Writer.m_Data = data;
+    p_Writer.m_Capacity = capacity;
+  }
+}
+//---------------------------------------------------------------------------//
+// Every mesh has its own node, a single primitive and its own accessors and buffer views, all
+// pointing into one external buffer, as exporters write them.
+static void writeSyntheticScene(TextWriter& p_Writer)
+{
+  const uint32_t accessorCount = kMeshCount * kAccessorsPerMesh;
+  const uint32_t meshBytes = kVertexCount * (12 + 12 + 16 + 8) + kIndexCount * 4;
+
+  append(p_Writer, "{\n\"asset\":{\"version\":\"2.0\",\"generator\":\"GltfParserBenchmark\"},\n");
+  append(p_Writer, "\"scene\":0,\n\"scenes\":[{\"name\":\"Scene\",\"nodes\":[");
+  for (uint32_t i = 0; i < kMeshCount; ++i)
+    append(p_Writer, i == 0 ? "%u" : ",%u", i);
+  append(p_Writer, "]}],\n");
+
+  append(p_Writer, "\"nodes\":[\n");
+  for (uint32_t i = 0; i < kMeshCount; ++i)
+  {
+    append(
+        p_Writer,
+        "{\"name\":\"Node_%u\",\"mesh\":%u,\"translation\":[%.4f,%.4f,%.4f],"
+        "\"rotation\":[0.0,0.7071068,0.0,0.7071068],\"scale\":[1.0,1.0,1.0]}%s\n",
+        i,
+        i,
+        (float)(i % 100) * 1.5f,
+        (float)(i / 10000) * 0.25f,
+        (float)((i / 100) % 100) * -1.5f,
+        i + 1 < kMeshCount ? "," : "");
+  }
+  append(p_Writer, "],\n");
+
+  append(p_Writer, "\"meshes\":[\n");
+  for (uint32_t i = 0; i < kMeshCount; ++i)
+  {
+    const uint32_t a = i * kAccessorsPerMesh;
+    append(
+        p_Writer,
+        "{\"name\":\"Mesh_%u\",\"primitives\":[{\"attributes\":{\"POSITION\":%u,\"NORMAL\":%u,"
+        "\"TANGENT\":%u,\"TEXCOORD_0\":%u},\"indices\":%u,\"material\":%u,\"mode\":4}]}%s\n",
+        i,
+        a,
+        a + 1,
+        a + 2,
+        a + 3,
+        a + 4,
+        i % kMaterialCount,
+        i + 1 < kMeshCount ? "," : "");
+  }
+  append(p_Writer, "],\n");
+
+  static const char* kTypes[kAccessorsPerMesh] = {"VEC3", "VEC3", "VEC4", "VEC2", "SCALAR"};
+  static const uint32_t kStrides[kAccessorsPerMesh] = {12, 12, 16, 8, 0};
+
+  append(p_Writer, "\"accessors\":[\n");
+  for (uint32_t i = 0; i < accessorCount; ++i)
+  {
+    const uint32_t kind = i % kAccessorsPerMesh;
+    const bool indices = kind == kAccessorsPerMesh - 1;
+    append(
+        p_Writer,
+        "{\"bufferView\":%u,\"byteOffset\":0,\"componentType\":%u,\"count\":%u,\"type\":\"%s\"",
+        i,
+        indices ? 5125 : 5126,
+        indices ? kIndexCount : kVertexCount,
+        kTypes[kind]);
+    if (kind == 0)
+      append(p_Writer, ",\"min\":[-1.0,-1.0,-1.0],\"max\":[1.0,1.0,1.0]");
+    append(p_Writer, "}%s\n", i + 1 < accessorCount ? "," : "");
+  }
+  append(p_Writer, "],\n");
+
+  append(p_Writer, "\"bufferViews\":[\n");
+  size_t offset = 0;
+  for (uint32_t i = 0; i < accessorCount; ++i)
+  {
+    const uint32_t kind = i % kAccessorsPerMesh;
+    const bool indices = kind == kAccessorsPerMesh - 1;
+    const uint32_t length = indices ? kIndexCount * 4 : kVertexCount * kStrides[kind];
+    if (indices)
+    {
+      append(
+          p_Writer,
+          "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%u,\"target\":34963}",
+          offset,
+          length);
+    }
+    else
+    {
+      append(
+          p_Writer,
+          "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%u,\"byteStride\":%u,\"target\":34962}",
+          offset,
+          length,
+          kStrides[kind]);
+    }
+    append(p_Writer, "%s\n", i + 1 < accessorCount ? "," : "");
+    offset += length;
+  }
+  append(p_Writer, "],\n");
+
+  append(
+      p_Writer,
+      "\"buffers\":[{\"uri\":\"GltfParserBenchmark.bin\",\"byteLength\":%zu}],\n",
+      (size_t)meshBytes * kMeshCount);
+
+  append(p_Writer, "\"materials\":[\n");
+  for (uint32_t i = 0; i < kMaterialCount; ++i)
+  {
+    append(
+        p_Writer,
+        "{\"name\":\"Material_%u\",\"pbrMetallicRoughness\":{\"baseColorFactor\":[1.0,1.0,1.0,1.0],"
+        "\"baseColorTexture\":{\"index\":%u},\"metallicRoughnessTexture\":{\"index\":%u},"
+        "\"metallicFactor\":1.0,\"roughnessFactor\":0.5},\"normalTexture\":{\"index\":%u},"
+        "\"alphaMode\":\"%s\",\"doubleSided\":%s}%s\n",
+        i,
+        i * 3,
+        i * 3 + 1,
+        i * 3 + 2,
+        i % 8 == 0 ? "BLEND" : "OPAQUE",
+        i % 16 == 0 ? "true" : "false",
+        i + 1 < kMaterialCount ? "," : "");
+  }
+  append(p_Writer, "],\n");
+
+  append(p_Writer, "\"textures\":[\n");
+  for (uint32_t i = 0; i < kMaterialCount * 3; ++i)
+    append(p_Writer, "{\"sampler\":0,\"source\":%u}%s\n", i, i + 1 < kMaterialCount * 3 ? "," : "");
+  append(p_Writer, "],\n");
+
+  append(p_Writer, "\"images\":[\n");
+  for (uint32_t i = 0; i < kMaterialCount * 3; ++i)
+  {
+    append(
+        p_Writer,
+        "{\"uri\":\"Textures/Texture_%u.png\"}%s\n",
+        i,
+        i + 1 < kMaterialCount * 3 ? "," : "");
+  }
+  append(p_Writer, "],\n");
+
+  append(
+      p_Writer,
+      "\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,"
+      "\"wrapT\":10497}]\n}\n");
+}
+//---------------------------------------------------------------------------//
+int main(int argc, char** argv)
+{
+  Time::serviceInit();
+
+  MemoryServiceConfiguration memoryConfiguration;
+  memoryConfiguration.MaximumDynamicSize = FRAMEWORK_GIGA(1ull);
+  MemoryService::instance()->init(&memoryConfiguration);
+  Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
+
+  const bool synthetic = argc < 2;
+  const char* path = synthetic ? kSyntheticPath : argv[1];
+
+  if (synthetic)
+  {
+    TextWriter writer{nullptr, 0, FRAMEWORK_MEGA(4), allocator};
+    writer.m_Data = (char*)FRAMEWORK_ALLOCA(writer.m_Capacity, allocator);
+    writeSyntheticScene(writer);
+    fileWriteBinary(path, writer.m_Data, writer.m_Size);
+    FRAMEWORK_FREE(writer.m_Data, allocator);
+  }
+
+  FileReadResult text = fileReadText(path, allocator);
+  if (text.data == nullptr)
+  {
+    printf("Could not read %s\n", path);
+    return 1;
+  }
+
+  glTF::glTF scene = gltfLoadFile(path);
+  if (synthetic && (scene.meshesCount != kMeshCount || scene.nodesCount != kMeshCount ||
+                    scene.accessorsCount != kMeshCount * kAccessorsPerMesh ||
+                    scene.materialsCount != kMaterialCount))
+  {
+    printf("Synthetic scene parsed with the wrong counts\n");
+    return 1;
+  }
+  printf(
+      "%s: %.2f MB, %u nodes, %u meshes, %u accessors, %u materials\n",
+      path,
+      text.size / (1024.0 * 1024.0),
+      scene.nodesCount,
+      scene.meshesCount,
+      scene.accessorsCount,
+      scene.materialsCount);
+  gltfFree(scene);
+
+  const double streamingMs = measure(kIterations, [&]() {
+    glTF::glTF loaded = gltfLoadFile(path);
+    gltfFree(loaded);
+  });
+  const double domMs = measure(kIterations, [&]() {
+    nlohmann::json document = nlohmann::json::parse(text.data, text.data + text.size);
+    (void)document;
+  });
+
+  const double megabytes = text.size / (1024.0 * 1024.0);
+  printf("Best of %u\n", kIterations);
+  printf("\tgltfLoadFile: %.2f ms, %.1f MB/s\n", streamingMs, megabytes / (streamingMs / 1000.0));
+  printf("\tnlohmann DOM only: %.2f ms, %.1f MB/s\n", domMs, megabytes / (domMs / 1000.0));
+  printf("\tspeedup %.2fx\n", domMs / streamingMs);
+
+  FRAMEWORK_FREE(text.data, allocator);
+  if (synthetic)
+    fileDelete(path);
+
+  MemoryService::instance()->shutdown();
+  Time::serviceShutdown();
+
+  return 0;
+}
+//---------------------------------------------------------------------------//
@@ -0,0 +1,182 @@
+// Compares an integration step of the cloth simulation over an array of vertex structs and over
+// the columns of a SoaArray. Only positions, forces, mass and the fixed flag are touched, the
+// joint tables are what the structs drag through the cache.
+//
+// Build the Release|x64 configuration of SoaArrayBenchmark and run it from a console with no
+// arguments. It prints the best time of each layout and their ratio; the ratio depends on the
+// cache sizes and memory bandwidth of the machine, so report the CPU and memory with any result.
+
+#include "Foundation/Array.hpp"
+#include "Foundation/Memory.hpp"
+#include "Foundation/SoaArray.hpp"
+#include "Foundation/Time.hpp"
+
+#include "Tests/TestHelpers.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Framework;
+//---------------------------------------------------------------------------//
+static const uint32_t kVertexCount = 1 << 20;
+static const uint32_t kIterations = 32;
+static const uint32_t kMaxJointCount = 12;
+static const float kDeltaTime = 1.0f / 60.0f;
+//---------------------------------------------------------------------------//
+struct Vec3
+{
+  float x, y, z;
+};
+
+struct Joint
+{
+  uint32_t vertexIndex;
+  float stiffness;
+};
+
+struct Joints
+{
+  Joint joints[kMaxJointCount];
+  uint32_t jointCount;
+};
+
+// Layout of the cloth vertices before the migration to SoaArray.
+struct Vertex
+{
+  Vec3 startPosition;
+  Vec3 previousPosition;
+  Vec3 position;
+  Vec3 normal;
+  Vec3 velocity;
+  Vec3 force;
+  Joints joints;
+  float mass;
+  bool fixed;
+};
+
+namespace VertexField
+{
+enum Enum : uint32_t
+{
+  kStartPosition,
+  kPreviousPosition,
+  kPosition,
+  kNormal,
+  kVelocity,
+  kForce,
+  kJoints,
+  kMass,
+  kFixed
+};
+} // namespace VertexField
+
+using Vertices = SoaArray<Vec3, Vec3, Vec3, Vec3, Vec3, Vec3, Joints, float, bool>;
+//---------------------------------------------------------------------------//
+static inline void integrate(
+    Vec3& p_Position, Vec3& p_PreviousPosition, const Vec3& p_Force, float p_Mass)
+{
+  const float scale = kDeltaTime * kDeltaTime / p_Mass;
+  const Vec3 position = p_Position;
+
+  p_Position.x = position.x * 2.0f - p_PreviousPosition.x + p_Force.x * scale;
+  p_Position.y = position.y * 2.0f - p_PreviousPosition.y + p_Force.y * scale;
+  p_Position.z = position.z * 2.0f - p_PreviousPosition.z + p_Force.z * scale;
+  p_PreviousPosition = position;
+}
+//---------------------------------------------------------------------------//
+static void integrateStructs(Array<Vertex>& p_Vertices)
+{
+  for (uint32_t i = 0; i < p_Vertices.m_Size; ++i)
+  {
+    Vertex& vertex = p_Vertices[i];
+    if (!vertex.fixed)
+      integrate(vertex.position, vertex.previousPosition, vertex.force, vertex.mass);
+  }
+}
+//---------------------------------------------------------------------------//
+static void integrateColumns(Vertices& p_Vertices)
+{
+  Vec3* positions = p_Vertices.column<VertexField::kPosition>();
+  Vec3* previousPositions = p_Vertices.column<VertexField::kPreviousPosition>();
+  const Vec3* forces = p_Vertices.column<VertexField::kForce>();
+  const float* masses = p_Vertices.column<VertexField::kMass>();
+  const bool* fixed = p_Vertices.column<VertexField::kFixed>();
+
+  for (uint32_t i = 0; i < p_Vertices.m_Size; ++i)
+  {
+    if (!fixed[i])
+      integrate(positions[i], previousPositions[i], forces[i], masses[i]);
+  }
+}
+//---------------------------------------------------------------------------//
+int main(int argc, char** argv)
+{
+  Time::serviceInit();
+
+  MemoryServiceConfiguration memoryConfiguration;
+  memoryConfiguration.MaximumDynamicSize = FRAMEWORK_GIGA(1ull);
+  MemoryService::instance()->init(&memoryConfiguration);
+  Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
+
+  Array<Vertex> structs;
+  structs.init(allocator, kVertexCount, kVertexCount);
+
+  Vertices columns;
+  columns.init(allocator, kVertexCount, kVertexCount);
+
+  for (uint32_t i = 0; i < kVertexCount; ++i)
+  {
+    const Vec3 position = {(float)(i % 1024), (float)(i / 1024), 0.0f};
+    const Vec3 force = {0.0f, -9.8f, 0.0f};
+
+    Vertex& vertex = structs[i];
+    memset(&vertex, 0, sizeof(Vertex));
+    vertex.startPosition = vertex.previousPosition = vertex.position = position;
+    vertex.force = force;
+    vertex.mass = 1.0f;
+    vertex.fixed = i < 1024;
+
+    columns.get<VertexField::kStartPosition>(i) = position;
+    columns.get<VertexField::kPreviousPosition>(i) = position;
+    columns.get<VertexField::kPosition>(i) = position;
+    columns.get<VertexField::kForce>(i) = force;
+    columns.get<VertexField::kMass>(i) = 1.0f;
+    columns.get<VertexField::kFixed>(i) = i < 1024;
+  }
+
+  const double structsMs = measure(kIterations, [&]() { integrateStructs(structs); });
+  const double columnsMs = measure(kIterations, [&]() { integrateColumns(columns); });
+
+  // Both layouts ran the same steps, their positions have to match.
+  for (uint32_t i = 0; i < kVertexCount; ++i)
+  {
+    const Vec3& a = structs[i].position;
+    const Vec3& b = columns.get<VertexField::kPosition>(i);
+    if (a.x != b.x || a.y != b.y || a.z != b.z)
+    {
+      printf("Mismatch at vertex %u\n", i);
+      return 1;
+    }
+  }
+
+  // Bytes the step needs per vertex: positions, forces, mass and flag read, positions written.
+  const double usefulBytes =
+      (double)kVertexCount * (sizeof(Vec3) * 5 + sizeof(float) + sizeof(bool));
+  printf("Cloth integration, %u vertices, best of %u\n", kVertexCount, kIterations);
+  printf(
+      "\tstructs (%zu bytes): %.3f ms, %.2f GB/s\n",
+      sizeof(Vertex),
+      structsMs,
+      usefulBytes / (structsMs * 1e6));
+  printf("\tcolumns: %.3f ms, %.2f GB/s\n", columnsMs, usefulBytes / (columnsMs * 1e6));
+  printf("\tspeedup %.2fx\n", structsMs / columnsMs);
+
+  columns.shutdown();
+  structs.shutdown();
+
+  MemoryService::instance()->shutdown();
+  Time::serviceShutdown();
+
+  return 0;
+}
+//---------------------------------------------------------------------------//
@@ -6,6 +6,13 @@
 #include <string.h>
 #include <assert.h>
 
+#if !defined(_WIN64)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 namespace Framework
 {
 
@@ -427,6 +434,220 @@ void fileWriteBinary(const char* p_Filename, void* p_Memory, size_t p_Size)
   fclose(file);
 }
 
+//
+// File mapping
+#if defined(_WIN64)
+
+static size_t fileMappingGranularity()
+{
+  SYSTEM_INFO systemInfo;
+  GetSystemInfo(&systemInfo);
+  return systemInfo.dwAllocationGranularity;
+}
+
+FileMapping fileMapRangeReadOnly(
+    const char* p_Filename, size_t p_Offset, size_t p_Size, FileAccessHint::Enum p_Hint)
+{
+  FileMapping result{};
+
+  DWORD flags = FILE_ATTRIBUTE_NORMAL;
+  if (p_Hint == FileAccessHint::kSequential)
+    flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+  else if (p_Hint == FileAccessHint::kRandom)
+    flags |= FILE_FLAG_RANDOM_ACCESS;
+
+  HANDLE file = CreateFileA(
+      p_Filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return result;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || p_Offset >= (size_t)fileSize.QuadPart)
+  {
+    CloseHandle(file);
+    return result;
+  }
+
+  const size_t size = p_Size ? p_Size : (size_t)fileSize.QuadPart - p_Offset;
+  if (p_Offset + size > (size_t)fileSize.QuadPart)
+  {
+    CloseHandle(file);
+    return result;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr)
+  {
+    CloseHandle(file);
+    return result;
+  }
+
+  // Views must start on the allocation granularity.
+  const size_t viewOffset = p_Offset - p_Offset % fileMappingGranularity();
+  const size_t viewSize = size + (p_Offset - viewOffset);
+  void* view = MapViewOfFile(
+      mapping,
+      FILE_MAP_READ,
+      (DWORD)((uint64_t)viewOffset >> 32),
+      (DWORD)(viewOffset & 0xffffffff),
+      viewSize);
+  if (view == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return result;
+  }
+
+  result.data = (uint8_t*)view + (p_Offset - viewOffset);
+  result.size = size;
+  result.viewBase = view;
+  result.viewSize = viewSize;
+  result.fileHandle = file;
+  result.mappingHandle = mapping;
+
+  return result;
+}
+
+void fileUnmap(FileMapping& p_Mapping)
+{
+  if (p_Mapping.data == nullptr)
+    return;
+
+  UnmapViewOfFile(p_Mapping.viewBase);
+  CloseHandle(p_Mapping.mappingHandle);
+  CloseHandle(p_Mapping.fileHandle);
+
+  p_Mapping = FileMapping{};
+}
+
+void fileMappingAdvise(const FileMapping& p_Mapping, FileAccessHint::Enum p_Hint)
+{
+  // NOTE: Windows only takes access hints when the file is opened, sequential reads are
+  // approximated with a prefetch of the whole view.
+  if (p_Mapping.data && p_Hint == FileAccessHint::kSequential)
+  {
+    fileMappingPrefetch(p_Mapping, 0, p_Mapping.size);
+  }
+}
+
+void fileMappingPrefetch(const FileMapping& p_Mapping, size_t p_Offset, size_t p_Size)
+{
+  if (p_Mapping.data == nullptr || p_Offset >= p_Mapping.size)
+    return;
+
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = p_Mapping.data + p_Offset;
+  range.NumberOfBytes = p_Size < p_Mapping.size - p_Offset ? p_Size : p_Mapping.size - p_Offset;
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+static size_t fileMappingGranularity() { return (size_t)sysconf(_SC_PAGESIZE); }
+
+static int fileMappingAdviceFromHint(FileAccessHint::Enum p_Hint)
+{
+  switch (p_Hint)
+  {
+  case FileAccessHint::kSequential:
+    return MADV_SEQUENTIAL;
+  case FileAccessHint::kRandom:
+    return MADV_RANDOM;
+  default:
+    return MADV_NORMAL;
+  }
+}
+
+FileMapping fileMapRangeReadOnly(
+    const char* p_Filename, size_t p_Offset, size_t p_Size, FileAccessHint::Enum p_Hint)
+{
+  FileMapping result{};
+
+  const int file = open(p_Filename, O_RDONLY);
+  if (file < 0)
+  {
+    return result;
+  }
+
+  struct stat fileStat;
+  if (fstat(file, &fileStat) != 0 || p_Offset >= (size_t)fileStat.st_size)
+  {
+    close(file);
+    return result;
+  }
+
+  const size_t size = p_Size ? p_Size : (size_t)fileStat.st_size - p_Offset;
+  if (p_Offset + size > (size_t)fileStat.st_size)
+  {
+    close(file);
+    return result;
+  }
+
+  // Views must start on a page.
+  const size_t viewOffset = p_Offset - p_Offset % fileMappingGranularity();
+  const size_t viewSize = size + (p_Offset - viewOffset);
+  void* view = mmap(nullptr, viewSize, PROT_READ, MAP_PRIVATE, file, (off_t)viewOffset);
+
+  // The mapping keeps its own reference to the file.
+  close(file);
+
+  if (view == MAP_FAILED)
+  {
+    return result;
+  }
+
+  result.data = (uint8_t*)view + (p_Offset - viewOffset);
+  result.size = size;
+  result.viewBase = view;
+  result.viewSize = viewSize;
+
+  if (p_Hint != FileAccessHint::kNormal)
+  {
+    madvise(view, viewSize, fileMappingAdviceFromHint(p_Hint));
+  }
+
+  return result;
+}
+
+void fileUnmap(FileMapping& p_Mapping)
+{
+  if (p_Mapping.data == nullptr)
+    return;
+
+  munmap(p_Mapping.viewBase, p_Mapping.viewSize);
+
+  p_Mapping = FileMapping{};
+}
+
+void fileMappingAdvise(const FileMapping& p_Mapping, FileAccessHint::Enum p_Hint)
+{
+  if (p_Mapping.data == nullptr)
+    return;
+
+  madvise(p_Mapping.viewBase, p_Mapping.viewSize, fileMappingAdviceFromHint(p_Hint));
+}
+
+void fileMappingPrefetch(const FileMapping& p_Mapping, size_t p_Offset, size_t p_Size)
+{
+  if (p_Mapping.data == nullptr || p_Offset >= p_Mapping.size)
+    return;
+
+  // madvise wants a page aligned address.
+  uint8_t* start = p_Mapping.data + p_Offset;
+  uint8_t* pageStart = start - ((size_t)start % fileMappingGranularity());
+  const size_t size = p_Size < p_Mapping.size - p_Offset ? p_Size : p_Mapping.size - p_Offset;
+  madvise(pageStart, size + (start - pageStart), MADV_WILLNEED);
+}
+
+#endif // _WIN64
+
+FileMapping fileMapReadOnly(const char* p_Filename, FileAccessHint::Enum p_Hint)
+{
+  return fileMapRangeReadOnly(p_Filename, 0, 0, p_Hint);
+}
+
 /// Scoped file
 ScopedFile::ScopedFile(const char* p_Filename, const char* p_Mode)
 {
@@ -434,4 +655,12 @@ ScopedFile::ScopedFile(const char* p_Filename, const char* p_Mode)
 }
 
 ScopedFile::~ScopedFile() { fileClose(m_File); }
+
+/// Scoped file mapping
+ScopedFileMapping::ScopedFileMapping(const char* p_Filename, FileAccessHint::Enum p_Hint)
+{
+  m_Mapping = fileMapReadOnly(p_Filename, p_Hint);
+}
+
+ScopedFileMapping::~ScopedFileMapping() { fileUnmap(m_Mapping); }
 } // namespace Framework
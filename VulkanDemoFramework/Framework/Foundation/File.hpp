@@ -48,6 +48,47 @@ FileReadResult fileReadText(const char* p_Filename, Allocator* p_Allocator);
 
 void fileWriteBinary(const char* p_Filename, void* p_Memory, size_t p_Size);
 
+// Access pattern hints for mapped files, so the OS can tune read ahead.
+namespace FileAccessHint
+{
+enum Enum
+{
+  kNormal,
+  kSequential,
+  kRandom
+};
+} // namespace FileAccessHint
+
+// Read only mapping of a file, or of a range of it. Pages are read by the OS on first access, so
+// the contents can be parsed or uploaded without a copy.
+struct FileMapping
+{
+  uint8_t* data;
+  size_t size;
+
+  // The view starts at the allocation granularity below data.
+  void* viewBase;
+  size_t viewSize;
+
+  void* fileHandle;
+  void* mappingHandle;
+};
+
+// Data is null if the file could not be mapped. Empty files can't be mapped.
+FileMapping
+fileMapReadOnly(const char* p_Filename, FileAccessHint::Enum p_Hint = FileAccessHint::kNormal);
+// Maps [offset, offset + size) of a file, a size of 0 maps up to the end of the file.
+FileMapping fileMapRangeReadOnly(
+    const char* p_Filename,
+    size_t p_Offset,
+    size_t p_Size,
+    FileAccessHint::Enum p_Hint = FileAccessHint::kNormal);
+void fileUnmap(FileMapping& p_Mapping);
+
+void fileMappingAdvise(const FileMapping& p_Mapping, FileAccessHint::Enum p_Hint);
+// Starts reading a range of the mapping in the background, before it is touched.
+void fileMappingPrefetch(const FileMapping& p_Mapping, size_t p_Offset, size_t p_Size);
+
 bool fileExists(const char* p_Path);
 void fileOpen(const char* p_Filename, const char* p_Mode, FileHandle* m_File);
 void fileClose(FileHandle m_File);
@@ -101,4 +142,16 @@ struct ScopedFile
   FileHandle m_File;
 }; // struct ScopedFile
 
+struct ScopedFileMapping
+{
+  ScopedFileMapping(
+      const char* p_Filename, FileAccessHint::Enum p_Hint = FileAccessHint::kNormal);
+  ~ScopedFileMapping();
+
+  ScopedFileMapping(const ScopedFileMapping&) = delete;
+  ScopedFileMapping& operator=(const ScopedFileMapping&) = delete;
+
+  FileMapping m_Mapping;
+}; // struct ScopedFileMapping
+
 } // namespace Framework
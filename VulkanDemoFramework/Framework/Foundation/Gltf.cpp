@@ -1,672 +1,1508 @@
 #include "Gltf.hpp"
 #include "File.hpp"
+#include "Array.hpp"
+#include "HashMap.hpp"
 
-#include <Externals/json.hpp>
-#include <assert.h>
+#include <algorithm>
 
-using json = nlohmann::json;
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 
 namespace Framework
 {
 
-static void* allocateAndZero(Allocator* p_Allocator, size_t p_Size)
+//---------------------------------------------------------------------------//
+// Streaming parser
+//---------------------------------------------------------------------------//
+// Single pass over the json text, without building a document. Values are written straight into
+// the scene arena: the elements of an array are gathered on a scratch stack, as their count is
+// only known at the closing bracket, then copied once into the arena. Nested arrays use the
+// scratch above the element being parsed and are released before it is pushed, so the elements
+// of every open array stay contiguous. Strings are unescaped into a single buffer and interned.
+struct GltfParser
 {
-  void* result = p_Allocator->allocate(p_Size, 64);
-  memset(result, 0, p_Size);
+  const char* m_Begin;
+  const char* m_Cursor;
+  const char* m_End;
 
-  return result;
-}
-
-static void tryLoadString(
-    json& p_JsonData, const char* p_Key, StringBuffer& p_StringBuffer, Allocator* p_Allocator)
-{
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
-    return;
+  LinearAllocator* m_Arena;
+  Array<uint8_t> m_Scratch;
 
-  std::string value = p_JsonData.value(p_Key, "");
+  StringBuffer* m_Strings;
+  FlatHashMap<uint64_t, uint32_t> m_StringToOffset;
 
-  p_StringBuffer.init(value.length() + 1, p_Allocator);
-  p_StringBuffer.append(value.c_str());
-}
+  bool m_Error;
+};
 
-static void tryLoadInt(json& p_JsonData, const char* p_Key, int& p_Value)
+static bool parseError(GltfParser& p_Parser, const char* p_Message)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  if (!p_Parser.m_Error)
   {
-    p_Value = glTF::INVALID_INT_VALUE;
-    return;
+    char msg[256];
+    sprintf(
+        msg,
+        "glTF parse error: %s at offset %zu\n",
+        p_Message,
+        (size_t)(p_Parser.m_Cursor - p_Parser.m_Begin));
+    OutputDebugStringA(msg);
   }
 
-  p_Value = p_JsonData.value(p_Key, 0);
+  p_Parser.m_Error = true;
+  return false;
 }
 
-static void tryLoadFloat(json& p_JsonData, const char* p_Key, float& p_Value)
+// The arena is sized from the text up front, running out of it fails the parse instead of
+// tripping the allocator overflow assert.
+static void* arenaAllocate(GltfParser& p_Parser, size_t p_Size, size_t p_Alignment)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  LinearAllocator* arena = p_Parser.m_Arena;
+  if (memoryAlign(arena->m_AllocatedSize, p_Alignment) + p_Size > arena->m_TotalSize)
   {
-    p_Value = glTF::INVALID_FLOAT_VALUE;
-    return;
+    parseError(p_Parser, "out of arena memory");
+    return nullptr;
   }
 
-  p_Value = p_JsonData.value(p_Key, 0.0f);
+  return arena->allocate(p_Size, p_Alignment);
 }
 
-static void tryLoadBool(json& p_JsonData, const char* p_Key, bool& p_Value)
+static void* allocateAndZero(GltfParser& p_Parser, size_t p_Size)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  void* result = arenaAllocate(p_Parser, p_Size, 64);
+  if (result != nullptr)
   {
-    p_Value = false;
-    return;
+    memset(result, 0, p_Size);
   }
 
-  p_Value = p_JsonData.value(p_Key, false);
+  return result;
 }
 
-static void tryLoadType(json& p_JsonData, const char* p_Key, glTF::Accessor::Type& p_Type)
+static inline bool isWhitespace(char p_Char)
 {
-  std::string value = p_JsonData.value(p_Key, "");
-  if (value == "SCALAR")
-  {
-    p_Type = glTF::Accessor::Type::Scalar;
-  }
-  else if (value == "VEC2")
+  return p_Char == ' ' || p_Char == '\n' || p_Char == '\r' || p_Char == '\t';
+}
+
+static inline void skipWhitespace(GltfParser& p_Parser)
+{
+  const char* cursor = p_Parser.m_Cursor;
+  while (cursor < p_Parser.m_End && isWhitespace(*cursor))
   {
-    p_Type = glTF::Accessor::Type::Vec2;
+    ++cursor;
   }
-  else if (value == "VEC3")
+  p_Parser.m_Cursor = cursor;
+}
+
+// Consumes the next non whitespace char if it matches.
+static inline bool consume(GltfParser& p_Parser, char p_Char)
+{
+  skipWhitespace(p_Parser);
+  if (p_Parser.m_Cursor < p_Parser.m_End && *p_Parser.m_Cursor == p_Char)
   {
-    p_Type = glTF::Accessor::Type::Vec3;
+    ++p_Parser.m_Cursor;
+    return true;
   }
-  else if (value == "VEC4")
+
+  return false;
+}
+
+static inline bool keyEquals(const StringView& p_Key, const char* p_Literal)
+{
+  return strncmp(p_Key.m_Text, p_Literal, p_Key.m_Length) == 0 && p_Literal[p_Key.m_Length] == 0;
+}
+
+// Raw view of a string in the text, escapes are left as they are. Used for keys and enums.
+static bool parseStringView(GltfParser& p_Parser, StringView& p_Text)
+{
+  if (!consume(p_Parser, '"'))
   {
-    p_Type = glTF::Accessor::Type::Vec4;
+    return parseError(p_Parser, "expected a string");
   }
-  else if (value == "MAT2")
+
+  const char* cursor = p_Parser.m_Cursor;
+  while (cursor < p_Parser.m_End && *cursor != '"')
   {
-    p_Type = glTF::Accessor::Type::Mat2;
+    cursor += *cursor == '\\' ? 2 : 1;
   }
-  else if (value == "MAT3")
+  if (cursor >= p_Parser.m_End)
   {
-    p_Type = glTF::Accessor::Type::Mat3;
+    return parseError(p_Parser, "unterminated string");
   }
-  else if (value == "MAT4")
+
+  p_Text.m_Text = (char*)p_Parser.m_Cursor;
+  p_Text.m_Length = cursor - p_Parser.m_Cursor;
+  p_Parser.m_Cursor = cursor + 1;
+
+  return true;
+}
+
+static inline uint32_t hexValue(char p_Char)
+{
+  if (p_Char >= '0' && p_Char <= '9')
+    return p_Char - '0';
+  if (p_Char >= 'a' && p_Char <= 'f')
+    return p_Char - 'a' + 10;
+  if (p_Char >= 'A' && p_Char <= 'F')
+    return p_Char - 'A' + 10;
+  return UINT32_MAX;
+}
+
+// Reads the 4 hex digits of a \u escape.
+static bool parseHex4(const char*& p_Source, const char* p_End, uint32_t& p_Value)
+{
+  if (p_End - p_Source < 4)
   {
-    p_Type = glTF::Accessor::Type::Mat4;
+    return false;
   }
-  else
+
+  p_Value = 0;
+  for (uint32_t i = 0; i < 4; ++i)
   {
-    assert(false);
+    const uint32_t digit = hexValue(*p_Source++);
+    if (digit == UINT32_MAX)
+    {
+      return false;
+    }
+    p_Value = (p_Value << 4) | digit;
   }
+
+  return true;
 }
 
-static void tryLoadIntArray(
-    json& p_JsonData, const char* p_Key, uint32_t& p_Count, int** p_Array, Allocator* p_Allocator)
+// Unescapes the string at the end of the strings buffer and keeps it only if it was not already
+// interned. The buffer is as big as the text, and a string never grows when unescaped.
+static bool parseString(GltfParser& p_Parser, StringBuffer& p_String)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  StringView text;
+  if (!parseStringView(p_Parser, text))
   {
-    p_Count = 0;
-    *p_Array = nullptr;
-    return;
+    return false;
   }
 
-  json jsonArray = p_JsonData.at(p_Key);
+  StringBuffer& strings = *p_Parser.m_Strings;
+  char* destination = strings.current();
+  const char* source = text.m_Text;
+  const char* sourceEnd = source + text.m_Length;
 
-  p_Count = static_cast<uint32_t>(jsonArray.size());
+  uint32_t length = 0;
+  while (source < sourceEnd)
+  {
+    char c = *source++;
+    if (c == '\\' && source < sourceEnd)
+    {
+      c = *source++;
+      switch (c)
+      {
+      case 'b':
+        c = '\b';
+        break;
+      case 'f':
+        c = '\f';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case 'r':
+        c = '\r';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'u': {
+        uint32_t codePoint;
+        if (!parseHex4(source, sourceEnd, codePoint))
+        {
+          return parseError(p_Parser, "invalid unicode escape");
+        }
+
+        // Code points above the basic plane are escaped as a high and a low surrogate.
+        if (codePoint >= 0xd800 && codePoint <= 0xdbff)
+        {
+          uint32_t low = 0;
+          const bool escaped = sourceEnd - source >= 2 && source[0] == '\\' && source[1] == 'u';
+          source += escaped ? 2 : 0;
+          if (!escaped || !parseHex4(source, sourceEnd, low) || low < 0xdc00 || low > 0xdfff)
+          {
+            return parseError(p_Parser, "unpaired surrogate in unicode escape");
+          }
+          codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+        }
+        else if (codePoint >= 0xdc00 && codePoint <= 0xdfff)
+        {
+          return parseError(p_Parser, "unpaired surrogate in unicode escape");
+        }
+
+        if (codePoint >= 0x10000)
+        {
+          destination[length++] = (char)(0xf0 | (codePoint >> 18));
+          destination[length++] = (char)(0x80 | ((codePoint >> 12) & 0x3f));
+          destination[length++] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+          c = (char)(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint >= 0x800)
+        {
+          destination[length++] = (char)(0xe0 | (codePoint >> 12));
+          destination[length++] = (char)(0x80 | ((codePoint >> 6) & 0x3f));
+          c = (char)(0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint >= 0x80)
+        {
+          destination[length++] = (char)(0xc0 | (codePoint >> 6));
+          c = (char)(0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+          c = (char)codePoint;
+        }
+        break;
+      }
+      case '"':
+      case '\\':
+      case '/':
+        // Quotes, backslashes and slashes stand for themselves.
+        break;
+      default:
+        return parseError(p_Parser, "invalid escape in string");
+      }
+    }
 
-  int* values = (int*)allocateAndZero(p_Allocator, sizeof(int) * p_Count);
+    destination[length++] = c;
+  }
+  destination[length] = 0;
 
-  for (size_t i = 0; i < p_Count; ++i)
+  const uint64_t hash = hashBytes(destination, length);
+  uint32_t offset = p_Parser.m_StringToOffset.get(hash);
+  if (offset == UINT32_MAX || strcmp(strings.m_Data + offset, destination) != 0)
   {
-    values[i] = jsonArray.at(i);
+    // New string, or a hash collision that simply keeps its own copy.
+    if (offset == UINT32_MAX)
+    {
+      p_Parser.m_StringToOffset.insert(hash, strings.m_CurrentSize);
+    }
+    offset = strings.m_CurrentSize;
+    strings.m_CurrentSize += length + 1;
   }
 
-  *p_Array = values;
+  // Strings are owned by the scene strings buffer.
+  p_String.m_Data = strings.m_Data + offset;
+  p_String.m_BufferSize = length + 1;
+  p_String.m_CurrentSize = length;
+  p_String.m_Allocator = nullptr;
+
+  return true;
 }
 
-static void tryLoadFloatArray(
-    json& p_JsonData, const char* p_Key, uint32_t& p_Count, float** p_Array, Allocator* p_Allocator)
+static inline bool isNumberChar(char p_Char)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
-  {
-    p_Count = 0;
-    *p_Array = nullptr;
-    return;
-  }
-
-  json jsonArray = p_JsonData.at(p_Key);
+  return (p_Char >= '0' && p_Char <= '9') || p_Char == '-' || p_Char == '+' || p_Char == '.' ||
+         p_Char == 'e' || p_Char == 'E';
+}
 
-  p_Count = static_cast<uint32_t>(jsonArray.size());
+static bool parseDouble(GltfParser& p_Parser, double& p_Value)
+{
+  skipWhitespace(p_Parser);
 
-  float* values = (float*)allocateAndZero(p_Allocator, sizeof(float) * p_Count);
+  // The text is not always null terminated (glb chunks), so strtod gets a bounded copy.
+  char number[64];
+  uint32_t length = 0;
+  const char* cursor = p_Parser.m_Cursor;
+  while (cursor < p_Parser.m_End && isNumberChar(*cursor) && length < sizeof(number) - 1)
+  {
+    number[length++] = *cursor++;
+  }
+  number[length] = 0;
 
-  for (size_t i = 0; i < p_Count; ++i)
+  char* end = nullptr;
+  p_Value = strtod(number, &end);
+  if (end == number)
   {
-    values[i] = jsonArray.at(i);
+    return parseError(p_Parser, "expected a number");
   }
+  p_Parser.m_Cursor += end - number;
 
-  *p_Array = values;
+  return true;
 }
 
-static void loadAsset(json& p_JsonData, glTF::Asset& asset, Allocator* p_Allocator)
+static bool parseFloat(GltfParser& p_Parser, float& p_Value)
 {
-  json jsonAsset = p_JsonData["asset"];
+  double value;
+  if (!parseDouble(p_Parser, value))
+  {
+    return false;
+  }
+  p_Value = (float)value;
 
-  tryLoadString(jsonAsset, "copyright", asset.copyright, p_Allocator);
-  tryLoadString(jsonAsset, "generator", asset.generator, p_Allocator);
-  tryLoadString(jsonAsset, "minVersion", asset.minVersion, p_Allocator);
-  tryLoadString(jsonAsset, "version", asset.version, p_Allocator);
+  return true;
 }
 
-static void loadScene(json& p_JsonData, glTF::Scene& p_Scene, Allocator* p_Allocator)
+static bool parseInt(GltfParser& p_Parser, int& p_Value)
 {
-  tryLoadIntArray(p_JsonData, "nodes", p_Scene.nodesCount, &p_Scene.nodes, p_Allocator);
-}
+  skipWhitespace(p_Parser);
 
-static void loadScenes(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
-{
-  json scenes = p_JsonData["scenes"];
+  const char* cursor = p_Parser.m_Cursor;
+  const bool negative = cursor < p_Parser.m_End && *cursor == '-';
+  cursor += negative ? 1 : 0;
 
-  size_t sceneCount = scenes.size();
-  p_GltfData.scenes = (glTF::Scene*)allocateAndZero(p_Allocator, sizeof(glTF::Scene) * sceneCount);
-  p_GltfData.scenesCount = static_cast<uint32_t>(sceneCount);
+  // The magnitude stops growing once it is out of range, so the accumulator can't overflow.
+  const int64_t limit = negative ? -(int64_t)INT_MIN : INT_MAX;
+  const char* digits = cursor;
+  int64_t value = 0;
+  while (cursor < p_Parser.m_End && *cursor >= '0' && *cursor <= '9')
+  {
+    if (value <= limit)
+    {
+      value = value * 10 + (*cursor - '0');
+    }
+    ++cursor;
+  }
 
-  for (size_t i = 0; i < sceneCount; ++i)
+  // Integers written with a fraction or an exponent take the slow path.
+  if (cursor == digits || (cursor < p_Parser.m_End &&
+                           (*cursor == '.' || *cursor == 'e' || *cursor == 'E')))
   {
-    loadScene(scenes[i], p_GltfData.scenes[i], p_Allocator);
+    double fallback;
+    if (!parseDouble(p_Parser, fallback))
+    {
+      return false;
+    }
+    if (!(fallback >= (double)INT_MIN && fallback <= (double)INT_MAX))
+    {
+      return parseError(p_Parser, "integer out of range");
+    }
+    p_Value = (int)fallback;
+    return true;
+  }
+
+  if (value > limit)
+  {
+    return parseError(p_Parser, "integer out of range");
   }
+
+  p_Value = (int)(negative ? -value : value);
+  p_Parser.m_Cursor = cursor;
+
+  return true;
 }
 
-static void loadBuffer(json& p_JsonData, glTF::Buffer& p_Buffer, Allocator* p_Allocator)
+static bool parseBool(GltfParser& p_Parser, bool& p_Value)
 {
-  tryLoadString(p_JsonData, "uri", p_Buffer.uri, p_Allocator);
-  tryLoadInt(p_JsonData, "byteLength", p_Buffer.byteLength);
-  tryLoadString(p_JsonData, "name", p_Buffer.name, p_Allocator);
+  skipWhitespace(p_Parser);
+
+  const size_t remaining = p_Parser.m_End - p_Parser.m_Cursor;
+  if (remaining >= 4 && strncmp(p_Parser.m_Cursor, "true", 4) == 0)
+  {
+    p_Value = true;
+    p_Parser.m_Cursor += 4;
+    return true;
+  }
+  if (remaining >= 5 && strncmp(p_Parser.m_Cursor, "false", 5) == 0)
+  {
+    p_Value = false;
+    p_Parser.m_Cursor += 5;
+    return true;
+  }
+
+  return parseError(p_Parser, "expected a boolean");
 }
 
-static void loadBuffers(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+// Skips unknown values, like extensions and extras.
+static bool skipValue(GltfParser& p_Parser)
 {
-  json buffers = p_JsonData["buffers"];
+  skipWhitespace(p_Parser);
+  if (p_Parser.m_Cursor >= p_Parser.m_End)
+  {
+    return parseError(p_Parser, "unexpected end of file");
+  }
 
-  size_t bufferCount = buffers.size();
-  p_GltfData.buffers =
-      (glTF::Buffer*)allocateAndZero(p_Allocator, sizeof(glTF::Buffer) * bufferCount);
-  p_GltfData.buffersCount = static_cast<uint32_t>(bufferCount);
+  const char first = *p_Parser.m_Cursor;
+  if (first == '"')
+  {
+    StringView text;
+    return parseStringView(p_Parser, text);
+  }
 
-  for (size_t i = 0; i < bufferCount; ++i)
+  const char* cursor = p_Parser.m_Cursor;
+  if (first == '{' || first == '[')
   {
-    loadBuffer(buffers[i], p_GltfData.buffers[i], p_Allocator);
+    // Strings are skipped whole so their brackets are not counted.
+    uint32_t depth = 0;
+    while (cursor < p_Parser.m_End)
+    {
+      const char c = *cursor++;
+      if (c == '"')
+      {
+        while (cursor < p_Parser.m_End && *cursor != '"')
+        {
+          cursor += *cursor == '\\' ? 2 : 1;
+        }
+        ++cursor;
+      }
+      else if (c == '{' || c == '[')
+      {
+        ++depth;
+      }
+      else if ((c == '}' || c == ']') && --depth == 0)
+      {
+        p_Parser.m_Cursor = cursor;
+        return true;
+      }
+    }
+
+    return parseError(p_Parser, "unterminated object or array");
   }
-}
 
-static void loadBufferView(json& p_JsonData, glTF::BufferView& bufferView, Allocator* p_Allocator)
-{
-  tryLoadInt(p_JsonData, "buffer", bufferView.buffer);
-  tryLoadInt(p_JsonData, "byteLength", bufferView.byteLength);
-  tryLoadInt(p_JsonData, "byteOffset", bufferView.byteOffset);
-  tryLoadInt(p_JsonData, "byteStride", bufferView.byteStride);
-  tryLoadInt(p_JsonData, "target", bufferView.target);
-  tryLoadString(p_JsonData, "name", bufferView.name, p_Allocator);
+  // Numbers and literals end at the next separator.
+  while (cursor < p_Parser.m_End && *cursor != ',' && *cursor != '}' && *cursor != ']' &&
+         !isWhitespace(*cursor))
+  {
+    ++cursor;
+  }
+  p_Parser.m_Cursor = cursor;
+
+  return true;
 }
 
-static void loadBufferViews(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+// Calls the field parser for every key of an object. Field parsers skip the keys they ignore.
+template <typename T>
+static bool parseObject(
+    GltfParser& p_Parser,
+    T& p_Value,
+    bool (*p_ParseField)(GltfParser&, const StringView&, T&))
 {
-  json buffers = p_JsonData["bufferViews"];
-
-  size_t bufferCount = buffers.size();
-  p_GltfData.bufferViews =
-      (glTF::BufferView*)allocateAndZero(p_Allocator, sizeof(glTF::BufferView) * bufferCount);
-  p_GltfData.bufferViewsCount = static_cast<uint32_t>(bufferCount);
+  if (!consume(p_Parser, '{'))
+  {
+    return parseError(p_Parser, "expected an object");
+  }
+  if (consume(p_Parser, '}'))
+  {
+    return true;
+  }
 
-  for (size_t i = 0; i < bufferCount; ++i)
+  while (true)
   {
-    loadBufferView(buffers[i], p_GltfData.bufferViews[i], p_Allocator);
+    StringView key;
+    if (!parseStringView(p_Parser, key))
+    {
+      return false;
+    }
+    if (!consume(p_Parser, ':'))
+    {
+      return parseError(p_Parser, "expected ':'");
+    }
+    if (!p_ParseField(p_Parser, key, p_Value))
+    {
+      return false;
+    }
+
+    if (consume(p_Parser, ','))
+    {
+      continue;
+    }
+    if (consume(p_Parser, '}'))
+    {
+      return true;
+    }
+    return parseError(p_Parser, "expected ',' or '}'");
   }
 }
 
-static void load_node(json& p_JsonData, glTF::Node& node, Allocator* p_Allocator)
+//
+// Scratch stack.
+static void pushScratch(GltfParser& p_Parser, const void* p_Element, uint32_t p_Size)
 {
-  tryLoadInt(p_JsonData, "camera", node.camera);
-  tryLoadInt(p_JsonData, "mesh", node.mesh);
-  tryLoadInt(p_JsonData, "skin", node.skin);
-  tryLoadIntArray(p_JsonData, "children", node.childrenCount, &node.children, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "matrix", node.matrixCount, &node.matrix, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "rotation", node.rotationCount, &node.rotation, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "scale", node.scaleCount, &node.scale, p_Allocator);
-  tryLoadFloatArray(
-      p_JsonData, "translation", node.translationCount, &node.translation, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "weights", node.weightsCount, &node.weights, p_Allocator);
-  tryLoadString(p_JsonData, "name", node.name, p_Allocator);
+  Array<uint8_t>& scratch = p_Parser.m_Scratch;
+  const uint32_t offset = scratch.m_Size;
+  scratch.setSize(offset + p_Size);
+  memcpy(scratch.m_Data + offset, p_Element, p_Size);
 }
 
-static void load_nodes(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+// Moves the elements pushed since the start offset into the arena.
+template <typename T>
+static bool
+popScratch(GltfParser& p_Parser, uint32_t p_ScratchStart, uint32_t p_Count, T*& p_Values)
 {
-  json array = p_JsonData["nodes"];
-
-  size_t arrayCount = array.size();
-  p_GltfData.nodes = (glTF::Node*)allocateAndZero(p_Allocator, sizeof(glTF::Node) * arrayCount);
-  p_GltfData.nodesCount = static_cast<uint32_t>(arrayCount);
-
-  for (size_t i = 0; i < arrayCount; ++i)
+  p_Values = nullptr;
+  if (p_Count > 0)
   {
-    load_node(array[i], p_GltfData.nodes[i], p_Allocator);
+    p_Values = (T*)arenaAllocate(p_Parser, sizeof(T) * p_Count, alignof(T));
+    if (p_Values == nullptr)
+    {
+      return false;
+    }
+    memcpy(p_Values, p_Parser.m_Scratch.m_Data + p_ScratchStart, sizeof(T) * p_Count);
   }
+  p_Parser.m_Scratch.setSize(p_ScratchStart);
+
+  return true;
 }
 
-static void
-loadMeshPrimitive(json& p_JsonData, glTF::MeshPrimitive& mesh_primitive, Allocator* p_Allocator)
+// Elements start zeroed, element parsers only set the values that are not zero by default.
+template <typename T>
+static bool parseArray(
+    GltfParser& p_Parser,
+    T*& p_Values,
+    uint32_t& p_Count,
+    bool (*p_ParseElement)(GltfParser&, T&))
 {
-  tryLoadInt(p_JsonData, "indices", mesh_primitive.indices);
-  tryLoadInt(p_JsonData, "material", mesh_primitive.material);
-  tryLoadInt(p_JsonData, "mode", mesh_primitive.mode);
-
-  json attributes = p_JsonData["attributes"];
+  p_Values = nullptr;
+  p_Count = 0;
 
-  mesh_primitive.attributes = (glTF::MeshPrimitive::Attribute*)allocateAndZero(
-      p_Allocator, sizeof(glTF::MeshPrimitive::Attribute) * attributes.size());
-  mesh_primitive.attributeCount = static_cast<uint32_t>(attributes.size());
+  if (!consume(p_Parser, '['))
+  {
+    return parseError(p_Parser, "expected an array");
+  }
 
-  uint32_t index = 0;
-  for (auto jsonAttribute : attributes.items())
+  const uint32_t scratchStart = p_Parser.m_Scratch.m_Size;
+  uint32_t count = 0;
+  if (!consume(p_Parser, ']'))
   {
-    std::string key = jsonAttribute.key();
-    glTF::MeshPrimitive::Attribute& attribute = mesh_primitive.attributes[index];
+    while (true)
+    {
+      T element{};
+      if (!p_ParseElement(p_Parser, element))
+      {
+        return false;
+      }
 
-    attribute.key.init(key.size() + 1, p_Allocator);
-    attribute.key.append(key.c_str());
+      pushScratch(p_Parser, &element, sizeof(T));
+      ++count;
 
-    attribute.accessorIndex = jsonAttribute.value();
+      if (consume(p_Parser, ','))
+      {
+        continue;
+      }
+      if (consume(p_Parser, ']'))
+      {
+        break;
+      }
+      return parseError(p_Parser, "expected ',' or ']'");
+    }
+  }
 
-    ++index;
+  if (!popScratch(p_Parser, scratchStart, count, p_Values))
+  {
+    return false;
   }
+  p_Count = count;
+
+  return true;
 }
 
-static void loadMeshPrimitives(json& p_JsonData, glTF::Mesh& mesh, Allocator* p_Allocator)
+// Optional sub object, allocated only when present.
+template <typename T>
+static bool parseSubObject(
+    GltfParser& p_Parser,
+    T*& p_Value,
+    bool (*p_ParseElement)(GltfParser&, T&))
 {
-  json array = p_JsonData["primitives"];
+  p_Value = (T*)allocateAndZero(p_Parser, sizeof(T));
+  return p_Value != nullptr && p_ParseElement(p_Parser, *p_Value);
+}
 
-  size_t arrayCount = array.size();
-  mesh.primitives =
-      (glTF::MeshPrimitive*)allocateAndZero(p_Allocator, sizeof(glTF::MeshPrimitive) * arrayCount);
-  mesh.primitivesCount = static_cast<uint32_t>(arrayCount);
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    loadMeshPrimitive(array[i], mesh.primitives[i], p_Allocator);
-  }
+//---------------------------------------------------------------------------//
+// glTF elements
+//---------------------------------------------------------------------------//
+static bool parseAssetField(GltfParser& p_Parser, const StringView& p_Key, glTF::Asset& p_Asset)
+{
+  if (keyEquals(p_Key, "copyright"))
+    return parseString(p_Parser, p_Asset.copyright);
+  if (keyEquals(p_Key, "generator"))
+    return parseString(p_Parser, p_Asset.generator);
+  if (keyEquals(p_Key, "minVersion"))
+    return parseString(p_Parser, p_Asset.minVersion);
+  if (keyEquals(p_Key, "version"))
+    return parseString(p_Parser, p_Asset.version);
+  return skipValue(p_Parser);
 }
 
-static void loadMesh(json& p_JsonData, glTF::Mesh& p_Mesh, Allocator* p_Allocator)
+static bool parseSceneField(GltfParser& p_Parser, const StringView& p_Key, glTF::Scene& p_Scene)
 {
-  loadMeshPrimitives(p_JsonData, p_Mesh, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "weights", p_Mesh.weightsCount, &p_Mesh.weights, p_Allocator);
-  tryLoadString(p_JsonData, "name", p_Mesh.name, p_Allocator);
+  if (keyEquals(p_Key, "nodes"))
+    return parseArray(p_Parser, p_Scene.nodes, p_Scene.nodesCount, parseInt);
+  return skipValue(p_Parser);
 }
 
-static void loadMeshes(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseScene(GltfParser& p_Parser, glTF::Scene& p_Scene)
 {
-  json array = p_JsonData["meshes"];
+  return parseObject(p_Parser, p_Scene, parseSceneField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.meshes = (glTF::Mesh*)allocateAndZero(p_Allocator, sizeof(glTF::Mesh) * arrayCount);
-  p_GltfData.meshesCount = static_cast<uint32_t>(arrayCount);
+static bool
+parseBufferField(GltfParser& p_Parser, const StringView& p_Key, glTF::Buffer& p_Buffer)
+{
+  if (keyEquals(p_Key, "uri"))
+    return parseString(p_Parser, p_Buffer.uri);
+  if (keyEquals(p_Key, "byteLength"))
+    return parseInt(p_Parser, p_Buffer.byteLength);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_Buffer.name);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    loadMesh(array[i], p_GltfData.meshes[i], p_Allocator);
-  }
+static bool parseBuffer(GltfParser& p_Parser, glTF::Buffer& p_Buffer)
+{
+  p_Buffer.byteLength = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Buffer, parseBufferField);
 }
 
-static void loadAccessor(json& p_JsonData, glTF::Accessor& accessor, Allocator* p_Allocator)
+static bool
+parseBufferViewField(GltfParser& p_Parser, const StringView& p_Key, glTF::BufferView& p_View)
 {
-  tryLoadInt(p_JsonData, "bufferView", accessor.bufferView);
-  tryLoadInt(p_JsonData, "byteOffset", accessor.byteOffset);
-  tryLoadInt(p_JsonData, "componentType", accessor.componentType);
-  tryLoadInt(p_JsonData, "count", accessor.count);
-  tryLoadInt(p_JsonData, "sparse", accessor.sparse);
-  tryLoadFloatArray(p_JsonData, "max", accessor.maxCount, &accessor.max, p_Allocator);
-  tryLoadFloatArray(p_JsonData, "min", accessor.minCount, &accessor.min, p_Allocator);
-  tryLoadBool(p_JsonData, "normalized", accessor.normalized);
-  tryLoadType(p_JsonData, "type", accessor.type);
+  if (keyEquals(p_Key, "buffer"))
+    return parseInt(p_Parser, p_View.buffer);
+  if (keyEquals(p_Key, "byteLength"))
+    return parseInt(p_Parser, p_View.byteLength);
+  if (keyEquals(p_Key, "byteOffset"))
+    return parseInt(p_Parser, p_View.byteOffset);
+  if (keyEquals(p_Key, "byteStride"))
+    return parseInt(p_Parser, p_View.byteStride);
+  if (keyEquals(p_Key, "target"))
+    return parseInt(p_Parser, p_View.target);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_View.name);
+  return skipValue(p_Parser);
 }
 
-static void loadAccessors(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseBufferView(GltfParser& p_Parser, glTF::BufferView& p_View)
 {
-  json array = p_JsonData["accessors"];
+  p_View.buffer = glTF::INVALID_INT_VALUE;
+  p_View.byteLength = glTF::INVALID_INT_VALUE;
+  p_View.byteOffset = glTF::INVALID_INT_VALUE;
+  p_View.byteStride = glTF::INVALID_INT_VALUE;
+  p_View.target = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_View, parseBufferViewField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.accessors =
-      (glTF::Accessor*)allocateAndZero(p_Allocator, sizeof(glTF::Accessor) * arrayCount);
-  p_GltfData.accessorsCount = static_cast<uint32_t>(arrayCount);
+static bool parseNodeField(GltfParser& p_Parser, const StringView& p_Key, glTF::Node& p_Node)
+{
+  if (keyEquals(p_Key, "camera"))
+    return parseInt(p_Parser, p_Node.camera);
+  if (keyEquals(p_Key, "mesh"))
+    return parseInt(p_Parser, p_Node.mesh);
+  if (keyEquals(p_Key, "skin"))
+    return parseInt(p_Parser, p_Node.skin);
+  if (keyEquals(p_Key, "children"))
+    return parseArray(p_Parser, p_Node.children, p_Node.childrenCount, parseInt);
+  if (keyEquals(p_Key, "matrix"))
+    return parseArray(p_Parser, p_Node.matrix, p_Node.matrixCount, parseFloat);
+  if (keyEquals(p_Key, "rotation"))
+    return parseArray(p_Parser, p_Node.rotation, p_Node.rotationCount, parseFloat);
+  if (keyEquals(p_Key, "scale"))
+    return parseArray(p_Parser, p_Node.scale, p_Node.scaleCount, parseFloat);
+  if (keyEquals(p_Key, "translation"))
+    return parseArray(p_Parser, p_Node.translation, p_Node.translationCount, parseFloat);
+  if (keyEquals(p_Key, "weights"))
+    return parseArray(p_Parser, p_Node.weights, p_Node.weightsCount, parseFloat);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_Node.name);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    loadAccessor(array[i], p_GltfData.accessors[i], p_Allocator);
-  }
+static bool parseNode(GltfParser& p_Parser, glTF::Node& p_Node)
+{
+  p_Node.camera = glTF::INVALID_INT_VALUE;
+  p_Node.mesh = glTF::INVALID_INT_VALUE;
+  p_Node.skin = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Node, parseNodeField);
 }
 
-static void tryLoadTextureInfo(
-    json& p_JsonData, const char* p_Key, glTF::TextureInfo** p_TextureInfo, Allocator* p_Allocator)
+// Attributes are the keys of an object, they are gathered like array elements.
+static bool parseMeshPrimitiveAttributes(GltfParser& p_Parser, glTF::MeshPrimitive& p_Primitive)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  if (!consume(p_Parser, '{'))
   {
-    *p_TextureInfo = nullptr;
-    return;
+    return parseError(p_Parser, "expected an object");
   }
 
-  glTF::TextureInfo* ti = (glTF::TextureInfo*)p_Allocator->allocate(sizeof(glTF::TextureInfo), 64);
+  const uint32_t scratchStart = p_Parser.m_Scratch.m_Size;
+  uint32_t count = 0;
+  if (!consume(p_Parser, '}'))
+  {
+    while (true)
+    {
+      glTF::MeshPrimitive::Attribute attribute;
+      if (!parseString(p_Parser, attribute.key))
+      {
+        return false;
+      }
+      if (!consume(p_Parser, ':'))
+      {
+        return parseError(p_Parser, "expected ':'");
+      }
+      if (!parseInt(p_Parser, attribute.accessorIndex))
+      {
+        return false;
+      }
 
-  tryLoadInt(*it, "index", ti->index);
-  tryLoadInt(*it, "texCoord", ti->texCoord);
+      pushScratch(p_Parser, &attribute, sizeof(attribute));
+      ++count;
 
-  *p_TextureInfo = ti;
-}
+      if (consume(p_Parser, ','))
+      {
+        continue;
+      }
+      if (consume(p_Parser, '}'))
+      {
+        break;
+      }
+      return parseError(p_Parser, "expected ',' or '}'");
+    }
+  }
 
-static void tryLoadMaterialNormalTextureInfo(
-    json& p_JsonData,
-    const char* p_Key,
-    glTF::MaterialNormalTextureInfo** p_TextureInfo,
-    Allocator* p_Allocator)
-{
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  if (!popScratch(p_Parser, scratchStart, count, p_Primitive.attributes))
   {
-    *p_TextureInfo = nullptr;
-    return;
+    return false;
   }
+  p_Primitive.attributeCount = count;
 
-  glTF::MaterialNormalTextureInfo* ti = (glTF::MaterialNormalTextureInfo*)p_Allocator->allocate(
-      sizeof(glTF::MaterialNormalTextureInfo), 64);
+  return true;
+}
 
-  tryLoadInt(*it, "index", ti->index);
-  tryLoadInt(*it, "texCoord", ti->texCoord);
-  tryLoadFloat(*it, "scale", ti->scale);
+static bool parseMeshPrimitiveField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::MeshPrimitive& p_Primitive)
+{
+  if (keyEquals(p_Key, "indices"))
+    return parseInt(p_Parser, p_Primitive.indices);
+  if (keyEquals(p_Key, "material"))
+    return parseInt(p_Parser, p_Primitive.material);
+  if (keyEquals(p_Key, "mode"))
+    return parseInt(p_Parser, p_Primitive.mode);
+  if (keyEquals(p_Key, "attributes"))
+    return parseMeshPrimitiveAttributes(p_Parser, p_Primitive);
+  return skipValue(p_Parser);
+}
 
-  *p_TextureInfo = ti;
+static bool parseMeshPrimitive(GltfParser& p_Parser, glTF::MeshPrimitive& p_Primitive)
+{
+  p_Primitive.indices = glTF::INVALID_INT_VALUE;
+  p_Primitive.material = glTF::INVALID_INT_VALUE;
+  p_Primitive.mode = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Primitive, parseMeshPrimitiveField);
 }
 
-static void tryLoadMaterialOcclusionTextureInfo(
-    json& p_JsonData,
-    const char* p_Key,
-    glTF::MaterialOcclusionTextureInfo** p_TextureInfo,
-    Allocator* p_Allocator)
+static bool parseMeshField(GltfParser& p_Parser, const StringView& p_Key, glTF::Mesh& p_Mesh)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  if (keyEquals(p_Key, "primitives"))
+    return parseArray(p_Parser, p_Mesh.primitives, p_Mesh.primitivesCount, parseMeshPrimitive);
+  if (keyEquals(p_Key, "weights"))
+    return parseArray(p_Parser, p_Mesh.weights, p_Mesh.weightsCount, parseFloat);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_Mesh.name);
+  return skipValue(p_Parser);
+}
+
+static bool parseMesh(GltfParser& p_Parser, glTF::Mesh& p_Mesh)
+{
+  return parseObject(p_Parser, p_Mesh, parseMeshField);
+}
+
+static bool parseAccessorType(GltfParser& p_Parser, glTF::Accessor::Type& p_Type)
+{
+  StringView value;
+  if (!parseStringView(p_Parser, value))
   {
-    *p_TextureInfo = nullptr;
-    return;
+    return false;
   }
 
-  glTF::MaterialOcclusionTextureInfo* ti =
-      (glTF::MaterialOcclusionTextureInfo*)p_Allocator->allocate(
-          sizeof(glTF::MaterialOcclusionTextureInfo), 64);
-
-  tryLoadInt(*it, "index", ti->index);
-  tryLoadInt(*it, "texCoord", ti->texCoord);
-  tryLoadFloat(*it, "strength", ti->strength);
+  if (keyEquals(value, "SCALAR"))
+    p_Type = glTF::Accessor::Type::Scalar;
+  else if (keyEquals(value, "VEC2"))
+    p_Type = glTF::Accessor::Type::Vec2;
+  else if (keyEquals(value, "VEC3"))
+    p_Type = glTF::Accessor::Type::Vec3;
+  else if (keyEquals(value, "VEC4"))
+    p_Type = glTF::Accessor::Type::Vec4;
+  else if (keyEquals(value, "MAT2"))
+    p_Type = glTF::Accessor::Type::Mat2;
+  else if (keyEquals(value, "MAT3"))
+    p_Type = glTF::Accessor::Type::Mat3;
+  else if (keyEquals(value, "MAT4"))
+    p_Type = glTF::Accessor::Type::Mat4;
+  else
+    return parseError(p_Parser, "unknown accessor type");
 
-  *p_TextureInfo = ti;
+  return true;
 }
 
-static void tryLoadMaterialPBRMetallicRoughness(
-    json& p_JsonData,
-    const char* p_Key,
-    glTF::MaterialPBRMetallicRoughness** p_TextureInfo,
-    Allocator* p_Allocator)
+static bool
+parseAccessorField(GltfParser& p_Parser, const StringView& p_Key, glTF::Accessor& p_Accessor)
 {
-  auto it = p_JsonData.find(p_Key);
-  if (it == p_JsonData.end())
+  if (keyEquals(p_Key, "bufferView"))
+    return parseInt(p_Parser, p_Accessor.bufferView);
+  if (keyEquals(p_Key, "byteOffset"))
+    return parseInt(p_Parser, p_Accessor.byteOffset);
+  if (keyEquals(p_Key, "componentType"))
+    return parseInt(p_Parser, p_Accessor.componentType);
+  if (keyEquals(p_Key, "count"))
+    return parseInt(p_Parser, p_Accessor.count);
+  if (keyEquals(p_Key, "max"))
+    return parseArray(p_Parser, p_Accessor.max, p_Accessor.maxCount, parseFloat);
+  if (keyEquals(p_Key, "min"))
+    return parseArray(p_Parser, p_Accessor.min, p_Accessor.minCount, parseFloat);
+  if (keyEquals(p_Key, "normalized"))
+    return parseBool(p_Parser, p_Accessor.normalized);
+  if (keyEquals(p_Key, "type"))
+    return parseAccessorType(p_Parser, p_Accessor.type);
+  // NOTE: sparse accessors are objects, only their presence is recorded.
+  if (keyEquals(p_Key, "sparse"))
   {
-    *p_TextureInfo = nullptr;
-    return;
+    p_Accessor.sparse = 1;
+    return skipValue(p_Parser);
   }
+  return skipValue(p_Parser);
+}
 
-  glTF::MaterialPBRMetallicRoughness* ti =
-      (glTF::MaterialPBRMetallicRoughness*)p_Allocator->allocate(
-          sizeof(glTF::MaterialPBRMetallicRoughness), 64);
+static bool parseAccessor(GltfParser& p_Parser, glTF::Accessor& p_Accessor)
+{
+  p_Accessor.bufferView = glTF::INVALID_INT_VALUE;
+  p_Accessor.byteOffset = glTF::INVALID_INT_VALUE;
+  p_Accessor.componentType = glTF::INVALID_INT_VALUE;
+  p_Accessor.count = glTF::INVALID_INT_VALUE;
+  p_Accessor.sparse = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Accessor, parseAccessorField);
+}
 
-  tryLoadFloatArray(
-      *it, "baseColorFactor", ti->baseColorFactorCount, &ti->baseColorFactor, p_Allocator);
-  tryLoadTextureInfo(*it, "baseColorTexture", &ti->baseColorTexture, p_Allocator);
-  tryLoadFloat(*it, "metallicFactor", ti->metallicFactor);
-  tryLoadTextureInfo(*it, "metallicRoughnessTexture", &ti->metallicRoughnessTexture, p_Allocator);
-  tryLoadFloat(*it, "roughnessFactor", ti->roughnessFactor);
+static bool
+parseTextureInfoField(GltfParser& p_Parser, const StringView& p_Key, glTF::TextureInfo& p_Info)
+{
+  if (keyEquals(p_Key, "index"))
+    return parseInt(p_Parser, p_Info.index);
+  if (keyEquals(p_Key, "texCoord"))
+    return parseInt(p_Parser, p_Info.texCoord);
+  return skipValue(p_Parser);
+}
 
-  *p_TextureInfo = ti;
+static bool parseTextureInfo(GltfParser& p_Parser, glTF::TextureInfo& p_Info)
+{
+  p_Info.index = glTF::INVALID_INT_VALUE;
+  p_Info.texCoord = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Info, parseTextureInfoField);
 }
 
-static void load_material(json& p_JsonData, glTF::Material& material, Allocator* p_Allocator)
+static bool parseNormalTextureInfoField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::MaterialNormalTextureInfo& p_Info)
 {
-  tryLoadFloatArray(
-      p_JsonData,
-      "emissiveFactor",
-      material.emissiveFactorCount,
-      &material.emissiveFactor,
-      p_Allocator);
-  tryLoadFloat(p_JsonData, "alphaCutoff", material.alphaCutoff);
-  tryLoadString(p_JsonData, "alphaMode", material.alphaMode, p_Allocator);
-  tryLoadBool(p_JsonData, "doubleSided", material.doubleSided);
+  if (keyEquals(p_Key, "index"))
+    return parseInt(p_Parser, p_Info.index);
+  if (keyEquals(p_Key, "texCoord"))
+    return parseInt(p_Parser, p_Info.texCoord);
+  if (keyEquals(p_Key, "scale"))
+    return parseFloat(p_Parser, p_Info.scale);
+  return skipValue(p_Parser);
+}
 
-  tryLoadTextureInfo(p_JsonData, "emissiveTexture", &material.emissiveTexture, p_Allocator);
-  tryLoadMaterialNormalTextureInfo(
-      p_JsonData, "normalTexture", &material.normalTexture, p_Allocator);
-  tryLoadMaterialOcclusionTextureInfo(
-      p_JsonData, "occlusionTexture", &material.occlusionTexture, p_Allocator);
-  tryLoadMaterialPBRMetallicRoughness(
-      p_JsonData, "pbrMetallicRoughness", &material.pbrMetallicRoughness, p_Allocator);
+static bool
+parseNormalTextureInfo(GltfParser& p_Parser, glTF::MaterialNormalTextureInfo& p_Info)
+{
+  p_Info.index = glTF::INVALID_INT_VALUE;
+  p_Info.texCoord = glTF::INVALID_INT_VALUE;
+  p_Info.scale = glTF::INVALID_FLOAT_VALUE;
+  return parseObject(p_Parser, p_Info, parseNormalTextureInfoField);
+}
 
-  tryLoadString(p_JsonData, "name", material.name, p_Allocator);
+static bool parseOcclusionTextureInfoField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::MaterialOcclusionTextureInfo& p_Info)
+{
+  if (keyEquals(p_Key, "index"))
+    return parseInt(p_Parser, p_Info.index);
+  if (keyEquals(p_Key, "texCoord"))
+    return parseInt(p_Parser, p_Info.texCoord);
+  if (keyEquals(p_Key, "strength"))
+    return parseFloat(p_Parser, p_Info.strength);
+  return skipValue(p_Parser);
 }
 
-static void loadMaterials(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool
+parseOcclusionTextureInfo(GltfParser& p_Parser, glTF::MaterialOcclusionTextureInfo& p_Info)
 {
-  json array = p_JsonData["materials"];
+  p_Info.index = glTF::INVALID_INT_VALUE;
+  p_Info.texCoord = glTF::INVALID_INT_VALUE;
+  p_Info.strength = glTF::INVALID_FLOAT_VALUE;
+  return parseObject(p_Parser, p_Info, parseOcclusionTextureInfoField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.materials =
-      (glTF::Material*)allocateAndZero(p_Allocator, sizeof(glTF::Material) * arrayCount);
-  p_GltfData.materialsCount = static_cast<uint32_t>(arrayCount);
+static bool parsePbrMetallicRoughnessField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::MaterialPBRMetallicRoughness& p_Pbr)
+{
+  if (keyEquals(p_Key, "baseColorFactor"))
+    return parseArray(p_Parser, p_Pbr.baseColorFactor, p_Pbr.baseColorFactorCount, parseFloat);
+  if (keyEquals(p_Key, "baseColorTexture"))
+    return parseSubObject(p_Parser, p_Pbr.baseColorTexture, parseTextureInfo);
+  if (keyEquals(p_Key, "metallicFactor"))
+    return parseFloat(p_Parser, p_Pbr.metallicFactor);
+  if (keyEquals(p_Key, "metallicRoughnessTexture"))
+    return parseSubObject(p_Parser, p_Pbr.metallicRoughnessTexture, parseTextureInfo);
+  if (keyEquals(p_Key, "roughnessFactor"))
+    return parseFloat(p_Parser, p_Pbr.roughnessFactor);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    load_material(array[i], p_GltfData.materials[i], p_Allocator);
-  }
+static bool
+parsePbrMetallicRoughness(GltfParser& p_Parser, glTF::MaterialPBRMetallicRoughness& p_Pbr)
+{
+  p_Pbr.metallicFactor = glTF::INVALID_FLOAT_VALUE;
+  p_Pbr.roughnessFactor = glTF::INVALID_FLOAT_VALUE;
+  return parseObject(p_Parser, p_Pbr, parsePbrMetallicRoughnessField);
 }
 
-static void loadTexture(json& p_JsonData, glTF::Texture& texture, Allocator* p_Allocator)
+static bool
+parseMaterialField(GltfParser& p_Parser, const StringView& p_Key, glTF::Material& p_Material)
 {
-  tryLoadInt(p_JsonData, "sampler", texture.sampler);
-  tryLoadInt(p_JsonData, "source", texture.source);
-  tryLoadString(p_JsonData, "name", texture.name, p_Allocator);
+  if (keyEquals(p_Key, "emissiveFactor"))
+    return parseArray(
+        p_Parser, p_Material.emissiveFactor, p_Material.emissiveFactorCount, parseFloat);
+  if (keyEquals(p_Key, "alphaCutoff"))
+    return parseFloat(p_Parser, p_Material.alphaCutoff);
+  if (keyEquals(p_Key, "alphaMode"))
+    return parseString(p_Parser, p_Material.alphaMode);
+  if (keyEquals(p_Key, "doubleSided"))
+    return parseBool(p_Parser, p_Material.doubleSided);
+  if (keyEquals(p_Key, "emissiveTexture"))
+    return parseSubObject(p_Parser, p_Material.emissiveTexture, parseTextureInfo);
+  if (keyEquals(p_Key, "normalTexture"))
+    return parseSubObject(p_Parser, p_Material.normalTexture, parseNormalTextureInfo);
+  if (keyEquals(p_Key, "occlusionTexture"))
+    return parseSubObject(p_Parser, p_Material.occlusionTexture, parseOcclusionTextureInfo);
+  if (keyEquals(p_Key, "pbrMetallicRoughness"))
+    return parseSubObject(p_Parser, p_Material.pbrMetallicRoughness, parsePbrMetallicRoughness);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_Material.name);
+  return skipValue(p_Parser);
 }
 
-static void loadTextures(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseMaterial(GltfParser& p_Parser, glTF::Material& p_Material)
 {
-  json array = p_JsonData["textures"];
+  p_Material.alphaCutoff = glTF::INVALID_FLOAT_VALUE;
+  return parseObject(p_Parser, p_Material, parseMaterialField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.textures =
-      (glTF::Texture*)allocateAndZero(p_Allocator, sizeof(glTF::Texture) * arrayCount);
-  p_GltfData.texturesCount = static_cast<uint32_t>(arrayCount);
+static bool
+parseTextureField(GltfParser& p_Parser, const StringView& p_Key, glTF::Texture& p_Texture)
+{
+  if (keyEquals(p_Key, "sampler"))
+    return parseInt(p_Parser, p_Texture.sampler);
+  if (keyEquals(p_Key, "source"))
+    return parseInt(p_Parser, p_Texture.source);
+  if (keyEquals(p_Key, "name"))
+    return parseString(p_Parser, p_Texture.name);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    loadTexture(array[i], p_GltfData.textures[i], p_Allocator);
-  }
+static bool parseTexture(GltfParser& p_Parser, glTF::Texture& p_Texture)
+{
+  p_Texture.sampler = glTF::INVALID_INT_VALUE;
+  p_Texture.source = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Texture, parseTextureField);
 }
 
-static void load_image(json& p_JsonData, glTF::Image& image, Allocator* p_Allocator)
+static bool parseImageField(GltfParser& p_Parser, const StringView& p_Key, glTF::Image& p_Image)
 {
-  tryLoadInt(p_JsonData, "bufferView", image.bufferView);
-  tryLoadString(p_JsonData, "mimeType", image.mimeType, p_Allocator);
-  tryLoadString(p_JsonData, "uri", image.uri, p_Allocator);
+  if (keyEquals(p_Key, "bufferView"))
+    return parseInt(p_Parser, p_Image.bufferView);
+  if (keyEquals(p_Key, "mimeType"))
+    return parseString(p_Parser, p_Image.mimeType);
+  if (keyEquals(p_Key, "uri"))
+    return parseString(p_Parser, p_Image.uri);
+  return skipValue(p_Parser);
 }
 
-static void loadImages(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseImage(GltfParser& p_Parser, glTF::Image& p_Image)
 {
-  json array = p_JsonData["images"];
+  p_Image.bufferView = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Image, parseImageField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.images = (glTF::Image*)allocateAndZero(p_Allocator, sizeof(glTF::Image) * arrayCount);
-  p_GltfData.imagesCount = static_cast<uint32_t>(arrayCount);
+static bool
+parseSamplerField(GltfParser& p_Parser, const StringView& p_Key, glTF::Sampler& p_Sampler)
+{
+  if (keyEquals(p_Key, "magFilter"))
+    return parseInt(p_Parser, p_Sampler.magFilter);
+  if (keyEquals(p_Key, "minFilter"))
+    return parseInt(p_Parser, p_Sampler.minFilter);
+  if (keyEquals(p_Key, "wrapS"))
+    return parseInt(p_Parser, p_Sampler.wrapS);
+  if (keyEquals(p_Key, "wrapT"))
+    return parseInt(p_Parser, p_Sampler.wrapT);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    load_image(array[i], p_GltfData.images[i], p_Allocator);
-  }
+static bool parseSampler(GltfParser& p_Parser, glTF::Sampler& p_Sampler)
+{
+  p_Sampler.magFilter = glTF::INVALID_INT_VALUE;
+  p_Sampler.minFilter = glTF::INVALID_INT_VALUE;
+  p_Sampler.wrapS = glTF::INVALID_INT_VALUE;
+  p_Sampler.wrapT = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Sampler, parseSamplerField);
 }
 
-static void loadSampler(json& p_JsonData, glTF::Sampler& p_Sampler, Allocator* p_Allocator)
+static bool parseSkinField(GltfParser& p_Parser, const StringView& p_Key, glTF::Skin& p_Skin)
 {
-  tryLoadInt(p_JsonData, "magFilter", p_Sampler.magFilter);
-  tryLoadInt(p_JsonData, "minFilter", p_Sampler.minFilter);
-  tryLoadInt(p_JsonData, "wrapS", p_Sampler.wrapS);
-  tryLoadInt(p_JsonData, "wrapT", p_Sampler.wrapT);
+  if (keyEquals(p_Key, "skeleton"))
+    return parseInt(p_Parser, p_Skin.skeletonRootNodeIndex);
+  if (keyEquals(p_Key, "inverseBindMatrices"))
+    return parseInt(p_Parser, p_Skin.inverseBindMatricesBufferIndex);
+  if (keyEquals(p_Key, "joints"))
+    return parseArray(p_Parser, p_Skin.joints, p_Skin.jointsCount, parseInt);
+  return skipValue(p_Parser);
 }
 
-static void loadSamplers(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseSkin(GltfParser& p_Parser, glTF::Skin& p_Skin)
 {
-  json array = p_JsonData["samplers"];
+  p_Skin.skeletonRootNodeIndex = glTF::INVALID_INT_VALUE;
+  p_Skin.inverseBindMatricesBufferIndex = glTF::INVALID_INT_VALUE;
+  return parseObject(p_Parser, p_Skin, parseSkinField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.samplers =
-      (glTF::Sampler*)allocateAndZero(p_Allocator, sizeof(glTF::Sampler) * arrayCount);
-  p_GltfData.samplersCount = static_cast<uint32_t>(arrayCount);
+static bool parseAnimationSamplerField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::AnimationSampler& p_Sampler)
+{
+  if (keyEquals(p_Key, "input"))
+    return parseInt(p_Parser, p_Sampler.m_InputKeyframeBufferIndex);
+  if (keyEquals(p_Key, "output"))
+    return parseInt(p_Parser, p_Sampler.m_OutputKeyframeBufferIndex);
+  if (keyEquals(p_Key, "interpolation"))
+  {
+    StringView value;
+    if (!parseStringView(p_Parser, value))
+    {
+      return false;
+    }
 
-  for (size_t i = 0; i < arrayCount; ++i)
+    if (keyEquals(value, "STEP"))
+      p_Sampler.m_Interpolation = glTF::AnimationSampler::Step;
+    else if (keyEquals(value, "CUBICSPLINE"))
+      p_Sampler.m_Interpolation = glTF::AnimationSampler::CubicSpline;
+    else
+      p_Sampler.m_Interpolation = glTF::AnimationSampler::Linear;
+
+    return true;
+  }
+  return skipValue(p_Parser);
+}
+
+static bool parseAnimationSampler(GltfParser& p_Parser, glTF::AnimationSampler& p_Sampler)
+{
+  p_Sampler.m_InputKeyframeBufferIndex = glTF::INVALID_INT_VALUE;
+  p_Sampler.m_OutputKeyframeBufferIndex = glTF::INVALID_INT_VALUE;
+  p_Sampler.m_Interpolation = glTF::AnimationSampler::Linear;
+  return parseObject(p_Parser, p_Sampler, parseAnimationSamplerField);
+}
+
+static bool parseAnimationTargetField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::AnimationChannel& p_Channel)
+{
+  if (keyEquals(p_Key, "node"))
+    return parseInt(p_Parser, p_Channel.targetNode);
+  if (keyEquals(p_Key, "path"))
   {
-    loadSampler(array[i], p_GltfData.samplers[i], p_Allocator);
+    StringView value;
+    if (!parseStringView(p_Parser, value))
+    {
+      return false;
+    }
+
+    if (keyEquals(value, "scale"))
+      p_Channel.targetType = glTF::AnimationChannel::Scale;
+    else if (keyEquals(value, "rotation"))
+      p_Channel.targetType = glTF::AnimationChannel::Rotation;
+    else if (keyEquals(value, "translation"))
+      p_Channel.targetType = glTF::AnimationChannel::Translation;
+    else if (keyEquals(value, "weights"))
+      p_Channel.targetType = glTF::AnimationChannel::Weights;
+    else
+      return parseError(p_Parser, "unknown animation target path");
+
+    return true;
   }
+  return skipValue(p_Parser);
 }
 
-static void loadSkin(json& p_JsonData, glTF::Skin& p_Skin, Allocator* p_Allocator)
+static bool parseAnimationChannelField(
+    GltfParser& p_Parser, const StringView& p_Key, glTF::AnimationChannel& p_Channel)
 {
-  tryLoadInt(p_JsonData, "skeleton", p_Skin.skeletonRootNodeIndex);
-  tryLoadInt(p_JsonData, "inverseBindMatrices", p_Skin.inverseBindMatricesBufferIndex);
-  tryLoadIntArray(p_JsonData, "joints", p_Skin.jointsCount, &p_Skin.joints, p_Allocator);
+  if (keyEquals(p_Key, "sampler"))
+    return parseInt(p_Parser, p_Channel.sampler);
+  if (keyEquals(p_Key, "target"))
+    return parseObject(p_Parser, p_Channel, parseAnimationTargetField);
+  return skipValue(p_Parser);
 }
 
-static void loadSkins(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseAnimationChannel(GltfParser& p_Parser, glTF::AnimationChannel& p_Channel)
 {
-  json array = p_JsonData["skins"];
+  p_Channel.sampler = glTF::INVALID_INT_VALUE;
+  p_Channel.targetNode = glTF::INVALID_INT_VALUE;
+  p_Channel.targetType = glTF::AnimationChannel::Count;
+  return parseObject(p_Parser, p_Channel, parseAnimationChannelField);
+}
 
-  size_t arrayCount = array.size();
-  p_GltfData.skins = (glTF::Skin*)allocateAndZero(p_Allocator, sizeof(glTF::Skin) * arrayCount);
-  p_GltfData.skinsCount = static_cast<uint32_t>(arrayCount);
+static bool
+parseAnimationField(GltfParser& p_Parser, const StringView& p_Key, glTF::Animation& p_Animation)
+{
+  if (keyEquals(p_Key, "samplers"))
+    return parseArray(
+        p_Parser, p_Animation.samplers, p_Animation.samplersCount, parseAnimationSampler);
+  if (keyEquals(p_Key, "channels"))
+    return parseArray(
+        p_Parser, p_Animation.channels, p_Animation.channelsCount, parseAnimationChannel);
+  return skipValue(p_Parser);
+}
 
-  for (size_t i = 0; i < arrayCount; ++i)
-  {
-    loadSkin(array[i], p_GltfData.skins[i], p_Allocator);
-  }
+static bool parseAnimation(GltfParser& p_Parser, glTF::Animation& p_Animation)
+{
+  return parseObject(p_Parser, p_Animation, parseAnimationField);
 }
 
-static void loadAnimation(json& p_JsonData, glTF::Animation& p_Animation, Allocator* p_Allocator)
+static bool parseGltfField(GltfParser& p_Parser, const StringView& p_Key, glTF::glTF& p_Gltf)
+{
+  if (keyEquals(p_Key, "asset"))
+    return parseObject(p_Parser, p_Gltf.asset, parseAssetField);
+  if (keyEquals(p_Key, "scene"))
+    return parseInt(p_Parser, p_Gltf.scene);
+  if (keyEquals(p_Key, "scenes"))
+    return parseArray(p_Parser, p_Gltf.scenes, p_Gltf.scenesCount, parseScene);
+  if (keyEquals(p_Key, "buffers"))
+    return parseArray(p_Parser, p_Gltf.buffers, p_Gltf.buffersCount, parseBuffer);
+  if (keyEquals(p_Key, "bufferViews"))
+    return parseArray(p_Parser, p_Gltf.bufferViews, p_Gltf.bufferViewsCount, parseBufferView);
+  if (keyEquals(p_Key, "nodes"))
+    return parseArray(p_Parser, p_Gltf.nodes, p_Gltf.nodesCount, parseNode);
+  if (keyEquals(p_Key, "meshes"))
+    return parseArray(p_Parser, p_Gltf.meshes, p_Gltf.meshesCount, parseMesh);
+  if (keyEquals(p_Key, "accessors"))
+    return parseArray(p_Parser, p_Gltf.accessors, p_Gltf.accessorsCount, parseAccessor);
+  if (keyEquals(p_Key, "materials"))
+    return parseArray(p_Parser, p_Gltf.materials, p_Gltf.materialsCount, parseMaterial);
+  if (keyEquals(p_Key, "textures"))
+    return parseArray(p_Parser, p_Gltf.textures, p_Gltf.texturesCount, parseTexture);
+  if (keyEquals(p_Key, "images"))
+    return parseArray(p_Parser, p_Gltf.images, p_Gltf.imagesCount, parseImage);
+  if (keyEquals(p_Key, "samplers"))
+    return parseArray(p_Parser, p_Gltf.samplers, p_Gltf.samplersCount, parseSampler);
+  if (keyEquals(p_Key, "skins"))
+    return parseArray(p_Parser, p_Gltf.skins, p_Gltf.skinsCount, parseSkin);
+  if (keyEquals(p_Key, "animations"))
+    return parseArray(p_Parser, p_Gltf.animations, p_Gltf.animationsCount, parseAnimation);
+  if (keyEquals(p_Key, "extensionsUsed"))
+    return parseArray(
+        p_Parser, p_Gltf.extensionsUsed, p_Gltf.extensionsUsedCount, parseString);
+  if (keyEquals(p_Key, "extensionsRequired"))
+    return parseArray(
+        p_Parser, p_Gltf.extensionsRequired, p_Gltf.extensionsRequiredCount, parseString);
+  return skipValue(p_Parser);
+}
+
+//---------------------------------------------------------------------------//
+// Embedded data
+//---------------------------------------------------------------------------//
+static const uint32_t kGlbMagic = 0x46546C67;     // "glTF"
+static const uint32_t kGlbVersion = 2;
+static const uint32_t kGlbChunkJson = 0x4E4F534A; // "JSON"
+static const uint32_t kGlbChunkBin = 0x004E4942;  // "BIN\0"
+
+struct GlbHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t length;
+};
+
+struct GlbChunkHeader
 {
+  uint32_t length;
+  uint32_t type;
+};
 
-  json jsonArray = p_JsonData.at("samplers");
-  if (jsonArray.is_array())
+static inline uint32_t base64Value(char p_Char)
+{
+  if (p_Char >= 'A' && p_Char <= 'Z')
+    return p_Char - 'A';
+  if (p_Char >= 'a' && p_Char <= 'z')
+    return p_Char - 'a' + 26;
+  if (p_Char >= '0' && p_Char <= '9')
+    return p_Char - '0' + 52;
+  if (p_Char == '+')
+    return 62;
+  if (p_Char == '/')
+    return 63;
+  // Padding
+  return 64;
+}
+
+// Decodes a base64 data uri in the arena. Returns null for any other uri.
+static uint8_t*
+decodeDataUri(const StringBuffer& p_Uri, Allocator* p_Allocator, uint32_t& p_DecodedSize)
+{
+  p_DecodedSize = 0;
+  if (p_Uri.m_Data == nullptr || strncmp(p_Uri.m_Data, "data:", 5) != 0)
   {
-    size_t count = jsonArray.size();
+    return nullptr;
+  }
+
+  const char* payload = strstr(p_Uri.m_Data, ";base64,");
+  if (payload == nullptr)
+  {
+    OutputDebugStringA("Error: only base64 data uris are supported.\n");
+    return nullptr;
+  }
+  payload += 8;
+
+  const size_t payloadLength = p_Uri.m_CurrentSize - (payload - p_Uri.m_Data);
+  uint8_t* decoded = (uint8_t*)p_Allocator->allocate(payloadLength / 4 * 3 + 3, 16);
+  if (decoded == nullptr)
+  {
+    return nullptr;
+  }
 
-    glTF::AnimationSampler* values = (glTF::AnimationSampler*)allocateAndZero(
-        p_Allocator, sizeof(glTF::AnimationSampler) * count);
+  uint32_t bits = 0;
+  uint32_t bitCount = 0;
+  uint32_t decodedSize = 0;
+  for (size_t i = 0; i < payloadLength; ++i)
+  {
+    const uint32_t value = base64Value(payload[i]);
+    if (value == 64)
+    {
+      break;
+    }
 
-    for (size_t i = 0; i < count; ++i)
+    bits = (bits << 6) | value;
+    bitCount += 6;
+    if (bitCount >= 8)
     {
-      json element = jsonArray.at(i);
-      glTF::AnimationSampler& sampler = values[i];
+      bitCount -= 8;
+      decoded[decodedSize++] = (uint8_t)(bits >> bitCount);
+    }
+  }
 
-      tryLoadInt(element, "input", sampler.m_InputKeyframeBufferIndex);
-      tryLoadInt(element, "output", sampler.m_OutputKeyframeBufferIndex);
+  p_DecodedSize = decodedSize;
+  return decoded;
+}
 
-      std::string value = element.value("interpolation", "");
-      if (value == "LINEAR")
-      {
-        sampler.m_Interpolation = glTF::AnimationSampler::Linear;
-      }
-      else if (value == "STEP")
-      {
-        sampler.m_Interpolation = glTF::AnimationSampler::Step;
-      }
-      else if (value == "CUBICSPLINE")
-      {
-        sampler.m_Interpolation = glTF::AnimationSampler::CubicSpline;
-      }
-      else
+// True when a buffer view lies inside its buffer.
+static bool isBufferViewInRange(const glTF::glTF& p_Gltf, const glTF::BufferView& p_BufferView)
+{
+  if (p_BufferView.buffer < 0 || (uint32_t)p_BufferView.buffer >= p_Gltf.buffersCount)
+  {
+    return false;
+  }
+
+  const int64_t offset = glTF::getDataOffset(0, p_BufferView.byteOffset);
+  const int64_t bufferSize = p_Gltf.buffers[p_BufferView.buffer].byteLength;
+  return offset >= 0 && p_BufferView.byteLength >= 0 &&
+         offset + p_BufferView.byteLength <= bufferSize;
+}
+
+// Points buffers and images at their contents when they live in the file or in a data uri. Images
+// in a view of an external buffer keep a null data, the scene resolves them from its mapping.
+static bool
+resolveEmbeddedData(glTF::glTF& p_Gltf, uint8_t* p_BinaryChunk, uint32_t p_BinaryChunkSize)
+{
+  for (uint32_t i = 0; i < p_Gltf.buffersCount; ++i)
+  {
+    glTF::Buffer& buffer = p_Gltf.buffers[i];
+
+    if (buffer.byteLength < 0)
+    {
+      OutputDebugStringA("Error: buffer with a negative byte length.\n");
+      return false;
+    }
+
+    if (buffer.uri.m_Data == nullptr)
+    {
+      // Only the first buffer of a glb can omit its uri, it is the binary chunk.
+      if (i != 0 || p_BinaryChunk == nullptr || (uint32_t)buffer.byteLength > p_BinaryChunkSize)
       {
-        sampler.m_Interpolation = glTF::AnimationSampler::Linear;
+        OutputDebugStringA("Error: buffer without uri outside of a glb binary chunk.\n");
+        return false;
       }
+
+      buffer.data = p_BinaryChunk;
+      continue;
+    }
+
+    if (strncmp(buffer.uri.m_Data, "data:", 5) != 0)
+    {
+      continue;
     }
 
-    p_Animation.samplers = values;
-    p_Animation.samplersCount = static_cast<uint32_t>(count);
+    uint32_t decodedSize;
+    buffer.data = decodeDataUri(buffer.uri, &p_Gltf.allocator, decodedSize);
+    if (buffer.data == nullptr || decodedSize < (uint32_t)buffer.byteLength)
+    {
+      OutputDebugStringA("Error: buffer data uri shorter than the buffer byte length.\n");
+      return false;
+    }
   }
 
-  jsonArray = p_JsonData.at("channels");
-  if (jsonArray.is_array())
+  // Views are read straight from the buffer memory, one past its end would read past the mapping.
+  for (uint32_t i = 0; i < p_Gltf.bufferViewsCount; ++i)
   {
-    size_t count = jsonArray.size();
-
-    glTF::AnimationChannel* values = (glTF::AnimationChannel*)allocateAndZero(
-        p_Allocator, sizeof(glTF::AnimationChannel) * count);
-
-    for (size_t i = 0; i < count; ++i)
+    if (!isBufferViewInRange(p_Gltf, p_Gltf.bufferViews[i]))
     {
-      json element = jsonArray.at(i);
-      glTF::AnimationChannel& channel = values[i];
+      OutputDebugStringA("Error: buffer view out of the range of its buffer.\n");
+      return false;
+    }
+  }
 
-      tryLoadInt(element, "sampler", channel.sampler);
-      json target = element.at("target");
-      tryLoadInt(target, "node", channel.targetNode);
+  for (uint32_t i = 0; i < p_Gltf.imagesCount; ++i)
+  {
+    glTF::Image& image = p_Gltf.images[i];
 
-      std::string targetPath = target.value("path", "");
-      if (targetPath == "scale")
-      {
-        channel.targetType = glTF::AnimationChannel::Scale;
-      }
-      else if (targetPath == "rotation")
-      {
-        channel.targetType = glTF::AnimationChannel::Rotation;
-      }
-      else if (targetPath == "translation")
+    if (image.bufferView != glTF::INVALID_INT_VALUE)
+    {
+      if (image.bufferView < 0 || (uint32_t)image.bufferView >= p_Gltf.bufferViewsCount)
       {
-        channel.targetType = glTF::AnimationChannel::Translation;
+        OutputDebugStringA("Error: image buffer view out of range.\n");
+        return false;
       }
-      else if (targetPath == "weights")
+
+      glTF::BufferView& bufferView = p_Gltf.bufferViews[image.bufferView];
+      uint8_t* bufferData = p_Gltf.buffers[bufferView.buffer].data;
+      if (bufferData != nullptr)
       {
-        channel.targetType = glTF::AnimationChannel::Weights;
+        image.data = bufferData + glTF::getDataOffset(0, bufferView.byteOffset);
+        image.dataSize = bufferView.byteLength;
       }
-      else
+      continue;
+    }
+
+    if (image.uri.m_Data == nullptr)
+    {
+      OutputDebugStringA("Error: image without uri nor buffer view.\n");
+      return false;
+    }
+
+    if (strncmp(image.uri.m_Data, "data:", 5) == 0)
+    {
+      image.data = decodeDataUri(image.uri, &p_Gltf.allocator, image.dataSize);
+      if (image.data == nullptr || image.dataSize == 0)
       {
-        assert(false && "Error parsing target path");
-        channel.targetType = glTF::AnimationChannel::Count;
+        OutputDebugStringA("Error: could not decode image data uri.\n");
+        return false;
       }
     }
+  }
+
+  return true;
+}
 
-    p_Animation.channels = values;
-    p_Animation.channelsCount = static_cast<uint32_t>(count);
+// Upper bound of the arena used by a parse of the text, from a counting pass over it. Every
+// object becomes at most one element or sub object, and every value of an array or member of an
+// object at most one scalar, key or attribute. Strings take no more room than in the text and
+// decoded data uris less. Brackets inside strings are counted too, which only over-reserves.
+static size_t computeArenaSize(const char* p_Text, size_t p_Length)
+{
+  static const size_t kMaxObjectSize = std::max(
+      {sizeof(glTF::Accessor),
+       sizeof(glTF::Animation),
+       sizeof(glTF::AnimationChannel),
+       sizeof(glTF::AnimationSampler),
+       sizeof(glTF::Buffer),
+       sizeof(glTF::BufferView),
+       sizeof(glTF::Image),
+       sizeof(glTF::Material),
+       sizeof(glTF::MaterialNormalTextureInfo),
+       sizeof(glTF::MaterialOcclusionTextureInfo),
+       sizeof(glTF::MaterialPBRMetallicRoughness),
+       sizeof(glTF::Mesh),
+       sizeof(glTF::MeshPrimitive),
+       sizeof(glTF::Node),
+       sizeof(glTF::Sampler),
+       sizeof(glTF::Scene),
+       sizeof(glTF::Skin),
+       sizeof(glTF::Texture),
+       sizeof(glTF::TextureInfo)});
+  static const size_t kMaxValueSize = std::max(
+      {sizeof(float),
+       sizeof(int32_t),
+       sizeof(StringBuffer),
+       sizeof(glTF::MeshPrimitive::Attribute)});
+
+  size_t objects = 0;
+  size_t values = 0;
+  for (size_t i = 0; i < p_Length; ++i)
+  {
+    const char c = p_Text[i];
+    objects += c == '{';
+    values += c == '[' || c == ',' || c == ':';
   }
+
+  // The slack per object covers the alignment of sub objects and data uris.
+  return objects * (kMaxObjectSize + 128) + values * kMaxValueSize + p_Length * 2 +
+         FRAMEWORK_KILO(4);
 }
 
-static void loadAnimations(json& p_JsonData, glTF::glTF& p_GltfData, Allocator* p_Allocator)
+static bool parseGltfJson(glTF::glTF& p_Gltf, const char* p_Text, size_t p_Length)
 {
-  json array = p_JsonData["animations"];
+  Allocator* heapAllocator = &MemoryService::instance()->m_SystemAllocator;
+
+  p_Gltf.allocator.init(computeArenaSize(p_Text, p_Length));
+  if (p_Gltf.allocator.m_Memory == nullptr)
+  {
+    OutputDebugStringA("Error: could not allocate the glTF arena.\n");
+    return false;
+  }
+  p_Gltf.strings.init(p_Length + 1, &p_Gltf.allocator);
+
+  GltfParser parser;
+  parser.m_Begin = p_Text;
+  parser.m_Cursor = p_Text;
+  parser.m_End = p_Text + p_Length;
+  parser.m_Arena = &p_Gltf.allocator;
+  parser.m_Scratch.init(heapAllocator, FRAMEWORK_KILO(64));
+  parser.m_Strings = &p_Gltf.strings;
+  parser.m_StringToOffset.init(heapAllocator, 256);
+  parser.m_StringToOffset.setDefaultValue(UINT32_MAX);
+  parser.m_Error = false;
 
-  size_t arrayCount = array.size();
-  p_GltfData.animations =
-      (glTF::Animation*)allocateAndZero(p_Allocator, sizeof(glTF::Animation) * arrayCount);
-  p_GltfData.animationsCount = static_cast<uint32_t>(arrayCount);
+  const bool parsed = parseObject(parser, p_Gltf, parseGltfField);
+
+  parser.m_StringToOffset.shutdown();
+  parser.m_Scratch.shutdown();
+
+  return parsed;
+}
+
+// A glb is a header followed by a json chunk and an optional binary chunk. The json is parsed in
+// place and the binary chunk stays in the mapping.
+static bool parseGlb(glTF::glTF& p_Gltf, const FileMapping& p_Mapping)
+{
+  const uint8_t* fileEnd = p_Mapping.data + p_Mapping.size;
+
+  const GlbHeader* header = (const GlbHeader*)p_Mapping.data;
+  if (header->version != kGlbVersion)
+  {
+    OutputDebugStringA("Error: unsupported glb version.\n");
+    return false;
+  }
+
+  const GlbChunkHeader* jsonChunk = (const GlbChunkHeader*)(header + 1);
+  const char* jsonText = (const char*)(jsonChunk + 1);
+  if (jsonChunk->type != kGlbChunkJson || (const uint8_t*)jsonText + jsonChunk->length > fileEnd)
+  {
+    OutputDebugStringA("Error: invalid glb json chunk.\n");
+    return false;
+  }
 
-  for (size_t i = 0; i < arrayCount; ++i)
+  if (!parseGltfJson(p_Gltf, jsonText, jsonChunk->length))
   {
-    loadAnimation(array[i], p_GltfData.animations[i], p_Allocator);
+    return false;
   }
+
+  uint8_t* binaryChunk = nullptr;
+  uint32_t binaryChunkSize = 0;
+
+  const uint8_t* nextChunk = (const uint8_t*)jsonText + jsonChunk->length;
+  if (nextChunk + sizeof(GlbChunkHeader) <= fileEnd)
+  {
+    const GlbChunkHeader* binChunk = (const GlbChunkHeader*)nextChunk;
+    if (binChunk->type == kGlbChunkBin &&
+        nextChunk + sizeof(GlbChunkHeader) + binChunk->length <= fileEnd)
+    {
+      binaryChunk = (uint8_t*)(binChunk + 1);
+      binaryChunkSize = binChunk->length;
+    }
+  }
+
+  return resolveEmbeddedData(p_Gltf, binaryChunk, binaryChunkSize);
 }
 
 glTF::glTF gltfLoadFile(const char* p_FilePath)
@@ -681,81 +1517,45 @@ glTF::glTF gltfLoadFile(const char* p_FilePath)
     return result;
   }
 
-  Allocator* heapAllocator = &MemoryService::instance()->m_SystemAllocator;
+  // Both flavours are parsed straight from the mapping, without reading the file in memory.
+  FileMapping mapping = fileMapReadOnly(p_FilePath, FileAccessHint::kSequential);
 
-  FileReadResult readResult = fileReadText(p_FilePath, heapAllocator);
+  bool parsed = false;
+  if (mapping.size >= sizeof(GlbHeader) + sizeof(GlbChunkHeader) &&
+      ((const GlbHeader*)mapping.data)->magic == kGlbMagic)
+  {
+    parsed = parseGlb(result, mapping);
 
-  json gltfData = json::parse(readResult.data);
+    // Buffers reference the binary chunk until gltfFree.
+    result.mapping = mapping;
+  }
+  else if (mapping.data != nullptr)
+  {
+    parsed = parseGltfJson(result, (const char*)mapping.data, mapping.size) &&
+             resolveEmbeddedData(result, nullptr, 0);
 
-  result.allocator.init(FRAMEWORK_MEGA(2));
-  Allocator* allocator = &result.allocator;
+    // Strings were copied out, nothing references the text anymore.
+    fileUnmap(mapping);
+  }
 
-  for (auto properties : gltfData.items())
+  if (!parsed)
   {
-    if (properties.key() == "asset")
-    {
-      loadAsset(gltfData, result.asset, allocator);
-    }
-    else if (properties.key() == "scene")
-    {
-      tryLoadInt(gltfData, "scene", result.scene);
-    }
-    else if (properties.key() == "scenes")
-    {
-      loadScenes(gltfData, result, allocator);
-    }
-    else if (properties.key() == "buffers")
-    {
-      loadBuffers(gltfData, result, allocator);
-    }
-    else if (properties.key() == "bufferViews")
-    {
-      loadBufferViews(gltfData, result, allocator);
-    }
-    else if (properties.key() == "nodes")
-    {
-      load_nodes(gltfData, result, allocator);
-    }
-    else if (properties.key() == "meshes")
-    {
-      loadMeshes(gltfData, result, allocator);
-    }
-    else if (properties.key() == "accessors")
-    {
-      loadAccessors(gltfData, result, allocator);
-    }
-    else if (properties.key() == "materials")
-    {
-      loadMaterials(gltfData, result, allocator);
-    }
-    else if (properties.key() == "textures")
-    {
-      loadTextures(gltfData, result, allocator);
-    }
-    else if (properties.key() == "images")
-    {
-      loadImages(gltfData, result, allocator);
-    }
-    else if (properties.key() == "samplers")
-    {
-      loadSamplers(gltfData, result, allocator);
-    }
-    else if (properties.key() == "skins")
-    {
-      loadSkins(gltfData, result, allocator);
-    }
-    else if (properties.key() == "animations")
-    {
-      loadAnimations(gltfData, result, allocator);
-    }
-  }
+    char msg[256];
+    sprintf(msg, "Error: could not parse glTF file %s.\n", p_FilePath);
+    OutputDebugStringA(msg);
 
-  heapAllocator->deallocate(readResult.data);
+    gltfFree(result);
+    return glTF::glTF{};
+  }
 
   return result;
 }
 
-void gltfFree(glTF::glTF& scene) { scene.allocator.shutdown(); }
+void gltfFree(glTF::glTF& scene)
+{
+  fileUnmap(scene.mapping);
+  scene.allocator.shutdown();
+}
 
 int gltfGetAttributeAccessorIndex(
     glTF::MeshPrimitive::Attribute* p_Attributes,
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "File.hpp"
 #include "Memory.hpp"
 #include "Prerequisites.hpp"
 #include "String.hpp"
@@ -115,6 +116,11 @@ struct Image
   // image/png
   StringBuffer mimeType;
   StringBuffer uri;
+
+  // Encoded contents of images stored in a data uri or a view of an embedded buffer. Null for
+  // external files and for views of external buffers, which the loader of the buffers resolves.
+  uint8_t* data;
+  uint32_t dataSize;
 };
 
 struct Node
@@ -280,6 +286,9 @@ struct Buffer
   int byteLength;
   StringBuffer uri;
   StringBuffer name;
+
+  // Contents of the glb binary chunk or of a data uri, null for external files.
+  uint8_t* data;
 };
 
 struct CameraPerspective
@@ -370,7 +379,11 @@ struct glTF
   uint32_t texturesCount;
   Texture* textures;
 
+  // Every string of the file, interned. The string fields above point into it.
+  StringBuffer strings;
   LinearAllocator allocator;
+  // Kept for glb files, as buffers point into their binary chunk.
+  FileMapping mapping;
 };
 
 int getDataOffset(int p_AccessorOffset, int p_BufferViewOffset);
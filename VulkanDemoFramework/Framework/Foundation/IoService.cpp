@@ -0,0 +1,571 @@
+#include "IoService.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(_WIN64)
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#  define FRAMEWORK_IO_URING
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif
+
+namespace Framework
+{
+static IoService g_IoService;
+IoService* IoService::instance() { return &g_IoService; }
+
+// Single reads are split in chunks the kernel is guaranteed to take in one go.
+static const size_t kMaxReadChunk = 1u << 30;
+//---------------------------------------------------------------------------//
+static void ioLog(const char* p_Message)
+{
+#if defined(_WIN64)
+  OutputDebugStringA(p_Message);
+#else
+  fputs(p_Message, stderr);
+#endif
+}
+//---------------------------------------------------------------------------//
+// Operations:
+//---------------------------------------------------------------------------//
+struct IoOperation
+{
+#if defined(_WIN64)
+  HANDLE file;
+#else
+  int file;
+  struct iovec chunk;
+#endif
+  size_t offset;
+  size_t size;
+  size_t bytesRead;
+  uint8_t* destination;
+  uint64_t userData;
+  bool allocated;
+  bool success;
+  bool inUse;
+};
+//---------------------------------------------------------------------------//
+// Opens the file and resolves the size to read, 0 size requests read to the end of the file.
+static bool ioOpenOperation(const IoReadRequest& p_Request, IoOperation& p_Operation)
+{
+  size_t fileSize = 0;
+#if defined(_WIN64)
+  p_Operation.file = CreateFileA(
+      p_Request.path,
+      GENERIC_READ,
+      FILE_SHARE_READ,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_FLAG_SEQUENTIAL_SCAN,
+      nullptr);
+  if (p_Operation.file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(p_Operation.file, &size))
+    fileSize = (size_t)size.QuadPart;
+#else
+  p_Operation.file = open(p_Request.path, O_RDONLY | O_CLOEXEC);
+  if (p_Operation.file < 0)
+    return false;
+
+  struct stat status;
+  if (fstat(p_Operation.file, &status) == 0)
+    fileSize = (size_t)status.st_size;
+#endif
+
+  p_Operation.offset = p_Request.offset;
+  if (p_Request.size)
+    p_Operation.size = p_Request.size;
+  else
+    p_Operation.size = p_Request.offset < fileSize ? fileSize - p_Request.offset : 0;
+
+  return p_Request.offset + p_Operation.size <= fileSize;
+}
+//---------------------------------------------------------------------------//
+static void ioCloseOperation(IoOperation& p_Operation)
+{
+#if defined(_WIN64)
+  if (p_Operation.file != INVALID_HANDLE_VALUE)
+    CloseHandle(p_Operation.file);
+  p_Operation.file = INVALID_HANDLE_VALUE;
+#else
+  if (p_Operation.file >= 0)
+    close(p_Operation.file);
+  p_Operation.file = -1;
+#endif
+}
+//---------------------------------------------------------------------------//
+// Blocking positional read, used by the worker threads.
+static void ioReadOperation(IoOperation& p_Operation)
+{
+  while (p_Operation.bytesRead < p_Operation.size)
+  {
+    const size_t remaining = p_Operation.size - p_Operation.bytesRead;
+    const size_t chunk = remaining < kMaxReadChunk ? remaining : kMaxReadChunk;
+    const uint64_t position = p_Operation.offset + p_Operation.bytesRead;
+    uint8_t* destination = p_Operation.destination + p_Operation.bytesRead;
+
+#if defined(_WIN64)
+    OVERLAPPED overlapped{};
+    overlapped.Offset = (DWORD)(position & 0xffffffff);
+    overlapped.OffsetHigh = (DWORD)(position >> 32);
+
+    DWORD read = 0;
+    if (!ReadFile(p_Operation.file, destination, (DWORD)chunk, &read, &overlapped) || !read)
+      break;
+#else
+    const ssize_t read = pread(p_Operation.file, destination, chunk, (off_t)position);
+    if (read < 0 && errno == EINTR)
+      continue;
+    if (read <= 0)
+      break;
+#endif
+
+    p_Operation.bytesRead += (size_t)read;
+  }
+
+  p_Operation.success = p_Operation.bytesRead == p_Operation.size;
+}
+//---------------------------------------------------------------------------//
+// io_uring:
+//---------------------------------------------------------------------------//
+#if defined(FRAMEWORK_IO_URING)
+
+// Submission and completion rings shared with the kernel, set up with the raw system calls.
+struct IoUring
+{
+  int fd;
+
+  void* ringMemory;
+  size_t ringMemorySize;
+  struct io_uring_sqe* sqes;
+  size_t sqesSize;
+
+  uint32_t* sqHead;
+  uint32_t* sqTail;
+  uint32_t* sqMask;
+  uint32_t* sqArray;
+
+  uint32_t* cqHead;
+  uint32_t* cqTail;
+  uint32_t* cqMask;
+  struct io_uring_cqe* cqes;
+
+  uint32_t pendingSubmissions;
+};
+//---------------------------------------------------------------------------//
+static bool ioUringInit(IoUring& p_Ring, uint32_t p_Entries)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  p_Ring.fd = (int)syscall(__NR_io_uring_setup, p_Entries, &params);
+  if (p_Ring.fd < 0)
+    return false;
+
+  // Kernels without a single mapping for both rings are old enough to not be worth supporting.
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+  {
+    close(p_Ring.fd);
+    return false;
+  }
+
+  const size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  const size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  p_Ring.ringMemorySize = sqSize > cqSize ? sqSize : cqSize;
+  p_Ring.ringMemory = mmap(
+      nullptr,
+      p_Ring.ringMemorySize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      p_Ring.fd,
+      IORING_OFF_SQ_RING);
+
+  p_Ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(
+      nullptr,
+      p_Ring.sqesSize,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      p_Ring.fd,
+      IORING_OFF_SQES);
+
+  if (p_Ring.ringMemory == MAP_FAILED || sqes == MAP_FAILED)
+  {
+    if (p_Ring.ringMemory != MAP_FAILED)
+      munmap(p_Ring.ringMemory, p_Ring.ringMemorySize);
+    if (sqes != MAP_FAILED)
+      munmap(sqes, p_Ring.sqesSize);
+    close(p_Ring.fd);
+    return false;
+  }
+
+  uint8_t* ring = (uint8_t*)p_Ring.ringMemory;
+  p_Ring.sqes = (struct io_uring_sqe*)sqes;
+  p_Ring.sqHead = (uint32_t*)(ring + params.sq_off.head);
+  p_Ring.sqTail = (uint32_t*)(ring + params.sq_off.tail);
+  p_Ring.sqMask = (uint32_t*)(ring + params.sq_off.ring_mask);
+  p_Ring.sqArray = (uint32_t*)(ring + params.sq_off.array);
+  p_Ring.cqHead = (uint32_t*)(ring + params.cq_off.head);
+  p_Ring.cqTail = (uint32_t*)(ring + params.cq_off.tail);
+  p_Ring.cqMask = (uint32_t*)(ring + params.cq_off.ring_mask);
+  p_Ring.cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+  p_Ring.pendingSubmissions = 0;
+
+  return true;
+}
+//---------------------------------------------------------------------------//
+static void ioUringShutdown(IoUring& p_Ring)
+{
+  munmap(p_Ring.sqes, p_Ring.sqesSize);
+  munmap(p_Ring.ringMemory, p_Ring.ringMemorySize);
+  close(p_Ring.fd);
+}
+//---------------------------------------------------------------------------//
+// Queues a read of what is left of the operation. The ring holds at least one entry per
+// operation, so it cannot be full.
+static void ioUringQueueRead(IoUring& p_Ring, IoOperation& p_Operation, uint32_t p_Index)
+{
+  const uint32_t tail = *p_Ring.sqTail;
+  const uint32_t slot = tail & *p_Ring.sqMask;
+  assert(tail - __atomic_load_n(p_Ring.sqHead, __ATOMIC_ACQUIRE) <= *p_Ring.sqMask);
+
+  const size_t remaining = p_Operation.size - p_Operation.bytesRead;
+  p_Operation.chunk.iov_base = p_Operation.destination + p_Operation.bytesRead;
+  p_Operation.chunk.iov_len = remaining < kMaxReadChunk ? remaining : kMaxReadChunk;
+
+  // Vectored reads are the oldest read opcode, plain reads need a 5.6 kernel.
+  struct io_uring_sqe& sqe = p_Ring.sqes[slot];
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_READV;
+  sqe.fd = p_Operation.file;
+  sqe.off = p_Operation.offset + p_Operation.bytesRead;
+  sqe.addr = (uint64_t)(uintptr_t)&p_Operation.chunk;
+  sqe.len = 1;
+  sqe.user_data = p_Index;
+
+  p_Ring.sqArray[slot] = slot;
+  __atomic_store_n(p_Ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+  ++p_Ring.pendingSubmissions;
+}
+//---------------------------------------------------------------------------//
+static bool ioUringEnter(IoUring& p_Ring, uint32_t p_WaitCount)
+{
+  const uint32_t flags = p_WaitCount ? IORING_ENTER_GETEVENTS : 0;
+  int result;
+  do
+  {
+    result = (int)syscall(
+        __NR_io_uring_enter, p_Ring.fd, p_Ring.pendingSubmissions, p_WaitCount, flags, nullptr, 0);
+  } while (result < 0 && errno == EINTR);
+
+  if (result < 0)
+    return false;
+
+  p_Ring.pendingSubmissions -= (uint32_t)result;
+  return true;
+}
+//---------------------------------------------------------------------------//
+void IoService::reapIoUring(bool p_Wait)
+{
+  IoUring& ring = *m_Ring;
+  if (ring.pendingSubmissions || p_Wait)
+    ioUringEnter(ring, p_Wait ? 1 : 0);
+
+  uint32_t head = *ring.cqHead;
+  const uint32_t tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head)
+  {
+    const struct io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+    const uint32_t operationIndex = (uint32_t)cqe.user_data;
+    IoOperation& operation = m_Operations[operationIndex];
+
+    if (cqe.res > 0)
+      operation.bytesRead += (size_t)cqe.res;
+
+    // Short reads and interrupted ones continue where they stopped.
+    const bool retry = cqe.res == -EINTR || cqe.res == -EAGAIN;
+    if ((cqe.res > 0 || retry) && operation.bytesRead < operation.size)
+    {
+      ioUringQueueRead(ring, operation, operationIndex);
+      continue;
+    }
+
+    operation.success = operation.bytesRead == operation.size;
+    completeOperation(operationIndex);
+  }
+  __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+  if (ring.pendingSubmissions)
+    ioUringEnter(ring, 0);
+}
+
+#else
+
+struct IoUring
+{
+};
+
+void IoService::reapIoUring(bool p_Wait) {}
+
+#endif // FRAMEWORK_IO_URING
+//---------------------------------------------------------------------------//
+// Service:
+//---------------------------------------------------------------------------//
+void IoService::init(void* p_Configuration)
+{
+  IoServiceConfiguration defaultConfiguration;
+  IoServiceConfiguration* configuration =
+      p_Configuration ? static_cast<IoServiceConfiguration*>(p_Configuration)
+                      : &defaultConfiguration;
+
+  Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
+  m_ReadAllocator.init(configuration->ReadMemorySize);
+
+  m_MaxOperations = configuration->MaxReadsInFlight;
+  m_Operations = (IoOperation*)FRAMEWORK_ALLOCA(sizeof(IoOperation) * m_MaxOperations, allocator);
+  memset(m_Operations, 0, sizeof(IoOperation) * m_MaxOperations);
+
+  // Sized so that they never grow, the completed list is pushed to by the workers.
+  m_FreeOperations.init(allocator, m_MaxOperations, m_MaxOperations);
+  for (uint32_t i = 0; i < m_MaxOperations; ++i)
+    m_FreeOperations[i] = m_MaxOperations - 1 - i;
+  m_Completed.init(allocator, m_MaxOperations);
+  m_Queued.init(allocator, m_MaxOperations);
+
+#if defined(FRAMEWORK_IO_URING)
+  m_Ring = (IoUring*)FRAMEWORK_ALLOCA(sizeof(IoUring), allocator);
+  if (ioUringInit(*m_Ring, m_MaxOperations))
+  {
+    ioLog("Io Service Init: io_uring\n");
+    return;
+  }
+
+  // Blocked by seccomp or an old kernel.
+  FRAMEWORK_FREE(m_Ring, allocator);
+  m_Ring = nullptr;
+#endif // FRAMEWORK_IO_URING
+
+  m_Running = true;
+  m_WorkerCount = configuration->WorkerThreadCount ? configuration->WorkerThreadCount : 1;
+  m_Workers = new std::thread[m_WorkerCount];
+  for (uint32_t i = 0; i < m_WorkerCount; ++i)
+    m_Workers[i] = std::thread([this]() { workerLoop(); });
+
+  ioLog("Io Service Init: worker threads\n");
+}
+//---------------------------------------------------------------------------//
+void IoService::shutdown()
+{
+  Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
+
+  if (m_Ring)
+  {
+    // The kernel writes in the destinations until the reads are done.
+    while (inFlightCount() > m_Completed.m_Size)
+      reapIoUring(true);
+
+#if defined(FRAMEWORK_IO_URING)
+    ioUringShutdown(*m_Ring);
+#endif // FRAMEWORK_IO_URING
+    FRAMEWORK_FREE(m_Ring, allocator);
+    m_Ring = nullptr;
+  }
+  else
+  {
+    // Reads not started yet are dropped, the ones in progress are finished by the workers.
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Running = false;
+      m_Queued.clear();
+    }
+    m_WorkAvailable.notify_all();
+
+    for (uint32_t i = 0; i < m_WorkerCount; ++i)
+      m_Workers[i].join();
+    delete[] m_Workers;
+    m_Workers = nullptr;
+    m_WorkerCount = 0;
+  }
+
+  for (uint32_t i = 0; i < m_MaxOperations; ++i)
+  {
+    IoOperation& operation = m_Operations[i];
+    if (!operation.inUse)
+      continue;
+
+    ioCloseOperation(operation);
+    if (operation.allocated)
+      m_ReadAllocator.deallocate(operation.destination);
+  }
+
+  m_Queued.shutdown();
+  m_Completed.shutdown();
+  m_FreeOperations.shutdown();
+  FRAMEWORK_FREE(m_Operations, allocator);
+  m_Operations = nullptr;
+  m_MaxOperations = 0;
+
+  m_ReadAllocator.shutdown();
+  m_OwnerThread = std::thread::id();
+
+  ioLog("Io Service Shutdown\n");
+}
+//---------------------------------------------------------------------------//
+uint32_t IoService::submit(const IoReadRequest* p_Requests, uint32_t p_Count)
+{
+  checkOwnerThread();
+
+  uint32_t accepted = 0;
+  for (; accepted < p_Count && m_FreeOperations.m_Size; ++accepted)
+  {
+    const IoReadRequest& request = p_Requests[accepted];
+    const uint32_t operationIndex = m_FreeOperations.back();
+    IoOperation& operation = m_Operations[operationIndex];
+
+    bool opened = ioOpenOperation(request, operation);
+    operation.bytesRead = 0;
+    operation.userData = request.userData;
+    operation.allocated = false;
+    operation.destination = (uint8_t*)request.destination;
+    if (opened && !operation.destination && operation.size)
+    {
+      operation.destination = (uint8_t*)m_ReadAllocator.allocate(operation.size, 64);
+      operation.allocated = operation.destination != nullptr;
+
+      if (!operation.destination)
+      {
+        ioCloseOperation(operation);
+
+        // Out of read memory, the request waits for reads in flight to be released. With none
+        // left the file can never fit, it fails instead of stalling the queue.
+        if (inFlightCount() > 0)
+          break;
+        opened = false;
+      }
+    }
+
+    m_FreeOperations.pop();
+    operation.inUse = true;
+
+    // Missing files and empty reads complete right away.
+    if (!opened || !operation.size)
+    {
+      operation.success = opened;
+      completeOperation(operationIndex);
+      continue;
+    }
+
+#if defined(FRAMEWORK_IO_URING)
+    if (m_Ring)
+    {
+      ioUringQueueRead(*m_Ring, operation, operationIndex);
+      continue;
+    }
+#endif // FRAMEWORK_IO_URING
+
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Queued.push(operationIndex);
+    }
+    m_WorkAvailable.notify_one();
+  }
+
+#if defined(FRAMEWORK_IO_URING)
+  if (m_Ring && m_Ring->pendingSubmissions)
+    ioUringEnter(*m_Ring, 0);
+#endif // FRAMEWORK_IO_URING
+
+  return accepted;
+}
+//---------------------------------------------------------------------------//
+uint32_t IoService::poll(IoCompletion* p_Completions, uint32_t p_MaxCount)
+{
+  checkOwnerThread();
+
+  if (m_Ring)
+    reapIoUring(false);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  const uint32_t count = p_MaxCount < m_Completed.m_Size ? p_MaxCount : m_Completed.m_Size;
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const uint32_t operationIndex = m_Completed.back();
+    m_Completed.pop();
+
+    IoOperation& operation = m_Operations[operationIndex];
+    ioCloseOperation(operation);
+
+    IoCompletion& completion = p_Completions[i];
+    completion.userData = operation.userData;
+    completion.data = operation.destination;
+    completion.size = operation.bytesRead;
+    completion.success = operation.success;
+    completion.allocated = operation.allocated;
+
+    operation.inUse = false;
+    m_FreeOperations.push(operationIndex);
+  }
+
+  return count;
+}
+//---------------------------------------------------------------------------//
+void IoService::release(const IoCompletion& p_Completion)
+{
+  checkOwnerThread();
+
+  if (p_Completion.allocated)
+    m_ReadAllocator.deallocate(p_Completion.data);
+}
+//---------------------------------------------------------------------------//
+// The free list, the ring and the read allocator are not synchronized: the first thread that
+// submits owns them until shutdown.
+void IoService::checkOwnerThread()
+{
+  const std::thread::id threadId = std::this_thread::get_id();
+  if (m_OwnerThread == std::thread::id())
+    m_OwnerThread = threadId;
+  assert(m_OwnerThread == threadId && "IoService used from more than one thread");
+}
+//---------------------------------------------------------------------------//
+// Called by the workers and by the thread that reaps the ring, poll reads the list concurrently.
+void IoService::completeOperation(uint32_t p_OperationIndex)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Completed.push(p_OperationIndex);
+}
+//---------------------------------------------------------------------------//
+void IoService::workerLoop()
+{
+  while (true)
+  {
+    uint32_t operationIndex;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_WorkAvailable.wait(lock, [this]() { return !m_Running || m_Queued.m_Size; });
+      if (!m_Running)
+        return;
+
+      operationIndex = m_Queued.back();
+      m_Queued.pop();
+    }
+
+    ioReadOperation(m_Operations[operationIndex]);
+    completeOperation(operationIndex);
+  }
+}
+//---------------------------------------------------------------------------//
+} // namespace Framework
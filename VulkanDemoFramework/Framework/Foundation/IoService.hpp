@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Foundation/Array.hpp"
+#include "Foundation/Memory.hpp"
+#include "Foundation/Service.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Framework
+{
+//---------------------------------------------------------------------------//
+struct IoReadRequest
+{
+  const char* path; // Only used while submitting.
+  size_t offset;
+  size_t size;       // 0 reads up to the end of the file.
+  void* destination; // Null reads in a buffer allocated by the service, see IoService::release.
+  uint64_t userData;  // Handed back with the completion, wide enough for a handle on any target.
+}; // struct IoReadRequest
+//---------------------------------------------------------------------------//
+struct IoCompletion
+{
+  uint64_t userData;
+  uint8_t* data;
+  size_t size; // Bytes read.
+  bool success;
+  bool allocated; // Data was allocated by the service and has to be released.
+}; // struct IoCompletion
+//---------------------------------------------------------------------------//
+struct IoServiceConfiguration
+{
+  uint32_t MaxReadsInFlight = 64;
+  uint32_t WorkerThreadCount = 4; // Only used when io_uring is not available.
+  size_t ReadMemorySize = FRAMEWORK_MEGA(128); // For reads without a destination.
+};
+//---------------------------------------------------------------------------//
+struct IoOperation;
+struct IoUring;
+//---------------------------------------------------------------------------//
+/// Batched asynchronous file reads. On Linux reads go through io_uring when the kernel allows it,
+/// otherwise a pool of threads does blocking positional reads. Submit, poll and release must be
+/// called from a single thread, usually the asset loader one: the first thread that submits owns
+/// the service until shutdown, other threads assert.
+struct IoService : public Service
+{
+  FRAMEWORK_DECLARE_SERVICE(IoService);
+
+  void init(void* p_Configuration);
+  void shutdown();
+
+  // Queues a batch of reads. Returns how many were accepted, the others have to be submitted
+  // again once some reads have completed. Reads that don't fit in the read memory even with
+  // nothing in flight complete as failed.
+  uint32_t submit(const IoReadRequest* p_Requests, uint32_t p_Count);
+  // Returns up to p_MaxCount finished reads, without blocking.
+  uint32_t poll(IoCompletion* p_Completions, uint32_t p_MaxCount);
+  // Gives back the buffer of a completed read allocated by the service.
+  void release(const IoCompletion& p_Completion);
+
+  uint32_t inFlightCount() const { return m_MaxOperations - m_FreeOperations.m_Size; }
+  bool usesIoUring() const { return m_Ring != nullptr; }
+
+  void checkOwnerThread();
+  void completeOperation(uint32_t p_OperationIndex);
+  void workerLoop();
+  void reapIoUring(bool p_Wait);
+
+  HeapAllocator m_ReadAllocator;
+
+  IoOperation* m_Operations = nullptr;
+  uint32_t m_MaxOperations = 0;
+  Array<uint32_t> m_FreeOperations;
+
+  // Finished operations, filled by the workers or by reaping the ring.
+  std::mutex m_Mutex;
+  Array<uint32_t> m_Completed;
+
+  // Thread pool fallback
+  std::condition_variable m_WorkAvailable;
+  Array<uint32_t> m_Queued;
+  std::thread* m_Workers = nullptr;
+  uint32_t m_WorkerCount = 0;
+  bool m_Running = false;
+
+  IoUring* m_Ring = nullptr;
+  std::thread::id m_OwnerThread;
+
+  static constexpr const char* ms_Name = "Framework io service";
+
+}; // struct IoService
+//---------------------------------------------------------------------------//
+} // namespace Framework
@@ -1,10 +1,14 @@
 #include "Memory.hpp"
 #include <assert.h>
 
+#include "Foundation/File.hpp"
+
 #include <Externals/tlsf.h>
 
 #include <stdlib.h>
 #include <memory.h>
+#include <mutex>
+#include <new>
 
 #if defined FRAMEWORK_IMGUI
 #  include <Externals/imgui/imgui.h>
@@ -33,11 +37,32 @@ void MemoryService::init(void* p_Configuration)
   OutputDebugStringA("Memory Service Init\n");
   MemoryServiceConfiguration* memoryConfiguration =
       static_cast<MemoryServiceConfiguration*>(p_Configuration);
-  m_SystemAllocator.init(memoryConfiguration ? memoryConfiguration->MaximumDynamicSize : g_Size);
+  const size_t size = memoryConfiguration ? memoryConfiguration->MaximumDynamicSize : g_Size;
+  if (memoryConfiguration && memoryConfiguration->ConcurrentThreadCount)
+    m_SystemAllocator.initConcurrent(size, memoryConfiguration->ConcurrentThreadCount);
+  else
+    m_SystemAllocator.init(size);
+
+  if (memoryConfiguration && memoryConfiguration->TrackAllocations)
+  {
+    m_AllocationTracker.init(memoryConfiguration->MaxTrackedAllocations, 4096);
+    m_AllocationReportPath = memoryConfiguration->AllocationReportPath;
+    m_SystemAllocator.m_Tracker = &m_AllocationTracker;
+  }
 }
 
 void MemoryService::shutdown()
 {
+  if (m_AllocationTracker.isEnabled())
+  {
+    // Allocations still alive here are leaks.
+    if (m_AllocationReportPath)
+      m_AllocationTracker.dumpReport(m_AllocationReportPath);
+
+    m_SystemAllocator.m_Tracker = nullptr;
+    m_AllocationTracker.shutdown();
+  }
+
   m_SystemAllocator.shutdown();
   OutputDebugStringA("Memory Service Shutdown\n");
 }
@@ -84,15 +109,102 @@ void MemoryService::imguiDraw()
   {
 
     m_SystemAllocator.debugUi();
+
+    if (m_AllocationTracker.isEnabled())
+      m_AllocationTracker.debugUi();
   }
   ImGui::End();
 }
 #endif // FRAMEWORK_IMGUI
 
+void MemoryService::newFrame()
+{
+  m_SystemAllocator.trim();
+
+  if (m_AllocationTracker.isEnabled())
+    m_AllocationTracker.newFrame();
+}
+
 void MemoryService::test() { assert(false && "Not implemented"); }
 //---------------------------------------------------------------------------//
 // Heap allocator
 //---------------------------------------------------------------------------//
+static const size_t kHeapChunkGranularity = FRAMEWORK_MEGA(1);
+static const size_t kHeapChunkSize = FRAMEWORK_MEGA(4);
+static const uint32_t kMaxSubHeapChunks = 64;
+static const uint8_t kNoChunkOwner = 0xff;
+
+static const uint32_t kMaxCachedHeapThreadSlots = 4;
+
+// Unique ids, so a concurrent heap created at the address of a destroyed one is not confused with
+// it. Thread ids start at 1, 0 marks a sub-heap without owner.
+static std::atomic<uint32_t> g_HeapIdCounter{0};
+static std::atomic<uint32_t> g_HeapThreadIdCounter{0};
+static thread_local uint32_t t_HeapThreadId = 0;
+
+// Sub-heap index of the calling thread in the last heaps it used.
+struct HeapThreadSlot
+{
+  uint32_t heapId;
+  uint32_t subHeapIndex;
+}; // struct HeapThreadSlot
+static thread_local HeapThreadSlot t_HeapThreadSlots[kMaxCachedHeapThreadSlots];
+static thread_local uint32_t t_NextHeapThreadSlot = 0;
+
+struct alignas(64) HeapSubHeap
+{
+  void* tlsfHandle = nullptr;
+  // Blocks freed by other threads, linked through their first bytes.
+  std::atomic<void*> pendingFrees{nullptr};
+  std::atomic<uint32_t> ownerThreadId{0};
+
+  // Held around the tlsf calls of the sub-heap, by its owner and by trims returning the pending
+  // frees. The last sub-heap is shared by the threads past the maximum count, under this lock.
+  std::mutex mutex;
+  bool shared = false;
+
+  void* chunks[kMaxSubHeapChunks];
+  uint32_t numChunks = 0;
+}; // struct HeapSubHeap
+
+static void* _alignedAllocate(size_t p_Size, size_t p_Alignment)
+{
+#if defined(_WIN64)
+  return _aligned_malloc(p_Size, p_Alignment);
+#else
+  return aligned_alloc(p_Alignment, memoryAlign(p_Size, p_Alignment));
+#endif
+}
+
+static void _alignedFree(void* p_Pointer)
+{
+#if defined(_WIN64)
+  _aligned_free(p_Pointer);
+#else
+  free(p_Pointer);
+#endif
+}
+
+static void _walkHeapPools(HeapAllocator& p_Heap, tlsf_walker p_Walker, void* p_User)
+{
+  if (!p_Heap.m_SubHeaps)
+  {
+    tlsf_walk_pool(tlsf_get_pool(p_Heap.m_TlsfHandle), p_Walker, p_User);
+    return;
+  }
+
+  for (uint32_t i = 0; i <= p_Heap.m_MaxThreads; ++i)
+  {
+    HeapSubHeap& subHeap = p_Heap.m_SubHeaps[i];
+    for (uint32_t c = 0; c < subHeap.numChunks; ++c)
+    {
+      // The first chunk also holds the tlsf control structure.
+      pool_t pool = c == 0 ? tlsf_get_pool(subHeap.tlsfHandle) : subHeap.chunks[c];
+      tlsf_walk_pool(pool, p_Walker, p_User);
+    }
+  }
+}
+
 HeapAllocator::~HeapAllocator() {}
 
 void HeapAllocator::init(size_t p_Size)
@@ -111,13 +223,52 @@ void HeapAllocator::init(size_t p_Size)
   }
 }
 
+void HeapAllocator::initConcurrent(size_t p_Size, uint32_t p_MaxThreads)
+{
+  assert(p_MaxThreads > 0 && p_MaxThreads + 1 < kNoChunkOwner);
+
+  m_Memory = malloc(p_Size);
+  m_MaxSize = p_Size;
+  m_AllocatedSize = 0;
+  m_MaxThreads = p_MaxThreads;
+  m_ChunkOffset = 0;
+  m_HeapId = g_HeapIdCounter.fetch_add(1) + 1;
+  m_ThreadCount = 0;
+
+  // Sub-heaps are created lazily, by their owner thread. One more is shared by extra threads.
+  const uint32_t numSubHeaps = m_MaxThreads + 1;
+  m_SubHeaps =
+      (HeapSubHeap*)_alignedAllocate(sizeof(HeapSubHeap) * numSubHeaps, alignof(HeapSubHeap));
+  for (uint32_t i = 0; i < numSubHeaps; ++i)
+  {
+    new (&m_SubHeaps[i]) HeapSubHeap();
+  }
+  m_SubHeaps[m_MaxThreads].shared = true;
+
+  const size_t numGranules = (p_Size + kHeapChunkGranularity - 1) / kHeapChunkGranularity;
+  m_ChunkOwners = (uint8_t*)malloc(numGranules);
+  memset(m_ChunkOwners, kNoChunkOwner, numGranules);
+
+  {
+    char msg[256];
+    sprintf(
+        msg, "HeapAllocator of size %llu created, %u thread sub-heaps\n", p_Size, p_MaxThreads);
+    OutputDebugStringA(msg);
+  }
+}
+
 void HeapAllocator::shutdown()
 {
 
+  // Other threads are done, return their queued frees before checking.
+  for (uint32_t i = 0; m_SubHeaps && i < m_MaxThreads; ++i)
+  {
+    freePendingBlocks(&m_SubHeaps[i]);
+  }
+
   // Check memory at the application exit.
   MemoryStatistics stats{0, m_MaxSize};
-  pool_t pool = tlsf_get_pool(m_TlsfHandle);
-  tlsf_walk_pool(pool, exitWalker, (void*)&stats);
+  _walkHeapPools(*this, exitWalker, (void*)&stats);
 
   if (stats.m_AllocatedBytes)
   {
@@ -139,7 +290,23 @@ void HeapAllocator::shutdown()
   if (stats.m_AllocatedBytes == 0)
     OutputDebugStringA("Allocations still present. Check your code!");
 
-  tlsf_destroy(m_TlsfHandle);
+  if (m_SubHeaps)
+  {
+    for (uint32_t i = 0; i <= m_MaxThreads; ++i)
+    {
+      if (m_SubHeaps[i].tlsfHandle)
+        tlsf_destroy(m_SubHeaps[i].tlsfHandle);
+      m_SubHeaps[i].~HeapSubHeap();
+    }
+    _alignedFree(m_SubHeaps);
+    free(m_ChunkOwners);
+    m_SubHeaps = nullptr;
+    m_ChunkOwners = nullptr;
+  }
+  else
+  {
+    tlsf_destroy(m_TlsfHandle);
+  }
 
   free(m_Memory);
 }
@@ -151,9 +318,19 @@ void HeapAllocator::debugUi()
   ImGui::Separator();
   ImGui::Text("Heap Allocator");
   ImGui::Separator();
+  if (m_SubHeaps)
+  {
+    // Walking the sub-heaps would race with their owners, show the counters only.
+    ImGui::Text(
+        "\tConcurrent, allocated %llu Mb, reserved chunks %llu Mb, total %llu Mb",
+        m_AllocatedSize.load() / (1024 * 1024),
+        m_ChunkOffset.load() / (1024 * 1024),
+        m_MaxSize / (1024 * 1024));
+    return;
+  }
+
   MemoryStatistics stats{0, m_MaxSize};
-  pool_t pool = tlsf_get_pool(m_TlsfHandle);
-  tlsf_walk_pool(pool, imguiWalker, (void*)&stats);
+  _walkHeapPools(*this, imguiWalker, (void*)&stats);
 
   ImGui::Separator();
   ImGui::Text("\tAllocation count %d", stats.m_AllocationCount);
@@ -165,43 +342,250 @@ void HeapAllocator::debugUi()
 }
 #endif // FRAMEWORK_IMGUI
 
-void* HeapAllocator::allocate(size_t p_Size, size_t p_Alignment)
+static inline void* _tlsfAllocate(void* p_TlsfHandle, size_t p_Size, size_t p_Alignment)
 {
-#if defined(HEAP_ALLOCATOR_STATS)
-  void* allocatedMemory = p_Alignment == 1 ? tlsf_malloc(m_TlsfHandle, p_Size)
-                                           : tlsf_memalign(m_TlsfHandle, p_Alignment, p_Size);
-  size_t actualSize = tlsf_block_size(allocatedMemory);
-  m_AllocatedSize += actualSize;
+  return p_Alignment == 1 ? tlsf_malloc(p_TlsfHandle, p_Size)
+                          : tlsf_memalign(p_TlsfHandle, p_Alignment, p_Size);
+}
 
-  return allocatedMemory;
-#endif // HEAP_ALLOCATOR_STATS
+void* HeapAllocator::allocate(size_t p_Size, size_t p_Alignment)
+{
+  return allocate(p_Size, p_Alignment, nullptr, 0);
 }
 
 void* HeapAllocator::allocate(size_t p_Size, size_t p_Alignment, const char* p_File, int p_Line)
 {
-  return allocate(p_Size, p_Alignment);
+#if defined(HEAP_ALLOCATOR_STATS)
+  void* allocatedMemory = nullptr;
+  size_t actualSize = 0;
+  if (m_SubHeaps)
+  {
+    HeapSubHeap* subHeap = getThreadSubHeap();
+    std::lock_guard<std::mutex> guard(subHeap->mutex);
+    freePendingBlocks(subHeap);
+
+    allocatedMemory =
+        subHeap->tlsfHandle ? _tlsfAllocate(subHeap->tlsfHandle, p_Size, p_Alignment) : nullptr;
+    if (!allocatedMemory)
+    {
+      // Chunk big enough for the block, its alignment and the pool bookkeeping.
+      const size_t chunkSize =
+          p_Size + p_Alignment + tlsf_size() + tlsf_pool_overhead() + tlsf_alloc_overhead();
+      if (!addSubHeapChunk(subHeap, chunkSize))
+      {
+        OutputDebugStringA("HeapAllocator: out of memory\n");
+        return nullptr;
+      }
+      allocatedMemory = _tlsfAllocate(subHeap->tlsfHandle, p_Size, p_Alignment);
+    }
+
+    // Block headers change on frees of their neighbours, read under lock.
+    if (allocatedMemory)
+      actualSize = tlsf_block_size(allocatedMemory);
+  }
+  else
+  {
+    allocatedMemory = _tlsfAllocate(m_TlsfHandle, p_Size, p_Alignment);
+    if (allocatedMemory)
+      actualSize = tlsf_block_size(allocatedMemory);
+  }
+
+  if (!allocatedMemory)
+    return nullptr;
+
+  m_AllocatedSize.fetch_add(actualSize, std::memory_order_relaxed);
+
+  if (m_Tracker)
+    m_Tracker->onAllocate(allocatedMemory, actualSize, p_File, p_Line);
+
+  return allocatedMemory;
+#endif // HEAP_ALLOCATOR_STATS
 }
 
 void HeapAllocator::deallocate(void* p_Pointer)
 {
 #if defined(HEAP_ALLOCATOR_STATS)
+  // Before the block can be reused by another thread.
+  if (m_Tracker && p_Pointer)
+    m_Tracker->onDeallocate(p_Pointer);
+
+  if (m_SubHeaps)
+  {
+    if (!p_Pointer)
+      return;
+
+    const size_t granule = ((uint8_t*)p_Pointer - (uint8_t*)m_Memory) / kHeapChunkGranularity;
+    HeapSubHeap* owner = &m_SubHeaps[m_ChunkOwners[granule]];
+    if (owner->shared)
+    {
+      std::lock_guard<std::mutex> guard(owner->mutex);
+      m_AllocatedSize.fetch_sub(tlsf_block_size(p_Pointer), std::memory_order_relaxed);
+      tlsf_free(owner->tlsfHandle, p_Pointer);
+      return;
+    }
+
+    HeapSubHeap* subHeap = getThreadSubHeap();
+    if (owner != subHeap)
+    {
+      // Only the owner touches its tlsf structures, hand the block back to it.
+      void* head = owner->pendingFrees.load(std::memory_order_relaxed);
+      do
+      {
+        *(void**)p_Pointer = head;
+      } while (!owner->pendingFrees.compare_exchange_weak(
+          head, p_Pointer, std::memory_order_release, std::memory_order_relaxed));
+
+      // Also a chance to return the blocks queued to this thread.
+      if (!subHeap->shared)
+      {
+        std::lock_guard<std::mutex> guard(subHeap->mutex);
+        freePendingBlocks(subHeap);
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> guard(subHeap->mutex);
+    freePendingBlocks(subHeap);
+    m_AllocatedSize.fetch_sub(tlsf_block_size(p_Pointer), std::memory_order_relaxed);
+    tlsf_free(subHeap->tlsfHandle, p_Pointer);
+    return;
+  }
+
   size_t actualSize = tlsf_block_size(p_Pointer);
   m_AllocatedSize -= actualSize;
 
   tlsf_free(m_TlsfHandle, p_Pointer);
 #endif
 }
+
+void HeapAllocator::trim()
+{
+  if (!m_SubHeaps)
+    return;
+
+  // Threads that stopped allocating never drain their own queue. Owners hold their lock for a
+  // single tlsf call, so waiting on it is short.
+  const uint32_t threadCount = m_ThreadCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < threadCount && i < m_MaxThreads; ++i)
+  {
+    HeapSubHeap& subHeap = m_SubHeaps[i];
+    if (!subHeap.pendingFrees.load(std::memory_order_relaxed))
+      continue;
+
+    std::lock_guard<std::mutex> guard(subHeap.mutex);
+    freePendingBlocks(&subHeap);
+  }
+}
+
+HeapSubHeap* HeapAllocator::getThreadSubHeap()
+{
+  for (uint32_t i = 0; i < kMaxCachedHeapThreadSlots; ++i)
+  {
+    if (t_HeapThreadSlots[i].heapId == m_HeapId)
+      return &m_SubHeaps[t_HeapThreadSlots[i].subHeapIndex];
+  }
+
+  if (t_HeapThreadId == 0)
+    t_HeapThreadId = g_HeapThreadIdCounter.fetch_add(1) + 1;
+
+  // Not cached, the thread may still own a sub-heap from before its slot was reused.
+  uint32_t subHeapIndex = m_MaxThreads;
+  const uint32_t threadCount = m_ThreadCount.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < threadCount && i < m_MaxThreads; ++i)
+  {
+    if (m_SubHeaps[i].ownerThreadId.load(std::memory_order_relaxed) == t_HeapThreadId)
+    {
+      subHeapIndex = i;
+      break;
+    }
+  }
+
+  if (subHeapIndex == m_MaxThreads)
+  {
+    // Threads past the maximum count fall back to the shared sub-heap.
+    uint32_t threadIndex = m_ThreadCount.load(std::memory_order_relaxed);
+    while (threadIndex < m_MaxThreads &&
+           !m_ThreadCount.compare_exchange_weak(
+               threadIndex, threadIndex + 1, std::memory_order_acq_rel))
+    {
+    }
+    if (threadIndex < m_MaxThreads)
+    {
+      m_SubHeaps[threadIndex].ownerThreadId.store(t_HeapThreadId, std::memory_order_relaxed);
+      subHeapIndex = threadIndex;
+    }
+  }
+
+  HeapThreadSlot& slot = t_HeapThreadSlots[t_NextHeapThreadSlot];
+  t_NextHeapThreadSlot = (t_NextHeapThreadSlot + 1) % kMaxCachedHeapThreadSlots;
+  slot.heapId = m_HeapId;
+  slot.subHeapIndex = subHeapIndex;
+  return &m_SubHeaps[subHeapIndex];
+}
+
+bool HeapAllocator::addSubHeapChunk(HeapSubHeap* p_SubHeap, size_t p_Size)
+{
+  if (p_SubHeap->numChunks == kMaxSubHeapChunks)
+    return false;
+
+  // Chunks get bigger as the sub-heap grows, to keep their count low.
+  size_t chunkSize = kHeapChunkSize * (p_SubHeap->numChunks + 1);
+  if (chunkSize < p_Size)
+    chunkSize = p_Size;
+  chunkSize = memoryAlign(chunkSize, kHeapChunkGranularity);
+
+  // Lock-free carving. The offset only advances when the chunk fits, so a request that is too
+  // big for the rest of the heap leaves that space to smaller chunks.
+  size_t offset = m_ChunkOffset.load(std::memory_order_relaxed);
+  do
+  {
+    if (chunkSize > m_MaxSize - offset)
+      return false;
+  } while (!m_ChunkOffset.compare_exchange_weak(
+      offset, offset + chunkSize, std::memory_order_relaxed));
+
+  uint8_t* chunk = (uint8_t*)m_Memory + offset;
+  const uint8_t ownerIndex = (uint8_t)(p_SubHeap - m_SubHeaps);
+  memset(
+      m_ChunkOwners + offset / kHeapChunkGranularity,
+      ownerIndex,
+      chunkSize / kHeapChunkGranularity);
+
+  if (p_SubHeap->tlsfHandle)
+    tlsf_add_pool(p_SubHeap->tlsfHandle, chunk, chunkSize);
+  else
+    p_SubHeap->tlsfHandle = tlsf_create_with_pool(chunk, chunkSize);
+
+  p_SubHeap->chunks[p_SubHeap->numChunks++] = chunk;
+  return true;
+}
+
+void HeapAllocator::freePendingBlocks(HeapSubHeap* p_SubHeap)
+{
+  if (!p_SubHeap->pendingFrees.load(std::memory_order_relaxed))
+    return;
+
+  void* block = p_SubHeap->pendingFrees.exchange(nullptr, std::memory_order_acquire);
+  while (block)
+  {
+    void* next = *(void**)block;
+    m_AllocatedSize.fetch_sub(tlsf_block_size(block), std::memory_order_relaxed);
+    tlsf_free(p_SubHeap->tlsfHandle, block);
+    block = next;
+  }
+}
 //---------------------------------------------------------------------------//
 // Linear allocator
 //---------------------------------------------------------------------------//
 LinearAllocator::~LinearAllocator() {}
 
-void LinearAllocator::init(size_t p_Size)
+void LinearAllocator::init(size_t p_Size, Allocator* p_OverflowAllocator)
 {
 
   m_Memory = (uint8_t*)malloc(p_Size);
   m_TotalSize = p_Size;
   m_AllocatedSize = 0;
+  m_OverflowAllocator = p_OverflowAllocator;
 }
 
 void LinearAllocator::shutdown()
@@ -215,12 +599,26 @@ void* LinearAllocator::allocate(size_t p_Size, size_t p_Alignment)
   assert(p_Size > 0);
 
   const size_t newStart = memoryAlign(m_AllocatedSize, p_Alignment);
-  assert(newStart < m_TotalSize);
   const size_t newAllocatedSize = newStart + p_Size;
   if (newAllocatedSize > m_TotalSize)
   {
-    assert(false && "Overflow");
-    return nullptr;
+    if (!m_OverflowAllocator)
+    {
+      assert(false && "Overflow");
+      return nullptr;
+    }
+
+    // The block starts with the link to the previous spill, the data follows aligned.
+    const size_t alignment = p_Alignment > alignof(void*) ? p_Alignment : alignof(void*);
+    const size_t headerSize = memoryAlign(sizeof(void*), alignment);
+    uint8_t* block = (uint8_t*)m_OverflowAllocator->allocate(headerSize + p_Size, alignment);
+    if (!block)
+      return nullptr;
+
+    *(void**)block = m_OverflowBlocks;
+    m_OverflowBlocks = block;
+    m_OverflowSize += p_Size;
+    return block + headerSize;
   }
 
   m_AllocatedSize = newAllocatedSize;
@@ -229,7 +627,10 @@ void* LinearAllocator::allocate(size_t p_Size, size_t p_Alignment)
 
 void* LinearAllocator::allocate(size_t p_Size, size_t p_Alignment, const char* p_File, int p_Line)
 {
-  return allocate(p_Size, p_Alignment);
+  void* memory = allocate(p_Size, p_Alignment);
+  if (m_Tracker && memory)
+    m_Tracker->onTransientAllocate(p_Size, p_File, p_Line);
+  return memory;
 }
 
 void LinearAllocator::deallocate(void*)
@@ -237,7 +638,385 @@ void LinearAllocator::deallocate(void*)
   // This allocator does not allocate on a per-pointer base!
 }
 
-void LinearAllocator::clear() { m_AllocatedSize = 0; }
+void LinearAllocator::clear()
+{
+  m_AllocatedSize = 0;
+
+  while (m_OverflowBlocks)
+  {
+    void* next = *(void**)m_OverflowBlocks;
+    m_OverflowAllocator->deallocate(m_OverflowBlocks);
+    m_OverflowBlocks = next;
+  }
+  m_OverflowSize = 0;
+}
+//---------------------------------------------------------------------------//
+// Thread frame arenas
+//---------------------------------------------------------------------------//
+void ThreadFrameArenas::init(
+    Allocator* p_Allocator, uint32_t p_NumThreads, uint32_t p_NumFrames, size_t p_Size)
+{
+  m_Allocator = p_Allocator;
+  m_NumThreads = p_NumThreads;
+  m_NumFrames = p_NumFrames;
+
+  const uint32_t numArenas = m_NumThreads * m_NumFrames;
+  m_Arenas = (Arena*)m_Allocator->allocate(sizeof(Arena) * numArenas, alignof(Arena));
+  for (uint32_t i = 0; i < numArenas; ++i)
+  {
+    new (&m_Arenas[i]) Arena();
+    m_Arenas[i].allocator.init(p_Size, m_Allocator);
+  }
+
+  m_HighWaterMarks = (size_t*)m_Allocator->allocate(sizeof(size_t) * m_NumThreads, alignof(size_t));
+  memset(m_HighWaterMarks, 0, sizeof(size_t) * m_NumThreads);
+}
+
+void ThreadFrameArenas::shutdown()
+{
+  for (uint32_t i = 0; i < m_NumThreads * m_NumFrames; ++i)
+  {
+    m_Arenas[i].allocator.shutdown();
+    m_Arenas[i].~Arena();
+  }
+
+  m_Allocator->deallocate(m_HighWaterMarks);
+  m_Allocator->deallocate(m_Arenas);
+  m_Arenas = nullptr;
+  m_HighWaterMarks = nullptr;
+}
+
+LinearAllocator* ThreadFrameArenas::get(uint32_t p_ThreadIndex, uint32_t p_FrameIndex)
+{
+  assert(p_ThreadIndex < m_NumThreads && p_FrameIndex < m_NumFrames);
+  return &m_Arenas[p_FrameIndex * m_NumThreads + p_ThreadIndex].allocator;
+}
+
+void ThreadFrameArenas::resetFrame(uint32_t p_FrameIndex)
+{
+  for (uint32_t t = 0; t < m_NumThreads; ++t)
+  {
+    LinearAllocator* arena = get(t, p_FrameIndex);
+    if (arena->getUsedSize() > m_HighWaterMarks[t])
+      m_HighWaterMarks[t] = arena->getUsedSize();
+
+    arena->clear();
+  }
+}
+//---------------------------------------------------------------------------//
+// Allocation tracker
+//---------------------------------------------------------------------------//
+static const uint32_t kInvalidCallsite = 0xffffffff;
+
+static inline uint32_t _roundUpPowerOfTwo(uint32_t p_Value)
+{
+  uint32_t result = 1;
+  while (result < p_Value)
+    result <<= 1;
+  return result;
+}
+
+static inline uint32_t _hashPointer(const void* p_Pointer)
+{
+  return (uint32_t)((((uint64_t)p_Pointer >> 4) * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static int _compareCallsiteBytes(const void* p_A, const void* p_B)
+{
+  const AllocationCallsite* a = (const AllocationCallsite*)p_A;
+  const AllocationCallsite* b = (const AllocationCallsite*)p_B;
+  return a->totalBytes < b->totalBytes ? 1 : (a->totalBytes > b->totalBytes ? -1 : 0);
+}
+
+void AllocationTracker::init(uint32_t p_MaxAllocations, uint32_t p_MaxCallsites)
+{
+  // Tables use malloc, the tracked allocators would recurse.
+  m_MaxAllocations = p_MaxAllocations;
+  const uint32_t allocationSlots = _roundUpPowerOfTwo(p_MaxAllocations * 2);
+  m_AllocationMask = allocationSlots - 1;
+  m_Allocations = (TrackedAllocation*)malloc(sizeof(TrackedAllocation) * allocationSlots);
+  memset(m_Allocations, 0, sizeof(TrackedAllocation) * allocationSlots);
+
+  m_MaxCallsites = p_MaxCallsites;
+  const uint32_t callsiteSlots = _roundUpPowerOfTwo(p_MaxCallsites * 2);
+  m_CallsiteMask = callsiteSlots - 1;
+  m_Callsites = (AllocationCallsite*)malloc(sizeof(AllocationCallsite) * p_MaxCallsites);
+  m_CallsiteSlots = (uint32_t*)malloc(sizeof(uint32_t) * callsiteSlots);
+  memset(m_CallsiteSlots, 0xff, sizeof(uint32_t) * callsiteSlots);
+
+  m_NumAllocations = 0;
+  m_NumCallsites = 0;
+  m_Frame = 0;
+  m_DroppedAllocations = 0;
+}
+
+void AllocationTracker::shutdown()
+{
+  free(m_Allocations);
+  free(m_Callsites);
+  free(m_CallsiteSlots);
+  m_Allocations = nullptr;
+  m_Callsites = nullptr;
+  m_CallsiteSlots = nullptr;
+}
+
+AllocationCallsite* AllocationTracker::getCallsite(const char* p_File, int p_Line)
+{
+  uint32_t slot = (_hashPointer(p_File) ^ ((uint32_t)p_Line * 0x85EBCA6Bu)) & m_CallsiteMask;
+  for (;;)
+  {
+    const uint32_t index = m_CallsiteSlots[slot];
+    if (index == kInvalidCallsite)
+      break;
+
+    AllocationCallsite& callsite = m_Callsites[index];
+    if (callsite.file == p_File && callsite.line == p_Line)
+      return &callsite;
+
+    slot = (slot + 1) & m_CallsiteMask;
+  }
+
+  if (m_NumCallsites == m_MaxCallsites)
+    return nullptr;
+
+  m_CallsiteSlots[slot] = m_NumCallsites;
+  AllocationCallsite& callsite = m_Callsites[m_NumCallsites++];
+  memset(&callsite, 0, sizeof(AllocationCallsite));
+  callsite.file = p_File;
+  callsite.line = p_Line;
+  return &callsite;
+}
+
+void AllocationTracker::onAllocate(void* p_Pointer, size_t p_Size, const char* p_File, int p_Line)
+{
+  std::lock_guard<std::mutex> guard(m_Mutex);
+
+  AllocationCallsite* callsite = getCallsite(p_File, p_Line);
+  if (!callsite || m_NumAllocations == m_MaxAllocations)
+  {
+    ++m_DroppedAllocations;
+    return;
+  }
+
+  ++callsite->count;
+  ++callsite->frameCount;
+  ++callsite->liveCount;
+  callsite->totalBytes += p_Size;
+  callsite->frameBytes += p_Size;
+  callsite->liveBytes += p_Size;
+  if (callsite->liveBytes > callsite->peakLiveBytes)
+    callsite->peakLiveBytes = callsite->liveBytes;
+
+  uint32_t slot = _hashPointer(p_Pointer) & m_AllocationMask;
+  while (m_Allocations[slot].pointer)
+  {
+    slot = (slot + 1) & m_AllocationMask;
+  }
+
+  TrackedAllocation& allocation = m_Allocations[slot];
+  allocation.pointer = p_Pointer;
+  allocation.size = p_Size;
+  allocation.callsite = (uint32_t)(callsite - m_Callsites);
+  allocation.frame = m_Frame;
+  ++m_NumAllocations;
+}
+
+void AllocationTracker::onTransientAllocate(size_t p_Size, const char* p_File, int p_Line)
+{
+  std::lock_guard<std::mutex> guard(m_Mutex);
+
+  AllocationCallsite* callsite = getCallsite(p_File, p_Line);
+  if (!callsite)
+  {
+    ++m_DroppedAllocations;
+    return;
+  }
+
+  ++callsite->count;
+  ++callsite->frameCount;
+  callsite->totalBytes += p_Size;
+  callsite->frameBytes += p_Size;
+}
+
+void AllocationTracker::onDeallocate(void* p_Pointer)
+{
+  std::lock_guard<std::mutex> guard(m_Mutex);
+
+  uint32_t slot = _hashPointer(p_Pointer) & m_AllocationMask;
+  while (m_Allocations[slot].pointer)
+  {
+    if (m_Allocations[slot].pointer == p_Pointer)
+    {
+      AllocationCallsite& callsite = m_Callsites[m_Allocations[slot].callsite];
+      --callsite.liveCount;
+      callsite.liveBytes -= m_Allocations[slot].size;
+
+      removeAllocationSlot(slot);
+      --m_NumAllocations;
+      return;
+    }
+    slot = (slot + 1) & m_AllocationMask;
+  }
+  // Not found: the allocation was dropped or made before tracking started.
+}
+
+void AllocationTracker::removeAllocationSlot(uint32_t p_Slot)
+{
+  // Backward shift deletion, keeps probe sequences intact without tombstones.
+  uint32_t hole = p_Slot;
+  uint32_t next = p_Slot;
+  for (;;)
+  {
+    next = (next + 1) & m_AllocationMask;
+    if (!m_Allocations[next].pointer)
+      break;
+
+    // Entries whose home slot lies cyclically in (hole, next] stay where they are.
+    const uint32_t home = _hashPointer(m_Allocations[next].pointer) & m_AllocationMask;
+    const bool stays = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+    if (stays)
+      continue;
+
+    m_Allocations[hole] = m_Allocations[next];
+    hole = next;
+  }
+  m_Allocations[hole].pointer = nullptr;
+}
+
+void AllocationTracker::newFrame()
+{
+  std::lock_guard<std::mutex> guard(m_Mutex);
+
+  for (uint32_t i = 0; i < m_NumCallsites; ++i)
+  {
+    AllocationCallsite& callsite = m_Callsites[i];
+    callsite.lastFrameCount = callsite.frameCount;
+    callsite.lastFrameBytes = callsite.frameBytes;
+    if (callsite.frameCount > callsite.maxFrameCount)
+      callsite.maxFrameCount = callsite.frameCount;
+
+    callsite.frameCount = 0;
+    callsite.frameBytes = 0;
+  }
+  ++m_Frame;
+}
+
+bool AllocationTracker::dumpReport(const char* p_Path)
+{
+  FileHandle file = nullptr;
+  fileOpen(p_Path, "w", &file);
+  if (!file)
+  {
+    char msg[512];
+    sprintf(msg, "Cannot write allocation report %s\n", p_Path);
+    OutputDebugStringA(msg);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(m_Mutex);
+
+  // Sort a copy, live allocations keep indexing the original array.
+  AllocationCallsite* sorted =
+      (AllocationCallsite*)malloc(sizeof(AllocationCallsite) * (m_NumCallsites + 1));
+  memcpy(sorted, m_Callsites, sizeof(AllocationCallsite) * m_NumCallsites);
+  qsort(sorted, m_NumCallsites, sizeof(AllocationCallsite), _compareCallsiteBytes);
+
+  fprintf(
+      file,
+      "Allocation report, %u frames, %u callsites, %u live allocations, %u dropped\n\n",
+      m_Frame,
+      m_NumCallsites,
+      m_NumAllocations,
+      m_DroppedAllocations);
+  fprintf(
+      file,
+      "%10s %10s %14s %14s %14s %10s %10s %10s %10s  %s\n",
+      "count",
+      "live",
+      "live bytes",
+      "peak bytes",
+      "total bytes",
+      "last frame",
+      "max frame",
+      "avg frame",
+      "last bytes",
+      "callsite");
+  for (uint32_t i = 0; i < m_NumCallsites; ++i)
+  {
+    const AllocationCallsite& callsite = sorted[i];
+    fprintf(
+        file,
+        "%10u %10u %14llu %14llu %14llu %10u %10u %10.2f %10llu  %s(%d)\n",
+        callsite.count,
+        callsite.liveCount,
+        (unsigned long long)callsite.liveBytes,
+        (unsigned long long)callsite.peakLiveBytes,
+        (unsigned long long)callsite.totalBytes,
+        callsite.lastFrameCount,
+        callsite.maxFrameCount,
+        m_Frame ? (double)callsite.count / m_Frame : (double)callsite.count,
+        (unsigned long long)callsite.lastFrameBytes,
+        callsite.file ? callsite.file : "(unknown)",
+        callsite.line);
+  }
+  free(sorted);
+
+  fprintf(file, "\nLive allocations\n");
+  for (uint32_t slot = 0; slot <= m_AllocationMask; ++slot)
+  {
+    const TrackedAllocation& allocation = m_Allocations[slot];
+    if (!allocation.pointer)
+      continue;
+
+    const AllocationCallsite& callsite = m_Callsites[allocation.callsite];
+    fprintf(
+        file,
+        "%p %12llu bytes, frame %u  %s(%d)\n",
+        allocation.pointer,
+        (unsigned long long)allocation.size,
+        allocation.frame,
+        callsite.file ? callsite.file : "(unknown)",
+        callsite.line);
+  }
+
+  fileClose(file);
+  return true;
+}
+
+#if defined FRAMEWORK_IMGUI
+void AllocationTracker::debugUi()
+{
+  ImGui::Separator();
+  ImGui::Text("Allocation tracking");
+  ImGui::Separator();
+
+  if (ImGui::Button("Dump report"))
+    dumpReport("AllocationReport.txt");
+
+  std::lock_guard<std::mutex> guard(m_Mutex);
+  ImGui::Text(
+      "\tFrame %u, %u live allocations, %u callsites, %u dropped",
+      m_Frame,
+      m_NumAllocations,
+      m_NumCallsites,
+      m_DroppedAllocations);
+
+  // Callsites churning the heap in the last frame.
+  for (uint32_t i = 0; i < m_NumCallsites; ++i)
+  {
+    const AllocationCallsite& callsite = m_Callsites[i];
+    if (!callsite.lastFrameCount)
+      continue;
+
+    ImGui::Text(
+        "\t%s(%d): %u allocations, %llu K last frame",
+        callsite.file ? callsite.file : "(unknown)",
+        callsite.line,
+        callsite.lastFrameCount,
+        (unsigned long long)callsite.lastFrameBytes / 1024);
+  }
+}
+#endif // FRAMEWORK_IMGUI
 //---------------------------------------------------------------------------//
 // Memory methods
 //---------------------------------------------------------------------------//
@@ -291,9 +1070,12 @@ void* StackAllocator::allocate(size_t p_Size, size_t p_Alignment)
   return m_Memory + newStart;
 }
 
-void* StackAllocator::allocate(size_t p_Size, size_t p_Alignment, const char* file, int line)
+void* StackAllocator::allocate(size_t p_Size, size_t p_Alignment, const char* p_File, int p_Line)
 {
-  return allocate(p_Size, p_Alignment);
+  void* memory = allocate(p_Size, p_Alignment);
+  if (m_Tracker && memory)
+    m_Tracker->onTransientAllocate(p_Size, p_File, p_Line);
+  return memory;
 }
 
 void StackAllocator::deallocate(void* p_Pointer)
@@ -3,6 +3,9 @@
 #include "Foundation/Prerequisites.hpp"
 #include "Foundation/Service.hpp"
 
+#include <atomic>
+#include <mutex>
+
 #define FRAMEWORK_IMGUI
 
 namespace Framework
@@ -29,6 +32,79 @@ struct MemoryStatistics
   }
 }; // struct MemoryStatistics
 //---------------------------------------------------------------------------//
+// Allocation tracking
+//---------------------------------------------------------------------------//
+struct AllocationCallsite
+{
+  const char* file;
+  int line;
+
+  uint32_t count; // Allocations since tracking started
+  uint32_t liveCount;
+  size_t totalBytes;
+  size_t liveBytes;
+  size_t peakLiveBytes;
+
+  // Churn: allocations in the current frame, the last completed one and the worst one.
+  uint32_t frameCount;
+  uint32_t lastFrameCount;
+  uint32_t maxFrameCount;
+  size_t frameBytes;
+  size_t lastFrameBytes;
+}; // struct AllocationCallsite
+//---------------------------------------------------------------------------//
+struct TrackedAllocation
+{
+  void* pointer; // nullptr for empty slots
+  size_t size;
+  uint32_t callsite;
+  uint32_t frame;
+}; // struct TrackedAllocation
+//---------------------------------------------------------------------------//
+/// Records allocations per callsite for allocators with a tracker set. Heap allocations are kept
+/// in an open addressing table until freed, stack and linear ones only count as churn.
+struct AllocationTracker
+{
+  void init(uint32_t p_MaxAllocations, uint32_t p_MaxCallsites);
+  void shutdown();
+
+  void onAllocate(void* p_Pointer, size_t p_Size, const char* p_File, int p_Line);
+  void onTransientAllocate(size_t p_Size, const char* p_File, int p_Line);
+  void onDeallocate(void* p_Pointer);
+
+  // Closes the per-frame churn counters of every callsite.
+  void newFrame();
+
+  // Writes the callsites sorted by allocated bytes, followed by the live allocations.
+  bool dumpReport(const char* p_Path);
+
+#if defined FRAMEWORK_IMGUI
+  void debugUi();
+#endif // FRAMEWORK_IMGUI
+
+  bool isEnabled() const { return m_Allocations != nullptr; }
+
+  AllocationCallsite* getCallsite(const char* p_File, int p_Line);
+  void removeAllocationSlot(uint32_t p_Slot);
+
+  TrackedAllocation* m_Allocations = nullptr;
+  uint32_t m_AllocationMask = 0;
+  uint32_t m_NumAllocations = 0;
+  uint32_t m_MaxAllocations = 0;
+
+  // Dense callsite array, indexed through an open addressing table.
+  AllocationCallsite* m_Callsites = nullptr;
+  uint32_t* m_CallsiteSlots = nullptr;
+  uint32_t m_CallsiteMask = 0;
+  uint32_t m_NumCallsites = 0;
+  uint32_t m_MaxCallsites = 0;
+
+  uint32_t m_Frame = 0;
+  uint32_t m_DroppedAllocations = 0;
+
+  std::mutex m_Mutex;
+}; // struct AllocationTracker
+//---------------------------------------------------------------------------//
 struct Allocator
 {
   virtual ~Allocator() {}
@@ -38,13 +114,24 @@ struct Allocator
   virtual void deallocate(void* p_Pointer) = 0;
 }; // struct Allocator
 //---------------------------------------------------------------------------//
+struct HeapSubHeap;
+
 struct HeapAllocator : public Allocator
 {
   ~HeapAllocator() override;
 
   void init(size_t p_Size);
+  // Concurrent mode: every thread allocates from its own TLSF sub-heap, grown with chunks of the
+  // reserved memory. Memory freed by another thread is queued and returned by the owner thread on
+  // its next allocation or free, or by the next trim. The first p_MaxThreads threads get their own
+  // sub-heap, later ones share a sub-heap behind a lock.
+  void initConcurrent(size_t p_Size, uint32_t p_MaxThreads);
   void shutdown();
 
+  // Returns the memory freed by other threads to every sub-heap, including the ones of threads
+  // that no longer allocate. Called once per frame by the memory service.
+  void trim();
+
 #if defined FRAMEWORK_IMGUI
   void debugUi();
 #endif // FRAMEWORK_IMGUI
@@ -54,11 +141,27 @@ struct HeapAllocator : public Allocator
 
   void deallocate(void* p_Pointer) override;
 
-  void* m_TlsfHandle;
-  void* m_Memory;
-  size_t m_AllocatedSize = 0;
+  void* m_TlsfHandle = nullptr;
+  void* m_Memory = nullptr;
+  std::atomic<size_t> m_AllocatedSize{0};
   size_t m_MaxSize = 0;
 
+  // Concurrent mode
+  HeapSubHeap* getThreadSubHeap();
+  bool addSubHeapChunk(HeapSubHeap* p_SubHeap, size_t p_Size);
+  void freePendingBlocks(HeapSubHeap* p_SubHeap);
+
+  AllocationTracker* m_Tracker = nullptr;
+
+  HeapSubHeap* m_SubHeaps = nullptr;
+  // Owning sub-heap of every chunk granule of m_Memory.
+  uint8_t* m_ChunkOwners = nullptr;
+  std::atomic<size_t> m_ChunkOffset{0};
+  uint32_t m_MaxThreads = 0;
+  // Threads that got a sub-heap, in order of their first use of the heap.
+  std::atomic<uint32_t> m_ThreadCount{0};
+  uint32_t m_HeapId = 0;
+
 }; // struct HeapAllocator
 //---------------------------------------------------------------------------//
 struct StackAllocator : public Allocator
@@ -80,6 +183,7 @@ struct StackAllocator : public Allocator
   uint8_t* m_Memory = nullptr;
   size_t m_TotalSize = 0;
   size_t m_AllocatedSize = 0;
+  AllocationTracker* m_Tracker = nullptr;
 
 }; // struct StackAllocator
 //---------------------------------------------------------------------------//
@@ -120,7 +224,9 @@ struct LinearAllocator : public Allocator
 {
   ~LinearAllocator();
 
-  void init(size_t p_Size);
+  // Without an overflow allocator running out of space asserts and returns nullptr. With one,
+  // allocations that don't fit spill to it and are freed by the next clear.
+  void init(size_t p_Size, Allocator* p_OverflowAllocator = nullptr);
   void shutdown();
 
   void* allocate(size_t p_Size, size_t p_Alignment) override;
@@ -130,11 +236,49 @@ struct LinearAllocator : public Allocator
 
   void clear();
 
+  // Linear part plus spilled bytes.
+  size_t getUsedSize() const { return m_AllocatedSize + m_OverflowSize; }
+
   uint8_t* m_Memory = nullptr;
   size_t m_TotalSize = 0;
   size_t m_AllocatedSize = 0;
+  AllocationTracker* m_Tracker = nullptr;
+
+  // Spilled blocks, linked through a header in front of each.
+  Allocator* m_OverflowAllocator = nullptr;
+  void* m_OverflowBlocks = nullptr;
+  size_t m_OverflowSize = 0;
 }; // struct LinearAllocator
 //---------------------------------------------------------------------------//
+/// Linear allocators per thread and per frame in flight. A thread only touches its own arena, so
+/// allocating never takes a lock, and all the arenas of a frame are cleared together. Arenas spill
+/// to p_Allocator when full, which has to accept frees from the thread clearing the frame.
+struct ThreadFrameArenas
+{
+  void init(Allocator* p_Allocator, uint32_t p_NumThreads, uint32_t p_NumFrames, size_t p_Size);
+  void shutdown();
+
+  LinearAllocator* get(uint32_t p_ThreadIndex, uint32_t p_FrameIndex);
+  // Clears the arenas of the frame, updating the high-water marks first.
+  void resetFrame(uint32_t p_FrameIndex);
+
+  // Peak bytes used by a thread in a single frame, spills included: a peak above the arena size
+  // means the arenas should grow.
+  size_t getHighWaterMark(uint32_t p_ThreadIndex) const { return m_HighWaterMarks[p_ThreadIndex]; }
+
+  // Padded to a cache line so threads never write to the same line.
+  struct alignas(64) Arena
+  {
+    LinearAllocator allocator;
+  }; // struct Arena
+
+  Arena* m_Arenas = nullptr;
+  size_t* m_HighWaterMarks = nullptr;
+  Allocator* m_Allocator = nullptr;
+  uint32_t m_NumThreads = 0;
+  uint32_t m_NumFrames = 0;
+}; // struct ThreadFrameArenas
+//---------------------------------------------------------------------------//
 /// DANGER: this should be used for NON runtime processes, like compilation of resources.
 struct MallocAllocator : public Allocator
 {
@@ -149,6 +293,12 @@ struct MallocAllocator : public Allocator
 struct MemoryServiceConfiguration
 {
   size_t MaximumDynamicSize = 32 * 1024 * 1024; // Defaults to max 32MB of dynamic memory.
+  uint32_t ConcurrentThreadCount = 0; // Non zero enables per-thread sub-heaps.
+
+  // Track system allocator allocations per callsite, writing a report at shutdown if a path is set.
+  bool TrackAllocations = false;
+  uint32_t MaxTrackedAllocations = 1024 * 1024;
+  const char* AllocationReportPath = nullptr;
 };
 //---------------------------------------------------------------------------//
 struct MemoryService : public Service
@@ -158,6 +308,11 @@ struct MemoryService : public Service
   void init(void* p_Configuration);
   void shutdown();
 
+  // Advances the frame number of tracked allocations and trims the system allocator sub-heap of
+  // the calling thread only. Threads that stop allocating keep memory freed to them by others
+  // until they call m_SystemAllocator.trim() themselves.
+  void newFrame();
+
 #if defined FRAMEWORK_IMGUI
   void imguiDraw();
 #endif // FRAMEWORK_IMGUI
@@ -166,6 +321,9 @@ struct MemoryService : public Service
   LinearAllocator m_ScratchAllocator;
   HeapAllocator m_SystemAllocator;
 
+  AllocationTracker m_AllocationTracker;
+  const char* m_AllocationReportPath = nullptr;
+
   //
   // Test allocators.
   void test();
@@ -4,9 +4,11 @@ namespace Framework
 {
 //---------------------------------------------------------------------------//
 // Static buffer to log the error coming from windows.
+// Per-thread so that processes can be executed concurrently from task threads.
 static const uint32_t kProcessLogBuffer = 256;
-char g_ProcessLogBuffer[kProcessLogBuffer];
-static char g_ProcessOutputBuffer[1025];
+thread_local char g_ProcessLogBuffer[kProcessLogBuffer];
+static const uint32_t kProcessOutputBuffer = 1024;
+static thread_local char g_ProcessOutputBuffer[kProcessOutputBuffer + 1];
 //---------------------------------------------------------------------------//
 void win32GetError(char* p_Buffer, uint32_t p_Size)
 {
@@ -52,30 +54,65 @@ bool processExecute(
   if (ok == FALSE)
     return false;
 
+  // The parent ends of the pipes stay in this process.
+  SetHandleInformation(handleStdinPipeWrite, HANDLE_FLAG_INHERIT, 0);
+  SetHandleInformation(handleStdoutPipeRead, HANDLE_FLAG_INHERIT, 0);
+
+  // Other task threads create inheritable pipes at the same time: restrict inheritance to the
+  // child ends of these pipes, or every child would keep the other children's pipes open and
+  // their readers would never see the end of the output.
+  HANDLE inheritedHandles[] = {handleStdinPipeRead, handleStdPipeWrite};
+
+  SIZE_T attributeListSize = 0;
+  InitializeProcThreadAttributeList(NULL, 1, 0, &attributeListSize);
+  LPPROC_THREAD_ATTRIBUTE_LIST attributeList =
+      (LPPROC_THREAD_ATTRIBUTE_LIST)HeapAlloc(GetProcessHeap(), 0, attributeListSize);
+
+  ok = attributeList != NULL &&
+       InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize);
+  if (ok == FALSE)
+  {
+    HeapFree(GetProcessHeap(), 0, attributeList);
+    CloseHandle(handleStdinPipeRead);
+    CloseHandle(handleStdinPipeWrite);
+    CloseHandle(handleStdoutPipeRead);
+    CloseHandle(handleStdPipeWrite);
+    return false;
+  }
+  ok = UpdateProcThreadAttribute(
+      attributeList,
+      0,
+      PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+      inheritedHandles,
+      sizeof(inheritedHandles),
+      NULL,
+      NULL);
+
   // Create startup informations with std redirection
-  STARTUPINFOA startupInfo = {};
-  startupInfo.cb = sizeof(startupInfo);
-  startupInfo.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
-  startupInfo.hStdInput = handleStdinPipeRead;
-  startupInfo.hStdError = handleStdPipeWrite;
-  startupInfo.hStdOutput = handleStdPipeWrite;
-  startupInfo.wShowWindow = SW_SHOW;
+  STARTUPINFOEXA startupInfo = {};
+  startupInfo.StartupInfo.cb = sizeof(startupInfo);
+  startupInfo.StartupInfo.dwFlags = STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
+  startupInfo.StartupInfo.hStdInput = handleStdinPipeRead;
+  startupInfo.StartupInfo.hStdError = handleStdPipeWrite;
+  startupInfo.StartupInfo.hStdOutput = handleStdPipeWrite;
+  startupInfo.StartupInfo.wShowWindow = SW_SHOW;
+  startupInfo.lpAttributeList = attributeList;
 
   bool executionSuccess = false;
   // Execute the process
   PROCESS_INFORMATION processInfo = {};
   BOOL inheritHandles = TRUE;
-  if (CreateProcessA(
-          p_ProcessFullpath,
-          (char*)p_Arguments,
-          0,
-          0,
-          inheritHandles,
-          0,
-          0,
-          p_WorkingDirectory,
-          &startupInfo,
-          &processInfo))
+  if (ok != FALSE && CreateProcessA(
+                         p_ProcessFullpath,
+                         (char*)p_Arguments,
+                         0,
+                         0,
+                         inheritHandles,
+                         EXTENDED_STARTUPINFO_PRESENT,
+                         0,
+                         p_WorkingDirectory,
+                         &startupInfo.StartupInfo,
+                         &processInfo))
   {
 
     CloseHandle(processInfo.hThread);
@@ -100,26 +137,38 @@ bool processExecute(
     sprintf(msg2, "Message: %s\n", g_ProcessLogBuffer);
     OutputDebugStringA(msg2);
   }
+  DeleteProcThreadAttributeList(attributeList);
+  HeapFree(GetProcessHeap(), 0, attributeList);
+
   CloseHandle(handleStdinPipeRead);
   CloseHandle(handleStdPipeWrite);
 
   // Output
-  DWORD bytesRead;
-  ok = ReadFile(handleStdoutPipeRead, g_ProcessOutputBuffer, 1024, &bytesRead, nullptr);
+  // Consume all outputs, appending each read after the previous ones. Once the buffer is full the
+  // rest is read and dropped, so that the process never blocks on a full pipe.
+  uint32_t outputSize = 0;
+  char discarded[256];
+  while (true)
+  {
+    const bool full = outputSize == kProcessOutputBuffer;
+    char* destination = full ? discarded : g_ProcessOutputBuffer + outputSize;
+    const DWORD capacity = full ? sizeof(discarded) : kProcessOutputBuffer - outputSize;
+
+    DWORD bytesRead = 0;
+    ok = ReadFile(handleStdoutPipeRead, destination, capacity, &bytesRead, nullptr);
+    if (ok == FALSE || bytesRead == 0)
+      break;
+
+    if (!full)
+      outputSize += bytesRead;
+  }
+  g_ProcessOutputBuffer[outputSize] = 0;
 
-  // Consume all outputs.
-  // Terminate current read and initialize the next.
-  while (ok == TRUE)
+  if (outputSize > 0)
   {
-    ok = ReadFile(handleStdoutPipeRead, g_ProcessOutputBuffer, 1024, &bytesRead, nullptr);
-
-    g_ProcessOutputBuffer[bytesRead] = 0;
-    if (g_ProcessOutputBuffer[0] != '\0')
-    {
-      char msg[256]{};
-      sprintf(msg, "Message: %s\n", g_ProcessLogBuffer);
-      OutputDebugStringA(msg);
-    }
+    OutputDebugStringA("Message: ");
+    OutputDebugStringA(g_ProcessOutputBuffer);
+    OutputDebugStringA("\n");
   }
 
   if (strlen(p_SearchErrorString) > 0 && strstr(g_ProcessOutputBuffer, p_SearchErrorString))
@@ -11,6 +11,6 @@ bool processExecute(
     const char* p_Arguments,
     const char* p_SearchErrorString = "");
 //---------------------------------------------------------------------------//
-const char* processGetOutput();
+const char* processGetOutput(); // Output of the last process executed by the calling thread.
 //---------------------------------------------------------------------------//
 } // namespace Framework
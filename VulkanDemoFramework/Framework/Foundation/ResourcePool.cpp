@@ -1,94 +1,253 @@
 #include "Foundation/ResourcePool.hpp"
 
+#include <new>
 #include <string.h>
 
 namespace Framework
 {
 static const uint32_t kInvalidIndex = 0xffffffff;
 
+static inline uint64_t _packFreeListHead(uint32_t p_Index, uint32_t p_Tag)
+{
+  return ((uint64_t)p_Tag << 32) | p_Index;
+}
+
 /// Resource Pool
 
+static inline uint32_t* _pageNextIndices(uint8_t* p_Page, uint32_t p_PageSize, uint32_t p_Size)
+{
+  return (uint32_t*)(p_Page + p_PageSize * p_Size);
+}
+
+static inline std::atomic<uint32_t>*
+_pageGenerations(uint8_t* p_Page, uint32_t p_PageSize, uint32_t p_Size)
+{
+  return (std::atomic<uint32_t>*)(_pageNextIndices(p_Page, p_PageSize, p_Size) + p_PageSize);
+}
+
+static_assert(
+    sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Generations are stored as plain words");
+
 void ResourcePool::init(Allocator* p_Allocator, uint32_t p_PoolSize, uint32_t p_ResourceSize)
 {
+  // A fixed pool is a single page.
+  initGrowable(p_Allocator, p_PoolSize, p_ResourceSize, p_PoolSize);
 
-  m_Allocator = p_Allocator;
-  m_PoolSize = p_PoolSize;
-  m_ResourceSize = p_ResourceSize;
+  std::lock_guard<std::mutex> guard(m_GrowMutex);
+  allocatePage();
+}
 
-  // Group allocate ( resource size + uint32_t )
-  size_t allocation_size = m_PoolSize * (m_ResourceSize + sizeof(uint32_t));
-  m_Memory = (uint8_t*)m_Allocator->allocate(allocation_size, 1);
-  memset(m_Memory, 0, allocation_size);
+void ResourcePool::initGrowable(
+    Allocator* p_Allocator, uint32_t p_PageSize, uint32_t p_ResourceSize, uint32_t p_MaxPoolSize)
+{
+  assert(p_PageSize > 0 && p_MaxPoolSize >= p_PageSize);
 
-  // Allocate and add free indices
-  m_FreeIndices = (uint32_t*)(m_Memory + m_PoolSize * m_ResourceSize);
-  m_FreeIndicesHead = 0;
+  m_Allocator = p_Allocator;
+  m_PageSize = p_PageSize;
+  m_ResourceSize = p_ResourceSize;
+  m_MaxPages = (p_MaxPoolSize + p_PageSize - 1) / p_PageSize;
 
-  for (uint32_t i = 0; i < m_PoolSize; ++i)
-  {
-    m_FreeIndices[i] = i;
-  }
+  // Page table is allocated upfront, so lookups never race with growth.
+  m_Pages = (uint8_t**)m_Allocator->allocate(sizeof(uint8_t*) * m_MaxPages, 8);
+  memset(m_Pages, 0, sizeof(uint8_t*) * m_MaxPages);
 
+  m_FreeListHead = _packFreeListHead(kInvalidIndex, 0);
+  m_PageCount = 0;
+  m_PoolSize = 0;
   m_UsedIndices = 0;
 }
 
 void ResourcePool::shutdown()
 {
 
-  if (m_FreeIndicesHead != 0)
+  if (m_UsedIndices != 0)
   {
     OutputDebugStringA("Resource pool has unfreed resources.\n");
 
-    for (uint32_t i = 0; i < m_FreeIndicesHead; ++i)
+    for (uint32_t i = 0; i < m_PoolSize; ++i)
     {
+      if (!isAlive(i))
+        continue;
+
       char msg[256];
-      sprintf(msg, "\tResource %u\n", m_FreeIndices[i]);
+      sprintf(msg, "\tResource %u\n", i);
       OutputDebugStringA(msg);
     }
   }
 
   assert(m_UsedIndices == 0);
 
-  m_Allocator->deallocate(m_Memory);
+  for (uint32_t p = 0; p < m_PageCount; ++p)
+  {
+    m_Allocator->deallocate(m_Pages[p]);
+  }
+  m_Allocator->deallocate(m_Pages);
+  m_Pages = nullptr;
+  m_PageCount = 0;
+  m_PoolSize = 0;
 }
 
 void ResourcePool::freeAllResources()
 {
-  m_FreeIndicesHead = 0;
+  const uint32_t pageCount = m_PageCount;
+  for (uint32_t p = 0; p < pageCount; ++p)
+  {
+    uint32_t* nextIndices = _pageNextIndices(m_Pages[p], m_PageSize, m_ResourceSize);
+    std::atomic<uint32_t>* generations = _pageGenerations(m_Pages[p], m_PageSize, m_ResourceSize);
+    for (uint32_t i = 0; i < m_PageSize; ++i)
+    {
+      const uint32_t index = p * m_PageSize + i;
+      nextIndices[i] = index + 1 < m_PoolSize ? index + 1 : kInvalidIndex;
+
+      // Invalidate handles to resources still in use.
+      if (generations[i].load(std::memory_order_relaxed) & 1)
+        generations[i].fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  m_FreeListHead.store(_packFreeListHead(m_PoolSize ? 0 : kInvalidIndex, 0));
   m_UsedIndices = 0;
+}
 
-  for (uint32_t i = 0; i < m_PoolSize; ++i)
+bool ResourcePool::allocatePage()
+{
+  if (m_PageCount >= m_MaxPages)
+    return false;
+
+  const size_t pageAllocationSize = m_PageSize * (m_ResourceSize + sizeof(uint32_t) * 2);
+  uint8_t* page = (uint8_t*)m_Allocator->allocate(pageAllocationSize, 16);
+  memset(page, 0, pageAllocationSize);
+
+  const uint32_t pageIndex = m_PageCount;
+  const uint32_t firstIndex = pageIndex * m_PageSize;
+  const uint32_t lastIndex = firstIndex + m_PageSize - 1;
+
+  // Link the new slots in order, then publish the page before its slots become reachable.
+  uint32_t* nextIndices = _pageNextIndices(page, m_PageSize, m_ResourceSize);
+  for (uint32_t i = 0; i < m_PageSize - 1; ++i)
   {
-    m_FreeIndices[i] = i;
+    nextIndices[i] = firstIndex + i + 1;
   }
+  std::atomic<uint32_t>* generations = _pageGenerations(page, m_PageSize, m_ResourceSize);
+  for (uint32_t i = 0; i < m_PageSize; ++i)
+  {
+    new (&generations[i]) std::atomic<uint32_t>(0);
+  }
+
+  m_Pages[pageIndex] = page;
+  m_PageCount.store(pageIndex + 1, std::memory_order_release);
+  m_PoolSize.store(lastIndex + 1, std::memory_order_release);
+
+  // Push the whole page on the free list.
+  uint64_t head = m_FreeListHead.load(std::memory_order_relaxed);
+  uint64_t next;
+  do
+  {
+    nextIndices[m_PageSize - 1] = (uint32_t)head;
+    next = _packFreeListHead(firstIndex, (uint32_t)(head >> 32) + 1);
+  } while (!m_FreeListHead.compare_exchange_weak(
+      head, next, std::memory_order_release, std::memory_order_relaxed));
+
+  return true;
 }
 
 uint32_t ResourcePool::obtainResource()
 {
-  // TODO: add bits for checking if resource is alive and use bitmasks.
-  if (m_FreeIndicesHead < m_PoolSize)
+  // Pop from the free list, the tag changes on every update so a concurrent pop/push of the same
+  // head in between is detected.
+  uint64_t head = m_FreeListHead.load(std::memory_order_acquire);
+  for (;;)
   {
-    const uint32_t freeIndex = m_FreeIndices[m_FreeIndicesHead++];
-    ++m_UsedIndices;
-    return freeIndex;
+    const uint32_t freeIndex = (uint32_t)head;
+    if (freeIndex == kInvalidIndex)
+    {
+      // Grow by one page, another thread may have done it already.
+      {
+        std::lock_guard<std::mutex> guard(m_GrowMutex);
+        if ((uint32_t)m_FreeListHead.load(std::memory_order_acquire) == kInvalidIndex &&
+            !allocatePage())
+        {
+          // Callers get an invalid index and report the failure themselves.
+          char msg[256];
+          sprintf(
+              msg,
+              "Resource pool error: all %u resources are in use\n",
+              m_PageSize * m_MaxPages);
+          OutputDebugStringA(msg);
+          return kInvalidIndex;
+        }
+      }
+      head = m_FreeListHead.load(std::memory_order_acquire);
+      continue;
+    }
+
+    const uint64_t next = _packFreeListHead(
+        nextFreeIndex(freeIndex).load(std::memory_order_relaxed), (uint32_t)(head >> 32) + 1);
+    if (m_FreeListHead.compare_exchange_weak(
+            head, next, std::memory_order_acquire, std::memory_order_acquire))
+    {
+      slotGeneration(freeIndex).fetch_add(1, std::memory_order_release);
+      m_UsedIndices.fetch_add(1, std::memory_order_relaxed);
+      return freeIndex;
+    }
   }
-  // Error: no more resources left!
-  assert(false);
-  return kInvalidIndex;
 }
 
 void ResourcePool::releaseResource(uint32_t handle)
 {
-  // TODO: add bits for checking if resource is alive and use bitmasks.
-  m_FreeIndices[--m_FreeIndicesHead] = handle;
-  --m_UsedIndices;
+  if (!isAlive(handle))
+  {
+    // Releasing twice would corrupt the free list.
+    char msg[256];
+    sprintf(msg, "Resource pool error: releasing resource %u which is not alive\n", handle);
+    OutputDebugStringA(msg);
+    return;
+  }
+
+  slotGeneration(handle).fetch_add(1, std::memory_order_release);
+
+  uint64_t head = m_FreeListHead.load(std::memory_order_relaxed);
+  uint64_t next;
+  do
+  {
+    nextFreeIndex(handle).store((uint32_t)head, std::memory_order_relaxed);
+    next = _packFreeListHead(handle, (uint32_t)(head >> 32) + 1);
+  } while (!m_FreeListHead.compare_exchange_weak(
+      head, next, std::memory_order_release, std::memory_order_relaxed));
+
+  m_UsedIndices.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ResourcePoolHandle ResourcePool::obtainHandle()
+{
+  const uint32_t index = obtainResource();
+  return index != kInvalidIndex ? getHandle(index) : ResourcePoolHandle{kInvalidIndex, 0};
+}
+
+ResourcePoolHandle ResourcePool::getHandle(uint32_t index) const
+{
+  return {index, slotGeneration(index).load(std::memory_order_acquire)};
+}
+
+bool ResourcePool::isAlive(uint32_t index) const
+{
+  return index < m_PoolSize &&
+         (slotGeneration(index).load(std::memory_order_acquire) & 1) != 0;
+}
+
+bool ResourcePool::isValid(ResourcePoolHandle handle) const
+{
+  // Generations of live slots are odd, so a match also means the slot is alive.
+  return handle.index < m_PoolSize &&
+         slotGeneration(handle.index).load(std::memory_order_acquire) == handle.generation &&
+         (handle.generation & 1) != 0;
 }
 
 void* ResourcePool::accessResource(uint32_t handle)
 {
   if (handle != kInvalidIndex)
   {
-    return &m_Memory[handle * m_ResourceSize];
+    return m_Pages[handle / m_PageSize] + (handle % m_PageSize) * m_ResourceSize;
   }
   return nullptr;
 }
@@ -97,9 +256,33 @@ const void* ResourcePool::accessResource(uint32_t handle) const
 {
   if (handle != kInvalidIndex)
   {
-    return &m_Memory[handle * m_ResourceSize];
+    return m_Pages[handle / m_PageSize] + (handle % m_PageSize) * m_ResourceSize;
+  }
+  return nullptr;
+}
+
+void* ResourcePool::accessResource(ResourcePoolHandle handle)
+{
+  if (isValid(handle))
+  {
+    return accessResource(handle.index);
   }
   return nullptr;
 }
 
+std::atomic<uint32_t>& ResourcePool::nextFreeIndex(uint32_t index) const
+{
+  // Read by obtainResource while the slot may be pushed again by another thread, the tag check
+  // discards such reads.
+  uint8_t* page = m_Pages[index / m_PageSize];
+  return ((std::atomic<uint32_t>*)_pageNextIndices(page, m_PageSize, m_ResourceSize))
+      [index % m_PageSize];
+}
+
+std::atomic<uint32_t>& ResourcePool::slotGeneration(uint32_t index) const
+{
+  uint8_t* page = m_Pages[index / m_PageSize];
+  return _pageGenerations(page, m_PageSize, m_ResourceSize)[index % m_PageSize];
+}
+
 } // namespace Framework
@@ -3,29 +3,81 @@
 #include "Foundation/Memory.hpp"
 
 #include <assert.h>
+#include <atomic>
+#include <mutex>
 
 namespace Framework
 {
+// Index plus the generation of the slot when the handle was taken.
+// A handle becomes stale as soon as its slot is released.
+struct ResourcePoolHandle
+{
+  uint32_t index;
+  uint32_t generation;
+}; // struct ResourcePoolHandle
+
 struct ResourcePool
 {
+  ResourcePool() = default;
+  // Pools own their pages, build structs holding one in place instead of copying them.
+  ResourcePool(const ResourcePool&) = delete;
+  ResourcePool& operator=(const ResourcePool&) = delete;
+
+  // Fixed size pool.
   void init(Allocator* p_Allocator, uint32_t p_PoolSize, uint32_t p_ResourceSize);
+  // Pool growing by pages of p_PageSize resources, up to p_MaxPoolSize.
+  // Pages are never moved so resource addresses stay stable.
+  void initGrowable(
+      Allocator* p_Allocator, uint32_t p_PageSize, uint32_t p_ResourceSize, uint32_t p_MaxPoolSize);
   void shutdown();
 
-  uint32_t obtainResource(); // Returns an index to the resource
+  // Obtain and release are lock-free and can be called from any thread, only page allocation
+  // takes a lock.
+  // Returns an index to the resource, or 0xffffffff once the pool can't grow anymore.
+  uint32_t obtainResource();
   void releaseResource(uint32_t index);
+  // Not thread-safe.
   void freeAllResources();
 
+  ResourcePoolHandle obtainHandle();
+  ResourcePoolHandle getHandle(uint32_t index) const;
+  bool isAlive(uint32_t index) const;
+  bool isValid(ResourcePoolHandle handle) const;
+
   void* accessResource(uint32_t index);
   const void* accessResource(uint32_t index) const;
+  // Returns nullptr for stale handles.
+  void* accessResource(ResourcePoolHandle handle);
 
-  uint8_t* m_Memory = nullptr;
-  uint32_t* m_FreeIndices = nullptr;
+  uint32_t getPageCount() const { return m_PageCount; }
+  // Fraction of the allocated slots in use.
+  float getOccupancy() const
+  {
+    return m_PoolSize ? (float)m_UsedIndices / (float)m_PoolSize : 0.0f;
+  }
+
+  // Page layout: resources, then per slot index of the next free slot (linking the free list),
+  // then per slot generation (odd while the slot is in use). Generations are bumped with release
+  // and read with acquire, so a valid handle also sees the writes made before obtaining it.
+  uint8_t** m_Pages = nullptr;
   Allocator* m_Allocator = nullptr;
 
-  uint32_t m_FreeIndicesHead = 0;
-  uint32_t m_PoolSize = 16;
+  // Free list head: slot index in the low bits, ABA tag in the high bits.
+  std::atomic<uint64_t> m_FreeListHead{0};
+  std::atomic<uint32_t> m_PageCount{0};
+  // Number of allocated slots.
+  std::atomic<uint32_t> m_PoolSize{0};
+  std::atomic<uint32_t> m_UsedIndices{0};
+
+  uint32_t m_PageSize = 16;
+  uint32_t m_MaxPages = 1;
   uint32_t m_ResourceSize = 4;
-  uint32_t m_UsedIndices = 0;
+
+  std::mutex m_GrowMutex;
+
+  bool allocatePage();
+  std::atomic<uint32_t>& nextFreeIndex(uint32_t index) const;
+  std::atomic<uint32_t>& slotGeneration(uint32_t index) const;
 
 }; // struct ResourcePool
 
@@ -33,6 +85,7 @@ template <typename T> struct ResourcePoolTyped : public ResourcePool
 {
 
   void init(Allocator* allocator, uint32_t poolSize);
+  void initGrowable(Allocator* allocator, uint32_t pageSize, uint32_t maxPoolSize);
   void shutdown();
 
   T* obtain();
@@ -49,16 +102,26 @@ inline void ResourcePoolTyped<T>::init(Allocator* p_Allocator, uint32_t p_PoolSi
   ResourcePool::init(p_Allocator, p_PoolSize, sizeof(T));
 }
 
+template <typename T>
+inline void ResourcePoolTyped<T>::initGrowable(
+    Allocator* p_Allocator, uint32_t p_PageSize, uint32_t p_MaxPoolSize)
+{
+  ResourcePool::initGrowable(p_Allocator, p_PageSize, sizeof(T), p_MaxPoolSize);
+}
+
 template <typename T> inline void ResourcePoolTyped<T>::shutdown()
 {
-  if (m_FreeIndicesHead != 0)
+  if (m_UsedIndices != 0)
   {
     OutputDebugStringA("Resource pool has unfreed resources.\n");
 
-    for (uint32_t i = 0; i < m_FreeIndicesHead; ++i)
+    for (uint32_t i = 0; i < m_PoolSize; ++i)
     {
+      if (!isAlive(i))
+        continue;
+
       char msg[256]{};
-      sprintf(msg, "\tResource %u, %s\n", m_FreeIndices[i], get(m_FreeIndices[i])->m_Name);
+      sprintf(msg, "\tResource %u, %s\n", i, get(i)->m_Name);
       OutputDebugStringA(msg);
     }
   }
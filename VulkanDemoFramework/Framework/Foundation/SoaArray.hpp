@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Foundation/Array.hpp"
+
+#include <assert.h>
+#include <tuple>
+#include <utility>
+
+namespace Framework
+{
+
+/// Data structures
+
+// Columns start on a cache line and their capacity is a multiple of the padding, so loops over a
+// column can use aligned loads and full SIMD widths up to the padded capacity.
+static const size_t kSoaColumnAlignment = 64;
+static const uint32_t kSoaColumnPadding = 16;
+
+/// SoaArray
+
+// Structure of arrays: each field lives in its own block, so a loop touching a single field only
+// pulls that field through the cache. Fields are copied with memcpy, like Array elements.
+template <typename... Fields> struct SoaArray
+{
+  static const uint32_t kNumColumns = sizeof...(Fields);
+
+  template <uint32_t Column>
+  using FieldType = typename std::tuple_element<Column, std::tuple<Fields...>>::type;
+
+  void init(Allocator* p_Allocator, uint32_t p_InitialCapacity, uint32_t p_InitialSize = 0);
+  void shutdown();
+
+  void push(const Fields&... p_Values);
+  uint32_t pushUse(); // Grow the size and return the index of the element to be filled.
+
+  void pop();
+  void deleteSwap(uint32_t p_Index);
+
+  void clear();
+  void setSize(uint32_t p_NewSize);
+  void setCapacity(uint32_t p_NewCapacity);
+  void grow(uint32_t p_NewCapacity);
+
+  template <uint32_t Column> FieldType<Column>* column();
+  template <uint32_t Column> const FieldType<Column>* column() const;
+  // View over the occupied part of a column.
+  template <uint32_t Column> ArrayView<FieldType<Column>> view();
+
+  template <uint32_t Column> FieldType<Column>& get(uint32_t p_Index);
+  template <uint32_t Column> const FieldType<Column>& get(uint32_t p_Index) const;
+
+  template <size_t... Columns>
+  void setValues(uint32_t p_Index, std::index_sequence<Columns...>, const Fields&... p_Values);
+
+  void* m_Columns[kNumColumns];
+  uint32_t m_Size = 0;     // Occupied size
+  uint32_t m_Capacity = 0; // Allocated capacity, per column
+  Allocator* m_Allocator = nullptr;
+
+}; // struct SoaArray
+
+/// Implementation
+
+template <typename... Fields>
+inline void SoaArray<Fields...>::init(
+    Allocator* p_Allocator, uint32_t p_InitialCapacity, uint32_t p_InitialSize)
+{
+  for (uint32_t c = 0; c < kNumColumns; ++c)
+  {
+    m_Columns[c] = nullptr;
+  }
+  m_Size = p_InitialSize;
+  m_Capacity = 0;
+  m_Allocator = p_Allocator;
+
+  if (p_InitialCapacity > 0 || p_InitialSize > 0)
+  {
+    grow(p_InitialCapacity > p_InitialSize ? p_InitialCapacity : p_InitialSize);
+  }
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::shutdown()
+{
+  if (m_Capacity > 0)
+  {
+    for (uint32_t c = 0; c < kNumColumns; ++c)
+    {
+      m_Allocator->deallocate(m_Columns[c]);
+      m_Columns[c] = nullptr;
+    }
+  }
+  m_Size = m_Capacity = 0;
+}
+
+template <typename... Fields>
+template <size_t... Columns>
+inline void SoaArray<Fields...>::setValues(
+    uint32_t p_Index, std::index_sequence<Columns...>, const Fields&... p_Values)
+{
+  int expand[] = {0, ((column<(uint32_t)Columns>()[p_Index] = p_Values), 0)...};
+  (void)expand;
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::push(const Fields&... p_Values)
+{
+  const uint32_t index = pushUse();
+  setValues(index, std::index_sequence_for<Fields...>{}, p_Values...);
+}
+
+template <typename... Fields> inline uint32_t SoaArray<Fields...>::pushUse()
+{
+  if (m_Size >= m_Capacity)
+  {
+    grow(m_Capacity + 1);
+  }
+  return m_Size++;
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::pop()
+{
+  assert(m_Size > 0);
+  --m_Size;
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::deleteSwap(uint32_t p_Index)
+{
+  assert(m_Size > 0 && p_Index < m_Size);
+  const size_t fieldSizes[] = {sizeof(Fields)...};
+
+  --m_Size;
+  // Removing the last element moves nothing.
+  if (p_Index == m_Size)
+    return;
+
+  for (uint32_t c = 0; c < kNumColumns; ++c)
+  {
+    uint8_t* data = (uint8_t*)m_Columns[c];
+    memoryCopy(data + p_Index * fieldSizes[c], data + m_Size * fieldSizes[c], fieldSizes[c]);
+  }
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::clear() { m_Size = 0; }
+
+template <typename... Fields> inline void SoaArray<Fields...>::setSize(uint32_t p_NewSize)
+{
+  if (p_NewSize > m_Capacity)
+  {
+    grow(p_NewSize);
+  }
+  m_Size = p_NewSize;
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::setCapacity(uint32_t p_NewCapacity)
+{
+  if (p_NewCapacity > m_Capacity)
+  {
+    grow(p_NewCapacity);
+  }
+}
+
+template <typename... Fields> inline void SoaArray<Fields...>::grow(uint32_t p_NewCapacity)
+{
+  if (p_NewCapacity < m_Capacity * 2)
+  {
+    p_NewCapacity = m_Capacity * 2;
+  }
+  p_NewCapacity = (p_NewCapacity + kSoaColumnPadding - 1) & ~(kSoaColumnPadding - 1);
+
+  const size_t fieldSizes[] = {sizeof(Fields)...};
+  for (uint32_t c = 0; c < kNumColumns; ++c)
+  {
+    void* newData = m_Allocator->allocate(p_NewCapacity * fieldSizes[c], kSoaColumnAlignment);
+    if (m_Capacity)
+    {
+      memoryCopy(newData, m_Columns[c], m_Capacity * fieldSizes[c]);
+
+      m_Allocator->deallocate(m_Columns[c]);
+    }
+    m_Columns[c] = newData;
+  }
+
+  m_Capacity = p_NewCapacity;
+}
+
+template <typename... Fields>
+template <uint32_t Column>
+inline typename SoaArray<Fields...>::template FieldType<Column>* SoaArray<Fields...>::column()
+{
+  return (FieldType<Column>*)m_Columns[Column];
+}
+
+template <typename... Fields>
+template <uint32_t Column>
+inline const typename SoaArray<Fields...>::template FieldType<Column>*
+SoaArray<Fields...>::column() const
+{
+  return (const FieldType<Column>*)m_Columns[Column];
+}
+
+template <typename... Fields>
+template <uint32_t Column>
+inline ArrayView<typename SoaArray<Fields...>::template FieldType<Column>>
+SoaArray<Fields...>::view()
+{
+  return ArrayView<FieldType<Column>>(column<Column>(), m_Size);
+}
+
+template <typename... Fields>
+template <uint32_t Column>
+inline typename SoaArray<Fields...>::template FieldType<Column>&
+SoaArray<Fields...>::get(uint32_t p_Index)
+{
+  assert(p_Index < m_Size);
+  return column<Column>()[p_Index];
+}
+
+template <typename... Fields>
+template <uint32_t Column>
+inline const typename SoaArray<Fields...>::template FieldType<Column>&
+SoaArray<Fields...>::get(uint32_t p_Index) const
+{
+  assert(p_Index < m_Size);
+  return column<Column>()[p_Index];
+}
+
+} // namespace Framework
@@ -59,18 +59,17 @@ void CommandBuffer::reset()
 
   vkResetDescriptorPool(m_GpuDevice->m_VulkanDevice, m_VulkanDescriptorPool, 0);
 
-  uint32_t resourceCount = m_DescriptorSets.m_FreeIndicesHead;
-  for (uint32_t i = 0; i < resourceCount; ++i)
+  // Live sets can sit anywhere in the pool, free the arrays of each then release them all.
+  for (uint32_t i = 0; i < m_DescriptorSets.m_PoolSize; ++i)
   {
-    DesciptorSet* descriptorSet = (DesciptorSet*)m_DescriptorSets.accessResource(i);
+    if (!m_DescriptorSets.isAlive(i))
+      continue;
 
-    if (descriptorSet)
-    {
-      // Contains the allocation for all the resources, binding and samplers arrays.
-      FRAMEWORK_FREE(descriptorSet->resources, m_GpuDevice->m_Allocator);
-    }
-    m_DescriptorSets.releaseResource(i);
+    DesciptorSet* descriptorSet = (DesciptorSet*)m_DescriptorSets.accessResource(i);
+    // Contains the allocation for all the resources, binding and samplers arrays.
+    FRAMEWORK_FREE(descriptorSet->resources, m_GpuDevice->m_Allocator);
   }
+  m_DescriptorSets.freeAllResources();
 }
 //---------------------------------------------------------------------------//
 void CommandBuffer::bindLocalDescriptorSet(
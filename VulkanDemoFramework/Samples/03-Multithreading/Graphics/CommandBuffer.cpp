@@ -1,5 +1,7 @@
 #include "CommandBuffer.hpp"
 
+#include <new>
+
 namespace Graphics
 {
 static const uint32_t g_SecondaryCommandBuffersCount = 2;
@@ -60,18 +62,17 @@ void CommandBuffer::reset()
 
   vkResetDescriptorPool(m_GpuDevice->m_VulkanDevice, m_VulkanDescriptorPool, 0);
 
-  uint32_t resourceCount = m_DescriptorSets.m_FreeIndicesHead;
-  for (uint32_t i = 0; i < resourceCount; ++i)
+  // Live sets can sit anywhere in the pool, free the arrays of each then release them all.
+  for (uint32_t i = 0; i < m_DescriptorSets.m_PoolSize; ++i)
   {
-    DesciptorSet* descriptorSet = (DesciptorSet*)m_DescriptorSets.accessResource(i);
+    if (!m_DescriptorSets.isAlive(i))
+      continue;
 
-    if (descriptorSet)
-    {
-      // Contains the allocation for all the resources, binding and samplers arrays.
-      FRAMEWORK_FREE(descriptorSet->resources, m_GpuDevice->m_Allocator);
-    }
-    m_DescriptorSets.releaseResource(i);
+    DesciptorSet* descriptorSet = (DesciptorSet*)m_DescriptorSets.accessResource(i);
+    // Contains the allocation for all the resources, binding and samplers arrays.
+    FRAMEWORK_FREE(descriptorSet->resources, m_GpuDevice->m_Allocator);
   }
+  m_DescriptorSets.freeAllResources();
 }
 //---------------------------------------------------------------------------//
 void CommandBuffer::bindLocalDescriptorSet(
@@ -636,7 +637,7 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
     cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     cmd.commandBufferCount = 1;
 
-    CommandBuffer& currentCommandBuffer = m_CommandBuffers[i];
+    CommandBuffer& currentCommandBuffer = *new (&m_CommandBuffers[i]) CommandBuffer();
     vkAllocateCommandBuffers(
         m_GpuDevice->m_VulkanDevice, &cmd, &currentCommandBuffer.m_VulkanCmdBuffer);
 
@@ -659,7 +660,8 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
 
     for (uint32_t cmdIndex = 0; cmdIndex < g_SecondaryCommandBuffersCount; ++cmdIndex)
     {
-      CommandBuffer cmdBuf{};
+      // Built in place, command buffers own their descriptor set pool and cannot be copied.
+      CommandBuffer& cmdBuf = *new (&m_SecondaryCommandBuffers.pushUse()) CommandBuffer();
       cmdBuf.m_VulkanCmdBuffer = secondaryBuffers[cmdIndex];
 
       cmdBuf.m_Handle = handle++;
@@ -667,8 +669,6 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
 
       // NOTE: access to the descriptor pool has to be synchronized
       // across theads. Don't allow for now
-
-      m_SecondaryCommandBuffers.push(cmdBuf);
     }
   }
 
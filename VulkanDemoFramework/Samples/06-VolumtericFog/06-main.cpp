@@ -11,6 +11,7 @@
 #endif
 
 #include <Foundation/File.hpp>
+#include <Foundation/IoService.hpp>
 #include <Foundation/Numerics.hpp>
 #include <Foundation/Time.hpp>
 #include <Foundation/ResourceManager.hpp>
@@ -40,6 +41,8 @@
 
 #include <stdio.h>
 #include <stdlib.h> // for exit()
+#include <string.h>
+#include <thread>
 
 // TODOS:
 // 1. Fix uniforms not getting updated
@@ -195,26 +198,30 @@ static void testSphereAABB(Framework::GameCamera& gameCamera)
 }
 
 // Light placement function ///////////////////////////////////////////////
-void place_lights(Framework::Array<Graphics::Light>& lights, uint32_t active_lights, bool grid)
+void place_lights(Graphics::Lights& lights, uint32_t active_lights, bool grid)
 {
 
   using namespace Framework;
+  using namespace Graphics;
 
   if (grid)
   {
+    vec3s* light_world_positions = lights.column<LightField::kWorldPosition>();
+    float* light_intensities = lights.column<LightField::kIntensity>();
+    float* light_radii = lights.column<LightField::kRadius>();
+    vec3s* light_colors = lights.column<LightField::kColor>();
+
     const uint32_t lights_per_side = ::ceil(sqrtf(active_lights * 1.f));
     for (uint32_t i = 0; i < active_lights; ++i)
     {
-      Graphics::Light& light = lights[i];
-
       const float x = (i % lights_per_side) - lights_per_side * .5f;
       const float y = 0.05f;
       const float z = (i / lights_per_side) - lights_per_side * .5f;
 
-      light.world_position = {x, y, z};
-      light.intensity = 10.f;
-      light.radius = 0.25f;
-      light.color = {1, 1, 1};
+      light_world_positions[i] = {x, y, z};
+      light_intensities[i] = 10.f;
+      light_radii[i] = 0.25f;
+      light_colors[i] = {1, 1, 1};
     }
   }
 
@@ -492,16 +499,24 @@ static void perform_geometric_tests(
 
     using namespace Graphics;
 
+    Lights& lights = scene->lights;
+    const vec3s* light_world_positions = lights.column<LightField::kWorldPosition>();
+    const vec4s* light_aabb_mins = lights.column<LightField::kAabbMin>();
+    const vec4s* light_aabb_maxs = lights.column<LightField::kAabbMax>();
+    float* light_shadow_map_resolutions = lights.column<LightField::kShadowMapResolution>();
+    uint32_t* light_tiles_x = lights.column<LightField::kTileX>();
+    uint32_t* light_tiles_y = lights.column<LightField::kTileY>();
+    float* light_solid_angles = lights.column<LightField::kSolidAngle>();
+
     for (uint32_t l = 0; l < light_count; ++l)
     {
-      Light& light = scene->lights[l];
-      light.shadow_map_resolution = 0.0f;
-      light.tile_x = 0;
-      light.tile_y = 0;
-      light.solid_angle = 0.0f;
+      light_shadow_map_resolutions[l] = 0.0f;
+      light_tiles_x[l] = 0;
+      light_tiles_y[l] = 0;
+      light_solid_angles[l] = 0.0f;
 
-      vec4s aabbMin_view = glms_mat4_mulv(last_camera.view, light.aabb_min);
-      vec4s aabbMax_view = glms_mat4_mulv(last_camera.view, light.aabb_max);
+      vec4s aabbMin_view = glms_mat4_mulv(last_camera.view, light_aabb_mins[l]);
+      vec4s aabbMax_view = glms_mat4_mulv(last_camera.view, light_aabb_maxs[l]);
 
       lights_aabb_view[l * 2] = vec3s{aabbMin_view.x, aabbMin_view.y, aabbMin_view.z};
       lights_aabb_view[l * 2 + 1] = vec3s{aabbMax_view.x, aabbMax_view.y, aabbMax_view.z};
@@ -557,8 +572,6 @@ static void perform_geometric_tests(
           bool intersects_light = false;
           for (uint32_t l = 0; l < scene->active_lights; ++l)
           {
-            Light& light = scene->lights[l];
-
             vec3s& light_aabbMin = lights_aabb_view[l * 2];
             vec3s& light_aabbMax = lights_aabb_view[l * 2 + 1];
 
@@ -599,8 +612,8 @@ static void perform_geometric_tests(
             {
               intersects_light = true;
 
-              vec4s sphere_world{
-                  light.world_position.x, light.world_position.y, light.world_position.z, 1.0f};
+              const vec3s& light_position = light_world_positions[l];
+              vec4s sphere_world{light_position.x, light_position.y, light_position.z, 1.0f};
               vec4s sphere_ndc = glms_mat4_mulv(last_camera.viewProjection, sphere_world);
 
               sphere_ndc.x /= sphere_ndc.w;
@@ -628,12 +641,12 @@ static void perform_geometric_tests(
               // https://efficientshading.com/wp-content/uploads/s2015_shadows.pdf
               float resolution = sqrtf((4.0f * Framework::PI * tile_pixels) / (6 * solid_angle));
 
-              if (resolution > light.shadow_map_resolution)
+              if (resolution > light_shadow_map_resolutions[l])
               {
-                light.shadow_map_resolution = resolution;
-                light.tile_x = x;
-                light.tile_y = y;
-                light.solid_angle = solid_angle;
+                light_shadow_map_resolutions[l] = resolution;
+                light_tiles_x[l] = x;
+                light_tiles_y[l] = y;
+                light_solid_angles[l] = solid_angle;
               }
             }
           }
@@ -656,15 +669,13 @@ static void perform_geometric_tests(
       float light_pos_len = 0.01;
       for (uint32_t l = 0; l < light_count; ++l)
       {
-        Light& light = scene->lights[l];
+        // printf( "Light resolution %f\n", light_shadow_map_resolutions[l] );
 
-        // printf( "Light resolution %f\n", light.shadow_map_resolution );
-
-        if (light.shadow_map_resolution != 0.0f)
+        if (light_shadow_map_resolutions[l] != 0.0f)
         {
           {
-            vec4s sphere_world{
-                light.world_position.x, light.world_position.y, light.world_position.z, 1.0f};
+            const vec3s& light_position = light_world_positions[l];
+            vec4s sphere_world{light_position.x, light_position.y, light_position.z, 1.0f};
             vec4s sphere_ndc = glms_mat4_mulv(last_camera.viewProjection, sphere_world);
 
             sphere_ndc.x /= sphere_ndc.w;
@@ -684,14 +695,14 @@ static void perform_geometric_tests(
                 1.0f / float(scene_data.resolution_x), 1.0f / (scene_data.resolution_y)};
 
             vec2s bottom_right{
-                float((light.tile_x + 1) * tile_size),
-                float(scene_data.resolution_y - (light.tile_y + 1) * tile_size)};
+                float((light_tiles_x[l] + 1) * tile_size),
+                float(scene_data.resolution_y - (light_tiles_y[l] + 1) * tile_size)};
             bottom_right = glms_vec2_subs(
                 glms_vec2_scale(glms_vec2_mul(bottom_right, screen_scale), 2.0f), 1.0f);
 
             vec2s top_left{
-                float((light.tile_x) * tile_size),
-                float(scene_data.resolution_y - (light.tile_y) * tile_size)};
+                float((light_tiles_x[l]) * tile_size),
+                float(scene_data.resolution_y - (light_tiles_y[l]) * tile_size)};
             top_left =
                 glms_vec2_subs(glms_vec2_scale(glms_vec2_mul(top_left, screen_scale), 2.0f), 1.0f);
 
@@ -735,12 +746,34 @@ int main(int argc, char** argv)
   // Init services
   MemoryServiceConfiguration memoryConfiguration;
   memoryConfiguration.MaximumDynamicSize = FRAMEWORK_GIGA(2ull);
+  // Loading and recording tasks allocate from worker threads.
+  memoryConfiguration.ConcurrentThreadCount = 64;
+
+  // --track-allocations writes a per-callsite report of the system and scratch allocators.
+  const char* scenePathArgument = nullptr;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--track-allocations") == 0)
+    {
+      memoryConfiguration.TrackAllocations = true;
+      memoryConfiguration.AllocationReportPath = "AllocationReport.txt";
+    }
+    else if (!scenePathArgument)
+    {
+      scenePathArgument = argv[i];
+    }
+  }
 
   MemoryService::instance()->init(&memoryConfiguration);
   Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
 
   StackAllocator scratchAllocator;
   scratchAllocator.init(FRAMEWORK_MEGA(8));
+  if (memoryConfiguration.TrackAllocations)
+    scratchAllocator.m_Tracker = &MemoryService::instance()->m_AllocationTracker;
+
+  // Texture reads are batched through the io service by the asynchronous loader.
+  IoService::instance()->init(nullptr);
 
   enki::TaskSchedulerConfig config;
   // In this example we create more threads than the hardware can run,
@@ -817,7 +850,7 @@ int main(int argc, char** argv)
     frameGraph.parse(frameGraphPath, &scratchAllocator);
     frameGraph.compile();
 
-    renderResourcesLoader.init(&renderer, &scratchAllocator, &frameGraph);
+    renderResourcesLoader.init(&renderer, &scratchAllocator, &frameGraph, &taskScheduler);
 
     // TODO: add this to render graph itself.
     // Add utility textures (dithering, ...)
@@ -826,37 +859,45 @@ int main(int argc, char** argv)
         temporaryNameBuffer.appendUseFormatted("%s%sBayerDither4x4.png", cwd, DATA_FOLDER);
     ditherTexture = renderResourcesLoader.loadTexture(ditherTexturePath, false);
 
-    // Parse techniques
-    Graphics::RendererUtil::GpuTechniqueCreation gtc;
-    temporaryNameBuffer.clear();
-    char const* fullScreenPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "fullscreen.json");
-    renderResourcesLoader.loadGpuTechnique(fullScreenPipelinePath);
-
-    temporaryNameBuffer.clear();
-    char const* mainPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "main.json");
-    renderResourcesLoader.loadGpuTechnique(mainPipelinePath);
-
-    temporaryNameBuffer.clear();
-    char const* pbrPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "pbr_lighting.json");
-    renderResourcesLoader.loadGpuTechnique(pbrPipelinePath);
+    // Parse techniques. Each one is parsed and its shaders compiled here while the pipelines of
+    // the previous one are built on task threads, OS messages are pumped while waiting so that
+    // the window stays responsive.
+    static const char* kTechniqueFiles[] = {
+        "fullscreen.json",
+        "main.json",
+        "pbr_lighting.json",
+        "dof.json",
+        "cloth.json",
+        "debug.json"};
+    static Graphics::GpuTechniqueBuild techniqueBuilds[2];
+    Graphics::GpuTechniqueBuild* pendingBuild = nullptr;
+
+    auto finishTechniqueBuild = [&](Graphics::GpuTechniqueBuild& p_Build) {
+      while (!renderResourcesLoader.isComplete(p_Build))
+      {
+        window.handleOSMessages();
+        // Give the core to the task threads building the pipelines instead of spinning.
+        std::this_thread::yield();
+      }
+      renderResourcesLoader.finishGpuTechnique(p_Build);
+    };
 
-    temporaryNameBuffer.clear();
-    char const* dofPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "dof.json");
-    renderResourcesLoader.loadGpuTechnique(dofPipelinePath);
+    const int64_t techniquesStart = Time::getCurrentTime();
+    for (uint32_t i = 0; i < arrayCount32(kTechniqueFiles); ++i)
+    {
+      temporaryNameBuffer.clear();
+      char const* techniquePath = temporaryNameBuffer.appendUseFormatted(
+          "%s%s%s", cwd, SHADER_FOLDER, kTechniqueFiles[i]);
 
-    temporaryNameBuffer.clear();
-    char const* clothPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "cloth.json");
-    renderResourcesLoader.loadGpuTechnique(clothPipelinePath);
+      Graphics::GpuTechniqueBuild& build = techniqueBuilds[i % 2];
+      renderResourcesLoader.loadGpuTechniqueAsync(techniquePath, build);
 
-    temporaryNameBuffer.clear();
-    char const* debugPipelinePath =
-        temporaryNameBuffer.appendUseFormatted("%s%s%s", cwd, SHADER_FOLDER, "debug.json");
-    renderResourcesLoader.loadGpuTechnique(debugPipelinePath);
+      if (pendingBuild)
+        finishTechniqueBuild(*pendingBuild);
+      pendingBuild = &build;
+    }
+    finishTechniqueBuild(*pendingBuild);
+    printf("Techniques loaded in %f ms\n", Time::deltaFromStartMilliseconds(techniquesStart));
   }
 
   Graphics::SceneGraph sceneGraph;
@@ -871,9 +912,9 @@ int main(int argc, char** argv)
 
   temporaryNameBuffer.clear();
   char const* scenePath = nullptr;
-  if (argc > 1)
+  if (scenePathArgument)
   {
-    scenePath = argv[1];
+    scenePath = scenePathArgument;
   }
   else
   {
@@ -892,10 +933,18 @@ int main(int argc, char** argv)
 
   scratchAllocator.freeMarker(scratchMarker);
 
-  Graphics::RenderScene* scene = new Graphics::ObjScene;
-
   char* fileExtension = fileExtensionFromPath(fileName);
 
+  Graphics::RenderScene* scene = nullptr;
+  if (strcmp(fileExtension, "gltf") == 0 || strcmp(fileExtension, "glb") == 0)
+  {
+    scene = new Graphics::glTFScene;
+  }
+  else
+  {
+    scene = new Graphics::ObjScene;
+  }
+
   scene->init(fileName, fileBasePath, allocator, &scratchAllocator, &asyncLoader);
 
   // NOTE: restore working directory
@@ -931,6 +980,7 @@ int main(int argc, char** argv)
   float springDamping = 5000.0f;
   float airDensity = 10.0f;
   bool resetSimulation = false;
+  bool parallelFrameGraphRecording = true;
   vec3s windDirection{-5.0f, 0.0f, 0.0f};
 
   while (!window.m_RequestedExit)
@@ -941,7 +991,7 @@ int main(int argc, char** argv)
       gpu.newFrame();
 
       static bool checksz = true;
-      if (asyncLoader.fileLoadRequests.m_Size == 0 && checksz)
+      if (!asyncLoader.hasPendingWork() && checksz)
       {
         checksz = false;
         printf(
@@ -950,6 +1000,8 @@ int main(int argc, char** argv)
       }
     }
 
+    MemoryService::instance()->newFrame();
+
     window.handleOSMessages();
     input.newFrame();
 
@@ -993,6 +1045,7 @@ int main(int argc, char** argv)
         ImGui::Checkbox(
             "Dynamically recreate descriptor sets", &Graphics::g_RecreatePerThreadDescriptors);
         ImGui::Checkbox("Use secondary command buffers", &Graphics::g_UseSecondaryCommandBuffers);
+        ImGui::Checkbox("Record frame graph in parallel", &parallelFrameGraphRecording);
 
         ImGui::SliderFloat("Animation Speed Multiplier", &animationSpeedMultiplier, 0.0f, 10.0f);
 
@@ -1054,6 +1107,58 @@ int main(int argc, char** argv)
       if (ImGui::Begin("GPU"))
       {
         renderer.imguiDraw();
+        frameGraph.debug_ui();
+
+        ImGui::Separator();
+        Graphics::FrustumCulling& culling = scene->frustum_culling;
+        ImGui::Checkbox("Frustum culling", &culling.enabled);
+        ImGui::Text(
+            "Mesh instances: %u visible, %u culled",
+            culling.instance_stats.visible,
+            culling.instance_stats.culled);
+
+        static const char* cullingListNames[] = {"Depth pre pass", "GBuffer", "Transparent"};
+        for (uint32_t l = 0; l < Graphics::CullingList::kCount; ++l)
+        {
+          ImGui::Text(
+              "%s draws: %u visible, %u culled",
+              cullingListNames[l],
+              culling.list_stats[l].visible,
+              culling.list_stats[l].culled);
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Sort opaque draw packets", &scene->sort_draw_packets);
+        ImGui::Checkbox("Opaque front to back", &scene->opaque_front_to_back);
+        ImGui::Checkbox("Indirect draws", &scene->use_indirect_draws);
+        ImGui::Checkbox("GPU written indirect commands", &scene->gpu_indirect_commands);
+        Graphics::DrawBindStats bindStats;
+        for (uint32_t l = 0; l < Graphics::CullingList::kCount; ++l)
+        {
+          const Graphics::DrawBindStats& queueStats = scene->draw_queues[l].stats;
+          bindStats.draws += queueStats.draws;
+          bindStats.pipelines += queueStats.pipelines;
+          bindStats.descriptor_sets += queueStats.descriptor_sets;
+          bindStats.vertex_buffers += queueStats.vertex_buffers;
+          bindStats.index_buffers += queueStats.index_buffers;
+          bindStats.indirect_draws += queueStats.indirect_draws;
+          bindStats.multi_draws += queueStats.multi_draws;
+          bindStats.gpu_draws += queueStats.gpu_draws;
+        }
+        ImGui::Text("Draws: %u", bindStats.draws);
+        ImGui::Text(
+            "Binds: %u pipelines, %u descriptor sets",
+            bindStats.pipelines,
+            bindStats.descriptor_sets);
+        ImGui::Text(
+            "Binds: %u vertex buffers, %u index buffers",
+            bindStats.vertex_buffers,
+            bindStats.index_buffers);
+        ImGui::Text(
+            "Indirect: %u draws in %u multi draws",
+            bindStats.indirect_draws,
+            bindStats.multi_draws);
+        ImGui::Text("GPU culled and written: %u draws", bindStats.gpu_draws);
       }
       ImGui::End();
     }
@@ -1067,6 +1172,15 @@ int main(int argc, char** argv)
       scene->update_joints();
     }
 
+    if (!window.m_Minimized)
+    {
+      // Visible draws of the passes, with this frame's camera and world matrices and before any
+      // pass is recorded. Sorting writes the indirect commands of this frame slot, the GPU is
+      // done with it only once the frame has begun.
+      frameRenderer.cull_draws(gameCamera.camera.viewProjection, &taskScheduler);
+      frameRenderer.sort_draws(&taskScheduler);
+    }
+
     {
       // Update scene constant buffer
       Graphics::MapBufferParameters sceneCbMap = {scene->scene_cb, 0, 0};
@@ -1095,8 +1209,25 @@ int main(int argc, char** argv)
 
     if (!window.m_Minimized)
     {
+      // Frame graph nodes are recorded in ranges on the task threads, the draw task only records
+      // the fullscreen pass and the UI.
+      // Compiles the graph again if passes were toggled, before anything is recorded.
+      frameGraph.prepare_render(gpu, scene);
+
+      // Passes transitioning textures themselves make the graph record serially, with tracking.
+      const bool recordInParallel =
+          parallelFrameGraphRecording && frameGraph.can_record_in_parallel();
+
+      Graphics::FrameGraphRecordTask recordTask;
+      if (recordInParallel)
+      {
+        recordTask.init(&gpu, &frameGraph, scene, taskScheduler.GetNumTaskThreads());
+        taskScheduler.AddTaskSetToPipe(&recordTask);
+      }
+
       Graphics::DrawTask drawTask;
       drawTask.init(renderer.m_GpuDevice, &frameGraph, &renderer, imgui, scene, &frameRenderer);
+      drawTask.render_frame_graph = !recordInParallel;
       taskScheduler.AddTaskSetToPipe(&drawTask);
 
       Graphics::CommandBuffer* async_compute_command_buffer = nullptr;
@@ -1108,6 +1239,15 @@ int main(int argc, char** argv)
 
       taskScheduler.WaitforTaskSet(&drawTask);
 
+      // Submission follows the node order, whatever thread recorded each range.
+      if (recordInParallel)
+      {
+        taskScheduler.WaitforTaskSet(&recordTask);
+        recordTask.queue_command_buffers();
+        frameGraph.apply_barrier_states(gpu);
+      }
+      gpu.queueCommandBuffer(drawTask.gpu_commands);
+
       // Avoid using the same command buffer
       renderer.addTextureUpdateCommands(
           (drawTask.thread_id + 1) % taskScheduler.GetNumTaskThreads());
@@ -1147,6 +1287,7 @@ int main(int argc, char** argv)
   window.unregisterOSMessagesCallback(inputOSMessagesCallback);
   window.shutdown();
 
+  IoService::instance()->shutdown();
   scratchAllocator.shutdown();
   MemoryService::instance()->shutdown();
 
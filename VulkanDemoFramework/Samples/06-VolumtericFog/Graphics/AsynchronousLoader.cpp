@@ -1,13 +1,113 @@
 #include "AsynchronousLoader.hpp"
 
-#include "Foundation/Time.hpp"
 #include "Graphics/Renderer.hpp"
 
 #include "Externals/stb_image.h"
-#include <atomic>
 
 namespace Graphics
 {
+// Reads submitted to the io service per update.
+static const uint32_t kMaxReadsPerUpdate = 32;
+// Textures decoded in parallel by one batch of the decode stage.
+static const uint32_t kMaxDecodesPerBatch = 64;
+static const size_t kTextureStagingSize = FRAMEWORK_MEGA(128);
+static const size_t kTextureStagingAlignment = 16;
+// Uploads recorded in one transfer submission, their textures fit in the renderer update list.
+static const uint32_t kMaxUploadsPerSubmission = 64;
+//---------------------------------------------------------------------------//
+void StagingRing::init(size_t p_Capacity)
+{
+  capacity = p_Capacity;
+  head = 0;
+  tail = 0;
+  used = 0;
+  firstRegion = 0;
+  regionCount = 0;
+}
+//---------------------------------------------------------------------------//
+bool StagingRing::allocate(size_t p_Size, size_t& p_OutOffset)
+{
+  if (regionCount == kMaxRegions || p_Size > capacity)
+    return false;
+
+  if (used == 0)
+  {
+    head = 0;
+    tail = 0;
+  }
+
+  size_t offset = head;
+  size_t consumed = p_Size;
+  if (used == 0 || head > tail)
+  {
+    // Free space is after the head and before the tail, wrap when the end is too short.
+    if (head + p_Size > capacity)
+    {
+      if (p_Size > tail)
+        return false;
+
+      offset = 0;
+      consumed += capacity - head;
+    }
+  }
+  else if (head + p_Size > tail)
+  {
+    return false;
+  }
+
+  Region& region = regions[(firstRegion + regionCount++) % kMaxRegions];
+  region.offset = offset;
+  region.end = offset + p_Size;
+  region.consumed = consumed;
+  region.released = false;
+
+  head = region.end;
+  used += consumed;
+  p_OutOffset = offset;
+  return true;
+}
+//---------------------------------------------------------------------------//
+void StagingRing::release(size_t p_Offset)
+{
+  for (uint32_t i = 0; i < regionCount; ++i)
+  {
+    Region& region = regions[(firstRegion + i) % kMaxRegions];
+    if (region.offset == p_Offset && !region.released)
+    {
+      region.released = true;
+      break;
+    }
+  }
+
+  // Memory goes back to the ring in allocation order.
+  while (regionCount && regions[firstRegion].released)
+  {
+    const Region& region = regions[firstRegion];
+    tail = region.end;
+    used -= region.consumed;
+    firstRegion = (firstRegion + 1) % kMaxRegions;
+    --regionCount;
+  }
+}
+//---------------------------------------------------------------------------//
+void TextureDecodeTask::ExecuteRange(enki::TaskSetPartition p_Range, uint32_t p_ThreadNum)
+{
+  for (uint32_t i = p_Range.start; i < p_Range.end; ++i)
+  {
+    TextureDecode& decode = decodes[i];
+
+    int width, height, comp;
+    uint8_t* pixels = stbi_load_from_memory(
+        decode.encoded, (int)decode.encodedSize, &width, &height, &comp, 4);
+    decode.success =
+        pixels && (uint32_t)width == decode.width && (uint32_t)height == decode.height;
+
+    // stb_image only decodes in memory of its own, copy to the ring and give it back right away.
+    if (decode.success)
+      memcpy(decode.destination, pixels, (size_t)decode.width * decode.height * 4);
+    stbi_image_free(pixels);
+  }
+}
 //---------------------------------------------------------------------------//
 void AsynchronousLoader::init(
     RendererUtil::Renderer* p_Renderer,
@@ -20,10 +120,9 @@ void AsynchronousLoader::init(
 
   fileLoadRequests.init(allocator, 16);
   uploadRequests.init(allocator, 16);
-
-  textureReady.index = kInvalidTexture.index;
-  cpuBufferReady.index = kInvalidBuffer.index;
-  gpuBufferReady.index = kInvalidBuffer.index;
+  submittedUploads.init(allocator, kMaxUploadsPerSubmission);
+  pendingDecodes.init(allocator, kMaxDecodesPerBatch);
+  decodes.init(allocator, kMaxDecodesPerBatch);
 
   using namespace Framework;
 
@@ -38,7 +137,17 @@ void AsynchronousLoader::init(
   stagingBuffer =
       (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(stagingBufferHandle.index);
 
-  stagingBufferOffset = 0;
+  // Decoded textures are written here by the decode tasks and copied to the images from there.
+  bc.reset()
+      .set(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, ResourceUsageType::kStream, kTextureStagingSize)
+      .setName("texture_staging_ring")
+      .setPersistent(true);
+  BufferHandle textureStagingBufferHandle = renderer->m_GpuDevice->createBuffer(bc);
+
+  textureStagingBuffer =
+      (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(textureStagingBufferHandle.index);
+  textureStagingRing.init(kTextureStagingSize);
+  decodeInFlight = false;
 
   for (uint32_t i = 0; i < kMaxFrames; ++i)
   {
@@ -84,159 +193,367 @@ void AsynchronousLoader::update(Framework::Allocator* scratchAllocator)
 {
   using namespace Framework;
 
-  // If a texture was processed in the previous commands, signal the renderer
-  if (textureReady.index != kInvalidTexture.index)
+  GpuDevice* gpu = renderer->m_GpuDevice;
+  const bool transferDone = vkGetFenceStatus(gpu->m_VulkanDevice, transferFence) == VK_SUCCESS;
+
+  // The last submission is done: signal its resources and give back its staging memory.
+  if (transferDone && submittedUploads.m_Size > 0)
   {
-    // Add update request.
-    // This method is multithreaded_safe
-    renderer->addTextureToUpdate(textureReady);
+    for (uint32_t i = 0; i < submittedUploads.m_Size; ++i)
+    {
+      const UploadRequest& request = submittedUploads[i];
+      if (request.texture.index != kInvalidTexture.index)
+      {
+        // Add update request.
+        // This method is multithreaded_safe
+        renderer->addTextureToUpdate(request.texture);
+
+        if (!request.data)
+          textureStagingRing.release(request.stagingOffset);
+      }
+      else if (
+          request.cpuBuffer.index != kInvalidBuffer.index &&
+          request.gpuBuffer.index != kInvalidBuffer.index)
+      {
+        // TODO: free cpu buffer
+        gpu->destroyBuffer(request.cpuBuffer);
+
+        Buffer* buffer = (Buffer*)gpu->m_Buffers.accessResource(request.gpuBuffer.index);
+        buffer->ready = true;
+      }
+
+      // Copied to the staging buffer when recorded, kept until now for simplicity.
+      free(request.data);
+    }
+    submittedUploads.clear();
   }
 
-  if (cpuBufferReady.index != kInvalidBuffer.index && cpuBufferReady.index != kInvalidBuffer.index)
+  // Hand the file requests to the io service first, so that reads carry on while the transfer
+  // queue is busy and overlap the decode below.
+  IoService* ioService = IoService::instance();
+  if (fileLoadRequests.m_Size > 0)
   {
-    // TODO: free cpu buffer
-    renderer->m_GpuDevice->destroyBuffer(cpuBufferReady);
-
-    Buffer* buffer = (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(gpuBufferReady.index);
-    buffer->ready = true;
+    IoReadRequest reads[kMaxReadsPerUpdate];
+    uint32_t readRequestIndices[kMaxReadsPerUpdate];
+    uint32_t readCount = 0;
+    for (uint32_t i = 0; i < fileLoadRequests.m_Size && readCount < kMaxReadsPerUpdate; ++i)
+    {
+      const FileLoadRequest& loadRequest = fileLoadRequests[i];
+      if (loadRequest.data)
+        continue;
+
+      IoReadRequest& read = reads[readCount];
+      read.path = loadRequest.path;
+      read.offset = 0;
+      read.size = 0;
+      read.destination = nullptr;
+      read.userData =
+          ((uint64_t)loadRequest.texture.generation << 32) | loadRequest.texture.index;
+      readRequestIndices[readCount++] = i;
+    }
 
-    gpuBufferReady.index = kInvalidBuffer.index;
-    cpuBufferReady.index = kInvalidBuffer.index;
+    // Requests not accepted stay queued for the next update.
+    const uint32_t submitted = ioService->submit(reads, readCount);
+    for (uint32_t i = submitted; i > 0; --i)
+      fileLoadRequests.deleteSwap(readRequestIndices[i - 1]);
   }
 
-  textureReady.index = kInvalidTexture.index;
+  // Decode before processing uploads, so finished decodes join this submission.
+  updateDecodes();
 
-  // Process upload requests
-  if (uploadRequests.m_Size > 0)
-  {
-    // Wait for transfer fence to be finished
-    if (vkGetFenceStatus(renderer->m_GpuDevice->m_VulkanDevice, transferFence) != VK_SUCCESS)
-    {
-      return;
-    }
-    // Reset if file requests are present.
-    vkResetFences(renderer->m_GpuDevice->m_VulkanDevice, 1, &transferFence);
+  // One submission at a time, the next one is recorded once the transfer fence signals.
+  if (uploadRequests.m_Size == 0 || !transferDone)
+    return;
+
+  vkResetFences(gpu->m_VulkanDevice, 1, &transferFence);
 
-    // Get last request
-    UploadRequest request = uploadRequests.back();
-    uploadRequests.pop();
+  CommandBuffer* cb = &commandBuffers[gpu->m_CurrentFrameIndex];
+  cb->begin();
 
-    CommandBuffer* cb = &commandBuffers[renderer->m_GpuDevice->m_CurrentFrameIndex];
-    cb->begin();
+  // Record all the uploads that fit in the staging buffer, the others wait for the next
+  // submission. Uploads decoded in the staging ring need no space in it.
+  size_t stagingOffset = 0;
+  for (uint32_t i = uploadRequests.m_Size;
+       i > 0 && submittedUploads.m_Size < kMaxUploadsPerSubmission;
+       --i)
+  {
+    const UploadRequest request = uploadRequests[i - 1];
 
     if (request.texture.index != kInvalidTexture.index)
     {
-      Texture* texture =
-          (Texture*)renderer->m_GpuDevice->m_Textures.accessResource(request.texture.index);
-      const uint32_t kTextureChannels = 4;
-      const uint32_t kTextureAlignment = 4;
-      const size_t alignedImageSize =
-          memoryAlign(texture->width * texture->height * kTextureChannels, kTextureAlignment);
-      // Request place in buffer
-      const size_t currentOffset = std::atomic_fetch_add(&stagingBufferOffset, alignedImageSize);
-
-      cb->uploadTextureData(texture->handle, request.data, stagingBuffer->handle, currentOffset);
-
-      free(request.data);
+      Texture* texture = (Texture*)gpu->m_Textures.accessResource(request.texture.index);
+
+      if (request.data)
+      {
+        const uint32_t kTextureChannels = 4;
+        const uint32_t kTextureAlignment = 4;
+        const size_t alignedImageSize =
+            memoryAlign(texture->width * texture->height * kTextureChannels, kTextureAlignment);
+        const size_t offset = memoryAlign(stagingOffset, kTextureAlignment);
+        if (offset + alignedImageSize > stagingBuffer->size)
+          continue;
+
+        cb->uploadTextureData(texture->handle, request.data, stagingBuffer->handle, offset);
+        stagingOffset = offset + alignedImageSize;
+      }
+      else
+      {
+        // Already decoded in the staging ring, released once the transfer is done.
+        cb->uploadTextureData(
+            texture->handle, nullptr, textureStagingBuffer->handle, request.stagingOffset);
+      }
     }
     else if (
         request.cpuBuffer.index != kInvalidBuffer.index &&
         request.gpuBuffer.index != kInvalidBuffer.index)
     {
-      Buffer* src =
-          (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(request.cpuBuffer.index);
-      Buffer* dst =
-          (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(request.gpuBuffer.index);
+      Buffer* src = (Buffer*)gpu->m_Buffers.accessResource(request.cpuBuffer.index);
+      Buffer* dst = (Buffer*)gpu->m_Buffers.accessResource(request.gpuBuffer.index);
 
       cb->uploadBufferData(src->handle, dst->handle);
     }
     else if (request.cpuBuffer.index != kInvalidBuffer.index)
     {
-      Buffer* buffer =
-          (Buffer*)renderer->m_GpuDevice->m_Buffers.accessResource(request.cpuBuffer.index);
+      Buffer* buffer = (Buffer*)gpu->m_Buffers.accessResource(request.cpuBuffer.index);
       // TODO: proper alignment
-      const size_t alignedImageSize = memoryAlign(buffer->size, 64);
-      const size_t currentOffset = std::atomic_fetch_add(&stagingBufferOffset, alignedImageSize);
-      cb->uploadBufferData(buffer->handle, request.data, stagingBuffer->handle, currentOffset);
-
-      free(request.data);
+      const size_t alignedSize = memoryAlign(buffer->size, 64);
+      if (alignedSize > stagingBuffer->size)
+      {
+        printf(
+            "Error uploading buffer %u, too large for the staging buffer\n",
+            buffer->handle.index);
+        free(request.data);
+        uploadRequests.deleteSwap(i - 1);
+        continue;
+      }
+
+      const size_t offset = memoryAlign(stagingOffset, 64);
+      if (offset + alignedSize > stagingBuffer->size)
+        continue;
+
+      cb->uploadBufferData(buffer->handle, request.data, stagingBuffer->handle, offset);
+      stagingOffset = offset + alignedSize;
     }
 
-    cb->end();
+    submittedUploads.push(request);
+    uploadRequests.deleteSwap(i - 1);
+  }
 
-    VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &cb->m_VulkanCmdBuffer;
-    VkPipelineStageFlags wait_flag[]{VK_PIPELINE_STAGE_TRANSFER_BIT};
-    VkSemaphore wait_semaphore[]{transferCompleteSemaphore};
-    submitInfo.pWaitSemaphores = wait_semaphore;
-    submitInfo.pWaitDstStageMask = wait_flag;
+  cb->end();
 
-    VkQueue usedQueue = renderer->m_GpuDevice->m_VulkanTransferQueue;
-    vkQueueSubmit(usedQueue, 1, &submitInfo, transferFence);
+  VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cb->m_VulkanCmdBuffer;
+  VkPipelineStageFlags wait_flag[]{VK_PIPELINE_STAGE_TRANSFER_BIT};
+  VkSemaphore wait_semaphore[]{transferCompleteSemaphore};
+  submitInfo.pWaitSemaphores = wait_semaphore;
+  submitInfo.pWaitDstStageMask = wait_flag;
 
-    // TODO: better management for state machine. We need to account for file -> buffer,
-    // buffer -> texture and buffer -> buffer. One the CPU buffer has been used it should be freed.
-    if (request.texture.index != kInvalidIndex)
+  VkQueue usedQueue = gpu->m_VulkanTransferQueue;
+  vkQueueSubmit(usedQueue, 1, &submitInfo, transferFence);
+}
+//---------------------------------------------------------------------------//
+void AsynchronousLoader::decodeTexture(
+    const uint8_t* data, size_t dataSize, TextureHandle texture)
+{
+  using namespace Framework;
+
+  Texture* textureResource =
+      (Texture*)renderer->m_GpuDevice->m_Textures.accessResource(texture.index);
+  const char* name =
+      textureResource && textureResource->name ? textureResource->name : "unnamed";
+
+  int x, y, comp;
+  uint8_t* textureData =
+      data ? stbi_load_from_memory(data, (int)dataSize, &x, &y, &comp, 4) : nullptr;
+
+  if (textureData)
+  {
+    UploadRequest& uploadRequest = uploadRequests.pushUse();
+    uploadRequest.data = textureData;
+    uploadRequest.texture = texture;
+    uploadRequest.cpuBuffer = kInvalidBuffer;
+  }
+  else
+  {
+    printf("Error reading texture %s\n", name);
+  }
+}
+//---------------------------------------------------------------------------//
+void AsynchronousLoader::updateDecodes()
+{
+  using namespace Framework;
+
+  IoService* ioService = IoService::instance();
+
+  // Hand the finished batch to the upload stage.
+  if (decodeInFlight && decodeTask.GetIsComplete())
+  {
+    for (uint32_t i = 0; i < decodes.m_Size; ++i)
     {
-      assert(textureReady.index == kInvalidTexture.index);
-      textureReady = request.texture;
+      TextureDecode& decode = decodes[i];
+      ioService->release(decode.read);
+
+      if (decode.success)
+      {
+        UploadRequest& uploadRequest = uploadRequests.pushUse();
+        uploadRequest.data = nullptr;
+        uploadRequest.stagingOffset = decode.stagingOffset;
+        uploadRequest.texture = decode.texture;
+        uploadRequest.cpuBuffer = kInvalidBuffer;
+      }
+      else
+      {
+        textureStagingRing.release(decode.stagingOffset);
+        printf("Error decoding texture %u\n", decode.texture.index);
+      }
     }
-    else if (
-        request.cpuBuffer.index != kInvalidBuffer.index &&
-        request.gpuBuffer.index != kInvalidBuffer.index)
-    {
-      assert(cpuBufferReady.index == kInvalidIndex);
-      assert(gpuBufferReady.index == kInvalidIndex);
 
-      cpuBufferReady = request.cpuBuffer;
-      gpuBufferReady = request.gpuBuffer;
-    }
-    else if (request.cpuBuffer.index != kInvalidIndex)
+    decodes.clear();
+    decodeInFlight = false;
+  }
+
+  // Gather encoded images, finished reads first then images already in memory.
+  if (pendingDecodes.m_Size < kMaxDecodesPerBatch)
+  {
+    IoCompletion completions[kMaxDecodesPerBatch];
+    const uint32_t completionCount =
+        ioService->poll(completions, kMaxDecodesPerBatch - pendingDecodes.m_Size);
+    for (uint32_t i = 0; i < completionCount; ++i)
     {
-      assert(cpuBufferReady.index == kInvalidIndex);
-      cpuBufferReady = request.cpuBuffer;
+      const IoCompletion& completion = completions[i];
+      TextureHandle texture = {
+          (uint32_t)completion.userData, (uint32_t)(completion.userData >> 32)};
+      if (completion.success)
+      {
+        queueDecode(completion.data, completion.size, completion, texture);
+        continue;
+      }
+
+      printf("Error reading texture %u\n", texture.index);
+      ioService->release(completion);
     }
   }
 
-  // Process a file request
-  if (fileLoadRequests.m_Size > 0)
+  for (uint32_t i = fileLoadRequests.m_Size;
+       i > 0 && pendingDecodes.m_Size < kMaxDecodesPerBatch;
+       --i)
   {
-    FileLoadRequest loadRequest = fileLoadRequests.back();
-    fileLoadRequests.pop();
+    const FileLoadRequest loadRequest = fileLoadRequests[i - 1];
+    if (!loadRequest.data)
+      continue;
 
-    int64_t startReadingFile = Time::getCurrentTime();
-    // Process request
-    int x, y, comp;
-    uint8_t* textureData = stbi_load(loadRequest.path, &x, &y, &comp, 4);
+    fileLoadRequests.deleteSwap(i - 1);
+    queueDecode(loadRequest.data, loadRequest.dataSize, IoCompletion{}, loadRequest.texture);
+  }
+
+  if (decodeInFlight || !pendingDecodes.m_Size)
+    return;
 
-    if (textureData)
+  // Start the next batch with the images that fit in the staging ring, the others wait for
+  // uploads to give their regions back.
+  for (uint32_t i = pendingDecodes.m_Size; i > 0; --i)
+  {
+    TextureDecode& decode = pendingDecodes[i - 1];
+    const size_t decodedSize =
+        memoryAlign((size_t)decode.width * decode.height * 4, kTextureStagingAlignment);
+    if (!textureStagingRing.allocate(decodedSize, decode.stagingOffset))
+      continue;
+
+    decode.destination = textureStagingBuffer->mappedData + decode.stagingOffset;
+    decodes.push(decode);
+    pendingDecodes.deleteSwap(i - 1);
+  }
+
+  if (!decodes.m_Size)
+    return;
+
+  decodeTask.decodes = decodes.m_Data;
+  decodeTask.m_SetSize = decodes.m_Size;
+  decodeTask.m_MinRange = 1;
+  decodeInFlight = true;
+
+  if (taskScheduler)
+  {
+    taskScheduler->AddTaskSetToPipe(&decodeTask);
+  }
+  else
+  {
+    decodeTask.ExecuteRange({0, decodeTask.m_SetSize}, 0);
+  }
+}
+//---------------------------------------------------------------------------//
+bool AsynchronousLoader::hasPendingWork() const
+{
+  return fileLoadRequests.m_Size > 0 || Framework::IoService::instance()->inFlightCount() > 0 ||
+         pendingDecodes.m_Size > 0 || decodes.m_Size > 0 || decodeInFlight ||
+         uploadRequests.m_Size > 0 || submittedUploads.m_Size > 0;
+}
+//---------------------------------------------------------------------------//
+void AsynchronousLoader::queueDecode(
+    const uint8_t* data,
+    size_t dataSize,
+    const Framework::IoCompletion& read,
+    TextureHandle texture)
+{
+  Texture* textureResource =
+      (Texture*)renderer->m_GpuDevice->m_Textures.accessResource(texture.index);
+  if (!textureResource)
+  {
+    printf("Error decoding texture %u, it does not exist\n", texture.index);
+    Framework::IoService::instance()->release(read);
+    return;
+  }
+
+  // Textures that can never fit in the staging ring are decoded here, in memory of their own, and
+  // uploaded through the staging buffer. The ones too large for both are dropped.
+  const size_t decodedSize = (size_t)textureResource->width * textureResource->height * 4;
+  if (decodedSize > textureStagingRing.capacity)
+  {
+    if (Framework::memoryAlign(decodedSize, 4) <= stagingBuffer->size)
     {
-      printf(
-          "File %s read in %f ms\n",
-          loadRequest.path,
-          Time::deltaFromStartMilliseconds(startReadingFile));
-
-      UploadRequest& uploadRequest = uploadRequests.pushUse();
-      uploadRequest.data = textureData;
-      uploadRequest.texture = loadRequest.texture;
-      uploadRequest.cpuBuffer = kInvalidBuffer;
+      decodeTexture(data, dataSize, texture);
     }
     else
     {
-      printf("Error reading file %s\n", loadRequest.path);
+      printf(
+          "Error decoding texture %s, too large for the staging buffers\n",
+          textureResource->name ? textureResource->name : "unnamed");
     }
+    Framework::IoService::instance()->release(read);
+    return;
   }
 
-  stagingBufferOffset = 0;
+  TextureDecode& decode = pendingDecodes.pushUse();
+  decode = TextureDecode();
+  decode.encoded = data;
+  decode.encodedSize = dataSize;
+  decode.read = read;
+  decode.texture = texture;
+  decode.width = textureResource->width;
+  decode.height = textureResource->height;
 }
 //---------------------------------------------------------------------------//
 void AsynchronousLoader::shutdown()
 {
+  // Encoded images of unfinished decodes are still owned by the io service.
+  if (decodeInFlight && taskScheduler && !decodeTask.GetIsComplete())
+    taskScheduler->WaitforTask(&decodeTask);
+
+  Framework::IoService* ioService = Framework::IoService::instance();
+  for (uint32_t i = 0; i < decodes.m_Size; ++i)
+    ioService->release(decodes[i].read);
+  for (uint32_t i = 0; i < pendingDecodes.m_Size; ++i)
+    ioService->release(pendingDecodes[i].read);
+
   renderer->m_GpuDevice->destroyBuffer(stagingBuffer->handle);
+  renderer->m_GpuDevice->destroyBuffer(textureStagingBuffer->handle);
 
   fileLoadRequests.shutdown();
   uploadRequests.shutdown();
+  submittedUploads.shutdown();
+  pendingDecodes.shutdown();
+  decodes.shutdown();
 
   for (uint32_t i = 0; i < kMaxFrames; ++i)
   {
@@ -261,6 +578,19 @@ void AsynchronousLoader::requestTextureData(const char* filename, TextureHandle
 {
   FileLoadRequest& request = fileLoadRequests.pushUse();
   strcpy(request.path, filename);
+  request.data = nullptr;
+  request.dataSize = 0;
+  request.texture = texture;
+  request.buffer = kInvalidBuffer;
+}
+//---------------------------------------------------------------------------//
+void AsynchronousLoader::requestTextureData(
+    const uint8_t* data, uint32_t dataSize, TextureHandle texture)
+{
+  FileLoadRequest& request = fileLoadRequests.pushUse();
+  strcpy(request.path, "embedded");
+  request.data = data;
+  request.dataSize = dataSize;
   request.texture = texture;
   request.buffer = kInvalidBuffer;
 }
@@ -4,12 +4,9 @@
 #include "Graphics/GpuDevice.hpp"
 #include "Graphics/CommandBuffer.hpp"
 
-#include <atomic>
+#include "Foundation/IoService.hpp"
 
-namespace enki
-{
-class TaskScheduler;
-}
+#include "Externals/enkiTS/TaskScheduler.h"
 //---------------------------------------------------------------------------//
 namespace Graphics
 {
@@ -27,6 +24,9 @@ struct Renderer;
 struct FileLoadRequest
 {
   char path[512];
+  // Encoded image already in memory (embedded in a glTF), used instead of the path when set.
+  const uint8_t* data = nullptr;
+  uint32_t dataSize = 0;
   TextureHandle texture = kInvalidTexture;
   BufferHandle buffer = kInvalidBuffer;
 }; // struct FileLoadRequest
@@ -34,12 +34,67 @@ struct FileLoadRequest
 struct UploadRequest
 {
   void* data = nullptr;
+  // Texture already decoded in the staging ring at this offset, used when data is null.
+  size_t stagingOffset = 0;
   uint32_t* completed = nullptr;
   TextureHandle texture = kInvalidTexture;
   BufferHandle cpuBuffer = kInvalidBuffer;
   BufferHandle gpuBuffer = kInvalidBuffer;
 }; // struct UploadRequest
 //---------------------------------------------------------------------------//
+// Staging memory decoded textures are written to. Regions are released in any order once their
+// upload is done, memory is reclaimed in allocation order.
+struct StagingRing
+{
+  void init(size_t capacity);
+
+  // Returns false when there is no contiguous space left for the region.
+  bool allocate(size_t size, size_t& outOffset);
+  void release(size_t offset);
+
+  struct Region
+  {
+    size_t offset;
+    size_t end;
+    size_t consumed; // Includes the space skipped at the end of the ring when wrapping.
+    bool released;
+  };
+
+  static constexpr uint32_t kMaxRegions = 256;
+
+  Region regions[kMaxRegions];
+  uint32_t firstRegion = 0;
+  uint32_t regionCount = 0;
+
+  size_t capacity = 0;
+  size_t head = 0;
+  size_t tail = 0;
+  size_t used = 0;
+}; // struct StagingRing
+//---------------------------------------------------------------------------//
+struct TextureDecode
+{
+  const uint8_t* encoded = nullptr;
+  size_t encodedSize = 0;
+  // Read the encoded image comes from, released once decoded. Empty for images in memory.
+  Framework::IoCompletion read = {};
+
+  TextureHandle texture = kInvalidTexture;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t* destination = nullptr;
+  size_t stagingOffset = 0;
+  bool success = false;
+}; // struct TextureDecode
+//---------------------------------------------------------------------------//
+// Decodes a batch of textures in parallel, each task writes RGBA straight in the staging ring.
+struct TextureDecodeTask : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition p_Range, uint32_t p_ThreadNum) override;
+
+  TextureDecode* decodes = nullptr;
+}; // struct TextureDecodeTask
+//---------------------------------------------------------------------------//
 struct AsynchronousLoader
 {
 
@@ -51,22 +106,42 @@ struct AsynchronousLoader
   void shutdown();
 
   void requestTextureData(const char* filename, TextureHandle texture);
+  void requestTextureData(const uint8_t* data, uint32_t dataSize, TextureHandle texture);
   void requestBufferUpload(void* data, BufferHandle buffer);
   void requestBufferCopy(BufferHandle src, BufferHandle dst);
 
+  // Decodes an encoded image and queues its upload, data is null for failed reads.
+  void decodeTexture(const uint8_t* data, size_t dataSize, TextureHandle texture);
+
+  // Collects the finished decode batch and starts the next one.
+  void updateDecodes();
+  // Reads, decodes or uploads are still outstanding.
+  bool hasPendingWork() const;
+  void queueDecode(
+      const uint8_t* data,
+      size_t dataSize,
+      const Framework::IoCompletion& read,
+      TextureHandle texture);
+
   Framework::Allocator* allocator = nullptr;
   RendererUtil::Renderer* renderer = nullptr;
   enki::TaskScheduler* taskScheduler = nullptr;
 
   Framework::Array<FileLoadRequest> fileLoadRequests;
   Framework::Array<UploadRequest> uploadRequests;
+  // Uploads of the last transfer submission, finished once the transfer fence signals.
+  Framework::Array<UploadRequest> submittedUploads;
 
   Buffer* stagingBuffer = nullptr;
 
-  std::atomic_size_t stagingBufferOffset;
-  TextureHandle textureReady;
-  BufferHandle cpuBufferReady;
-  BufferHandle gpuBufferReady;
+  // Parallel decode stage
+  Framework::Array<TextureDecode> pendingDecodes;
+  Framework::Array<TextureDecode> decodes;
+  TextureDecodeTask decodeTask;
+  bool decodeInFlight = false;
+
+  Buffer* textureStagingBuffer = nullptr;
+  StagingRing textureStagingRing;
 
   VkCommandPool commandPools[kMaxFrames];
   CommandBuffer commandBuffers[kMaxFrames];
@@ -1,5 +1,7 @@
 #include "CommandBuffer.hpp"
 
+#include <new>
+
 namespace Graphics
 {
 static const uint32_t g_SecondaryCommandBuffersCount = 2;
@@ -75,18 +77,9 @@ void CommandBuffer::reset()
 
   vkResetDescriptorPool(m_GpuDevice->m_VulkanDevice, m_VulkanDescriptorPool, 0);
 
-  uint32_t resourceCount = m_DescriptorSets.m_FreeIndicesHead;
-  for (uint32_t i = 0; i < resourceCount; ++i)
-  {
-    DescriptorSet* descriptorSet = (DescriptorSet*)m_DescriptorSets.accessResource(i);
-
-    if (descriptorSet)
-    {
-      // Contains the allocation for all the resources, binding and samplers arrays.
-      FRAMEWORK_FREE(descriptorSet->resources, m_GpuDevice->m_Allocator);
-    }
-    m_DescriptorSets.releaseResource(i);
-  }
+  // Resources, binding and samplers arrays of the sets live in the frame arena, cleared by the
+  // device, only the slots are given back.
+  m_DescriptorSets.freeAllResources();
 }
 //---------------------------------------------------------------------------//
 void CommandBuffer::bindLocalDescriptorSet(
@@ -168,7 +161,7 @@ void CommandBuffer::bindPass(
     {
       Framework::Array<VkRenderingAttachmentInfoKHR> colorAttachmentsInfo;
       colorAttachmentsInfo.init(
-          m_GpuDevice->m_Allocator,
+          m_ThreadFramePool->frameArena,
           framebuffer->numColorAttachments,
           framebuffer->numColorAttachments);
       memset(
@@ -524,9 +517,38 @@ void CommandBuffer::drawIndirect(
       m_VulkanCmdBuffer, vkBuffer, vkOffset, p_DrawCount, sizeof(VkDrawIndirectCommand));
 }
 //---------------------------------------------------------------------------//
-void CommandBuffer::drawIndexedIndirect(BufferHandle p_Handle, uint32_t p_Offset, uint32_t p_Stride)
+void CommandBuffer::drawIndexedIndirect(
+    BufferHandle p_Handle, uint32_t p_DrawCount, uint32_t p_Offset, uint32_t p_Stride)
 {
-  assert(false && "Not implemented");
+  Buffer* buffer = (Buffer*)m_GpuDevice->m_Buffers.accessResource(p_Handle.index);
+
+  VkBuffer vkBuffer = buffer->vkBuffer;
+  VkDeviceSize vkOffset = p_Offset;
+
+  vkCmdDrawIndexedIndirect(m_VulkanCmdBuffer, vkBuffer, vkOffset, p_DrawCount, p_Stride);
+}
+//---------------------------------------------------------------------------//
+void CommandBuffer::drawIndexedIndirectCount(
+    BufferHandle p_Handle,
+    uint32_t p_Offset,
+    BufferHandle p_CountHandle,
+    uint32_t p_CountOffset,
+    uint32_t p_MaxDrawCount,
+    uint32_t p_Stride)
+{
+  assert(m_GpuDevice->m_DrawIndirectCountExtensionPresent);
+
+  Buffer* buffer = (Buffer*)m_GpuDevice->m_Buffers.accessResource(p_Handle.index);
+  Buffer* countBuffer = (Buffer*)m_GpuDevice->m_Buffers.accessResource(p_CountHandle.index);
+
+  m_GpuDevice->m_CmdDrawIndexedIndirectCount(
+      m_VulkanCmdBuffer,
+      buffer->vkBuffer,
+      VkDeviceSize(p_Offset),
+      countBuffer->vkBuffer,
+      VkDeviceSize(p_CountOffset),
+      p_MaxDrawCount,
+      p_Stride);
 }
 //---------------------------------------------------------------------------//
 void CommandBuffer::dispatch(uint32_t p_GroupX, uint32_t p_GroupY, uint32_t p_GroupZ)
@@ -868,9 +890,11 @@ DescriptorSetHandle CommandBuffer::createDescriptorSet(const DescriptorSetCreati
   assert(result == VK_SUCCESS);
 
   // Cache data
-  uint8_t* memory = FRAMEWORK_ALLOCAM(
+  // Only used while recording this frame.
+  uint8_t* memory = (uint8_t*)FRAMEWORK_ALLOCAA(
       (sizeof(ResourceHandle) + sizeof(SamplerHandle) + sizeof(uint16_t)) * creation.numResources,
-      m_GpuDevice->m_Allocator);
+      m_ThreadFramePool->frameArena,
+      alignof(ResourceHandle));
   descriptorSet->resources = (ResourceHandle*)memory;
   descriptorSet->samplers =
       (SamplerHandle*)(memory + sizeof(ResourceHandle) * creation.numResources);
@@ -985,11 +1009,14 @@ void CommandBuffer::uploadTextureData(
       static_cast<Buffer*>(m_GpuDevice->m_Buffers.accessResource(p_StagingBuffer.index));
   uint32_t imageSize = texture->width * texture->height * 4;
 
-  // Copy buffer_data to staging buffer
-  memcpy(
-      stagingBuffer->mappedData + p_StagingBufferOffset,
-      p_TextureData,
-      static_cast<size_t>(imageSize));
+  // Copy buffer_data to staging buffer, null data is already there.
+  if (p_TextureData)
+  {
+    memcpy(
+        stagingBuffer->mappedData + p_StagingBufferOffset,
+        p_TextureData,
+        static_cast<size_t>(imageSize));
+  }
 
   VkBufferImageCopy region = {};
   region.bufferOffset = p_StagingBufferOffset;
@@ -1225,7 +1252,7 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
     cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     cmd.commandBufferCount = 1;
 
-    CommandBuffer& currentCommandBuffer = m_CommandBuffers[i];
+    CommandBuffer& currentCommandBuffer = *new (&m_CommandBuffers[i]) CommandBuffer();
     vkAllocateCommandBuffers(
         m_GpuDevice->m_VulkanDevice, &cmd, &currentCommandBuffer.m_VulkanCmdBuffer);
 
@@ -1249,7 +1276,8 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
 
     for (uint32_t cmdIndex = 0; cmdIndex < g_SecondaryCommandBuffersCount; ++cmdIndex)
     {
-      CommandBuffer cmdBuf{};
+      // Built in place, command buffers own their descriptor set pool and cannot be copied.
+      CommandBuffer& cmdBuf = *new (&m_SecondaryCommandBuffers.pushUse()) CommandBuffer();
       cmdBuf.m_VulkanCmdBuffer = secondaryBuffers[cmdIndex];
 
       cmdBuf.m_Handle = handle++;
@@ -1258,7 +1286,6 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
 
       // NOTE: access to the descriptor pool has to be synchronized
       // across threads. Don't allow for now
-      m_SecondaryCommandBuffers.push(cmdBuf);
     }
   }
 
@@ -1270,7 +1297,7 @@ void CommandBufferManager::init(GpuDevice* p_GpuDevice, uint32_t p_NumThreads)
     cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     cmd.commandBufferCount = 1;
 
-    CommandBuffer& currentCommandBuffer = m_ComputeCommandBuffers[i];
+    CommandBuffer& currentCommandBuffer = *new (&m_ComputeCommandBuffers[i]) CommandBuffer();
     vkAllocateCommandBuffers(
         m_GpuDevice->m_VulkanDevice, &cmd, &currentCommandBuffer.m_VulkanCmdBuffer);
 
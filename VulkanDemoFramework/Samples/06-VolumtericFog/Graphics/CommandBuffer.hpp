@@ -70,7 +70,18 @@ struct CommandBuffer
 
   void
   drawIndirect(BufferHandle p_Handle, uint32_t p_DrawCount, uint32_t p_Offset, uint32_t p_Stride);
-  void drawIndexedIndirect(BufferHandle p_Handle, uint32_t p_Offset, uint32_t p_Stride);
+  // Multi draw: p_DrawCount commands read p_Stride bytes apart, starting at p_Offset.
+  void drawIndexedIndirect(
+      BufferHandle p_Handle, uint32_t p_DrawCount, uint32_t p_Offset, uint32_t p_Stride);
+  // Multi draw whose draw count is read from p_CountHandle, at most p_MaxDrawCount commands.
+  // Needs GpuDevice::m_DrawIndirectCountExtensionPresent.
+  void drawIndexedIndirectCount(
+      BufferHandle p_Handle,
+      uint32_t p_Offset,
+      BufferHandle p_CountHandle,
+      uint32_t p_CountOffset,
+      uint32_t p_MaxDrawCount,
+      uint32_t p_Stride);
 
   void dispatch(uint32_t p_GroupX, uint32_t p_GroupY, uint32_t p_GroupZ);
   void dispatchIndirect(BufferHandle p_Handle, uint32_t p_Offset);
@@ -83,6 +94,7 @@ struct CommandBuffer
   void popMarker();
 
   // Non-drawing methods
+  // Null texture data uploads what is already in the staging buffer at the offset.
   void uploadTextureData(
       TextureHandle p_Texture,
       void* p_TextureData,
@@ -144,7 +156,8 @@ struct CommandBufferManager
 
   GpuDevice* m_GpuDevice = nullptr;
   uint32_t m_NumPoolsPerFrame = 0;
-  uint32_t m_NumCommandBuffersPerThread = 3;
+  // Enough for a thread recording several frame graph ranges in the same frame.
+  uint32_t m_NumCommandBuffersPerThread = 8;
 };
 //---------------------------------------------------------------------------//
 } // namespace Graphics
@@ -8,6 +8,7 @@
 #include "Graphics/CommandBuffer.hpp"
 
 #include "Externals/json.hpp"
+#include "Externals/imgui/imgui.h"
 
 namespace Graphics
 {
@@ -74,8 +75,15 @@ void FrameGraph::init(FrameGraphBuilder* builder_)
 
   builder = builder_;
 
-  nodes.init(allocator, FrameGraphBuilder::k_max_nodes_count);
-  all_nodes.init(allocator, FrameGraphBuilder::k_max_nodes_count);
+  nodes.init(allocator, FrameGraphBuilder::k_pool_page_size);
+  all_nodes.init(allocator, FrameGraphBuilder::k_pool_page_size);
+  transient_memory_blocks.init(allocator, 16);
+  transient_resources.init(allocator, FrameGraphBuilder::k_pool_page_size);
+  barriers.init(allocator, FrameGraphBuilder::k_pool_page_size);
+  node_edges.init(allocator, FrameGraphBuilder::k_pool_page_size);
+  culled_nodes.init(allocator, FrameGraphBuilder::k_pool_page_size);
+
+  compile_allocator.init(FRAMEWORK_MEGA(1));
 }
 
 void FrameGraph::shutdown()
@@ -95,25 +103,33 @@ void FrameGraph::shutdown()
 
   all_nodes.shutdown();
   nodes.shutdown();
+  culled_nodes.shutdown();
+  node_edges.shutdown();
+  barriers.shutdown();
+
+  // Released by the device after the textures bound to them.
+  for (uint32_t i = 0; i < transient_memory_blocks.m_Size; ++i)
+  {
+    builder->device->freeMemory(transient_memory_blocks[i]);
+  }
+  transient_memory_blocks.shutdown();
+  transient_resources.shutdown();
 
+  compile_allocator.shutdown();
   local_allocator.shutdown();
 }
 
-void FrameGraph::parse(cstring file_path, Framework::StackAllocator* temp_allocator)
+void FrameGraph::parse_json(cstring file_path, Framework::StackAllocator* temp_allocator)
 {
   using json = nlohmann::json;
 
-  if (!Framework::fileExists(file_path))
-  {
-    assert(false);
-    return;
-  }
-
   size_t current_allocator_marker = temp_allocator->getMarker();
 
-  FileReadResult read_result = Framework::fileReadText(file_path, temp_allocator);
+  // Parsed straight from the mapped file.
+  Framework::ScopedFileMapping graph_file(file_path, Framework::FileAccessHint::kSequential);
+  const uint8_t* graph_text = graph_file.m_Mapping.data;
 
-  json graph_data = json::parse(read_result.data);
+  json graph_data = json::parse(graph_text, graph_text + graph_file.m_Mapping.size);
 
   StringBuffer string_buffer;
   string_buffer.init(2048, &local_allocator);
@@ -283,61 +299,434 @@ void FrameGraph::parse(cstring file_path, Framework::StackAllocator* temp_alloca
   temp_allocator->freeMarker(current_allocator_marker);
 }
 
-static void compute_edges(FrameGraph* frame_graph, FrameGraphNode* node, uint32_t node_index)
+static cstring k_baked_extension = ".fgb";
+
+// Baked graph next to the JSON one, with the extension replaced.
+static void baked_path_from_source(cstring file_path, char* baked_path)
 {
+  const size_t length = strlen(file_path);
+  assert(length + strlen(k_baked_extension) < kMaxPath);
+  memcpy(baked_path, file_path, length + 1);
 
-  FrameGraphNodeHandle node_handle = frame_graph->all_nodes[node_index];
+  // Only a dot in the file name starts the extension, directories can have dots too.
+  char* file_name = baked_path;
+  for (char* c = baked_path; *c; ++c)
+  {
+    if (*c == '/' || *c == '\\')
+    {
+      file_name = c + 1;
+    }
+  }
 
-  for (uint32_t r = 0; r < node->inputs.m_Size; ++r)
+  char* extension = strrchr(file_name, '.');
+  strcpy(extension ? extension : baked_path + length, k_baked_extension);
+}
+
+// Hash of the JSON content, so that edits are detected whatever the file times say. Zero when the
+// file can't be read: the baked graph can't be checked against it then.
+static uint64_t source_content_hash(cstring file_path)
+{
+  Framework::ScopedFileMapping source_file(file_path, Framework::FileAccessHint::kSequential);
+  const Framework::FileMapping& mapping = source_file.m_Mapping;
+  if (mapping.data == nullptr)
   {
-    FrameGraphResource* resource = frame_graph->access_resource(node->inputs[r]);
+    return 0;
+  }
+
+  return hashBytes((void*)mapping.data, mapping.size);
+}
+
+// Only the fields resources are created from are baked, the handles are runtime state.
+static void bake_resource_info(
+    FrameGraphResourceType type,
+    const FrameGraphResourceInfo& info,
+    FrameGraphBakedResource& baked_resource)
+{
+  baked_resource.type = type;
+  baked_resource.external = info.external;
+
+  if (type == kFrameGraphResourceTypeBuffer)
+  {
+    baked_resource.size = info.buffer.size;
+    baked_resource.flags = info.buffer.flags;
+    return;
+  }
+
+  baked_resource.flags = info.texture.flags;
+  baked_resource.width = info.texture.width;
+  baked_resource.height = info.texture.height;
+  baked_resource.depth = info.texture.depth;
+  baked_resource.scale_width = info.texture.scale_width;
+  baked_resource.scale_height = info.texture.scale_height;
+  baked_resource.format = info.texture.format;
+  baked_resource.load_op = info.texture.load_op;
+  memcpy(baked_resource.clear_values, info.texture.clear_values, sizeof(float) * 4);
+  baked_resource.compute = info.texture.compute;
+}
+
+static FrameGraphResourceInfo load_resource_info(const FrameGraphBakedResource& baked_resource)
+{
+  FrameGraphResourceInfo info{};
+  info.external = baked_resource.external != 0;
+
+  if (baked_resource.type == kFrameGraphResourceTypeBuffer)
+  {
+    info.buffer.size = (size_t)baked_resource.size;
+    info.buffer.flags = baked_resource.flags;
+    return info;
+  }
+
+  info.texture.flags = baked_resource.flags;
+  info.texture.width = baked_resource.width;
+  info.texture.height = baked_resource.height;
+  info.texture.depth = baked_resource.depth;
+  info.texture.scale_width = baked_resource.scale_width;
+  info.texture.scale_height = baked_resource.scale_height;
+  info.texture.format = (VkFormat)baked_resource.format;
+  info.texture.load_op = (RenderPassOperation::Enum)baked_resource.load_op;
+  memcpy(info.texture.clear_values, baked_resource.clear_values, sizeof(float) * 4);
+  info.texture.compute = baked_resource.compute != 0;
+  return info;
+}
 
+// Offsets and ranges of the baked tables, a stale or damaged file must not read out of the blob.
+static bool baked_tables_valid(
+    const FrameGraphBakedHeader& header,
+    const FrameGraphBakedResource* resources,
+    const FrameGraphBakedNode* nodes,
+    const FrameGraphBakedEdge* edges,
+    const char* names)
+{
+  // Every name runs up to a terminator inside the table.
+  if (header.names_size == 0 || names[header.names_size - 1] != 0 ||
+      header.name >= header.names_size)
+  {
+    return false;
+  }
+
+  for (uint32_t r = 0; r < header.resource_count; ++r)
+  {
+    if (resources[r].name >= header.names_size ||
+        resources[r].type > FrameGraphResourceType_ShadingRate)
     {
-      FrameGraphResource* output_resource = frame_graph->get_resource(resource->m_Name);
-      if (output_resource == nullptr && !resource->resourceInfo.external)
-      {
-        // TODO: external resources
-        assert(false);
-        continue;
-      }
+      return false;
+    }
+  }
+
+  for (uint32_t n = 0; n < header.node_count; ++n)
+  {
+    const FrameGraphBakedNode& node = nodes[n];
+    const uint64_t resource_end =
+        (uint64_t)node.first_resource + node.input_count + node.output_count;
+    if (node.name >= header.names_size || resource_end > header.resource_count)
+    {
+      return false;
+    }
+  }
 
-      resource->producer = output_resource->producer;
-      resource->resourceInfo = output_resource->resourceInfo;
-      resource->outputHandle = output_resource->outputHandle;
+  for (uint32_t e = 0; e < header.edge_count; ++e)
+  {
+    if (edges[e].parent >= header.node_count || edges[e].child >= header.node_count)
+    {
+      return false;
     }
+  }
+
+  return true;
+}
+
+void FrameGraph::parse(cstring file_path, Framework::StackAllocator* temp_allocator)
+{
+  char baked_path[kMaxPath];
+  baked_path_from_source(file_path, baked_path);
+
+  const bool source_exists = Framework::fileExists(file_path);
+  const bool baked_exists = Framework::fileExists(baked_path);
 
-    for (uint32_t n = 0; n < frame_graph->all_nodes.m_Size; ++n)
+  // Builds can ship the baked graph alone, there is nothing to check it against then.
+  if (!source_exists)
+  {
+    if (baked_exists)
     {
-      if (n == node_index)
+      printf("Frame graph %s not found, loading %s unverified\n", file_path, baked_path);
+      if (load_baked(baked_path, 0, temp_allocator))
       {
-        continue;
+        return;
       }
+    }
 
-      FrameGraphNodeHandle parent_handle = frame_graph->all_nodes[n];
-      FrameGraphNode* parent_node = frame_graph->access_node(parent_handle);
+    assert(false);
+    return;
+  }
 
-      for (uint32_t o = 0; o < parent_node->outputs.m_Size; ++o)
-      {
-        FrameGraphResource* output_resource = frame_graph->access_resource(parent_node->outputs[o]);
+  // A baked graph is used unless the JSON was modified after baking it, or can't be read to tell.
+  const uint64_t source_hash = source_content_hash(file_path);
+  if (source_hash == 0)
+  {
+    printf("Frame graph %s can't be read, ignoring %s\n", file_path, baked_path);
+  }
+  else if (baked_exists && load_baked(baked_path, source_hash, temp_allocator))
+  {
+    return;
+  }
+
+  parse_json(file_path, temp_allocator);
+  compute_node_edges();
+  if (source_hash != 0)
+  {
+    bake(baked_path, source_hash, temp_allocator);
+  }
+}
 
-        if (strcmp(resource->m_Name, output_resource->m_Name) != 0)
+void FrameGraph::compute_node_edges()
+{
+  node_edges.clear();
+
+  for (uint32_t c = 0; c < all_nodes.m_Size; ++c)
+  {
+    FrameGraphNode* child = builder->access_node(all_nodes[c]);
+
+    for (uint32_t i = 0; i < child->inputs.m_Size; ++i)
+    {
+      FrameGraphResource* input = builder->access_resource(child->inputs[i]);
+
+      for (uint32_t p = 0; p < all_nodes.m_Size; ++p)
+      {
+        if (p == c)
         {
           continue;
         }
 
+        FrameGraphNode* parent = builder->access_node(all_nodes[p]);
+        for (uint32_t o = 0; o < parent->outputs.m_Size; ++o)
+        {
+          FrameGraphResource* output = builder->access_resource(parent->outputs[o]);
+          if (strcmp(input->m_Name, output->m_Name) == 0)
+          {
+            node_edges.push({p, c});
+          }
+        }
+      }
+    }
+  }
+}
+
+void FrameGraph::bake(
+    cstring file_path, uint64_t source_hash, Framework::StackAllocator* temp_allocator)
+{
+  const size_t marker = temp_allocator->getMarker();
+
+  uint32_t resource_count = 0;
+  uint32_t names_size = (uint32_t)strlen(name) + 1;
+  for (uint32_t n = 0; n < all_nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[n]);
+    names_size += (uint32_t)strlen(node->name) + 1;
+
+    for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+    {
+      names_size += (uint32_t)strlen(builder->access_resource(node->inputs[i])->m_Name) + 1;
+    }
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      names_size += (uint32_t)strlen(builder->access_resource(node->outputs[o])->m_Name) + 1;
+    }
+    resource_count += node->inputs.m_Size + node->outputs.m_Size;
+  }
+
+  const size_t size = sizeof(FrameGraphBakedHeader) +
+                      sizeof(FrameGraphBakedResource) * resource_count +
+                      sizeof(FrameGraphBakedNode) * all_nodes.m_Size +
+                      sizeof(FrameGraphBakedEdge) * node_edges.m_Size + names_size;
+  uint8_t* memory = (uint8_t*)FRAMEWORK_ALLOCAA(size, temp_allocator, 8);
+  memset(memory, 0, size);
+
+  // Tables with the largest alignment first.
+  FrameGraphBakedHeader* header = (FrameGraphBakedHeader*)memory;
+  FrameGraphBakedResource* baked_resources = (FrameGraphBakedResource*)(header + 1);
+  FrameGraphBakedNode* baked_nodes = (FrameGraphBakedNode*)(baked_resources + resource_count);
+  FrameGraphBakedEdge* baked_edges = (FrameGraphBakedEdge*)(baked_nodes + all_nodes.m_Size);
+  char* names = (char*)(baked_edges + node_edges.m_Size);
+
+  header->magic = FrameGraphBakedHeader::k_magic;
+  header->version = FrameGraphBakedHeader::k_version;
+  header->source_hash = source_hash;
+  header->node_count = all_nodes.m_Size;
+  header->resource_count = resource_count;
+  header->edge_count = node_edges.m_Size;
+  header->names_size = names_size;
+
+  uint32_t names_offset = 0;
+  auto intern = [&](cstring value) {
+    const uint32_t offset = names_offset;
+    const uint32_t length = (uint32_t)strlen(value) + 1;
+    memcpy(names + offset, value, length);
+    names_offset += length;
+    return offset;
+  };
+
+  header->name = intern(name);
+
+  uint32_t r = 0;
+  for (uint32_t n = 0; n < all_nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[n]);
+
+    FrameGraphBakedNode& baked_node = baked_nodes[n];
+    baked_node.name = intern(node->name);
+    baked_node.first_resource = r;
+    baked_node.input_count = node->inputs.m_Size;
+    baked_node.output_count = node->outputs.m_Size;
+    baked_node.compute = node->compute;
+    baked_node.ray_tracing = node->ray_tracing;
+    baked_node.enabled = node->enabled;
+
+    // Inputs first, then outputs, with the descriptions they were created from.
+    for (uint32_t i = 0; i < node->inputs.m_Size + node->outputs.m_Size; ++i, ++r)
+    {
+      FrameGraphResource* resource = builder->access_resource(
+          i < node->inputs.m_Size ? node->inputs[i] : node->outputs[i - node->inputs.m_Size]);
+
+      baked_resources[r].name = intern(resource->m_Name);
+      bake_resource_info(resource->type, resource->resourceInfo, baked_resources[r]);
+    }
+  }
+
+  memcpy(baked_edges, node_edges.m_Data, sizeof(FrameGraphBakedEdge) * node_edges.m_Size);
+  assert(names_offset == names_size);
+
+  Framework::fileWriteBinary(file_path, memory, size);
+
+  temp_allocator->freeMarker(marker);
+}
+
+bool FrameGraph::load_baked(
+    cstring file_path, uint64_t source_hash, Framework::StackAllocator* temp_allocator)
+{
+  const size_t marker = temp_allocator->getMarker();
+
+  // Everything is copied out of the mapping, it is released on return.
+  Framework::ScopedFileMapping baked_file(file_path, Framework::FileAccessHint::kSequential);
+  const Framework::FileMapping& mapping = baked_file.m_Mapping;
+  const FrameGraphBakedHeader* header = (const FrameGraphBakedHeader*)mapping.data;
+
+  const bool valid = mapping.data && mapping.size >= sizeof(FrameGraphBakedHeader) &&
+                     header->magic == FrameGraphBakedHeader::k_magic &&
+                     header->version == FrameGraphBakedHeader::k_version &&
+                     (source_hash == 0 || header->source_hash == source_hash) &&
+                     mapping.size ==
+                         sizeof(FrameGraphBakedHeader) +
+                             sizeof(FrameGraphBakedResource) * header->resource_count +
+                             sizeof(FrameGraphBakedNode) * header->node_count +
+                             sizeof(FrameGraphBakedEdge) * header->edge_count + header->names_size;
+  if (!valid)
+  {
+    temp_allocator->freeMarker(marker);
+    return false;
+  }
+
+  const FrameGraphBakedResource* baked_resources = (const FrameGraphBakedResource*)(header + 1);
+  const FrameGraphBakedNode* baked_nodes =
+      (const FrameGraphBakedNode*)(baked_resources + header->resource_count);
+  const FrameGraphBakedEdge* baked_edges =
+      (const FrameGraphBakedEdge*)(baked_nodes + header->node_count);
+  const char* baked_names = (const char*)(baked_edges + header->edge_count);
+
+  // The JSON is parsed instead.
+  if (!baked_tables_valid(*header, baked_resources, baked_nodes, baked_edges, baked_names))
+  {
+    temp_allocator->freeMarker(marker);
+    return false;
+  }
+
+  // Nodes and resources keep pointers to their names, the table lives as long as the graph.
+  char* names = (char*)FRAMEWORK_ALLOCA(header->names_size, &local_allocator);
+  memcpy(names, baked_names, header->names_size);
+
+  name = names + header->name;
+
+  for (uint32_t n = 0; n < header->node_count; ++n)
+  {
+    const FrameGraphBakedNode& baked_node = baked_nodes[n];
+
+    FrameGraphNodeCreation node_creation{};
+    node_creation.inputs.init(temp_allocator, baked_node.input_count);
+    node_creation.outputs.init(temp_allocator, baked_node.output_count);
+    node_creation.name = names + baked_node.name;
+    node_creation.compute = baked_node.compute != 0;
+    node_creation.ray_tracing = baked_node.ray_tracing != 0;
+    node_creation.enabled = baked_node.enabled != 0;
+
+    const FrameGraphBakedResource* resources = baked_resources + baked_node.first_resource;
+    for (uint32_t i = 0; i < baked_node.input_count; ++i)
+    {
+      FrameGraphResourceInputCreation& input_creation = node_creation.inputs.pushUse();
+      input_creation.type = (FrameGraphResourceType)resources[i].type;
+      input_creation.resourceInfo = load_resource_info(resources[i]);
+      input_creation.name = names + resources[i].name;
+    }
+
+    resources += baked_node.input_count;
+    for (uint32_t o = 0; o < baked_node.output_count; ++o)
+    {
+      FrameGraphResourceOutputCreation& output_creation = node_creation.outputs.pushUse();
+      output_creation.type = (FrameGraphResourceType)resources[o].type;
+      output_creation.resourceInfo = load_resource_info(resources[o]);
+      output_creation.name = names + resources[o].name;
+    }
+
+    all_nodes.push(builder->create_node(node_creation));
+  }
+
+  node_edges.setSize(header->edge_count);
+  memcpy(node_edges.m_Data, baked_edges, sizeof(FrameGraphNodeEdge) * header->edge_count);
+
+  temp_allocator->freeMarker(marker);
+  return true;
+}
+
+static void compute_edges(FrameGraph* frame_graph, FrameGraphNode* node, uint32_t node_index)
+{
+  FrameGraphNodeHandle node_handle = frame_graph->all_nodes[node_index];
+
+  for (uint32_t r = 0; r < node->inputs.m_Size; ++r)
+  {
+    FrameGraphResource* resource = frame_graph->access_resource(node->inputs[r]);
+
+    // Reads of resources nothing writes are reported by validate_nodes().
+    FrameGraphResource* output_resource = frame_graph->get_resource(resource->m_Name);
+    if (output_resource == nullptr)
+    {
+      assert(resource->resourceInfo.external || frame_graph->validation);
+      continue;
+    }
+
+    resource->producer = output_resource->producer;
+    resource->resourceInfo = output_resource->resourceInfo;
+    resource->outputHandle = output_resource->outputHandle;
+  }
+
+  // Edges between the nodes were matched by name once, when parsing or baking the graph.
+  for (uint32_t e = 0; e < frame_graph->node_edges.m_Size; ++e)
+  {
+    const FrameGraphNodeEdge& edge = frame_graph->node_edges[e];
+    if (edge.child != node_index)
+    {
+      continue;
+    }
+
+    FrameGraphNode* parent_node = frame_graph->access_node(frame_graph->all_nodes[edge.parent]);
+
 #if FRAME_GRAPH_DEBUG
-        printf(
-            "Adding edge for resource %s from %s [%d] to %s [%d]\n",
-            output_resource->m_Name,
-            parent_node->name,
-            n,
-            node->name,
-            node_index)
+    printf(
+        "Adding edge from %s [%d] to %s [%d]\n",
+        parent_node->name,
+        edge.parent,
+        node->name,
+        node_index);
 #endif
 
-            parent_node->edges.push(node_handle);
-      }
-    }
+    parent_node->edges.push(node_handle);
   }
 }
 
@@ -536,13 +925,21 @@ static void create_render_pass(FrameGraph* frame_graph, FrameGraphNode* node)
 void FrameGraph::enable_render_pass(cstring render_pass_name)
 {
   FrameGraphNode* node = builder->get_node(render_pass_name);
-  node->enabled = true;
+  if (node->enabled != true)
+  {
+    node->enabled = true;
+    dirty = true;
+  }
 }
 
 void FrameGraph::disable_render_pass(cstring render_pass_name)
 {
   FrameGraphNode* node = builder->get_node(render_pass_name);
-  node->enabled = false;
+  if (node->enabled != false)
+  {
+    node->enabled = false;
+    dirty = true;
+  }
 }
 
 namespace FrameGraphNodeVisitStatus
@@ -556,103 +953,691 @@ enum Enum
 }; // enum Enum
 }; // namespace FrameGraphNodeVisitStatus
 
-void FrameGraph::compile()
+// Transient attachment waiting for memory, with its lifetime as positions in the sorted nodes.
+struct FrameGraphTransientTexture
 {
-  // TODO
-  // - check that input has been produced by a different node
-  // - cull inactive nodes
+  FrameGraphResourceHandle handle;
+  FrameGraphResource* resource;
+  TextureCreation creation;
+  VkMemoryRequirements requirements;
 
-  for (uint32_t i = 0; i < all_nodes.m_Size; ++i)
-  {
-    FrameGraphNode* node = builder->access_node(all_nodes[i]);
+  uint32_t first_node;
+  uint32_t last_node;
 
-    // NOTE: we want to clear all edges first, then populate them. If we clear them inside
-    // the loop below we risk clearing the list after it has already been used by one of the child
-    // nodes
-    node->edges.clear();
-  }
+  uint32_t block;
+  VkDeviceSize offset;
+};
 
-  for (uint32_t i = 0; i < all_nodes.m_Size; ++i)
+struct FrameGraphMemoryBlock
+{
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  uint32_t memory_type_bits;
+  uint32_t texture_count;
+};
+
+struct FrameGraphMemoryRange
+{
+  VkDeviceSize begin;
+  VkDeviceSize end;
+};
+
+static int compare_transient_textures(const void* a, const void* b)
+{
+  const FrameGraphTransientTexture* ta = (const FrameGraphTransientTexture*)a;
+  const FrameGraphTransientTexture* tb = (const FrameGraphTransientTexture*)b;
+
+  // Largest first, then by first use so that equal sizes pack in graph order.
+  if (ta->requirements.size != tb->requirements.size)
   {
-    FrameGraphNode* node = builder->access_node(all_nodes[i]);
-    if (!node->enabled)
-    {
-      continue;
-    }
+    return ta->requirements.size > tb->requirements.size ? -1 : 1;
+  }
+  return (int)ta->first_node - (int)tb->first_node;
+}
 
-    compute_edges(this, node, i);
+static int compare_memory_ranges(const void* a, const void* b)
+{
+  const FrameGraphMemoryRange* ra = (const FrameGraphMemoryRange*)a;
+  const FrameGraphMemoryRange* rb = (const FrameGraphMemoryRange*)b;
+
+  if (ra->begin == rb->begin)
+  {
+    return 0;
   }
+  return ra->begin < rb->begin ? -1 : 1;
+}
 
-  Array<FrameGraphNodeHandle> sorted_nodes;
-  sorted_nodes.init(&local_allocator, all_nodes.m_Size);
+static VkDeviceSize align_device_size(VkDeviceSize size, VkDeviceSize alignment)
+{
+  return (size + alignment - 1) & ~(alignment - 1);
+}
 
-  Array<uint8_t> node_status;
-  node_status.init(&local_allocator, all_nodes.m_Size, all_nodes.m_Size);
-  memset(node_status.m_Data, 0, sizeof(bool) * all_nodes.m_Size);
+// Best fit packing of lifetime intervals: textures are placed from the largest, each in the
+// smallest gap left by the already placed textures alive at the same time, in any block with a
+// compatible memory type. A texture that fits nowhere opens a new block of its own size.
+static void pack_transient_textures(
+    Array<FrameGraphTransientTexture>& textures,
+    Array<FrameGraphMemoryBlock>& blocks,
+    Framework::Allocator* temp_allocator)
+{
+  qsort(
+      textures.m_Data,
+      textures.m_Size,
+      sizeof(FrameGraphTransientTexture),
+      compare_transient_textures);
 
-  Array<FrameGraphNodeHandle> stack;
-  stack.init(&local_allocator, nodes.m_Size);
+  Array<FrameGraphMemoryRange> ranges;
+  ranges.init(temp_allocator, textures.m_Size);
 
-  // Topological sorting
-  for (uint32_t n = 0; n < all_nodes.m_Size; ++n)
+  for (uint32_t t = 0; t < textures.m_Size; ++t)
   {
-    FrameGraphNode* node = builder->access_node(all_nodes[n]);
-    if (!node->enabled)
-    {
-      continue;
-    }
+    FrameGraphTransientTexture& texture = textures[t];
+    const VkDeviceSize size = texture.requirements.size;
+    const VkDeviceSize alignment = texture.requirements.alignment;
 
-    stack.push(all_nodes[n]);
+    uint32_t best_block = kInvalidIndex;
+    VkDeviceSize best_offset = 0;
+    VkDeviceSize best_waste = ~0ull;
 
-    while (stack.m_Size > 0)
+    for (uint32_t b = 0; b < blocks.m_Size; ++b)
     {
-      FrameGraphNodeHandle node_handle = stack.back();
-
-      if (node_status[node_handle.index] == FrameGraphNodeVisitStatus::Added)
+      const FrameGraphMemoryBlock& block = blocks[b];
+      if ((block.memory_type_bits & texture.requirements.memoryTypeBits) == 0)
       {
-        stack.pop();
-
         continue;
       }
 
-      if (node_status[node_handle.index] == FrameGraphNodeVisitStatus::Visited)
+      // Memory used in this block by textures alive at the same time.
+      ranges.clear();
+      for (uint32_t p = 0; p < t; ++p)
       {
-        node_status[node_handle.index] = FrameGraphNodeVisitStatus::Added;
-
-        sorted_nodes.push(node_handle);
-
-        stack.pop();
-
-        continue;
+        const FrameGraphTransientTexture& placed = textures[p];
+        if (placed.block == b && placed.first_node <= texture.last_node &&
+            texture.first_node <= placed.last_node)
+        {
+          ranges.push({placed.offset, placed.offset + placed.requirements.size});
+        }
       }
+      qsort(ranges.m_Data, ranges.m_Size, sizeof(FrameGraphMemoryRange), compare_memory_ranges);
 
-      node_status[node_handle.index] = FrameGraphNodeVisitStatus::Visited;
-
-      FrameGraphNode* node = builder->access_node(node_handle);
-
-      // Leaf node
-      if (node->edges.m_Size == 0)
+      VkDeviceSize cursor = 0;
+      for (uint32_t r = 0; r <= ranges.m_Size; ++r)
       {
-        continue;
-      }
+        const VkDeviceSize gap_end = r < ranges.m_Size ? ranges[r].begin : block.size;
+        const VkDeviceSize offset = align_device_size(cursor, alignment);
 
-      for (uint32_t r = 0; r < node->edges.m_Size; ++r)
-      {
-        FrameGraphNodeHandle child_handle = node->edges[r];
+        if (offset + size <= gap_end && gap_end - offset - size < best_waste)
+        {
+          best_block = b;
+          best_offset = offset;
+          best_waste = gap_end - offset - size;
+        }
 
-        if (node_status[child_handle.index] == FrameGraphNodeVisitStatus::New)
+        if (r < ranges.m_Size && ranges[r].end > cursor)
         {
-          stack.push(child_handle);
+          cursor = ranges[r].end;
         }
       }
     }
+
+    if (best_block == kInvalidIndex)
+    {
+      best_block = blocks.m_Size;
+      best_offset = 0;
+      blocks.push({size, alignment, texture.requirements.memoryTypeBits, 0});
+    }
+
+    FrameGraphMemoryBlock& block = blocks[best_block];
+    block.alignment = block.alignment > alignment ? block.alignment : alignment;
+    block.memory_type_bits &= texture.requirements.memoryTypeBits;
+    block.texture_count++;
+
+    texture.block = best_block;
+    texture.offset = best_offset;
   }
 
-  nodes.clear();
+  ranges.shutdown();
+}
 
-  for (int i = sorted_nodes.m_Size - 1; i >= 0; --i)
-  {
+static bool is_read_only_state(ResourceState state)
+{
+  return state != RESOURCE_STATE_UNDEFINED &&
+         (state & ~(RESOURCE_STATE_GENERIC_READ | RESOURCE_STATE_DEPTH_READ)) == 0;
+}
+
+static void plan_barrier(
+    FrameGraph* frame_graph,
+    Array<ResourceState>& states,
+    FrameGraphResourceHandle handle,
+    FrameGraphResource* resource,
+    ResourceState new_state,
+    bool discard,
+    bool first_use,
+    bool record)
+{
+  const bool buffer = resource->type == kFrameGraphResourceTypeBuffer;
+  const ResourceState old_state = discard ? RESOURCE_STATE_UNDEFINED : states[handle.index];
+  states[handle.index] = new_state;
+
+  // Reads following reads in the same layout need no synchronization.
+  if (!record || (!first_use && old_state == new_state && is_read_only_state(new_state)))
+  {
+    return;
+  }
+
+  FrameGraphBarrier& barrier = frame_graph->barriers.pushUse();
+  barrier.resource = handle;
+  barrier.old_state = old_state;
+  barrier.new_state = new_state;
+  barrier.queue = QueueType::kGraphics;
+  barrier.buffer = buffer;
+  barrier.depth =
+      !buffer && TextureFormat::hasDepthOrStencil(resource->resourceInfo.texture.format);
+  barrier.discard = discard;
+  barrier.first_use = first_use;
+}
+
+// Resources keep their state from one frame to the next, so a first walk finds the states at the
+// end of the frame and the second one plans the barriers starting from them.
+void FrameGraph::plan_barriers(Framework::Allocator* temp_allocator)
+{
+  const uint32_t resource_count = builder->resource_cache.resources.m_UsedIndices;
+
+  Array<ResourceState> states;
+  states.init(temp_allocator, resource_count, resource_count);
+  Array<uint8_t> accessed;
+  accessed.init(temp_allocator, resource_count, resource_count);
+  for (uint32_t i = 0; i < resource_count; ++i)
+  {
+    states[i] = RESOURCE_STATE_UNDEFINED;
+    accessed[i] = 0;
+  }
+
+  barriers.clear();
+
+  for (uint32_t walk = 0; walk < 2; ++walk)
+  {
+    const bool record = walk == 1;
+
+    for (uint32_t n = 0; n < nodes.m_Size; ++n)
+    {
+      FrameGraphNode* node = builder->access_node(nodes[n]);
+      node->barrier_offset = barriers.m_Size;
+
+      // Ray tracing passes synchronize their own resources.
+      if (node->ray_tracing)
+      {
+        node->barrier_count = 0;
+        continue;
+      }
+
+      for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+      {
+        FrameGraphResource* input_resource = builder->access_resource(node->inputs[i]);
+        FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
+
+        if (resource == nullptr || resource->resourceInfo.external)
+        {
+          continue;
+        }
+
+        ResourceState state = RESOURCE_STATE_UNDEFINED;
+        if (input_resource->type == kFrameGraphResourceTypeTexture)
+        {
+          state = node->compute ? RESOURCE_STATE_SHADER_RESOURCE
+                                : RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+        }
+        else if (input_resource->type == kFrameGraphResourceTypeAttachment)
+        {
+          if (node->compute)
+          {
+            state = RESOURCE_STATE_UNORDERED_ACCESS;
+          }
+          else
+          {
+            state = TextureFormat::hasDepthOrStencil(resource->resourceInfo.texture.format)
+                        ? RESOURCE_STATE_DEPTH_WRITE
+                        : RESOURCE_STATE_RENDER_TARGET;
+          }
+        }
+        else if (input_resource->type == kFrameGraphResourceTypeBuffer)
+        {
+          state = RESOURCE_STATE_SHADER_RESOURCE;
+        }
+
+        if (state != RESOURCE_STATE_UNDEFINED)
+        {
+          const uint32_t index = input_resource->outputHandle.index;
+          plan_barrier(
+              this,
+              states,
+              input_resource->outputHandle,
+              resource,
+              state,
+              false,
+              record && !accessed[index],
+              record);
+          accessed[index] = record;
+        }
+      }
+
+      for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+      {
+        FrameGraphResource* resource = builder->access_resource(node->outputs[o]);
+
+        ResourceState state = RESOURCE_STATE_UNDEFINED;
+        if (resource->type == kFrameGraphResourceTypeAttachment)
+        {
+          const bool depth =
+              TextureFormat::hasDepthOrStencil(resource->resourceInfo.texture.format);
+          // Compute passes can't write depth.
+          assert(!node->compute || !depth);
+
+          if (node->compute)
+          {
+            state = RESOURCE_STATE_UNORDERED_ACCESS;
+          }
+          else
+          {
+            state = depth ? RESOURCE_STATE_DEPTH_WRITE : RESOURCE_STATE_RENDER_TARGET;
+          }
+        }
+        else if (resource->type == kFrameGraphResourceTypeBuffer)
+        {
+          state = RESOURCE_STATE_UNORDERED_ACCESS;
+        }
+
+        if (state != RESOURCE_STATE_UNDEFINED)
+        {
+          // Aliased outputs lost their content to the resources sharing their memory.
+          const uint32_t index = node->outputs[o].index;
+          plan_barrier(
+              this,
+              states,
+              node->outputs[o],
+              resource,
+              state,
+              resource->aliased,
+              record && !accessed[index],
+              record);
+          accessed[index] = record;
+        }
+      }
+
+      node->barrier_count = barriers.m_Size - node->barrier_offset;
+
+#if FRAME_GRAPH_DEBUG
+      for (uint32_t b = 0; record && b < node->barrier_count; ++b)
+      {
+        const FrameGraphBarrier& barrier = barriers[node->barrier_offset + b];
+        printf(
+            "Node %s barrier %s: 0x%x -> 0x%x%s\n",
+            node->name,
+            builder->access_resource(barrier.resource)->m_Name,
+            barrier.old_state,
+            barrier.new_state,
+            barrier.discard ? " (discard)" : "");
+      }
+#endif
+    }
+  }
+
+  states.shutdown();
+  accessed.shutdown();
+}
+
+// Enabled nodes, which decide the sorted order.
+static uint64_t compute_topology_hash(FrameGraph* frame_graph)
+{
+  uint64_t hash = hashCalculate(frame_graph->all_nodes.m_Size);
+  for (uint32_t i = 0; i < frame_graph->all_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = frame_graph->builder->access_node(frame_graph->all_nodes[i]);
+    const uint32_t key[] = {frame_graph->all_nodes[i].index, node->enabled ? 1u : 0u};
+    hash = hashBytes((void*)key, sizeof(key), hash);
+  }
+  return hash;
+}
+
+// Everything compile() depends on: enabled nodes, output descriptions and swapchain size.
+static uint64_t compute_compile_hash(FrameGraph* frame_graph)
+{
+  FrameGraphBuilder* builder = frame_graph->builder;
+
+  const uint32_t swapchain_size[] = {
+      builder->device->m_SwapchainWidth, builder->device->m_SwapchainHeight};
+  uint64_t hash = hashBytes((void*)swapchain_size, sizeof(swapchain_size));
+  hash = hashCalculate(compute_topology_hash(frame_graph), hash);
+
+  for (uint32_t i = 0; i < frame_graph->all_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(frame_graph->all_nodes[i]);
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      FrameGraphResource* resource = builder->access_resource(node->outputs[o]);
+      if (resource->type != kFrameGraphResourceTypeAttachment)
+      {
+        continue;
+      }
+
+      const FrameGraphResourceInfo& info = resource->resourceInfo;
+      // Scaled sizes are resolved by compile() itself, only the scale is part of the description.
+      const bool scaled = info.texture.scale_width > 0.f || info.texture.scale_height > 0.f;
+      const uint32_t key[] = {
+          (uint32_t)info.external,
+          (uint32_t)info.texture.compute,
+          (uint32_t)info.texture.format,
+          scaled ? 0 : info.texture.width,
+          scaled ? 0 : info.texture.height,
+          info.texture.depth,
+          (uint32_t)(info.texture.scale_width * 1024.f),
+          (uint32_t)(info.texture.scale_height * 1024.f)};
+      hash = hashBytes((void*)key, sizeof(key), hash);
+    }
+  }
+  return hash;
+}
+
+// Resource the frame is presented from, always a sink of the graph.
+static cstring k_final_resource_name = "final";
+
+// Enabled node, other than the given one, declaring an output with the name.
+static bool is_written_by_other_node(FrameGraph* frame_graph, uint32_t node_index, cstring name)
+{
+  for (uint32_t n = 0; n < frame_graph->all_nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = frame_graph->access_node(frame_graph->all_nodes[n]);
+    if (n == node_index || !node->enabled)
+    {
+      continue;
+    }
+
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      if (strcmp(frame_graph->access_resource(node->outputs[o])->m_Name, name) == 0)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Reports reads of resources no other enabled node writes, and resources written by several
+// enabled nodes. Returns the number of errors found.
+static uint32_t validate_nodes(FrameGraph* frame_graph)
+{
+  uint32_t errors = 0;
+
+  for (uint32_t n = 0; n < frame_graph->all_nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = frame_graph->access_node(frame_graph->all_nodes[n]);
+    if (!node->enabled)
+    {
+      continue;
+    }
+
+    for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+    {
+      FrameGraphResource* resource = frame_graph->access_resource(node->inputs[i]);
+      if (resource->resourceInfo.external ||
+          is_written_by_other_node(frame_graph, n, resource->m_Name))
+      {
+        continue;
+      }
+
+      printf(
+          "Frame graph %s: node %s reads %s, which no other enabled node writes\n",
+          frame_graph->name,
+          node->name,
+          resource->m_Name);
+      ++errors;
+    }
+
+    // Every writer after the first reports the resource once.
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      FrameGraphResource* resource = frame_graph->access_resource(node->outputs[o]);
+      if (resource->resourceInfo.external)
+      {
+        continue;
+      }
+
+      for (uint32_t p = 0; p < n; ++p)
+      {
+        FrameGraphNode* previous = frame_graph->access_node(frame_graph->all_nodes[p]);
+        if (!previous->enabled)
+        {
+          continue;
+        }
+
+        bool written = false;
+        for (uint32_t po = 0; po < previous->outputs.m_Size && !written; ++po)
+        {
+          FrameGraphResource* other = frame_graph->access_resource(previous->outputs[po]);
+          written = strcmp(other->m_Name, resource->m_Name) == 0;
+        }
+
+        if (written)
+        {
+          printf(
+              "Frame graph %s: %s is written by both %s and %s\n",
+              frame_graph->name,
+              resource->m_Name,
+              previous->name,
+              node->name);
+          ++errors;
+          break;
+        }
+      }
+    }
+  }
+
+  return errors;
+}
+
+// Sinks are the nodes writing the final or an external resource, through an output or a loaded
+// attachment. Nodes declaring no writes have effects the graph doesn't see and are kept as well.
+static bool is_sink_node(FrameGraph* frame_graph, FrameGraphNode* node)
+{
+  bool writes = false;
+
+  for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+  {
+    FrameGraphResource* resource = frame_graph->access_resource(node->outputs[o]);
+    if (resource->resourceInfo.external || strcmp(resource->m_Name, k_final_resource_name) == 0)
+    {
+      return true;
+    }
+    writes = true;
+  }
+
+  for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+  {
+    FrameGraphResource* resource = frame_graph->access_resource(node->inputs[i]);
+    if (resource->type != kFrameGraphResourceTypeAttachment)
+    {
+      continue;
+    }
+
+    if (resource->resourceInfo.external || strcmp(resource->m_Name, k_final_resource_name) == 0)
+    {
+      return true;
+    }
+    writes = true;
+  }
+
+  return !writes;
+}
+
+void FrameGraph::compile()
+{
+  // Nothing changed since the last compilation, keep the sorted nodes, textures and barriers.
+  const uint64_t compile_hash = compute_compile_hash(this);
+  if (compile_hash == compiled_hash)
+  {
+    return;
+  }
+  compiled_hash = compile_hash;
+
+  compile_allocator.clear();
+
+  const uint64_t topology_hash = compute_topology_hash(this);
+  if (topology_hash != compiled_topology_hash)
+  {
+    compiled_topology_hash = topology_hash;
+    sort_nodes();
+  }
+
+  allocate_resources();
+
+  plan_barriers(&compile_allocator);
+
+  for (uint32_t i = 0; i < nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(nodes[i]);
+    assert(node->enabled);
+
+    if (node->compute)
+    {
+      continue;
+    }
+
+    if (node->render_pass.index == kInvalidIndex)
+    {
+      create_render_pass(this, node);
+    }
+
+    if (node->framebuffer.index == kInvalidIndex)
+    {
+      create_framebuffer(this, node);
+    }
+  }
+}
+
+void FrameGraph::sort_nodes()
+{
+  for (uint32_t i = 0; i < all_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[i]);
+
+    // NOTE: we want to clear all edges first, then populate them. If we clear them inside
+    // the loop below we risk clearing the list after it has already been used by one of the child
+    // nodes
+    node->edges.clear();
+  }
+
+  for (uint32_t i = 0; i < all_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[i]);
+    if (!node->enabled)
+    {
+      continue;
+    }
+
+    compute_edges(this, node, i);
+  }
+
+  validation_errors = validation ? validate_nodes(this) : 0;
+
+  Array<FrameGraphNodeHandle> sorted_nodes;
+  sorted_nodes.init(&compile_allocator, all_nodes.m_Size);
+
+  Array<uint8_t> node_status;
+  node_status.init(&compile_allocator, all_nodes.m_Size, all_nodes.m_Size);
+  memset(node_status.m_Data, 0, sizeof(bool) * all_nodes.m_Size);
+
+  Array<FrameGraphNodeHandle> stack;
+  stack.init(&compile_allocator, nodes.m_Size);
+
+  // Topological sorting
+  for (uint32_t n = 0; n < all_nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[n]);
+    if (!node->enabled)
+    {
+      continue;
+    }
+
+    stack.push(all_nodes[n]);
+
+    while (stack.m_Size > 0)
+    {
+      FrameGraphNodeHandle node_handle = stack.back();
+
+      if (node_status[node_handle.index] == FrameGraphNodeVisitStatus::Added)
+      {
+        stack.pop();
+
+        continue;
+      }
+
+      if (node_status[node_handle.index] == FrameGraphNodeVisitStatus::Visited)
+      {
+        node_status[node_handle.index] = FrameGraphNodeVisitStatus::Added;
+
+        sorted_nodes.push(node_handle);
+
+        stack.pop();
+
+        continue;
+      }
+
+      node_status[node_handle.index] = FrameGraphNodeVisitStatus::Visited;
+
+      FrameGraphNode* node = builder->access_node(node_handle);
+
+      // Leaf node
+      if (node->edges.m_Size == 0)
+      {
+        continue;
+      }
+
+      for (uint32_t r = 0; r < node->edges.m_Size; ++r)
+      {
+        FrameGraphNodeHandle child_handle = node->edges[r];
+
+        if (node_status[child_handle.index] == FrameGraphNodeVisitStatus::New)
+        {
+          stack.push(child_handle);
+        }
+      }
+    }
+  }
+
+  // Reverse reachability from the sinks: sorted nodes come after their children, so a node is live
+  // when it is a sink or one of its already visited children is live.
+  Array<uint8_t> node_live;
+  node_live.init(&compile_allocator, all_nodes.m_Size, all_nodes.m_Size);
+  memset(node_live.m_Data, 0, sizeof(uint8_t) * all_nodes.m_Size);
+
+  for (uint32_t i = 0; i < sorted_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(sorted_nodes[i]);
+
+    bool live = is_sink_node(this, node);
+    for (uint32_t e = 0; e < node->edges.m_Size && !live; ++e)
+    {
+      live = node_live[node->edges[e].index] != 0;
+    }
+    node_live[sorted_nodes[i].index] = live ? 1 : 0;
+  }
+
+  nodes.clear();
+  culled_nodes.clear();
+
+  for (int i = sorted_nodes.m_Size - 1; i >= 0; --i)
+  {
     FrameGraphNode* node = builder->access_node(sorted_nodes[i]);
+    if (!node_live[sorted_nodes[i].index])
+    {
+#if FRAME_GRAPH_DEBUG
+      printf("Node %s is culled, nothing consumes its outputs\n", node->name);
+#endif
+      culled_nodes.push(sorted_nodes[i]);
+      continue;
+    }
+
 #if FRAME_GRAPH_DEBUG
     printf("Node %s is at position %d\n", node->name, nodes.m_Size);
 #endif
@@ -660,31 +1645,40 @@ void FrameGraph::compile()
     nodes.push(sorted_nodes[i]);
   }
 
+  node_live.shutdown();
   node_status.shutdown();
   stack.shutdown();
   sorted_nodes.shutdown();
+}
 
+void FrameGraph::allocate_resources()
+{
   // NOTE: allocations and deallocations are used for verification purposes only
   uint32_t resource_count = builder->resource_cache.resources.m_UsedIndices;
   Array<FrameGraphNodeHandle> allocations;
-  allocations.init(&local_allocator, resource_count, resource_count);
+  allocations.init(&compile_allocator, resource_count, resource_count);
   for (uint32_t i = 0; i < resource_count; ++i)
   {
     allocations[i].index = kInvalidIndex;
   }
 
   Array<FrameGraphNodeHandle> deallocations;
-  deallocations.init(&local_allocator, resource_count, resource_count);
+  deallocations.init(&compile_allocator, resource_count, resource_count);
   for (uint32_t i = 0; i < resource_count; ++i)
   {
     deallocations[i].index = kInvalidIndex;
   }
 
-  Array<TextureHandle> free_list;
-  free_list.init(&local_allocator, resource_count);
+  // Index of every transient attachment in transient_textures, by resource.
+  Array<uint32_t> transient_indices;
+  transient_indices.init(&compile_allocator, resource_count, resource_count);
+  for (uint32_t i = 0; i < resource_count; ++i)
+  {
+    transient_indices[i] = kInvalidIndex;
+  }
 
-  size_t peak_memory = 0;
-  size_t instant_memory = 0;
+  Array<FrameGraphTransientTexture> transient_textures;
+  transient_textures.init(&compile_allocator, resource_count);
 
   for (uint32_t i = 0; i < nodes.m_Size; ++i)
   {
@@ -708,6 +1702,8 @@ void FrameGraph::compile()
     }
   }
 
+  // Lifetimes: a transient attachment lives from the node writing it to its last reader, or to
+  // the end of the frame when nothing in the graph reads it.
   for (uint32_t i = 0; i < nodes.m_Size; ++i)
   {
     FrameGraphNode* node = builder->access_node(nodes[i]);
@@ -731,7 +1727,7 @@ void FrameGraph::compile()
           FrameGraphResourceInfo& info = resource->resourceInfo;
 
           // Resolve texture size if needed
-          if (info.texture.width == 0 || info.texture.height == 0)
+          if (info.texture.scale_width > 0.f || info.texture.scale_height > 0.f)
           {
             info.texture.width = builder->device->m_SwapchainWidth * info.texture.scale_width;
             info.texture.height = builder->device->m_SwapchainHeight * info.texture.scale_height;
@@ -743,35 +1739,21 @@ void FrameGraph::compile()
                         TextureFlags::kRenderTargetMask | TextureFlags::kComputeMask)
                   : TextureFlags::kRenderTargetMask;
 
-          if (free_list.m_Size > 0)
-          {
-            // TODO: find best fit
-            TextureHandle alias_texture = free_list.back();
-            free_list.pop();
-
-            TextureCreation texture_creation{};
-            texture_creation.setData(nullptr)
-                .setAlias(alias_texture)
-                .setName(resource->m_Name)
-                .setFormatType(info.texture.format, TextureType::Enum::kTexture2D)
-                .setSize(info.texture.width, info.texture.height, info.texture.depth)
-                .setFlags(texture_creation_flags);
-            TextureHandle handle = builder->device->createTexture(texture_creation);
-
-            info.texture.handle = handle;
-          }
-          else
-          {
-            TextureCreation texture_creation{};
-            texture_creation.setData(nullptr)
-                .setName(resource->m_Name)
-                .setFormatType(info.texture.format, TextureType::Enum::kTexture2D)
-                .setSize(info.texture.width, info.texture.height, info.texture.depth)
-                .setFlags(texture_creation_flags);
-            TextureHandle handle = builder->device->createTexture(texture_creation);
-
-            info.texture.handle = handle;
-          }
+          FrameGraphTransientTexture& transient = transient_textures.pushUse();
+          transient.handle = node->outputs[j];
+          transient.resource = resource;
+          transient.creation = {};
+          transient.creation.setData(nullptr)
+              .setName(resource->m_Name)
+              .setFormatType(info.texture.format, TextureType::Enum::kTexture2D)
+              .setSize(info.texture.width, info.texture.height, info.texture.depth)
+              .setFlags(texture_creation_flags);
+          transient.first_node = i;
+          transient.last_node = nodes.m_Size - 1;
+          transient.block = kInvalidIndex;
+          transient.offset = 0;
+
+          transient_indices[resource_index] = transient_textures.m_Size - 1;
         }
 
 #if FRAME_GRAPH_DEBUG
@@ -784,58 +1766,176 @@ void FrameGraph::compile()
     {
       FrameGraphResource* input_resource = builder->access_resource(node->inputs[j]);
 
-      uint32_t resource_index = input_resource->outputHandle.index;
-      FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
+      uint32_t resource_index = input_resource->outputHandle.index;
+      FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
+
+      if (resource == nullptr)
+      {
+        continue;
+      }
+
+      resource->refCount--;
+
+      if (!resource->resourceInfo.external && resource->refCount == 0)
+      {
+        assert(deallocations[resource_index].index == kInvalidIndex);
+        deallocations[resource_index] = nodes[i];
+
+        if (transient_indices[resource_index] != kInvalidIndex)
+        {
+          transient_textures[transient_indices[resource_index]].last_node = i;
+        }
+
+#if FRAME_GRAPH_DEBUG
+        printf("Output %s deallocated on node %d\n", resource->m_Name, nodes[i].index);
+#endif
+      }
+    }
+  }
+
+  // Textures are only recreated when their descriptions or lifetimes changed.
+  uint64_t allocation_hash = hashCalculate(transient_textures.m_Size);
+  for (uint32_t t = 0; t < transient_textures.m_Size; ++t)
+  {
+    const FrameGraphTransientTexture& transient = transient_textures[t];
+    const uint32_t key[] = {
+        transient.creation.width,
+        transient.creation.height,
+        transient.creation.depth,
+        transient.creation.flags,
+        (uint32_t)transient.creation.format,
+        transient.first_node,
+        transient.last_node};
+    allocation_hash = hashBytes((void*)key, sizeof(key), allocation_hash);
+  }
+
+  if (allocation_hash == compiled_allocation_hash)
+  {
+    allocations.shutdown();
+    deallocations.shutdown();
+    transient_indices.shutdown();
+    transient_textures.shutdown();
+    return;
+  }
+
+  // Passes referencing the previous textures need to update, not the first time around.
+  dependent_resources_dirty = compiled_allocation_hash != 0;
+  compiled_allocation_hash = allocation_hash;
+  release_transient_resources();
+
+  for (uint32_t t = 0; t < transient_textures.m_Size; ++t)
+  {
+    FrameGraphTransientTexture& transient = transient_textures[t];
+    builder->device->getTextureMemoryRequirements(transient.creation, transient.requirements);
+    transient_resources.push(transient.handle);
+  }
+
+  // Memory needed without aliasing, and the lower bound with it.
+  transient_memory_unaliased = 0;
+  transient_memory_peak = 0;
+  for (uint32_t i = 0; i < nodes.m_Size; ++i)
+  {
+    size_t alive_memory = 0;
+    for (uint32_t t = 0; t < transient_textures.m_Size; ++t)
+    {
+      const FrameGraphTransientTexture& transient = transient_textures[t];
+      if (transient.first_node <= i && i <= transient.last_node)
+      {
+        alive_memory += transient.requirements.size;
+      }
+    }
+    if (alive_memory > transient_memory_peak)
+    {
+      transient_memory_peak = alive_memory;
+    }
+  }
+  for (uint32_t t = 0; t < transient_textures.m_Size; ++t)
+  {
+    transient_memory_unaliased += transient_textures[t].requirements.size;
+  }
+
+  Array<FrameGraphMemoryBlock> memory_blocks;
+  memory_blocks.init(&compile_allocator, transient_textures.m_Size);
 
-      if (resource == nullptr)
-      {
-        continue;
-      }
+  pack_transient_textures(transient_textures, memory_blocks, &compile_allocator);
 
-      resource->refCount--;
+  transient_memory_aliased = 0;
+  const uint32_t first_block = transient_memory_blocks.m_Size;
+  for (uint32_t b = 0; b < memory_blocks.m_Size; ++b)
+  {
+    const FrameGraphMemoryBlock& block = memory_blocks[b];
 
-      if (!resource->resourceInfo.external && resource->refCount == 0)
-      {
-        assert(deallocations[resource_index].index == kInvalidIndex);
-        deallocations[resource_index] = nodes[i];
+    VkMemoryRequirements requirements{};
+    requirements.size = block.size;
+    requirements.alignment = block.alignment;
+    requirements.memoryTypeBits = block.memory_type_bits;
+    transient_memory_blocks.push(builder->device->allocateMemory(requirements));
 
-        if (resource->type == kFrameGraphResourceTypeAttachment ||
-            resource->type == kFrameGraphResourceTypeTexture)
-        {
-          free_list.push(resource->resourceInfo.texture.handle);
-        }
+    transient_memory_aliased += block.size;
+  }
+
+  for (uint32_t t = 0; t < transient_textures.m_Size; ++t)
+  {
+    FrameGraphTransientTexture& transient = transient_textures[t];
+    FrameGraphResource* resource = transient.resource;
+
+    transient.creation.setAliasMemory(
+        transient_memory_blocks[first_block + transient.block], transient.offset);
+    resource->resourceInfo.texture.handle = builder->device->createTexture(transient.creation);
+    resource->aliased = memory_blocks[transient.block].texture_count > 1;
+  }
 
 #if FRAME_GRAPH_DEBUG
-        printf("Output %s deallocated on node %d\n", resource->m_Name, nodes[i].index);
+  printf(
+      "Frame graph transient memory: %lluMB aliased, %lluMB unaliased, %lluMB peak alive\n",
+      (uint64_t)transient_memory_aliased / (1024 * 1024),
+      (uint64_t)transient_memory_unaliased / (1024 * 1024),
+      (uint64_t)transient_memory_peak / (1024 * 1024));
 #endif
-      }
-    }
-  }
 
   allocations.shutdown();
   deallocations.shutdown();
-  free_list.shutdown();
+  transient_indices.shutdown();
+  transient_textures.shutdown();
+  memory_blocks.shutdown();
+}
 
-  for (uint32_t i = 0; i < nodes.m_Size; ++i)
-  {
-    FrameGraphNode* node = builder->access_node(nodes[i]);
-    assert(node->enabled);
+void FrameGraph::release_transient_resources()
+{
+  GpuDevice* gpu = builder->device;
 
-    if (node->compute)
+  // Framebuffers reference the transient textures: release them without their attachments, as
+  // external ones are still in use. The nodes get new ones at the end of compile().
+  for (uint32_t i = 0; i < all_nodes.m_Size; ++i)
+  {
+    FrameGraphNode* node = builder->access_node(all_nodes[i]);
+    if (node->framebuffer.index == kInvalidIndex)
     {
       continue;
     }
 
-    if (node->render_pass.index == kInvalidIndex)
-    {
-      create_render_pass(this, node);
-    }
+    Framebuffer* framebuffer =
+        (Framebuffer*)gpu->m_Framebuffers.accessResource(node->framebuffer.index);
+    framebuffer->numColorAttachments = 0;
+    framebuffer->depthStencilAttachment = kInvalidTexture;
+    gpu->destroyFramebuffer(node->framebuffer);
+    node->framebuffer = kInvalidFramebuffer;
+  }
 
-    if (node->framebuffer.index == kInvalidIndex)
-    {
-      create_framebuffer(this, node);
-    }
+  for (uint32_t i = 0; i < transient_resources.m_Size; ++i)
+  {
+    FrameGraphResource* resource = builder->access_resource(transient_resources[i]);
+    gpu->destroyTexture(resource->resourceInfo.texture.handle);
+    resource->resourceInfo.texture.handle = kInvalidTexture;
+    resource->aliased = false;
   }
+  transient_resources.clear();
+
+  for (uint32_t i = 0; i < transient_memory_blocks.m_Size; ++i)
+  {
+    gpu->freeMemory(transient_memory_blocks[i]);
+  }
+  transient_memory_blocks.clear();
 }
 
 void FrameGraph::add_ui()
@@ -849,236 +1949,450 @@ void FrameGraph::add_ui()
   }
 }
 
-void FrameGraph::render(
-    uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene)
+// Records a batch of barriers with a single pipeline barrier.
+static void flush_node_barriers(
+    CommandBuffer* gpu_commands,
+    VkImageMemoryBarrier2KHR* image_barriers,
+    uint32_t num_image_barriers,
+    VkBufferMemoryBarrier2KHR* buffer_barriers,
+    uint32_t num_buffer_barriers)
 {
-  for (uint32_t n = 0; n < nodes.m_Size; ++n)
+  GpuDevice* gpu = gpu_commands->m_GpuDevice;
+
+  if (gpu->m_Synchronization2ExtensionPresent)
   {
-    FrameGraphNode* node = builder->access_node(nodes[n]);
-    assert(node->enabled);
+    VkDependencyInfoKHR dependency_info{VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR};
+    dependency_info.imageMemoryBarrierCount = num_image_barriers;
+    dependency_info.pImageMemoryBarriers = image_barriers;
+    dependency_info.bufferMemoryBarrierCount = num_buffer_barriers;
+    dependency_info.pBufferMemoryBarriers = buffer_barriers;
 
-    if (node->compute)
+    gpu->m_CmdPipelineBarrier2(gpu_commands->m_VulkanCmdBuffer, &dependency_info);
+    return;
+  }
+
+  // Without synchronization2 the stages of all the barriers are merged.
+  VkImageMemoryBarrier image_barriers_v1[FrameGraphBuilder::k_max_node_barriers];
+  VkBufferMemoryBarrier buffer_barriers_v1[FrameGraphBuilder::k_max_node_barriers];
+  VkPipelineStageFlags src_stage_mask = 0;
+  VkPipelineStageFlags dst_stage_mask = 0;
+
+  for (uint32_t i = 0; i < num_image_barriers; ++i)
+  {
+    const VkImageMemoryBarrier2KHR& barrier = image_barriers[i];
+    VkImageMemoryBarrier& barrier_v1 = image_barriers_v1[i];
+    barrier_v1 = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier_v1.srcAccessMask = (VkAccessFlags)barrier.srcAccessMask;
+    barrier_v1.dstAccessMask = (VkAccessFlags)barrier.dstAccessMask;
+    barrier_v1.oldLayout = barrier.oldLayout;
+    barrier_v1.newLayout = barrier.newLayout;
+    barrier_v1.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier_v1.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier_v1.image = barrier.image;
+    barrier_v1.subresourceRange = barrier.subresourceRange;
+
+    src_stage_mask |= (VkPipelineStageFlags)barrier.srcStageMask;
+    dst_stage_mask |= (VkPipelineStageFlags)barrier.dstStageMask;
+  }
+
+  for (uint32_t i = 0; i < num_buffer_barriers; ++i)
+  {
+    const VkBufferMemoryBarrier2KHR& barrier = buffer_barriers[i];
+    VkBufferMemoryBarrier& barrier_v1 = buffer_barriers_v1[i];
+    barrier_v1 = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier_v1.srcAccessMask = (VkAccessFlags)barrier.srcAccessMask;
+    barrier_v1.dstAccessMask = (VkAccessFlags)barrier.dstAccessMask;
+    barrier_v1.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier_v1.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier_v1.buffer = barrier.buffer;
+    barrier_v1.offset = barrier.offset;
+    barrier_v1.size = barrier.size;
+
+    src_stage_mask |= (VkPipelineStageFlags)barrier.srcStageMask;
+    dst_stage_mask |= (VkPipelineStageFlags)barrier.dstStageMask;
+  }
+
+  vkCmdPipelineBarrier(
+      gpu_commands->m_VulkanCmdBuffer,
+      src_stage_mask ? src_stage_mask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      dst_stage_mask ? dst_stage_mask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0,
+      nullptr,
+      num_buffer_barriers,
+      buffer_barriers_v1,
+      num_image_barriers,
+      image_barriers_v1);
+}
+
+// Records the planned barriers of a node, in as few pipeline barriers as the batch arrays allow.
+// When tracking states, texture layouts are taken from and written to the textures, as passes can
+// also transition the textures they use. Otherwise nodes can be recorded in any order, and only
+// the first use of a texture in the frame reads its state.
+static void record_node_barriers(
+    FrameGraph* frame_graph,
+    FrameGraphNode* node,
+    CommandBuffer* gpu_commands,
+    bool track_states)
+{
+  if (node->barrier_count == 0)
+  {
+    return;
+  }
+
+  GpuDevice* gpu = gpu_commands->m_GpuDevice;
+  FrameGraphBuilder* builder = frame_graph->builder;
+
+  VkImageMemoryBarrier2KHR image_barriers[FrameGraphBuilder::k_max_node_barriers];
+  VkBufferMemoryBarrier2KHR buffer_barriers[FrameGraphBuilder::k_max_node_barriers];
+  uint32_t num_image_barriers = 0;
+  uint32_t num_buffer_barriers = 0;
+
+  for (uint32_t b = 0; b < node->barrier_count; ++b)
+  {
+    // Nodes with more barriers than the arrays hold record them in several batches.
+    if (num_image_barriers == FrameGraphBuilder::k_max_node_barriers ||
+        num_buffer_barriers == FrameGraphBuilder::k_max_node_barriers)
     {
-      gpu_commands->pushMarker(node->name);
+      flush_node_barriers(
+          gpu_commands, image_barriers, num_image_barriers, buffer_barriers, num_buffer_barriers);
+      num_image_barriers = 0;
+      num_buffer_barriers = 0;
+    }
 
-      for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
-      {
-        FrameGraphResource* input_resource = builder->access_resource(node->inputs[i]);
-        FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
+    const FrameGraphBarrier& planned = frame_graph->barriers[node->barrier_offset + b];
+    FrameGraphResource* resource = builder->access_resource(planned.resource);
 
-        if (resource == nullptr || resource->resourceInfo.external)
-        {
-          continue;
-        }
+    ResourceState old_state = planned.old_state;
+    VkImage image = VK_NULL_HANDLE;
 
-        if (input_resource->type == kFrameGraphResourceTypeTexture)
-        {
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
-
-          utilAddImageBarrier(
-              gpu_commands->m_GpuDevice,
-              gpu_commands->m_VulkanCmdBuffer,
-              texture,
-              RESOURCE_STATE_SHADER_RESOURCE,
-              0,
-              1,
-              TextureFormat::hasDepth(texture->vkFormat));
-        }
-        else if (input_resource->type == kFrameGraphResourceTypeAttachment)
-        {
-          // TODO: what to do with attachments ?
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
-          texture = texture;
-        }
+    if (!planned.buffer)
+    {
+      Texture* texture =
+          (Texture*)gpu->m_Textures.accessResource(resource->resourceInfo.texture.handle.index);
+      if (planned.discard)
+      {
+        old_state = RESOURCE_STATE_UNDEFINED;
       }
-
-      for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+      else if (track_states || planned.first_use)
       {
-        FrameGraphResource* resource = builder->access_resource(node->outputs[o]);
+        old_state = texture->state;
+      }
 
-        if (resource->type == kFrameGraphResourceTypeAttachment)
-        {
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
+      if (track_states)
+      {
+        texture->state = planned.new_state;
+      }
+      image = texture->vkImage;
 
-          if (TextureFormat::hasDepth(texture->vkFormat))
-          {
-            // Is this supported even ?
-            assert(false);
-          }
-          else
-          {
-            utilAddImageBarrier(
-                gpu_commands->m_GpuDevice,
-                gpu_commands->m_VulkanCmdBuffer,
-                texture,
-                RESOURCE_STATE_UNORDERED_ACCESS,
-                0,
-                1,
-                false);
-          }
-        }
+      if (old_state == planned.new_state && is_read_only_state(old_state))
+      {
+        continue;
       }
+    }
 
-      node->graph_render_pass->pre_render(current_frame_index, gpu_commands, this, render_scene);
-      node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
-      node->graph_render_pass->post_render(current_frame_index, gpu_commands, this, render_scene);
+    const VkAccessFlags2KHR src_access = utilToVkAccessFlags2(old_state);
+    const VkAccessFlags2KHR dst_access = utilToVkAccessFlags2(planned.new_state);
+    // Discarded memory may still be read by the resource aliasing it, so wait for all of it.
+    const VkPipelineStageFlags2KHR src_stage =
+        planned.discard ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR
+                        : utilDeterminePipelineStageFlags2(src_access, planned.queue);
+    const VkPipelineStageFlags2KHR dst_stage =
+        utilDeterminePipelineStageFlags2(dst_access, planned.queue);
 
-      gpu_commands->popMarker();
+    if (planned.buffer)
+    {
+      Buffer* buffer =
+          (Buffer*)gpu->m_Buffers.accessResource(resource->resourceInfo.buffer.handle.index);
+
+      VkBufferMemoryBarrier2KHR& barrier = buffer_barriers[num_buffer_barriers++];
+      barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR};
+      barrier.srcAccessMask = src_access;
+      barrier.srcStageMask = src_stage;
+      barrier.dstAccessMask = dst_access;
+      barrier.dstStageMask = dst_stage;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.buffer = buffer->vkBuffer;
+      barrier.offset = 0;
+      barrier.size = buffer->size;
     }
-    else if (node->ray_tracing)
+    else
     {
-      gpu_commands->pushMarker(node->name);
+      VkImageMemoryBarrier2KHR& barrier = image_barriers[num_image_barriers++];
+      barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR};
+      barrier.srcAccessMask = src_access;
+      barrier.srcStageMask = src_stage;
+      barrier.dstAccessMask = dst_access;
+      barrier.dstStageMask = dst_stage;
+      barrier.oldLayout = utilToVkImageLayout2(old_state);
+      barrier.newLayout = utilToVkImageLayout2(planned.new_state);
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange.aspectMask =
+          planned.depth ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = 1;
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = 1;
+    }
+  }
 
-      node->graph_render_pass->pre_render(current_frame_index, gpu_commands, this, render_scene);
-      node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
-      node->graph_render_pass->post_render(current_frame_index, gpu_commands, this, render_scene);
+  if (num_image_barriers == 0 && num_buffer_barriers == 0)
+  {
+    return;
+  }
 
-      gpu_commands->popMarker();
-    }
-    else
+  flush_node_barriers(
+      gpu_commands, image_barriers, num_image_barriers, buffer_barriers, num_buffer_barriers);
+}
+
+static void render_node(
+    FrameGraph* frame_graph,
+    FrameGraphNode* node,
+    uint32_t current_frame_index,
+    CommandBuffer* gpu_commands,
+    RenderScene* render_scene,
+    bool track_states)
+{
+  FrameGraphBuilder* builder = frame_graph->builder;
+
+  if (node->compute)
+  {
+    gpu_commands->pushMarker(node->name);
+
+    record_node_barriers(frame_graph, node, gpu_commands, track_states);
+
+    node->graph_render_pass->pre_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+    node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
+    node->graph_render_pass->post_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+
+    gpu_commands->popMarker();
+  }
+  else if (node->ray_tracing)
+  {
+    gpu_commands->pushMarker(node->name);
+
+    node->graph_render_pass->pre_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+    node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
+    node->graph_render_pass->post_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+
+    gpu_commands->popMarker();
+  }
+  else
+  {
+    gpu_commands->pushMarker(node->name);
+
+    record_node_barriers(frame_graph, node, gpu_commands, track_states);
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
     {
-      gpu_commands->pushMarker(node->name);
+      FrameGraphResource* input_resource = builder->access_resource(node->inputs[i]);
+      FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
 
-      uint32_t width = 0;
-      uint32_t height = 0;
+      if (resource == nullptr || resource->resourceInfo.external)
+      {
+        continue;
+      }
 
-      for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+      if (input_resource->type == kFrameGraphResourceTypeAttachment)
       {
-        FrameGraphResource* input_resource = builder->access_resource(node->inputs[i]);
-        FrameGraphResource* resource = builder->access_resource(input_resource->outputHandle);
+        Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
+            resource->resourceInfo.texture.handle.index);
 
-        if (resource == nullptr || resource->resourceInfo.external)
-        {
-          continue;
-        }
+        width = texture->width;
+        height = texture->height;
+      }
+    }
 
-        if (input_resource->type == kFrameGraphResourceTypeTexture)
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      FrameGraphResource* resource = builder->access_resource(node->outputs[o]);
+
+      if (resource->type == kFrameGraphResourceTypeAttachment)
+      {
+        Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
+            resource->resourceInfo.texture.handle.index);
+
+        width = texture->width;
+        height = texture->height;
+
+        float* clear_color = resource->resourceInfo.texture.clear_values;
+        if (TextureFormat::hasDepth(texture->vkFormat))
         {
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
-
-          utilAddImageBarrier(
-              gpu_commands->m_GpuDevice,
-              gpu_commands->m_VulkanCmdBuffer,
-              texture,
-              RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
-              0,
-              1,
-              TextureFormat::hasDepth(texture->vkFormat));
+          gpu_commands->clearDepthStencil(clear_color[0], (uint8_t)clear_color[1]);
         }
-        else if (input_resource->type == kFrameGraphResourceTypeAttachment)
+        else
         {
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
-
-          width = texture->width;
-          height = texture->height;
-
-          // For textures that are read-write check if a transition is needed.
-          if (!TextureFormat::hasDepthOrStencil(texture->vkFormat))
-          {
-            utilAddImageBarrier(
-                gpu_commands->m_GpuDevice,
-                gpu_commands->m_VulkanCmdBuffer,
-                texture,
-                RESOURCE_STATE_RENDER_TARGET,
-                0,
-                1,
-                false);
-          }
-          else
-          {
-            utilAddImageBarrier(
-                gpu_commands->m_GpuDevice,
-                gpu_commands->m_VulkanCmdBuffer,
-                texture,
-                RESOURCE_STATE_DEPTH_WRITE,
-                0,
-                1,
-                true);
-          }
+          gpu_commands->clear(clear_color[0], clear_color[1], clear_color[2], clear_color[3], o);
         }
       }
+    }
 
-      for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
-      {
-        FrameGraphResource* resource = builder->access_resource(node->outputs[o]);
+    Rect2DInt scissor{0, 0, (uint16_t)width, (uint16_t)height};
+    gpu_commands->setScissor(&scissor);
 
-        if (resource->type == kFrameGraphResourceTypeAttachment)
-        {
-          Texture* texture = (Texture*)gpu_commands->m_GpuDevice->m_Textures.accessResource(
-              resource->resourceInfo.texture.handle.index);
+    Viewport viewport{};
+    viewport.rect = {0, 0, (uint16_t)width, (uint16_t)height};
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
 
-          width = texture->width;
-          height = texture->height;
+    gpu_commands->setViewport(&viewport);
 
-          if (TextureFormat::hasDepth(texture->vkFormat))
-          {
-            utilAddImageBarrier(
-                gpu_commands->m_GpuDevice,
-                gpu_commands->m_VulkanCmdBuffer,
-                texture,
-                RESOURCE_STATE_DEPTH_WRITE,
-                0,
-                1,
-                true);
-
-            float* clear_color = resource->resourceInfo.texture.clear_values;
-            gpu_commands->clearDepthStencil(clear_color[0], (uint8_t)clear_color[1]);
-          }
-          else
-          {
-            utilAddImageBarrier(
-                gpu_commands->m_GpuDevice,
-                gpu_commands->m_VulkanCmdBuffer,
-                texture,
-                RESOURCE_STATE_RENDER_TARGET,
-                0,
-                1,
-                false);
-
-            float* clear_color = resource->resourceInfo.texture.clear_values;
-            gpu_commands->clear(clear_color[0], clear_color[1], clear_color[2], clear_color[3], o);
-          }
-        }
-      }
+    node->graph_render_pass->pre_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+
+    gpu_commands->bindPass(node->render_pass, node->framebuffer, false);
+
+    node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
+
+    gpu_commands->endCurrentRenderPass();
+
+    node->graph_render_pass->post_render(
+        current_frame_index, gpu_commands, frame_graph, render_scene);
+
+    gpu_commands->popMarker();
+  }
+}
+
+void FrameGraph::prepare_render(GpuDevice& gpu, RenderScene* render_scene)
+{
+  // Passes were toggled since the last frame, sort and allocate again before recording.
+  if (dirty)
+  {
+    dirty = false;
+    compile();
+  }
+
+  if (!dependent_resources_dirty)
+  {
+    return;
+  }
 
-      Rect2DInt scissor{0, 0, (uint16_t)width, (uint16_t)height};
-      gpu_commands->setScissor(&scissor);
+  for (uint32_t n = 0; n < nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(nodes[n]);
+    node->graph_render_pass->update_dependent_resources(gpu, this, render_scene);
+  }
+  dependent_resources_dirty = false;
+}
+
+void FrameGraph::render(
+    uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene)
+{
+  prepare_render(*gpu_commands->m_GpuDevice, render_scene);
+
+  for (uint32_t n = 0; n < nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(nodes[n]);
+    assert(node->enabled);
+
+    render_node(this, node, current_frame_index, gpu_commands, render_scene, true);
+  }
+}
+
+void FrameGraph::render_range(
+    uint32_t current_frame_index,
+    CommandBuffer* gpu_commands,
+    RenderScene* render_scene,
+    uint32_t first_node,
+    uint32_t node_count)
+{
+  assert(first_node + node_count <= nodes.m_Size);
 
-      Viewport viewport{};
-      viewport.rect = {0, 0, (uint16_t)width, (uint16_t)height};
-      viewport.minDepth = 0.0f;
-      viewport.maxDepth = 1.0f;
+  for (uint32_t n = first_node; n < first_node + node_count; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(nodes[n]);
+    assert(node->enabled);
 
-      gpu_commands->setViewport(&viewport);
+    render_node(this, node, current_frame_index, gpu_commands, render_scene, false);
+  }
+}
 
-      node->graph_render_pass->pre_render(current_frame_index, gpu_commands, this, render_scene);
+bool FrameGraph::can_record_in_parallel()
+{
+  for (uint32_t n = 0; n < nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(nodes[n]);
+    if (node->graph_render_pass && node->graph_render_pass->changes_texture_states())
+    {
+      return false;
+    }
+  }
+  return true;
+}
 
-      gpu_commands->bindPass(node->render_pass, node->framebuffer, false);
+void FrameGraph::apply_barrier_states(GpuDevice& gpu)
+{
+  for (uint32_t b = 0; b < barriers.m_Size; ++b)
+  {
+    const FrameGraphBarrier& barrier = barriers[b];
+    if (barrier.buffer)
+    {
+      continue;
+    }
 
-      node->graph_render_pass->render(current_frame_index, gpu_commands, render_scene);
+    FrameGraphResource* resource = builder->access_resource(barrier.resource);
+    Texture* texture =
+        (Texture*)gpu.m_Textures.accessResource(resource->resourceInfo.texture.handle.index);
+    texture->state = barrier.new_state;
+  }
+}
 
-      gpu_commands->endCurrentRenderPass();
+// Attachments of a framebuffer the graph doesn't create itself.
+static bool has_external_attachment(FrameGraph* frame_graph, FrameGraphNode* node)
+{
+  for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+  {
+    FrameGraphResource* resource = frame_graph->access_resource(node->outputs[o]);
+    if (resource->type == kFrameGraphResourceTypeAttachment && resource->resourceInfo.external)
+    {
+      return true;
+    }
+  }
 
-      node->graph_render_pass->post_render(current_frame_index, gpu_commands, this, render_scene);
+  for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+  {
+    FrameGraphResource* input = frame_graph->access_resource(node->inputs[i]);
+    if (input->type != kFrameGraphResourceTypeAttachment)
+    {
+      continue;
+    }
 
-      gpu_commands->popMarker();
+    FrameGraphResource* resource = frame_graph->get_resource(input->m_Name);
+    if (resource != nullptr && resource->resourceInfo.external)
+    {
+      return true;
     }
   }
+
+  return false;
 }
 
 void FrameGraph::on_resize(GpuDevice& gpu, uint32_t new_width, uint32_t new_height)
 {
+  // The swapchain size is part of the compile hash: transient textures are created again at the
+  // new size with new framebuffers, only framebuffers with external attachments still need to
+  // be resized.
+  compile();
+
   for (uint32_t n = 0; n < nodes.m_Size; ++n)
   {
     FrameGraphNode* node = builder->access_node(nodes[n]);
     assert(node->enabled);
 
-    gpu.resizeOutputTextures(node->framebuffer, new_width, new_height);
+    if (node->framebuffer.index != kInvalidIndex && has_external_attachment(this, node))
+    {
+      gpu.resizeOutputTextures(node->framebuffer, new_width, new_height);
+    }
 
     node->graph_render_pass->on_resize(gpu, this, new_width, new_height);
   }
@@ -1086,7 +2400,28 @@ void FrameGraph::on_resize(GpuDevice& gpu, uint32_t new_width, uint32_t new_heig
 
 void FrameGraph::debug_ui()
 {
-  // TODO
+  ImGui::Text(
+      "Transient memory: %lluMB, %lluMB without aliasing, %lluMB peak alive",
+      (uint64_t)transient_memory_aliased / (1024 * 1024),
+      (uint64_t)transient_memory_unaliased / (1024 * 1024),
+      (uint64_t)transient_memory_peak / (1024 * 1024));
+
+  ImGui::Text("Nodes: %u recorded, %u culled", nodes.m_Size, culled_nodes.m_Size);
+  for (uint32_t i = 0; i < culled_nodes.m_Size; ++i)
+  {
+    ImGui::BulletText("%s", builder->access_node(culled_nodes[i])->name);
+  }
+
+  if (ImGui::Checkbox("Validate frame graph", &validation) && validation)
+  {
+    // Validation runs with the node sorting, force it on the next compilation and ask for one.
+    compiled_hash = compiled_topology_hash = 0;
+    dirty = true;
+  }
+  if (validation)
+  {
+    ImGui::Text("Validation errors: %u", validation_errors);
+  }
 }
 
 void FrameGraph::add_node(FrameGraphNodeCreation& creation)
@@ -1130,8 +2465,9 @@ void FrameGraphResourceCache::init(Framework::Allocator* allocator, GpuDevice* d
 {
   device = device_;
 
-  resources.init(allocator, FrameGraphBuilder::k_max_resources_count);
-  resource_map.init(allocator, FrameGraphBuilder::k_max_resources_count);
+  resources.initGrowable(
+      allocator, FrameGraphBuilder::k_pool_page_size, FrameGraphBuilder::k_max_resources_count);
+  resource_map.init(allocator, FrameGraphBuilder::k_pool_page_size);
 }
 
 void FrameGraphResourceCache::shutdown()
@@ -1145,7 +2481,7 @@ void FrameGraphResourceCache::shutdown()
 
     if ((resource->type == kFrameGraphResourceTypeTexture ||
          resource->type == kFrameGraphResourceTypeAttachment) &&
-        (resource->resourceInfo.texture.handle.index > 0))
+        (resource->resourceInfo.texture.handle.index != kInvalidIndex))
     {
       Texture* texture =
           (Texture*)device->m_Textures.accessResource(resource->resourceInfo.texture.handle.index);
@@ -1153,7 +2489,7 @@ void FrameGraphResourceCache::shutdown()
     }
     else if (
         (resource->type == kFrameGraphResourceTypeBuffer) &&
-        (resource->resourceInfo.buffer.handle.index > 0))
+        (resource->resourceInfo.buffer.handle.index != kInvalidIndex))
     {
       Buffer* buffer =
           (Buffer*)device->m_Buffers.accessResource(resource->resourceInfo.buffer.handle.index);
@@ -1174,8 +2510,12 @@ void FrameGraphNodeCache::init(Framework::Allocator* allocator, GpuDevice* devic
 {
   device = device_;
 
-  nodes.init(allocator, FrameGraphBuilder::k_max_nodes_count, sizeof(FrameGraphNode));
-  node_map.init(allocator, FrameGraphBuilder::k_max_nodes_count);
+  nodes.initGrowable(
+      allocator,
+      FrameGraphBuilder::k_pool_page_size,
+      sizeof(FrameGraphNode),
+      FrameGraphBuilder::k_max_nodes_count);
+  node_map.init(allocator, FrameGraphBuilder::k_pool_page_size);
 }
 
 void FrameGraphNodeCache::shutdown()
@@ -1223,6 +2563,14 @@ FrameGraphResourceHandle FrameGraphBuilder::create_node_output(
   if (creation.type != kFrameGraphResourceTypeReference)
   {
     resource->resourceInfo = creation.resourceInfo;
+    // Graph owned resources get their handles when compiled.
+    if (!resource->resourceInfo.external)
+    {
+      if (creation.type == kFrameGraphResourceTypeBuffer)
+        resource->resourceInfo.buffer.handle = kInvalidBuffer;
+      else
+        resource->resourceInfo.texture.handle = kInvalidTexture;
+    }
     resource->outputHandle = resource_handle;
     resource->producer = producer;
     resource->refCount = 0;
@@ -1258,6 +2606,7 @@ FrameGraphBuilder::create_node_input(const FrameGraphResourceInputCreation& crea
   FrameGraphResource* resource = resource_cache.resources.get(resource_handle.index);
 
   resource->resourceInfo = {};
+  resource->resourceInfo.texture.handle = kInvalidTexture;
   resource->producer.index = kInvalidIndex;
   resource->outputHandle.index = kInvalidIndex;
   resource->type = creation.type;
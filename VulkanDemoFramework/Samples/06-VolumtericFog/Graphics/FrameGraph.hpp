@@ -108,6 +108,8 @@ struct FrameGraphResource
   FrameGraphResourceHandle outputHandle;
 
   int refCount = 0;
+  // Shares memory with other transient attachments, so its content is lost between uses.
+  bool aliased = false;
 
   const char* m_Name = nullptr;
 };
@@ -180,10 +182,38 @@ struct FrameGraphRenderPass
   update_dependent_resources(GpuDevice& gpu, FrameGraph* frame_graph, RenderScene* render_scene)
   {
   }
+  // Passes whose pre_render or post_render transition textures themselves, with copies or image
+  // barriers. The planned barriers can't see those, so such graphs are recorded serially.
+  virtual bool changes_texture_states() const { return false; }
 
   bool enabled = true;
 };
 
+// Transition of a resource before a node runs, planned by FrameGraph::compile.
+struct FrameGraphBarrier
+{
+  FrameGraphResourceHandle resource;
+
+  ResourceState old_state;
+  ResourceState new_state;
+  QueueType::Enum queue;
+
+  bool buffer;
+  bool depth;
+  bool discard; // Previous content is not needed, transition from an undefined layout
+  // First access of the resource in the frame: its old state is the one left by the previous frame
+  // and is read from the texture, as the steady state planned doesn't hold for the first frame.
+  bool first_use;
+};
+
+// Dependency between nodes, as indices in FrameGraph::all_nodes: the child reads an output of the
+// parent.
+struct FrameGraphNodeEdge
+{
+  uint32_t parent;
+  uint32_t child;
+};
+
 struct FrameGraphNode
 {
   int ref_count = 0;
@@ -198,6 +228,10 @@ struct FrameGraphNode
 
   Array<FrameGraphNodeHandle> edges;
 
+  // Range of FrameGraph::barriers recorded before the node.
+  uint32_t barrier_offset = 0;
+  uint32_t barrier_count = 0;
+
   float resolution_scale_width = 0.f;
   float resolution_scale_height = 0.f;
 
@@ -238,6 +272,64 @@ struct FrameGraphNodeCache
   ResourcePool nodes;
 };
 
+// Binary graph baked from the JSON one, loaded with a single read. The header is followed by the
+// resource, node and edge tables and then the name table; names are offsets into it.
+struct FrameGraphBakedHeader
+{
+  static constexpr uint32_t k_magic = 0x42474646; // "FFGB"
+  static constexpr uint32_t k_version = 2;
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash; // Of the JSON graph content, to detect edits since baking
+
+  uint32_t name;
+  uint32_t node_count;
+  uint32_t resource_count;
+  uint32_t edge_count;
+  uint32_t names_size;
+  uint32_t padding;
+};
+
+struct FrameGraphBakedNode
+{
+  uint32_t name;
+  // Resources of the node are contiguous: inputs first, then outputs.
+  uint32_t first_resource;
+  uint32_t input_count;
+  uint32_t output_count;
+
+  uint8_t compute;
+  uint8_t ray_tracing;
+  uint8_t enabled;
+  uint8_t padding;
+};
+
+// Creation fields of FrameGraphResourceInfo, handles are only known once the graph is compiled.
+struct FrameGraphBakedResource
+{
+  uint32_t name;
+  uint32_t type;
+
+  uint64_t size; // Buffers only, as the usage flags
+  uint32_t flags;
+
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  float scale_width;
+  float scale_height;
+  uint32_t format;
+  uint32_t load_op;
+  float clear_values[4];
+
+  uint8_t external;
+  uint8_t compute;
+  uint8_t padding[6];
+};
+
+typedef FrameGraphNodeEdge FrameGraphBakedEdge;
+
 //
 //
 struct FrameGraphBuilder : public Service
@@ -269,8 +361,12 @@ struct FrameGraphBuilder : public Service
   GpuDevice* device;
 
   static constexpr uint32_t k_max_render_pass_count = 256;
-  static constexpr uint32_t k_max_resources_count = 1024;
-  static constexpr uint32_t k_max_nodes_count = 1024;
+  // Resources and nodes pools grow by pages up to these limits.
+  static constexpr uint32_t k_max_resources_count = 16384;
+  static constexpr uint32_t k_max_nodes_count = 16384;
+  static constexpr uint32_t k_pool_page_size = 64;
+  // Barriers of each kind recorded per pipeline barrier, nodes with more use several.
+  static constexpr uint32_t k_max_node_barriers = 32;
 
   static constexpr cstring k_name = "raptor_frame_graph_builder_service";
 };
@@ -282,16 +378,46 @@ struct FrameGraph
   void init(FrameGraphBuilder* builder);
   void shutdown();
 
+  // Loads the baked graph next to the JSON one, unless the JSON was edited since it was baked. In
+  // that case the JSON is parsed and baked again. Without the JSON the baked graph is loaded as is.
   void parse(cstring file_path, Framework::StackAllocator* temp_allocator);
-
-  // NOTE: each frame we rebuild the graph so that we can enable only
-  // the nodes we are interested in
-  void reset();
+  void parse_json(cstring file_path, Framework::StackAllocator* temp_allocator);
+  // Writes the parsed nodes, before any compilation, as a baked graph.
+  void bake(cstring file_path, uint64_t source_hash, Framework::StackAllocator* temp_allocator);
+  // A zero source hash skips the check against the JSON, for builds shipped without it.
+  bool
+  load_baked(cstring file_path, uint64_t source_hash, Framework::StackAllocator* temp_allocator);
+  void compute_node_edges();
+
+  // Toggled passes mark the graph dirty, it is compiled again by the next prepare_render.
   void enable_render_pass(cstring render_pass_name);
   void disable_render_pass(cstring render_pass_name);
+  // Cheap when nothing changed since the last call: the result is cached by a hash of the enabled
+  // nodes, the output descriptions and the swapchain size, and only the stale parts are rebuilt.
+  // Enabled nodes whose writes never reach the final or an external resource are culled.
   void compile();
+  void sort_nodes();
+  void allocate_resources();
+  // Walks the sorted nodes tracking the state of every resource and fills barriers.
+  void plan_barriers(Framework::Allocator* temp_allocator);
+  void release_transient_resources();
   void add_ui();
   void render(uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene);
+  // Parallel recording: ranges of the sorted nodes are recorded into separate command buffers,
+  // submitted in node order. Barriers use the planned states, so call prepare_render before the
+  // ranges are recorded and apply_barrier_states once they are all done. prepare_render also
+  // compiles the graph again when passes were toggled, call it from the main thread every frame.
+  // Transitions made by the passes themselves are not planned, graphs with such passes have to be
+  // recorded with render(), see can_record_in_parallel.
+  void prepare_render(GpuDevice& gpu, RenderScene* render_scene);
+  bool can_record_in_parallel();
+  void render_range(
+      uint32_t current_frame_index,
+      CommandBuffer* gpu_commands,
+      RenderScene* render_scene,
+      uint32_t first_node,
+      uint32_t node_count);
+  void apply_barrier_states(GpuDevice& gpu);
   void on_resize(GpuDevice& gpu, uint32_t new_width, uint32_t new_height);
 
   void debug_ui();
@@ -308,11 +434,40 @@ struct FrameGraph
   // NOTE: nodes sorted in topological order
   Array<FrameGraphNodeHandle> nodes;
   Array<FrameGraphNodeHandle> all_nodes;
+  Array<FrameGraphNodeEdge> node_edges; // Between all the nodes, enabled or not
+
+  // Enabled nodes left out of the sorted ones, as nothing reachable from a sink consumes them.
+  Array<FrameGraphNodeHandle> culled_nodes;
+
+  // Barriers of all the sorted nodes, merged into a single pipeline barrier per node.
+  Array<FrameGraphBarrier> barriers;
 
   FrameGraphBuilder* builder;
   Framework::Allocator* allocator;
 
   LinearAllocator local_allocator;
+  LinearAllocator compile_allocator; // Cleared by every compilation
+
+  // Hashes of what the compiled state was built from.
+  uint64_t compiled_hash = 0;
+  uint64_t compiled_topology_hash = 0;
+  uint64_t compiled_allocation_hash = 0;
+  // Transient textures were recreated, passes must update what references them.
+  bool dependent_resources_dirty = false;
+  // Passes were enabled or disabled since the last compilation.
+  bool dirty = false;
+
+  // Check reads of resources nothing writes and resources with several writers on every sort.
+  bool validation = true;
+  uint32_t validation_errors = 0;
+
+  Array<FrameGraphResourceHandle> transient_resources;
+
+  // Memory of the transient attachments, shared by the ones with disjoint lifetimes.
+  Array<VmaAllocation> transient_memory_blocks;
+  size_t transient_memory_unaliased = 0; // Every transient attachment with its own memory
+  size_t transient_memory_peak = 0;      // Most memory alive at a single node
+  size_t transient_memory_aliased = 0;   // Sum of the shared blocks
 
   const char* name = nullptr;
 };
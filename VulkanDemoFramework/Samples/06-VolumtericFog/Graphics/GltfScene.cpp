@@ -35,6 +35,45 @@ void glTFScene::init(
 
   int64_t endLoadingFile = Time::getCurrentTime();
 
+  // Temporary array of buffer data. Embedded buffers (glb binary chunk, data uris) are used in
+  // place and external files are mapped: buffer views are uploaded straight from the mappings.
+  Array<void*> buffersData;
+  buffersData.init(residentAllocator, gltfScene.buffersCount);
+  bufferMappings.init(residentAllocator, gltfScene.buffersCount, gltfScene.buffersCount);
+
+  for (uint32_t bufferIndex = 0; bufferIndex < gltfScene.buffersCount; ++bufferIndex)
+  {
+    glTF::Buffer& buffer = gltfScene.buffers[bufferIndex];
+
+    FileMapping& mapping = bufferMappings[bufferIndex];
+    mapping = FileMapping{};
+    if (buffer.data)
+    {
+      buffersData.push(buffer.data);
+      continue;
+    }
+
+    mapping = fileMapReadOnly(buffer.uri.m_Data, FileAccessHint::kSequential);
+    assert(mapping.data != nullptr && mapping.size >= (size_t)buffer.byteLength);
+    buffersData.push(mapping.data);
+  }
+
+  // Images in views of external buffers point in the mappings, the loader only resolves the
+  // embedded ones.
+  for (uint32_t imageIndex = 0; imageIndex < gltfScene.imagesCount; ++imageIndex)
+  {
+    glTF::Image& image = gltfScene.images[imageIndex];
+    if (image.data || image.bufferView == glTF::INVALID_INT_VALUE)
+      continue;
+
+    glTF::BufferView& bufferView = gltfScene.bufferViews[image.bufferView];
+    image.data = (uint8_t*)buffersData[bufferView.buffer] +
+                 glTF::getDataOffset(0, bufferView.byteOffset);
+    image.dataSize = bufferView.byteLength;
+  }
+
+  int64_t endReadingBuffersData = Time::getCurrentTime();
+
   // Load all textures
   images.init(residentAllocator, gltfScene.imagesCount);
 
@@ -50,7 +89,20 @@ void glTFScene::init(
 
     int comp, width, height;
 
-    stbi_info(image.uri.m_Data, &width, &height, &comp);
+    // Embedded images (glb buffer views, data uris) are decoded from the scene memory.
+    char* imageName = image.uri.m_Data;
+    if (image.data)
+    {
+      stbi_info_from_memory(image.data, image.dataSize, &width, &height, &comp);
+
+      // Texture names are referenced until the scene is freed.
+      imageName = (char*)gltfScene.allocator.allocate(32, 1);
+      snprintf(imageName, 32, "image_%u", imageIndex);
+    }
+    else
+    {
+      stbi_info(image.uri.m_Data, &width, &height, &comp);
+    }
 
     uint32_t mipLevels = 1;
     if (true)
@@ -72,12 +124,18 @@ void glTFScene::init(
         .setFormatType(VK_FORMAT_R8G8B8A8_UNORM, TextureType::kTexture2D)
         .setFlags(mipLevels, 0)
         .setSize((uint16_t)width, (uint16_t)height, 1)
-        .setName(image.uri.m_Data);
+        .setName(imageName);
     RendererUtil::TextureResource* tr = renderer->createTexture(tc);
     assert(tr != nullptr);
 
     images.push(*tr);
 
+    if (image.data)
+    {
+      asyncLoader->requestTextureData(image.data, image.dataSize, tr->m_Handle);
+      continue;
+    }
+
     // Reconstruct file path
     char* fullFilename = nameBuffer.appendUseFormatted("%s%s", path, image.uri.m_Data);
     asyncLoader->requestTextureData(fullFilename, tr->m_Handle);
@@ -164,27 +222,62 @@ void glTFScene::init(
 
   int64_t endCreatingSamplers = Time::getCurrentTime();
 
-  // Temporary array of buffer data
-  Array<void*> buffersData;
-  buffersData.init(residentAllocator, gltfScene.buffersCount);
+  packMegaBuffers(buffersData, residentAllocator);
 
-  for (uint32_t bufferIndex = 0; bufferIndex < gltfScene.buffersCount; ++bufferIndex)
+  // Primitives drawn from their own buffers: skinned ones and the ones left out of the mega
+  // buffers. Only the views they bind get a gpu buffer.
+  Array<uint8_t> boundViews;
+  boundViews.init(tempAllocator, gltfScene.bufferViewsCount, gltfScene.bufferViewsCount);
+  memset(boundViews.m_Data, 0, gltfScene.bufferViewsCount);
+
+  for (uint32_t nodeIndex = 0; nodeIndex < gltfScene.nodesCount; ++nodeIndex)
   {
-    glTF::Buffer& buffer = gltfScene.buffers[bufferIndex];
+    glTF::Node& node = gltfScene.nodes[nodeIndex];
+    if (node.mesh == glTF::INVALID_INT_VALUE)
+      continue;
 
-    FileReadResult bufferData = fileReadBinary(buffer.uri.m_Data, residentAllocator);
-    buffersData.push(bufferData.data);
-  }
+    glTF::Mesh& gltfMesh = gltfScene.meshes[node.mesh];
+    for (uint32_t primitiveIndex = 0; primitiveIndex < gltfMesh.primitivesCount; ++primitiveIndex)
+    {
+      const uint32_t flatPrimitiveIndex = meshFirstPrimitive[node.mesh] + primitiveIndex;
+      if (node.skin == glTF::INVALID_INT_VALUE &&
+          primitiveMegaFirstVertex[flatPrimitiveIndex] != UINT32_MAX)
+        continue;
 
-  int64_t endReadingBuffersData = Time::getCurrentTime();
+      glTF::MeshPrimitive& meshPrimitive = gltfMesh.primitives[primitiveIndex];
+      for (uint32_t a = 0; a < meshPrimitive.attributeCount; ++a)
+      {
+        const glTF::Accessor& accessor =
+            gltfScene.accessors[meshPrimitive.attributes[a].accessorIndex];
+        const int bufferView = accessor.bufferView;
+        if (bufferView != glTF::INVALID_INT_VALUE)
+          boundViews[bufferView] = 1;
+      }
+      if (meshPrimitive.indices != glTF::INVALID_INT_VALUE)
+      {
+        const int bufferView = gltfScene.accessors[meshPrimitive.indices].bufferView;
+        if (bufferView != glTF::INVALID_INT_VALUE)
+          boundViews[bufferView] = 1;
+      }
+    }
+  }
 
-  // Load all buffers and initialize them with buffer data
+  // Load the bound buffer views and initialize them with buffer data, the others keep an invalid
+  // handle.
   buffers.init(residentAllocator, gltfScene.bufferViewsCount);
 
   for (uint32_t bufferIndex = 0; bufferIndex < gltfScene.bufferViewsCount; ++bufferIndex)
   {
     glTF::BufferView& buffer = gltfScene.bufferViews[bufferIndex];
 
+    if (!boundViews[bufferIndex])
+    {
+      RendererUtil::BufferResource& unbound = buffers.pushUse();
+      unbound = RendererUtil::BufferResource{};
+      unbound.m_Handle = kInvalidBuffer;
+      continue;
+    }
+
     int offset = buffer.byteOffset;
     if (offset == glTF::INVALID_INT_VALUE)
     {
@@ -210,10 +303,20 @@ void glTFScene::init(
     buffers.push(*br);
   }
 
-  for (uint32_t bufferIndex = 0; bufferIndex < gltfScene.buffersCount; ++bufferIndex)
+  // Embedded data is owned by the glTF scene. Mappings images point in are read by the texture
+  // decodes, they stay until shutdown.
+  for (uint32_t mappingIndex = 0; mappingIndex < bufferMappings.m_Size; ++mappingIndex)
   {
-    void* buffer = buffersData[bufferIndex];
-    residentAllocator->deallocate(buffer);
+    bool holdsImages = false;
+    for (uint32_t imageIndex = 0; imageIndex < gltfScene.imagesCount; ++imageIndex)
+    {
+      const glTF::Image& image = gltfScene.images[imageIndex];
+      holdsImages |= image.bufferView != glTF::INVALID_INT_VALUE &&
+                     gltfScene.bufferViews[image.bufferView].buffer == (int)mappingIndex;
+    }
+
+    if (!holdsImages)
+      fileUnmap(bufferMappings[mappingIndex]);
   }
   buffersData.shutdown();
 
@@ -235,10 +338,10 @@ void glTFScene::init(
       filename,
       Time::deltaSeconds(startSceneLoading, endLoading),
       Time::deltaSeconds(startSceneLoading, endLoadingFile),
-      Time::deltaSeconds(endLoadingFile, endCreatingTextures),
+      Time::deltaSeconds(endReadingBuffersData, endCreatingTextures),
       Time::deltaSeconds(endCreatingTextures, endCreatingSamplers),
-      Time::deltaSeconds(endCreatingSamplers, endReadingBuffersData),
-      Time::deltaSeconds(endReadingBuffersData, endCreatingBuffers));
+      Time::deltaSeconds(endLoadingFile, endReadingBuffersData),
+      Time::deltaSeconds(endCreatingSamplers, endCreatingBuffers));
 }
 //---------------------------------------------------------------------------//
 void glTFScene::shutdown(RendererUtil::Renderer* p_Renderer)
@@ -295,11 +398,19 @@ void glTFScene::shutdown(RendererUtil::Renderer* p_Renderer)
 
   for (uint32_t i = 0; i < buffers.m_Size; ++i)
   {
+    if (buffers[i].m_Handle.index == kInvalidIndex)
+      continue;
+
     p_Renderer->destroyBuffer(&buffers[i]);
   }
 
   meshes.shutdown();
 
+  mega_buffers.shutdown(gpu);
+  meshFirstPrimitive.shutdown();
+  primitiveMegaFirstVertex.shutdown();
+  primitiveMegaFirstIndex.shutdown();
+
   namesBuffer.shutdown();
 
   // Free scene buffers
@@ -307,6 +418,12 @@ void glTFScene::shutdown(RendererUtil::Renderer* p_Renderer)
   images.shutdown();
   buffers.shutdown();
 
+  for (uint32_t i = 0; i < bufferMappings.m_Size; ++i)
+  {
+    fileUnmap(bufferMappings[i]);
+  }
+  bufferMappings.shutdown();
+
   // NOTE: we can't destroy this sooner as textures and buffers
   // hold a pointer to the names stored here
   gltfFree(gltfScene);
@@ -535,13 +652,24 @@ void glTFScene::prepareDraws(
               ? VK_INDEX_TYPE_UINT16
               : VK_INDEX_TYPE_UINT32;
 
-      glTF::BufferView& indicesBufferView = gltfScene.bufferViews[indicesAccessor.bufferView];
-      RendererUtil::BufferResource& indicesBufferGpu = buffers[indicesBufferView.buffer];
+      // Views have their own buffers, the accessor offset is relative to the view.
+      RendererUtil::BufferResource& indicesBufferGpu = buffers[indicesAccessor.bufferView];
       mesh.indexBuffer = indicesBufferGpu.m_Handle;
-      mesh.indexOffset =
-          glTF::getDataOffset(indicesAccessor.byteOffset, indicesBufferView.byteOffset);
+      mesh.indexOffset = glTF::getDataOffset(indicesAccessor.byteOffset, 0);
       mesh.primitiveCount = indicesAccessor.count;
 
+      // Static primitives in the mega buffers are drawn from them, indirectly or one by one.
+      if (!mesh.hasSkinning())
+      {
+        const uint32_t flatPrimitiveIndex = meshFirstPrimitive[node.mesh] + primitive_index;
+        mesh.mega_first_vertex = primitiveMegaFirstVertex[flatPrimitiveIndex];
+        mesh.mega_first_index = primitiveMegaFirstIndex[flatPrimitiveIndex];
+        if (mesh.hasMegaGeometry())
+        {
+          mega_buffers.bind_mesh(mesh);
+        }
+      }
+
       // Read pbr material data
       if (meshPrimitive.material != glTF::INVALID_INT_VALUE)
       {
@@ -589,6 +717,113 @@ void glTFScene::prepareDraws(
   p_ScratchAllocator->freeMarker(cachedScratchSize);
 }
 
+//---------------------------------------------------------------------------//
+void glTFScene::packMegaBuffers(
+    const Array<void*>& buffersData, Framework::Allocator* residentAllocator)
+{
+  static const char* kStreamAttributes[MeshStream::kCount] = {
+      "POSITION", "TANGENT", "NORMAL", "TEXCOORD_0"};
+  static const uint32_t kStreamElementSizes[MeshStream::kCount] = {12, 16, 12, 8};
+
+  uint32_t primitiveCount = 0;
+  meshFirstPrimitive.init(residentAllocator, gltfScene.meshesCount);
+  for (uint32_t meshIndex = 0; meshIndex < gltfScene.meshesCount; ++meshIndex)
+  {
+    meshFirstPrimitive.push(primitiveCount);
+    primitiveCount += gltfScene.meshes[meshIndex].primitivesCount;
+  }
+  primitiveMegaFirstVertex.init(residentAllocator, primitiveCount, primitiveCount);
+  primitiveMegaFirstIndex.init(residentAllocator, primitiveCount, primitiveCount);
+
+  mega_buffers.init(residentAllocator, FRAMEWORK_KILO(64), FRAMEWORK_KILO(256));
+
+  for (uint32_t meshIndex = 0; meshIndex < gltfScene.meshesCount; ++meshIndex)
+  {
+    glTF::Mesh& gltfMesh = gltfScene.meshes[meshIndex];
+
+    for (uint32_t primitiveIndex = 0; primitiveIndex < gltfMesh.primitivesCount;
+         ++primitiveIndex)
+    {
+      const uint32_t flatPrimitiveIndex = meshFirstPrimitive[meshIndex] + primitiveIndex;
+      primitiveMegaFirstVertex[flatPrimitiveIndex] = UINT32_MAX;
+      primitiveMegaFirstIndex[flatPrimitiveIndex] = 0;
+
+      glTF::MeshPrimitive& meshPrimitive = gltfMesh.primitives[primitiveIndex];
+      if (meshPrimitive.indices == glTF::INVALID_INT_VALUE)
+      {
+        continue;
+      }
+
+      // Skinned primitives keep their own buffers, they are drawn with the skinning pipelines.
+      if (gltfGetAttributeAccessorIndex(
+              meshPrimitive.attributes, meshPrimitive.attributeCount, "JOINTS_0") != -1)
+      {
+        continue;
+      }
+
+      // Only float attributes are packed, quantized ones would need converting.
+      MeshStreamSource sources[MeshStream::kCount];
+      int vertexCount = -1;
+      bool packable = true;
+      for (uint32_t s = 0; s < MeshStream::kCount && packable; ++s)
+      {
+        const int accessorIndex = gltfGetAttributeAccessorIndex(
+            meshPrimitive.attributes, meshPrimitive.attributeCount, kStreamAttributes[s]);
+        if (accessorIndex == -1)
+        {
+          packable = s != MeshStream::kPosition;
+          continue;
+        }
+
+        glTF::Accessor& accessor = gltfScene.accessors[accessorIndex];
+        if (accessor.componentType != glTF::Accessor::ComponentType::FLOAT ||
+            accessor.bufferView == glTF::INVALID_INT_VALUE ||
+            (vertexCount != -1 && accessor.count != vertexCount))
+        {
+          packable = false;
+          continue;
+        }
+        vertexCount = accessor.count;
+
+        glTF::BufferView& bufferView = gltfScene.bufferViews[accessor.bufferView];
+        sources[s].data = (uint8_t*)buffersData[bufferView.buffer] +
+                          glTF::getDataOffset(accessor.byteOffset, bufferView.byteOffset);
+        sources[s].element_size = kStreamElementSizes[s];
+        sources[s].stride = bufferView.byteStride != glTF::INVALID_INT_VALUE
+                                ? bufferView.byteStride
+                                : kStreamElementSizes[s];
+      }
+
+      glTF::Accessor& indicesAccessor = gltfScene.accessors[meshPrimitive.indices];
+      if (!packable || indicesAccessor.bufferView == glTF::INVALID_INT_VALUE ||
+          (indicesAccessor.componentType != glTF::Accessor::ComponentType::UNSIGNED_SHORT &&
+           indicesAccessor.componentType != glTF::Accessor::ComponentType::UNSIGNED_INT))
+      {
+        continue;
+      }
+
+      glTF::BufferView& indicesBufferView = gltfScene.bufferViews[indicesAccessor.bufferView];
+      const uint8_t* indices =
+          (uint8_t*)buffersData[indicesBufferView.buffer] +
+          glTF::getDataOffset(indicesAccessor.byteOffset, indicesBufferView.byteOffset);
+      const VkIndexType indexType =
+          (indicesAccessor.componentType == glTF::Accessor::ComponentType::UNSIGNED_SHORT)
+              ? VK_INDEX_TYPE_UINT16
+              : VK_INDEX_TYPE_UINT32;
+
+      mega_buffers.add_mesh(
+          sources,
+          vertexCount,
+          indices,
+          indexType,
+          indicesAccessor.count,
+          primitiveMegaFirstVertex[flatPrimitiveIndex],
+          primitiveMegaFirstIndex[flatPrimitiveIndex]);
+    }
+  }
+
+  mega_buffers.create_gpu_buffers(renderer);
+}
 //---------------------------------------------------------------------------//
 void glTFScene::getMeshVertexBuffer(
     int accessorIndex,
@@ -600,11 +835,11 @@ void glTFScene::getMeshVertexBuffer(
   if (accessorIndex != -1)
   {
     glTF::Accessor& bufferAccessor = gltfScene.accessors[accessorIndex];
-    glTF::BufferView& bufferView = gltfScene.bufferViews[bufferAccessor.bufferView];
     RendererUtil::BufferResource& bufferGpu = buffers[bufferAccessor.bufferView];
 
+    // Views have their own buffers, the accessor offset is relative to the view.
     outBufferHandle = bufferGpu.m_Handle;
-    outBufferOffset = glTF::getDataOffset(bufferAccessor.byteOffset, bufferView.byteOffset);
+    outBufferOffset = glTF::getDataOffset(bufferAccessor.byteOffset, 0);
 
     outFlags |= flag;
   }
@@ -28,6 +28,10 @@ struct glTFScene : public RenderScene
       Framework::StackAllocator* scratchAllocator,
       SceneGraph* sceneGraph) override;
 
+  // Packs the static primitives in the mega buffers, from the loaded buffer data.
+  void packMegaBuffers(
+      const Framework::Array<void*>& buffersData, Framework::Allocator* residentAllocator);
+
   void getMeshVertexBuffer(
       int accessorIndex,
       uint32_t flag,
@@ -48,6 +52,13 @@ struct glTFScene : public RenderScene
   Framework::Array<RendererUtil::BufferResource> buffers;
 
   Framework::glTF::glTF gltfScene; // Source gltf scene
+  // Mappings of the external buffers, per buffer. Only the ones images point in stay mapped.
+  Framework::Array<Framework::FileMapping> bufferMappings;
+
+  // Mega buffer location of each primitive, UINT32_MAX when not packed.
+  Framework::Array<uint32_t> meshFirstPrimitive;
+  Framework::Array<uint32_t> primitiveMegaFirstVertex;
+  Framework::Array<uint32_t> primitiveMegaFirstIndex;
 };
 //---------------------------------------------------------------------------//
 } // namespace Graphics
@@ -9,8 +9,12 @@
 #include "Foundation/String.hpp"
 #include "Foundation/File.hpp"
 #include "Foundation/Process.hpp"
+#include "Foundation/Time.hpp"
+
+#include "Externals/enkiTS/TaskScheduler.h"
 
 #include <assert.h>
+#include <atomic>
 
 template <class T> constexpr const T& _min(const T& a, const T& b) { return (a < b) ? a : b; }
 
@@ -54,6 +58,35 @@ DeviceCreation& DeviceCreation::setNumThreads(uint32_t p_NumThreads)
   numThreads = p_NumThreads;
   return *this;
 }
+DeviceCreation& DeviceCreation::setShaderCache(bool p_Enable, size_t p_MaxSize)
+{
+  enableShaderCache = p_Enable;
+  shaderCacheMaxSize = p_MaxSize;
+  return *this;
+}
+DeviceCreation& DeviceCreation::setOptimizeShaders(bool p_Optimize)
+{
+  optimizeShaders = p_Optimize;
+  return *this;
+}
+//---------------------------------------------------------------------------//
+// Hash of the compiler and optimizer version strings, so that an SDK upgrade misses the cache.
+static uint64_t _hashShaderCompilerVersion(const char* p_BinariesPath)
+{
+  char path[512];
+  sprintf(path, "%sglslangValidator.exe", p_BinariesPath);
+  Framework::processExecute(".", path, "glslangValidator.exe --version", "");
+  const char* output = Framework::processGetOutput();
+  uint64_t hash = Framework::hashBytes((void*)output, strlen(output));
+
+  sprintf(path, "%sspirv-opt.exe", p_BinariesPath);
+  Framework::processExecute(".", path, "spirv-opt.exe --version", "");
+  output = Framework::processGetOutput();
+  hash = Framework::hashBytes((void*)output, strlen(output), hash);
+
+  // No output means the tools could not be run, fall back to their location.
+  return hash ? hash : Framework::hashBytes((void*)p_BinariesPath, strlen(p_BinariesPath));
+}
 //---------------------------------------------------------------------------//
 // Debug helpers:
 //---------------------------------------------------------------------------//
@@ -121,7 +154,9 @@ static SDL_Window* g_SdlWindow;
 
 static const uint32_t kBindlessTextureBinding = 10u;
 static const uint32_t kBindlessImageBinding = 11u;
-static const uint32_t kMaxBindlessResources = 1024u;
+static const size_t kFrameArenaSize = 1024 * 1024;
+// Command buffers submitted by a single present, e.g. one per range of recorded frame graph nodes.
+static const uint32_t kMaxQueuedCommandBuffers = 16u;
 
 static VkPresentModeKHR _toVkPresentMode(PresentMode::Enum p_Mode)
 {
@@ -395,6 +430,45 @@ static VkRenderPass _vulkanCreateRenderPass(
   return vkRenderPass;
 }
 //---------------------------------------------------------------------------//
+static void _fillImageCreateInfo(const TextureCreation& p_Creation, VkImageCreateInfo& p_ImageInfo)
+{
+  p_ImageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  p_ImageInfo.format = p_Creation.format;
+  p_ImageInfo.flags = 0;
+  p_ImageInfo.imageType = toVkImageType(p_Creation.type);
+  p_ImageInfo.extent.width = p_Creation.width;
+  p_ImageInfo.extent.height = p_Creation.height;
+  p_ImageInfo.extent.depth = p_Creation.depth;
+  p_ImageInfo.mipLevels = p_Creation.mipmaps;
+  p_ImageInfo.arrayLayers = 1;
+  p_ImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  p_ImageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+
+  const bool isRenderTarget =
+      (p_Creation.flags & TextureFlags::kRenderTargetMask) == TextureFlags::kRenderTargetMask;
+  const bool isComputeUsed =
+      (p_Creation.flags & TextureFlags::kComputeMask) == TextureFlags::kComputeMask;
+
+  // Default to always readable from shader.
+  p_ImageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+  p_ImageInfo.usage |= isComputeUsed ? VK_IMAGE_USAGE_STORAGE_BIT : 0;
+
+  if (TextureFormat::hasDepthOrStencil(p_Creation.format))
+  {
+    // Depth/Stencil textures are normally textures you render into.
+    p_ImageInfo.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  }
+  else
+  {
+    p_ImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    p_ImageInfo.usage |= isRenderTarget ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT : 0;
+  }
+
+  p_ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  p_ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+//---------------------------------------------------------------------------//
 static void _vulkanCreateTexture(
     GpuDevice& p_GpuDevice,
     const TextureCreation& p_Creation,
@@ -415,52 +489,38 @@ static void _vulkanCreateTexture(
   p_Texture->handle = p_Handle;
 
   // Create the image
-  VkImageCreateInfo imageInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
-  imageInfo.format = p_Texture->vkFormat;
-  imageInfo.flags = 0;
-  imageInfo.imageType = toVkImageType(p_Creation.type);
-  imageInfo.extent.width = p_Creation.width;
-  imageInfo.extent.height = p_Creation.height;
-  imageInfo.extent.depth = p_Creation.depth;
-  imageInfo.mipLevels = p_Creation.mipmaps;
-  imageInfo.arrayLayers = 1;
-  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-
-  const bool isRenderTarget =
-      (p_Creation.flags & TextureFlags::kRenderTargetMask) == TextureFlags::kRenderTargetMask;
-  const bool isComputeUsed =
-      (p_Creation.flags & TextureFlags::kComputeMask) == TextureFlags::kComputeMask;
-
-  // Default to always readable from shader.
-  imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-
-  imageInfo.usage |= isComputeUsed ? VK_IMAGE_USAGE_STORAGE_BIT : 0;
-
-  if (TextureFormat::hasDepthOrStencil(p_Creation.format))
-  {
-    // Depth/Stencil textures are normally textures you render into.
-    imageInfo.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  VkImageCreateInfo imageInfo;
+  _fillImageCreateInfo(p_Creation, imageInfo);
+
+  if (p_Creation.aliasMemory)
+  {
+    // Aliased textures don't own their memory, see destroyTextureInstant.
+    CHECKRES(vkCreateImage(
+        p_GpuDevice.m_VulkanDevice,
+        &imageInfo,
+        p_GpuDevice.m_VulkanAllocCallbacks,
+        &p_Texture->vkImage));
+    CHECKRES(vmaBindImageMemory2(
+        p_GpuDevice.m_VmaAllocator,
+        p_Creation.aliasMemory,
+        p_Creation.aliasOffset,
+        p_Texture->vkImage,
+        nullptr));
+    p_Texture->vmaAllocation = nullptr;
   }
   else
   {
-    imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    imageInfo.usage |= isRenderTarget ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT : 0;
-  }
-
-  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-  VmaAllocationCreateInfo memoryCi{};
-  memoryCi.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VmaAllocationCreateInfo memoryCi{};
+    memoryCi.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-  CHECKRES(vmaCreateImage(
-      p_GpuDevice.m_VmaAllocator,
-      &imageInfo,
-      &memoryCi,
-      &p_Texture->vkImage,
-      &p_Texture->vmaAllocation,
-      nullptr));
+    CHECKRES(vmaCreateImage(
+        p_GpuDevice.m_VmaAllocator,
+        &imageInfo,
+        &memoryCi,
+        &p_Texture->vkImage,
+        &p_Texture->vmaAllocation,
+        nullptr));
+  }
 
   p_GpuDevice.setResourceName(VK_OBJECT_TYPE_IMAGE, (uint64_t)p_Texture->vkImage, p_Creation.name);
 
@@ -501,6 +561,8 @@ static void _vulkanCreateTexture(
     resourceUpdate.handle = p_Texture->handle.index;
     resourceUpdate.currentFrame = p_GpuDevice.m_CurrentFrameIndex;
     resourceUpdate.deleting = 0;
+
+    std::lock_guard<std::mutex> guard(p_GpuDevice.m_ResourceUpdateMutex);
     p_GpuDevice.m_TextureToUpdateBindless.push(resourceUpdate);
   }
 }
@@ -786,8 +848,7 @@ void GpuDevice::fillWriteDescriptorSets(
     case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: {
       p_DescriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 
-      TextureHandle textureHandle = {p_Resources[r]};
-      Texture* textureData = (Texture*)p_Gpu.m_Textures.accessResource(textureHandle.index);
+      Texture* textureData = (Texture*)p_Gpu.m_Textures.accessResource(p_Resources[r]);
 
       // Find proper sampler.
       // TODO: improve. Remove the single texture interface ?
@@ -817,8 +878,7 @@ void GpuDevice::fillWriteDescriptorSets(
     case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: {
       p_DescriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 
-      TextureHandle textureHandle = {p_Resources[r]};
-      Texture* textureData = (Texture*)p_Gpu.m_Textures.accessResource(textureHandle.index);
+      Texture* textureData = (Texture*)p_Gpu.m_Textures.accessResource(p_Resources[r]);
 
       p_ImageInfo[i].sampler = nullptr;
       p_ImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -830,8 +890,7 @@ void GpuDevice::fillWriteDescriptorSets(
     }
 
     case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: {
-      BufferHandle bufferHandle = {p_Resources[r]};
-      Buffer* buffer = (Buffer*)p_Gpu.m_Buffers.accessResource(bufferHandle.index);
+      Buffer* buffer = (Buffer*)p_Gpu.m_Buffers.accessResource(p_Resources[r]);
 
       p_DescriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
       p_DescriptorWrite[i].descriptorType = buffer->usage == ResourceUsageType::kDynamic
@@ -859,8 +918,7 @@ void GpuDevice::fillWriteDescriptorSets(
     }
 
     case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: {
-      BufferHandle bufferHandle = {p_Resources[r]};
-      Buffer* buffer = (Buffer*)p_Gpu.m_Buffers.accessResource(bufferHandle.index);
+      Buffer* buffer = (Buffer*)p_Gpu.m_Buffers.accessResource(p_Resources[r]);
 
       p_DescriptorWrite[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
       // Bind parent buffer if present, used for dynamic resources.
@@ -1047,6 +1105,12 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
           m_Synchronization2ExtensionPresent = true;
           continue;
         }
+
+        if (!strcmp(extensions[i].extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+        {
+          m_DrawIndirectCountExtensionPresent = true;
+          continue;
+        }
       }
 
       tempAllocator->freeMarker(initialTempAllocatorMarker);
@@ -1155,6 +1219,11 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
       deviceExtensions.push(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
     }
 
+    if (m_DrawIndirectCountExtensionPresent)
+    {
+      deviceExtensions.push(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
     const float queuePriority[] = {1.0f, 1.0f};
     VkDeviceQueueCreateInfo queueInfo[3] = {};
     uint32_t queueCount = 0;
@@ -1226,6 +1295,10 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
 
     assert(vulkan11Features.shaderDrawParameters == VK_TRUE);
 
+    m_MultiDrawIndirectSupported = physicalFeatures2.features.multiDrawIndirect == VK_TRUE;
+    m_DrawIndirectFirstInstanceSupported =
+        physicalFeatures2.features.drawIndirectFirstInstance == VK_TRUE;
+
     VkDeviceCreateInfo deviceCi = {};
     deviceCi.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCi.queueCreateInfoCount = queueCount;
@@ -1265,6 +1338,12 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
           m_VulkanDevice, "vkCmdPipelineBarrier2KHR");
     }
 
+    if (m_DrawIndirectCountExtensionPresent)
+    {
+      m_CmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+          m_VulkanDevice, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+
     vkGetDeviceQueue(m_VulkanDevice, mainQueueFamilyIndex, 0, &m_VulkanMainQueue);
 
     vkGetDeviceQueue(
@@ -1418,6 +1497,8 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
   const uint32_t numPools = p_Creation.numThreads * kMaxFrames;
   m_NumThreads = p_Creation.numThreads;
   m_ThreadFramePools.init(m_Allocator, numPools, numPools);
+  // One more arena for the compute pools, which can record while the threads do.
+  m_FrameArenas.init(m_Allocator, m_NumThreads + 1, kMaxFrames, kFrameArenaSize);
 
   // Create compute command pools and command buffers
   m_ComputeFramePools.init(m_Allocator, kMaxFrames, kMaxFrames);
@@ -1425,6 +1506,7 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
   for (uint32_t i = 0; i < m_ThreadFramePools.m_Size; ++i)
   {
     GpuThreadFramePools& pool = m_ThreadFramePools[i];
+    pool.frameArena = m_FrameArenas.get(i % m_NumThreads, i / m_NumThreads);
 
     // Create command buffer pool.
     VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr};
@@ -1438,6 +1520,7 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
   for (uint32_t i = 0; i < m_ComputeFramePools.m_Size; ++i)
   {
     GpuThreadFramePools& pool = m_ComputeFramePools[i];
+    pool.frameArena = m_FrameArenas.get(m_NumThreads, i);
 
     VkCommandPoolCreateInfo cmdPoolInfo = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr};
     cmdPoolInfo.queueFamilyIndex = m_VulkanComputeQueueFamily;
@@ -1448,16 +1531,24 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
   }
 
   // Init pools
-  m_Buffers.init(m_Allocator, kBuffersPoolSize, sizeof(Buffer));
-  m_Textures.init(m_Allocator, kTexturesPoolSize, sizeof(Texture));
-  m_RenderPasses.init(m_Allocator, kRenderPassesPoolSize, sizeof(RenderPass));
-  m_Framebuffers.init(m_Allocator, 256, sizeof(RenderPass));
-  m_DescriptorSetLayouts.init(
-      m_Allocator, kDescriptorSetLayoutsPoolSize, sizeof(DescriptorSetLayout));
-  m_Pipelines.init(m_Allocator, kPipelinesPoolSize, sizeof(Pipeline));
-  m_Shaders.init(m_Allocator, kShadersPoolSize, sizeof(ShaderState));
-  m_DescriptorSets.init(m_Allocator, kDescriptorSetsPoolSize, sizeof(DescriptorSet));
-  m_Samplers.init(m_Allocator, kSamplersPoolSize, sizeof(Sampler));
+  m_Buffers.initGrowable(m_Allocator, kResourcePoolPageSize, sizeof(Buffer), kBuffersPoolSize);
+  m_Textures.initGrowable(
+      m_Allocator, kResourcePoolPageSize, sizeof(Texture), kTexturesPoolSize);
+  m_RenderPasses.initGrowable(
+      m_Allocator, kResourcePoolPageSize, sizeof(RenderPass), kRenderPassesPoolSize);
+  m_Framebuffers.initGrowable(
+      m_Allocator, kResourcePoolPageSize, sizeof(Framebuffer), kFramebuffersPoolSize);
+  m_DescriptorSetLayouts.initGrowable(
+      m_Allocator,
+      kResourcePoolPageSize,
+      sizeof(DescriptorSetLayout),
+      kDescriptorSetLayoutsPoolSize);
+  m_Pipelines.initGrowable(
+      m_Allocator, kResourcePoolPageSize, sizeof(Pipeline), kPipelinesPoolSize);
+  m_Shaders.initGrowable(m_Allocator, kResourcePoolPageSize, sizeof(ShaderState), kShadersPoolSize);
+  m_DescriptorSets.initGrowable(
+      m_Allocator, kResourcePoolPageSize, sizeof(DescriptorSet), kDescriptorSetsPoolSize);
+  m_Samplers.initGrowable(m_Allocator, kResourcePoolPageSize, sizeof(Sampler), kSamplersPoolSize);
 
   // Create synchronization objects
   VkSemaphoreCreateInfo semaphoreCi{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
@@ -1518,6 +1609,7 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
 
   // Init resource deletion queue and descriptor set updates
   m_ResourceDeletionQueue.init(m_Allocator, 16);
+  m_MemoryReleaseQueue.init(m_Allocator, 16);
   m_DescriptorSetUpdates.init(m_Allocator, 16);
   m_TextureToUpdateBindless.init(m_Allocator, 16);
 
@@ -1618,13 +1710,65 @@ void GpuDevice::init(const DeviceCreation& p_Creation)
 
   // Cache working directory
   Framework::directoryCurrent(&m_Cwd);
+
+  // SPIR-V cache setup
+  m_ShaderCacheEnabled = p_Creation.enableShaderCache;
+  m_ShaderCacheMaxSize = p_Creation.shaderCacheMaxSize;
+  m_OptimizeShaders = p_Creation.optimizeShaders;
+  m_ShaderCacheStats = {};
+  m_ShaderCompilerHash =
+      m_ShaderCacheEnabled ? _hashShaderCompilerVersion(m_VulkanBinariesPath) : 0;
+  sprintf(m_ShaderCachePath, "%s%sCache\\", m_Cwd.path, SHADER_FOLDER);
+  if (m_ShaderCacheEnabled)
+  {
+    if (!Framework::directoryExists(m_ShaderCachePath))
+    {
+      Framework::directoryCreate(m_ShaderCachePath);
+    }
+    trimShaderCache();
+  }
+
+  // Compile timings are taken with the time service, make sure frequency is cached.
+  Framework::Time::serviceInit();
+
+  // Device pipeline cache setup
+  sprintf(m_PipelineCachePath, "%s%sPipelineCache.bin", m_Cwd.path, SHADER_FOLDER);
+  m_VulkanPipelineCache = loadPipelineCache(m_PipelineCachePath);
+
+  // Fold caches written per pipeline by older builds into the device cache.
+  {
+    char searchPattern[512];
+    sprintf(searchPattern, "%s%s*.cache", m_Cwd.path, SHADER_FOLDER);
+
+    WIN32_FIND_DATAA findData;
+    HANDLE findHandle = FindFirstFileA(searchPattern, &findData);
+    if (findHandle != INVALID_HANDLE_VALUE)
+    {
+      do
+      {
+        char legacyPath[512];
+        sprintf(legacyPath, "%s%s%s", m_Cwd.path, SHADER_FOLDER, findData.cFileName);
+
+        VkPipelineCache legacyCache = loadPipelineCache(legacyPath);
+        mergePipelineCaches(&legacyCache, 1);
+        vkDestroyPipelineCache(m_VulkanDevice, legacyCache, m_VulkanAllocCallbacks);
+
+        Framework::fileDelete(legacyPath);
+      } while (FindNextFileA(findHandle, &findData));
+      FindClose(findHandle);
+    }
+  }
 }
 //---------------------------------------------------------------------------//
 void GpuDevice::shutdown()
 {
   vkDeviceWaitIdle(m_VulkanDevice);
 
+  savePipelineCache();
+  vkDestroyPipelineCache(m_VulkanDevice, m_VulkanPipelineCache, m_VulkanAllocCallbacks);
+
   g_CmdBufferRing.shutdown();
+  m_FrameArenas.shutdown();
 
   for (size_t i = 0; i < kMaxSwapchainImages; i++)
   {
@@ -1669,6 +1813,11 @@ void GpuDevice::shutdown()
     releaseResource(resourceDeletion);
   }
 
+  for (uint32_t i = 0; i < m_MemoryReleaseQueue.m_Size; i++)
+  {
+    vmaFreeMemory(m_VmaAllocator, m_MemoryReleaseQueue[i].allocation);
+  }
+
   // Destroy render passes from the cache.
   // Swapchain vkRenderPass is also present.
   if (!m_DynamicRenderingExtensionPresent)
@@ -1691,6 +1840,7 @@ void GpuDevice::shutdown()
 
   m_TextureToUpdateBindless.shutdown();
   m_ResourceDeletionQueue.shutdown();
+  m_MemoryReleaseQueue.shutdown();
   m_DescriptorSetUpdates.shutdown();
 
   m_Buffers.shutdown();
@@ -1761,6 +1911,7 @@ void GpuDevice::newFrame()
 
   // Command pool reset
   g_CmdBufferRing.resetPools(m_CurrentFrameIndex);
+  m_FrameArenas.resetFrame(m_CurrentFrameIndex);
   // Dynamic memory update
   const uint32_t usedSize = m_DynamicAllocatedSize - (m_DynamicPerFrameSize * m_PreviousFrameIndex);
   m_DynamicMaxPerFrameSize = _max(usedSize, m_DynamicMaxPerFrameSize);
@@ -1808,7 +1959,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
   VkSemaphore* renderCompleteSemaphore = &m_VulkanRenderCompleteSemaphore[m_CurrentFrameIndex];
 
   // Copy all commands
-  VkCommandBuffer enqueuedCommandBuffers[4];
+  VkCommandBuffer enqueuedCommandBuffers[kMaxQueuedCommandBuffers];
   for (uint32_t c = 0; c < m_NumQueuedCommandBuffers; c++)
   {
     CommandBuffer* commandBuffer = m_QueuedCommandBuffers[c];
@@ -1824,6 +1975,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
   }
 
   // Update bindless descriptor sets:
+  m_ResourceUpdateMutex.lock();
   if (m_TextureToUpdateBindless.m_Size > 0)
   {
     // Handle deferred writes to bindless textures.
@@ -1917,6 +2069,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
           m_VulkanDevice, currentWriteIndex, bindlessDescriptorWrites, 0, nullptr);
     }
   }
+  m_ResourceUpdateMutex.unlock();
 
   // Submit command buffers
   uint32_t waitSemaphoreCount = 1;
@@ -1933,7 +2086,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
 
     if (m_Synchronization2ExtensionPresent)
     {
-      VkCommandBufferSubmitInfoKHR commandBufferInfo[4]{};
+      VkCommandBufferSubmitInfoKHR commandBufferInfo[kMaxQueuedCommandBuffers]{};
       for (uint32_t c = 0; c < m_NumQueuedCommandBuffers; c++)
       {
         commandBufferInfo[c].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
@@ -2031,7 +2184,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
 
     if (m_Synchronization2ExtensionPresent)
     {
-      VkCommandBufferSubmitInfoKHR commandBufferInfo[4]{};
+      VkCommandBufferSubmitInfoKHR commandBufferInfo[kMaxQueuedCommandBuffers]{};
       for (uint32_t c = 0; c < m_NumQueuedCommandBuffers; c++)
       {
         commandBufferInfo[c].sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
@@ -2125,6 +2278,7 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
   frameCountersAdvance();
 
   // Resource deletion using reverse iteration and swap with last element.
+  std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
   if (m_ResourceDeletionQueue.m_Size > 0)
   {
     for (int i = m_ResourceDeletionQueue.m_Size - 1; i >= 0; i--)
@@ -2144,17 +2298,29 @@ void GpuDevice::present(CommandBuffer* p_AsyncComputeCommandBuffer)
       }
     }
   }
+
+  // Memory goes after the resources bound to it.
+  for (int i = m_MemoryReleaseQueue.m_Size - 1; i >= 0; i--)
+  {
+    if (m_MemoryReleaseQueue[i].currentFrame == m_CurrentFrameIndex)
+    {
+      vmaFreeMemory(m_VmaAllocator, m_MemoryReleaseQueue[i].allocation);
+      m_MemoryReleaseQueue.deleteSwap(i);
+    }
+  }
 }
 //---------------------------------------------------------------------------//
 // Creation/Destruction of resources
 //---------------------------------------------------------------------------//
 BufferHandle GpuDevice::createBuffer(const BufferCreation& p_Creation)
 {
-  BufferHandle handle = {m_Buffers.obtainResource()};
-  if (handle.index == kInvalidIndex)
+  const uint32_t resourceIndex = m_Buffers.obtainResource();
+  BufferHandle handle = {resourceIndex, 0};
+  if (resourceIndex == kInvalidIndex)
   {
     return handle;
   }
+  handle.generation = m_Buffers.getHandle(resourceIndex).generation;
 
   Buffer* buffer = (Buffer*)m_Buffers.accessResource(handle.index);
 
@@ -2230,11 +2396,12 @@ BufferHandle GpuDevice::createBuffer(const BufferCreation& p_Creation)
 TextureHandle GpuDevice::createTexture(const TextureCreation& p_Creation)
 {
   uint32_t resourceIndex = m_Textures.obtainResource();
-  TextureHandle handle = {resourceIndex};
+  TextureHandle handle = {resourceIndex, 0};
   if (resourceIndex == kInvalidIndex)
   {
     return handle;
   }
+  handle.generation = m_Textures.getHandle(resourceIndex).generation;
 
   Texture* texture = (Texture*)m_Textures.accessResource(handle.index);
 
@@ -2249,55 +2416,45 @@ TextureHandle GpuDevice::createTexture(const TextureCreation& p_Creation)
   return handle;
 }
 //---------------------------------------------------------------------------//
-PipelineHandle
-GpuDevice::createPipeline(const PipelineCreation& p_Creation, const char* p_CachePath)
+void GpuDevice::getTextureMemoryRequirements(
+    const TextureCreation& p_Creation, VkMemoryRequirements& p_Requirements)
+{
+  // Requirements depend on the driver's image layout, so create a temporary unbound image.
+  VkImageCreateInfo imageInfo;
+  _fillImageCreateInfo(p_Creation, imageInfo);
+
+  VkImage image;
+  CHECKRES(vkCreateImage(m_VulkanDevice, &imageInfo, m_VulkanAllocCallbacks, &image));
+  vkGetImageMemoryRequirements(m_VulkanDevice, image, &p_Requirements);
+  vkDestroyImage(m_VulkanDevice, image, m_VulkanAllocCallbacks);
+}
+//---------------------------------------------------------------------------//
+VmaAllocation GpuDevice::allocateMemory(const VkMemoryRequirements& p_Requirements)
+{
+  VmaAllocationCreateInfo memoryCi{};
+  memoryCi.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  VmaAllocation allocation = nullptr;
+  CHECKRES(vmaAllocateMemory(m_VmaAllocator, &p_Requirements, &memoryCi, &allocation, nullptr));
+  return allocation;
+}
+//---------------------------------------------------------------------------//
+void GpuDevice::freeMemory(VmaAllocation p_Allocation)
+{
+  std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
+  m_MemoryReleaseQueue.push({p_Allocation, m_CurrentFrameIndex});
+}
+//---------------------------------------------------------------------------//
+PipelineHandle GpuDevice::createPipeline(const PipelineCreation& p_Creation)
 {
+  std::unique_lock<std::recursive_mutex> lock(m_PipelineCreationMutex);
+
   PipelineHandle handle = {m_Pipelines.obtainResource()};
   if (handle.index == kInvalidIndex)
   {
     return handle;
   }
 
-  // Set up pipeline cache
-  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
-  bool cacheExists = Framework::fileExists(p_CachePath);
-  {
-    VkPipelineCacheCreateInfo pipelineCacheCi{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
-
-    if (p_CachePath != nullptr && cacheExists)
-    {
-      Framework::FileReadResult readResult = Framework::fileReadBinary(p_CachePath, m_Allocator);
-
-      VkPipelineCacheHeaderVersionOne* cacheHeader =
-          (VkPipelineCacheHeaderVersionOne*)readResult.data;
-
-      if (cacheHeader->deviceID == m_VulkanPhysicalDeviceProps.deviceID &&
-          cacheHeader->vendorID == m_VulkanPhysicalDeviceProps.vendorID &&
-          memcmp(
-              cacheHeader->pipelineCacheUUID,
-              m_VulkanPhysicalDeviceProps.pipelineCacheUUID,
-              VK_UUID_SIZE) == 0)
-      {
-        pipelineCacheCi.initialDataSize = readResult.size;
-        pipelineCacheCi.pInitialData = readResult.data;
-      }
-      else
-      {
-        cacheExists = false;
-      }
-
-      CHECKRES(vkCreatePipelineCache(
-          m_VulkanDevice, &pipelineCacheCi, m_VulkanAllocCallbacks, &pipelineCache));
-
-      m_Allocator->deallocate(readResult.data);
-    }
-    else
-    {
-      CHECKRES(vkCreatePipelineCache(
-          m_VulkanDevice, &pipelineCacheCi, m_VulkanAllocCallbacks, &pipelineCache));
-    }
-  }
-
   ShaderStateHandle shaderState = createShaderState(p_Creation.shaders);
   if (shaderState.index == kInvalidIndex)
   {
@@ -2586,9 +2743,12 @@ GpuDevice::createPipeline(const PipelineCreation& p_Creation, const char* p_Cach
 
     pipelineCi.pDynamicState = &dynamicStateCi;
 
+    lock.unlock();
+
+    std::shared_lock<std::shared_timed_mutex> cacheLock(m_PipelineCacheMutex);
     CHECKRES(vkCreateGraphicsPipelines(
         m_VulkanDevice,
-        pipelineCache,
+        m_VulkanPipelineCache,
         1,
         &pipelineCi,
         m_VulkanAllocCallbacks,
@@ -2603,9 +2763,12 @@ GpuDevice::createPipeline(const PipelineCreation& p_Creation, const char* p_Cach
     pipelineCi.stage = shaderStateData->shaderStageInfo[0];
     pipelineCi.layout = pipelineLayout;
 
+    lock.unlock();
+
+    std::shared_lock<std::shared_timed_mutex> cacheLock(m_PipelineCacheMutex);
     CHECKRES(vkCreateComputePipelines(
         m_VulkanDevice,
-        pipelineCache,
+        m_VulkanPipelineCache,
         1,
         &pipelineCi,
         m_VulkanAllocCallbacks,
@@ -2614,21 +2777,6 @@ GpuDevice::createPipeline(const PipelineCreation& p_Creation, const char* p_Cach
     pipeline->vkBindPoint = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE;
   }
 
-  if (p_CachePath != nullptr && !cacheExists)
-  {
-    size_t cacheDataSize = 0;
-    CHECKRES(vkGetPipelineCacheData(m_VulkanDevice, pipelineCache, &cacheDataSize, nullptr));
-
-    void* cacheData = m_Allocator->allocate(cacheDataSize, 64);
-    CHECKRES(vkGetPipelineCacheData(m_VulkanDevice, pipelineCache, &cacheDataSize, cacheData));
-
-    Framework::fileWriteBinary(p_CachePath, cacheData, cacheDataSize);
-
-    m_Allocator->deallocate(cacheData);
-  }
-
-  vkDestroyPipelineCache(m_VulkanDevice, pipelineCache, m_VulkanAllocCallbacks);
-
   return handle;
 }
 //---------------------------------------------------------------------------//
@@ -2674,6 +2822,8 @@ SamplerHandle GpuDevice::createSampler(const SamplerCreation& p_Creation)
 DescriptorSetLayoutHandle
 GpuDevice::createDescriptorSetLayout(const DescriptorSetLayoutCreation& p_Creation)
 {
+  std::lock_guard<std::recursive_mutex> guard(m_PipelineCreationMutex);
+
   DescriptorSetLayoutHandle handle = {m_DescriptorSetLayouts.obtainResource()};
   if (handle.index == kInvalidIndex)
   {
@@ -2946,6 +3096,8 @@ ShaderStateHandle GpuDevice::createShaderState(const ShaderStateCreation& p_Crea
     return handle;
   }
 
+  std::lock_guard<std::recursive_mutex> guard(m_PipelineCreationMutex);
+
   handle.index = m_Shaders.obtainResource();
   if (handle.index == kInvalidIndex)
   {
@@ -2959,10 +3111,10 @@ ShaderStateHandle GpuDevice::createShaderState(const ShaderStateCreation& p_Crea
   shaderState->graphicsPipeline = true;
   shaderState->activeShaders = 0;
 
-  size_t currentTemporaryMarker = m_TemporaryAllocator->getMarker();
-
+  // Use the heap for reflection names, the temporary allocator is not safe to use from the
+  // task threads that build pipelines.
   Framework::StringBuffer nameBuffer;
-  nameBuffer.init(4096, m_TemporaryAllocator);
+  nameBuffer.init(4096, m_Allocator);
 
   // Parse result needs to be always in memory as its used to free descriptor sets.
   shaderState->parseResult =
@@ -2992,6 +3144,12 @@ ShaderStateHandle GpuDevice::createShaderState(const ShaderStateCreation& p_Crea
       shaderCi = compileShader(stage.code, stage.codeSize, stage.type, p_Creation.name);
     }
 
+    // Compilation failed, or a batch compile left the stage without code.
+    if (shaderCi.pCode == nullptr || shaderCi.codeSize == 0)
+    {
+      break;
+    }
+
     // Compile shader module
     VkPipelineShaderStageCreateInfo& shaderStageCi = shaderState->shaderStageInfo[compiledShaders];
     memset(&shaderStageCi, 0, sizeof(VkPipelineShaderStageCreateInfo));
@@ -3011,18 +3169,13 @@ ShaderStateHandle GpuDevice::createShaderState(const ShaderStateCreation& p_Crea
 
     Spirv::parseBinary(shaderCi.pCode, shaderCi.codeSize, nameBuffer, shaderState->parseResult);
 
-    //
-    // Note - temp allocator freed at the end.
-    //
 
     setResourceName(
         VK_OBJECT_TYPE_SHADER_MODULE,
         (uint64_t)shaderState->shaderStageInfo[compiledShaders].module,
         p_Creation.name);
   }
-  // Not needed anymore - temp allocator freed at the end.
-  // nameBuffer.shutdown();
-  m_TemporaryAllocator->freeMarker(currentTemporaryMarker);
+  nameBuffer.shutdown();
 
   bool creationFailed = compiledShaders != p_Creation.stagesCount;
   if (!creationFailed)
@@ -3059,8 +3212,9 @@ ShaderStateHandle GpuDevice::createShaderState(const ShaderStateCreation& p_Crea
 //---------------------------------------------------------------------------//
 void GpuDevice::destroyBuffer(BufferHandle p_Buffer)
 {
-  if (p_Buffer.index < m_Buffers.m_PoolSize)
+  if (p_Buffer.index < m_Buffers.m_PoolSize && isValid(p_Buffer))
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kBuffer, p_Buffer.index, m_CurrentFrameIndex, 1});
   }
@@ -3074,8 +3228,9 @@ void GpuDevice::destroyBuffer(BufferHandle p_Buffer)
 //---------------------------------------------------------------------------//
 void GpuDevice::destroyTexture(TextureHandle p_Texture)
 {
-  if (p_Texture.index < m_Textures.m_PoolSize)
+  if (p_Texture.index < m_Textures.m_PoolSize && isValid(p_Texture))
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kTexture, p_Texture.index, m_CurrentFrameIndex, 1});
     m_TextureToUpdateBindless.push(
@@ -3091,8 +3246,11 @@ void GpuDevice::destroyPipeline(PipelineHandle p_Pipeline)
 {
   if (p_Pipeline.index < m_Pipelines.m_PoolSize)
   {
-    m_ResourceDeletionQueue.push(
-        {ResourceUpdateType::kPipeline, p_Pipeline.index, m_CurrentFrameIndex, 1});
+    {
+      std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
+      m_ResourceDeletionQueue.push(
+          {ResourceUpdateType::kPipeline, p_Pipeline.index, m_CurrentFrameIndex, 1});
+    }
     // Shader state creation is handled internally when creating a pipeline, thus add this to
     // track correctly.
     Pipeline* pipeline = (Pipeline*)m_Pipelines.accessResource(p_Pipeline.index);
@@ -3116,6 +3274,7 @@ void GpuDevice::destroySampler(SamplerHandle p_Sampler)
 {
   if (p_Sampler.index < m_Samplers.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kSampler, p_Sampler.index, m_CurrentFrameIndex, 1});
   }
@@ -3131,6 +3290,7 @@ void GpuDevice::destroyDescriptorSetLayout(DescriptorSetLayoutHandle p_Layout)
 {
   if (p_Layout.index < m_DescriptorSetLayouts.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kDescriptorSetLayout, p_Layout.index, m_CurrentFrameIndex, 1});
   }
@@ -3144,6 +3304,7 @@ void GpuDevice::destroyDescriptorSet(DescriptorSetHandle p_Set)
 {
   if (p_Set.index < m_DescriptorSets.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kDescriptorSet, p_Set.index, m_CurrentFrameIndex, 1});
   }
@@ -3157,6 +3318,7 @@ void GpuDevice::destroyRenderPass(RenderPassHandle p_RenderPass)
 {
   if (p_RenderPass.index < m_RenderPasses.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kRenderPass, p_RenderPass.index, m_CurrentFrameIndex, 1});
   }
@@ -3170,6 +3332,7 @@ void GpuDevice::destroyFramebuffer(FramebufferHandle p_Framebuffer)
 {
   if (p_Framebuffer.index < m_Framebuffers.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kFramebuffer, p_Framebuffer.index, m_CurrentFrameIndex, 1});
   }
@@ -3183,6 +3346,7 @@ void GpuDevice::destroyShaderState(ShaderStateHandle p_Shader)
 {
   if (p_Shader.index < m_Shaders.m_PoolSize)
   {
+    std::lock_guard<std::mutex> guard(m_ResourceUpdateMutex);
     m_ResourceDeletionQueue.push(
         {ResourceUpdateType::kShaderState, p_Shader.index, m_CurrentFrameIndex, 1});
 
@@ -3637,7 +3801,8 @@ void GpuDevice::createSwapchain()
     vkFramebuffer->resize = 0;
 
     vkFramebuffer->numColorAttachments = 1;
-    vkFramebuffer->colorAttachments[0].index = m_Textures.obtainResource();
+    const Framework::ResourcePoolHandle colorHandle = m_Textures.obtainHandle();
+    vkFramebuffer->colorAttachments[0] = {colorHandle.index, colorHandle.generation};
 
     vkFramebuffer->name = "Swapchain";
 
@@ -3813,6 +3978,7 @@ CommandBuffer* GpuDevice::getSecondaryCommandBuffer(uint32_t p_ThreadIndex, uint
 //---------------------------------------------------------------------------//
 void GpuDevice::queueCommandBuffer(CommandBuffer* p_CommandBuffer)
 {
+  assert(m_NumQueuedCommandBuffers < kMaxQueuedCommandBuffers);
   m_QueuedCommandBuffers[m_NumQueuedCommandBuffers++] = p_CommandBuffer;
 }
 //---------------------------------------------------------------------------//
@@ -3820,6 +3986,9 @@ VkRenderPass GpuDevice::getVulkanRenderPass(const RenderPassOutput& p_Output, co
 {
   // Hash the memory output and find a compatible VkRenderPass.
   // In current form RenderPassOutput should track everything needed, including load operations.
+  // The cache is shared with pipelines created on task threads.
+  std::lock_guard<std::recursive_mutex> guard(m_PipelineCreationMutex);
+
   uint64_t hashedMemory = Framework::hashBytes((void*)&p_Output, sizeof(RenderPassOutput));
   VkRenderPass vulkanRenderPass = g_RenderPassCache.get(hashedMemory);
   if (vulkanRenderPass)
@@ -3835,83 +4004,469 @@ VkRenderPass GpuDevice::getVulkanRenderPass(const RenderPassOutput& p_Output, co
 VkShaderModuleCreateInfo GpuDevice::compileShader(
     const char* p_Code, uint32_t p_CodeSize, VkShaderStageFlagBits p_Stage, const char* p_Name)
 {
+  ShaderCompileRequest request{p_Code, p_CodeSize, p_Stage, p_Name};
   VkShaderModuleCreateInfo shaderCi = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
 
-  // Compile from glsl to SpirV.
-  // TODO: detect if input is HLSL.
-  const char* tempFilename = "temp.shader";
+  compileShaders(&request, 1, &shaderCi, nullptr);
 
-  // Write current shader to file.
-  FILE* tempShaderFile = fopen(tempFilename, "w");
-  fwrite(p_Code, p_CodeSize, 1, tempShaderFile);
-  fclose(tempShaderFile);
-
-  size_t currentMarker = m_TemporaryAllocator->getMarker();
-  Framework::StringBuffer tempStringBuffer;
-  tempStringBuffer.init(FRAMEWORK_KILO(1), m_TemporaryAllocator);
+  return shaderCi;
+}
+//---------------------------------------------------------------------------//
+// Shader compilation helpers:
+//---------------------------------------------------------------------------//
+static const char* kShaderTargetEnvironment = "vulkan1.2";
+static std::atomic<uint32_t> g_ShaderCompileCounter{0};
+//---------------------------------------------------------------------------//
+struct ShaderCompileJob
+{
+  char stageDefine[256];
+  char cacheFilename[512];
+  char tempFilename[64];
+  char spirvFilename[64];
+  // Output of the failing tool, the process output is per thread so it is copied here.
+  char compilerOutput[2048];
+  bool cached = false;
+  bool compiled = false;
+}; // struct ShaderCompileJob
+//---------------------------------------------------------------------------//
+static bool _isValidSpirv(const uint32_t* p_Code, size_t p_CodeSize)
+{
+  static const uint32_t kSpirvMagic = 0x07230203;
+  return p_Code && p_CodeSize >= sizeof(uint32_t) * 5 && (p_CodeSize % sizeof(uint32_t)) == 0 &&
+         p_Code[0] == kSpirvMagic;
+}
+//---------------------------------------------------------------------------//
+// Runs glslangValidator (and spirv-opt if requested) for a single stage.
+// Only touches its own files and stack memory so it can run from any task thread.
+// Returns false when a tool reported an error, its output is then in the job.
+static bool _runShaderCompiler(
+    const char* p_BinariesPath,
+    const ShaderCompileRequest& p_Request,
+    ShaderCompileJob& p_Job,
+    bool p_Optimize)
+{
+  p_Job.compilerOutput[0] = 0;
 
-  // Add uppercase define as STAGE_NAME
-  char* stageDefine = tempStringBuffer.appendUseFormatted("%s_%s", toStageDefines(p_Stage), p_Name);
-  size_t stageDefineLength = strlen(stageDefine);
-  for (uint32_t i = 0; i < stageDefineLength; ++i)
+  // Write current shader to file.
+  FILE* tempShaderFile = fopen(p_Job.tempFilename, "w");
+  if (tempShaderFile == nullptr)
   {
-    stageDefine[i] = toupper(stageDefine[i]);
+    snprintf(
+        p_Job.compilerOutput,
+        sizeof(p_Job.compilerOutput),
+        "Cannot write %s\n",
+        p_Job.tempFilename);
+    return false;
   }
+  fwrite(p_Request.code, p_Request.codeSize, 1, tempShaderFile);
+  fclose(tempShaderFile);
+
   // Compile to SPV
-  char* glslCompilerPath =
-      tempStringBuffer.appendUseFormatted("%sglslangValidator.exe", m_VulkanBinariesPath);
-  char* finalSpirvFilename = tempStringBuffer.appendUse("shader_final.spv");
+  char glslCompilerPath[512];
+  sprintf(glslCompilerPath, "%sglslangValidator.exe", p_BinariesPath);
   // TODO: add optional debug information in shaders (option -g).
-  char* arguments = tempStringBuffer.appendUseFormatted(
-      "glslangValidator.exe %s -V --target-env vulkan1.2 -o %s -S %s --D %s --D %s",
-      tempFilename,
-      finalSpirvFilename,
-      toCompilerExtension(p_Stage),
-      stageDefine,
-      toStageDefines(p_Stage));
+  char arguments[1024];
+  sprintf(
+      arguments,
+      "glslangValidator.exe %s -V --target-env %s -o %s -S %s --D %s --D %s",
+      p_Job.tempFilename,
+      kShaderTargetEnvironment,
+      p_Job.spirvFilename,
+      toCompilerExtension(p_Request.stage),
+      p_Job.stageDefine,
+      toStageDefines(p_Request.stage));
 
-  Framework::processExecute(".", glslCompilerPath, arguments, "");
+  bool success = Framework::processExecute(".", glslCompilerPath, arguments, "ERROR");
+  if (!success)
+  {
+    snprintf(
+        p_Job.compilerOutput,
+        sizeof(p_Job.compilerOutput),
+        "%s",
+        Framework::processGetOutput());
+  }
 
-  bool optimizeShaders = false;
-  if (optimizeShaders)
+  if (success && p_Optimize && Framework::fileExists(p_Job.spirvFilename))
   {
-    // TODO: add optional optimization stage
     //"spirv-opt -O input -o output
-    char* spirvOptimizerPath =
-        tempStringBuffer.appendUseFormatted("%sspirv-opt.exe", m_VulkanBinariesPath);
-    char* optimizedSpirvFilename = tempStringBuffer.appendUseFormatted("shader_opt.spv");
-    char* spirvOptArguments = tempStringBuffer.appendUseFormatted(
+    char spirvOptimizerPath[512];
+    sprintf(spirvOptimizerPath, "%sspirv-opt.exe", p_BinariesPath);
+    char optimizedSpirvFilename[80];
+    sprintf(optimizedSpirvFilename, "%s.opt", p_Job.spirvFilename);
+    char spirvOptArguments[512];
+    sprintf(
+        spirvOptArguments,
         "spirv-opt.exe -O --preserve-bindings %s -o %s",
-        finalSpirvFilename,
+        p_Job.spirvFilename,
         optimizedSpirvFilename);
 
-    Framework::processExecute(".", spirvOptimizerPath, spirvOptArguments, "");
+    success = Framework::processExecute(".", spirvOptimizerPath, spirvOptArguments, "error");
+    if (!success)
+    {
+      snprintf(
+          p_Job.compilerOutput,
+          sizeof(p_Job.compilerOutput),
+          "%s",
+          Framework::processGetOutput());
+    }
 
-    // Read back SPV file.
-    shaderCi.pCode = reinterpret_cast<const uint32_t*>(Framework::fileReadBinary(
-        optimizedSpirvFilename, m_TemporaryAllocator, &shaderCi.codeSize));
+    // Keep the optimized binary under the final name.
+    Framework::fileDelete(p_Job.spirvFilename);
+    rename(optimizedSpirvFilename, p_Job.spirvFilename);
+  }
+
+  // Temporary files cleanup
+  Framework::fileDelete(p_Job.tempFilename);
 
-    Framework::fileDelete(optimizedSpirvFilename);
+  return success;
+}
+//---------------------------------------------------------------------------//
+struct ShaderCompileTask : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition p_Range, uint32_t p_ThreadNum) override
+  {
+    for (uint32_t i = p_Range.start; i < p_Range.end; ++i)
+    {
+      if (!jobs[i].cached)
+      {
+        jobs[i].compiled = _runShaderCompiler(binariesPath, requests[i], jobs[i], optimize);
+      }
+    }
   }
-  else
+
+  const ShaderCompileRequest* requests = nullptr;
+  ShaderCompileJob* jobs = nullptr;
+  const char* binariesPath = nullptr;
+  bool optimize = false;
+}; // struct ShaderCompileTask
+//---------------------------------------------------------------------------//
+bool GpuDevice::compileShaders(
+    const ShaderCompileRequest* p_Requests,
+    uint32_t p_Count,
+    VkShaderModuleCreateInfo* p_OutShaderCis,
+    enki::TaskScheduler* p_TaskScheduler)
+{
+  if (p_Count == 0)
+    return true;
+
+  // Jobs are only needed until the binaries are read back, output memory is allocated after them
+  // from the same temporary allocator and must survive, so use the heap here.
+  ShaderCompileJob* jobs =
+      (ShaderCompileJob*)FRAMEWORK_ALLOCA(sizeof(ShaderCompileJob) * p_Count, m_Allocator);
+
+  const uint32_t batchIndex = g_ShaderCompileCounter.fetch_add(1);
+  uint32_t numMisses = 0;
+
+  // Cache lookup: done serially, it is only file reads.
+  for (uint32_t r = 0; r < p_Count; ++r)
+  {
+    const ShaderCompileRequest& request = p_Requests[r];
+    ShaderCompileJob& job = jobs[r];
+    VkShaderModuleCreateInfo& shaderCi = p_OutShaderCis[r];
+    shaderCi = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+
+    // Add uppercase define as STAGE_NAME
+    snprintf(
+        job.stageDefine,
+        sizeof(job.stageDefine),
+        "%s_%s",
+        toStageDefines(request.stage),
+        request.name);
+    const size_t stageDefineLength = strlen(job.stageDefine);
+    for (uint32_t i = 0; i < stageDefineLength; ++i)
+    {
+      job.stageDefine[i] = toupper(job.stageDefine[i]);
+    }
+
+    // Unique names so that stages can be compiled concurrently.
+    sprintf(job.tempFilename, "temp_%u_%u.shader", batchIndex, r);
+    sprintf(job.spirvFilename, "shader_final_%u_%u.spv", batchIndex, r);
+    job.cacheFilename[0] = 0;
+    job.compilerOutput[0] = 0;
+    job.cached = false;
+    job.compiled = false;
+
+    // The key covers everything that can change the output binary.
+    if (m_ShaderCacheEnabled)
+    {
+      const uint32_t optimize = m_OptimizeShaders ? 1 : 0;
+      uint64_t hash = Framework::hashBytes((void*)request.code, request.codeSize);
+      hash = Framework::hashBytes((void*)&request.stage, sizeof(request.stage), hash);
+      hash = Framework::hashBytes(job.stageDefine, stageDefineLength, hash);
+      hash = Framework::hashBytes(
+          (void*)kShaderTargetEnvironment, strlen(kShaderTargetEnvironment), hash);
+      hash = Framework::hashBytes((void*)&optimize, sizeof(optimize), hash);
+      hash = Framework::hashBytes(&m_ShaderCompilerHash, sizeof(m_ShaderCompilerHash), hash);
+
+      sprintf(job.cacheFilename, "%s%016llx.spv", m_ShaderCachePath, hash);
+
+      const int64_t lookupStart = Framework::Time::getCurrentTime();
+      if (Framework::fileExists(job.cacheFilename))
+      {
+        shaderCi.pCode = reinterpret_cast<const uint32_t*>(Framework::fileReadBinary(
+            job.cacheFilename, m_TemporaryAllocator, &shaderCi.codeSize));
+
+        // Discard truncated or foreign files, they will be overwritten by a fresh compile.
+        if (_isValidSpirv(shaderCi.pCode, shaderCi.codeSize))
+        {
+          job.cached = true;
+          ++m_ShaderCacheStats.hits;
+          m_ShaderCacheStats.lookupTimeMs +=
+              Framework::Time::deltaFromStartMilliseconds(lookupStart);
+          continue;
+        }
+
+        shaderCi.pCode = nullptr;
+        shaderCi.codeSize = 0;
+      }
+      ++m_ShaderCacheStats.misses;
+    }
+
+    ++numMisses;
+  }
+
+  // Compile all misses, in parallel when a scheduler is available.
+  if (numMisses)
   {
-    // Read back SPV file.
-    shaderCi.pCode = reinterpret_cast<const uint32_t*>(
-        Framework::fileReadBinary(finalSpirvFilename, m_TemporaryAllocator, &shaderCi.codeSize));
+    const int64_t compileStart = Framework::Time::getCurrentTime();
+
+    ShaderCompileTask compileTask;
+    compileTask.m_SetSize = p_Count;
+    compileTask.m_MinRange = 1;
+    compileTask.requests = p_Requests;
+    compileTask.jobs = jobs;
+    compileTask.binariesPath = m_VulkanBinariesPath;
+    compileTask.optimize = m_OptimizeShaders;
+
+    if (p_TaskScheduler && numMisses > 1)
+    {
+      p_TaskScheduler->AddTaskSetToPipe(&compileTask);
+      p_TaskScheduler->WaitforTask(&compileTask);
+    }
+    else
+    {
+      compileTask.ExecuteRange({0, p_Count}, 0);
+    }
+
+    m_ShaderCacheStats.compileTimeMs += Framework::Time::deltaFromStartMilliseconds(compileStart);
   }
 
-  // TODO: Handling compilation error
-  if (shaderCi.pCode == nullptr)
+  // Read back compiled binaries in request order and store them in the cache.
+  bool allCompiled = true;
+  for (uint32_t r = 0; r < p_Count; ++r)
   {
-    dumpShaderCode(tempStringBuffer, p_Code, p_Stage, p_Name);
-    assert(false && "Failed to compile shader!");
+    const ShaderCompileRequest& request = p_Requests[r];
+    ShaderCompileJob& job = jobs[r];
+    if (job.cached)
+      continue;
+
+    VkShaderModuleCreateInfo& shaderCi = p_OutShaderCis[r];
+    shaderCi.pCode = nullptr;
+    shaderCi.codeSize = 0;
+    // A failed compile can still leave a binary behind, only read it when the tools succeeded.
+    if (job.compiled && Framework::fileExists(job.spirvFilename))
+    {
+      shaderCi.pCode = reinterpret_cast<const uint32_t*>(Framework::fileReadBinary(
+          job.spirvFilename, m_TemporaryAllocator, &shaderCi.codeSize));
+    }
+    Framework::fileDelete(job.spirvFilename);
+
+    if (!_isValidSpirv(shaderCi.pCode, shaderCi.codeSize))
+    {
+      // The failed stage is left without code and never reaches the cache.
+      shaderCi.pCode = nullptr;
+      shaderCi.codeSize = 0;
+      allCompiled = false;
+
+      char msg[256]{};
+      sprintf(
+          msg,
+          "Failed to compile shader %s, stage %s:\n",
+          request.name,
+          toStageDefines(request.stage));
+      OutputDebugStringA(msg);
+      OutputDebugStringA(job.compilerOutput[0] ? job.compilerOutput : "No valid SPIR-V output.\n");
+      OutputDebugStringA("\n");
+
+      size_t currentMarker = m_TemporaryAllocator->getMarker();
+      Framework::StringBuffer tempStringBuffer;
+      tempStringBuffer.init(FRAMEWORK_KILO(1), m_TemporaryAllocator);
+      dumpShaderCode(tempStringBuffer, request.code, request.stage, request.name);
+      m_TemporaryAllocator->freeMarker(currentMarker);
+    }
+    else if (job.cacheFilename[0])
+    {
+      Framework::fileWriteBinary(job.cacheFilename, (void*)shaderCi.pCode, shaderCi.codeSize);
+      m_ShaderCacheStats.sizeInBytes += shaderCi.codeSize;
+    }
   }
 
-  // Temporary files cleanup
-  Framework::fileDelete(tempFilename);
-  Framework::fileDelete(finalSpirvFilename);
+  // Evict old entries if the cache went over budget.
+  if (m_ShaderCacheEnabled && m_ShaderCacheMaxSize &&
+      m_ShaderCacheStats.sizeInBytes > m_ShaderCacheMaxSize)
+  {
+    trimShaderCache();
+  }
 
-  return shaderCi;
+  m_Allocator->deallocate(jobs);
+
+  return allCompiled;
+}
+//---------------------------------------------------------------------------//
+// Pipeline cache:
+//---------------------------------------------------------------------------//
+static bool _isPipelineCacheCompatible(
+    const void* p_Data, size_t p_Size, const VkPhysicalDeviceProperties& p_Props)
+{
+  if (p_Data == nullptr || p_Size < sizeof(VkPipelineCacheHeaderVersionOne))
+    return false;
+
+  const VkPipelineCacheHeaderVersionOne* cacheHeader =
+      (const VkPipelineCacheHeaderVersionOne*)p_Data;
+
+  return cacheHeader->headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+         cacheHeader->headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         cacheHeader->vendorID == p_Props.vendorID &&
+         cacheHeader->deviceID == p_Props.deviceID &&
+         memcmp(cacheHeader->pipelineCacheUUID, p_Props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+//---------------------------------------------------------------------------//
+VkPipelineCache GpuDevice::loadPipelineCache(const char* p_Path)
+{
+  VkPipelineCacheCreateInfo pipelineCacheCi{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+
+  // The driver copies the initial data, the mapping only has to outlive the creation.
+  Framework::FileMapping mapping{};
+  if (p_Path != nullptr && Framework::fileExists(p_Path))
+  {
+    mapping = Framework::fileMapReadOnly(p_Path, Framework::FileAccessHint::kSequential);
+
+    // Data from another driver or device is ignored, the cache starts empty.
+    if (_isPipelineCacheCompatible(mapping.data, mapping.size, m_VulkanPhysicalDeviceProps))
+    {
+      pipelineCacheCi.initialDataSize = mapping.size;
+      pipelineCacheCi.pInitialData = mapping.data;
+    }
+  }
+
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  CHECKRES(vkCreatePipelineCache(
+      m_VulkanDevice, &pipelineCacheCi, m_VulkanAllocCallbacks, &pipelineCache));
+
+  Framework::fileUnmap(mapping);
+
+  return pipelineCache;
+}
+//---------------------------------------------------------------------------//
+void GpuDevice::mergePipelineCaches(const VkPipelineCache* p_Caches, uint32_t p_Count)
+{
+  if (p_Count == 0)
+    return;
+
+  std::lock_guard<std::shared_timed_mutex> guard(m_PipelineCacheMutex);
+  CHECKRES(vkMergePipelineCaches(m_VulkanDevice, m_VulkanPipelineCache, p_Count, p_Caches));
+}
+//---------------------------------------------------------------------------//
+void GpuDevice::savePipelineCache()
+{
+  if (m_VulkanPipelineCache == VK_NULL_HANDLE)
+    return;
+
+  std::lock_guard<std::shared_timed_mutex> guard(m_PipelineCacheMutex);
+
+  size_t cacheDataSize = 0;
+  CHECKRES(vkGetPipelineCacheData(m_VulkanDevice, m_VulkanPipelineCache, &cacheDataSize, nullptr));
+  if (cacheDataSize == 0)
+    return;
+
+  void* cacheData = m_Allocator->allocate(cacheDataSize, 64);
+  CHECKRES(
+      vkGetPipelineCacheData(m_VulkanDevice, m_VulkanPipelineCache, &cacheDataSize, cacheData));
+
+  if (_isPipelineCacheCompatible(cacheData, cacheDataSize, m_VulkanPhysicalDeviceProps))
+  {
+    // Write to a temporary file and swap it in, so a crash never leaves a truncated cache.
+    char tempPath[520];
+    sprintf(tempPath, "%s.tmp", m_PipelineCachePath);
+    Framework::fileWriteBinary(tempPath, cacheData, cacheDataSize);
+
+    if (!MoveFileExA(
+            tempPath, m_PipelineCachePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+      Framework::fileDelete(tempPath);
+    }
+  }
+
+  m_Allocator->deallocate(cacheData);
+}
+//---------------------------------------------------------------------------//
+struct ShaderCacheEntry
+{
+  uint64_t lastWriteTime;
+  size_t size;
+  char filename[64];
+};
+//---------------------------------------------------------------------------//
+static int _compareShaderCacheEntries(const void* p_A, const void* p_B)
+{
+  const uint64_t timeA = ((const ShaderCacheEntry*)p_A)->lastWriteTime;
+  const uint64_t timeB = ((const ShaderCacheEntry*)p_B)->lastWriteTime;
+  return timeA < timeB ? -1 : (timeA > timeB ? 1 : 0);
+}
+//---------------------------------------------------------------------------//
+void GpuDevice::trimShaderCache()
+{
+  size_t currentMarker = m_TemporaryAllocator->getMarker();
+
+  Framework::Array<ShaderCacheEntry> entries;
+  entries.init(m_TemporaryAllocator, 64);
+
+  char searchPattern[512];
+  sprintf(searchPattern, "%s*.spv", m_ShaderCachePath);
+
+  size_t totalSize = 0;
+  WIN32_FIND_DATAA findData;
+  HANDLE findHandle = FindFirstFileA(searchPattern, &findData);
+  if (findHandle != INVALID_HANDLE_VALUE)
+  {
+    do
+    {
+      if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        continue;
+
+      ShaderCacheEntry& entry = entries.pushUse();
+      entry.lastWriteTime = ((uint64_t)findData.ftLastWriteTime.dwHighDateTime << 32) |
+                            findData.ftLastWriteTime.dwLowDateTime;
+      entry.size = ((size_t)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+      strncpy(entry.filename, findData.cFileName, sizeof(entry.filename) - 1);
+      entry.filename[sizeof(entry.filename) - 1] = 0;
+
+      totalSize += entry.size;
+    } while (FindNextFileA(findHandle, &findData) != 0);
+    FindClose(findHandle);
+  }
+
+  // Evict oldest entries first, leaving some headroom so the next misses don't retrigger a scan.
+  if (m_ShaderCacheMaxSize && totalSize > m_ShaderCacheMaxSize)
+  {
+    qsort(entries.m_Data, entries.m_Size, sizeof(ShaderCacheEntry), _compareShaderCacheEntries);
+
+    const size_t targetSize = m_ShaderCacheMaxSize - m_ShaderCacheMaxSize / 4;
+    for (uint32_t i = 0; i < entries.m_Size && totalSize > targetSize; ++i)
+    {
+      char path[512];
+      sprintf(path, "%s%s", m_ShaderCachePath, entries[i].filename);
+      Framework::fileDelete(path);
+
+      totalSize -= entries[i].size;
+      ++m_ShaderCacheStats.evictions;
+    }
+  }
+
+  m_ShaderCacheStats.sizeInBytes = totalSize;
+
+  entries.shutdown();
+  m_TemporaryAllocator->freeMarker(currentMarker);
 }
 //---------------------------------------------------------------------------//
 void GpuDevice::frameCountersAdvance()
@@ -3942,7 +4497,7 @@ void GpuDevice::querySampler(SamplerHandle p_Sampler, SamplerDescription& p_OutD
 //---------------------------------------------------------------------------//
 void GpuDevice::queryTexture(TextureHandle p_Texture, TextureDescription& p_OutDescription)
 {
-  if (p_Texture.index != kInvalidIndex)
+  if (p_Texture.index != kInvalidIndex && isValid(p_Texture))
   {
     const Texture* textureData = (Texture*)m_Textures.accessResource(p_Texture.index);
 
@@ -3963,7 +4518,7 @@ void GpuDevice::queryTexture(TextureHandle p_Texture, TextureDescription& p_OutD
 //---------------------------------------------------------------------------//
 void GpuDevice::queryBuffer(BufferHandle p_Buffer, BufferDescription& p_OutDescription)
 {
-  if (p_Buffer.index != kInvalidIndex)
+  if (p_Buffer.index != kInvalidIndex && isValid(p_Buffer))
   {
     const Buffer* bufferData = (Buffer*)m_Buffers.accessResource(p_Buffer.index);
 
@@ -3976,6 +4531,25 @@ void GpuDevice::queryBuffer(BufferHandle p_Buffer, BufferDescription& p_OutDescr
   }
 }
 //---------------------------------------------------------------------------//
+bool GpuDevice::isValid(BufferHandle p_Buffer) const
+{
+  if (p_Buffer.index == kInvalidIndex)
+    return false;
+
+  // Handles built from a bare index can't be checked, they must come from the device.
+  assert(p_Buffer.generation != 0);
+  return m_Buffers.isValid({p_Buffer.index, p_Buffer.generation});
+}
+//---------------------------------------------------------------------------//
+bool GpuDevice::isValid(TextureHandle p_Texture) const
+{
+  if (p_Texture.index == kInvalidIndex)
+    return false;
+
+  assert(p_Texture.generation != 0);
+  return m_Textures.isValid({p_Texture.index, p_Texture.generation});
+}
+//---------------------------------------------------------------------------//
 void GpuDevice::linkTextureSampler(TextureHandle p_Texture, SamplerHandle p_Sampler)
 {
   Texture* texture = (Texture*)m_Textures.accessResource(p_Texture.index);
@@ -4049,7 +4623,8 @@ void GpuDevice::resizeTexture(TextureHandle texture, uint32_t width, uint32_t he
   }
 
   // Queue deletion of texture by creating a temporary one
-  TextureHandle textureToDelete = {m_Textures.obtainResource()};
+  const Framework::ResourcePoolHandle deletion = m_Textures.obtainHandle();
+  TextureHandle textureToDelete = {deletion.index, deletion.generation};
   Texture* vkTextureToDelete = (Texture*)m_Textures.accessResource(textureToDelete.index);
 
   // Cache all informations (image, image view, flags, ...) into texture to delete.
@@ -4098,6 +4673,9 @@ void GpuDevice::fillBarrier(FramebufferHandle framebuffer, ExecutionBarrier& out
 //---------------------------------------------------------------------------//
 bool GpuDevice::bufferReady(BufferHandle p_Buffer)
 {
+  if (!isValid(p_Buffer))
+    return false;
+
   Buffer* buffer = (Buffer*)m_Buffers.accessResource(p_Buffer.index);
   return buffer->ready;
 }
@@ -14,9 +14,17 @@
 #include "Foundation/Array.hpp"
 #include "Foundation/File.hpp"
 
+#include <mutex>
+#include <shared_mutex>
+
 // TODOs:
 // 1. gpu timing
 
+namespace enki
+{
+class TaskScheduler;
+}
+
 namespace Graphics
 {
 // Forward declarations:
@@ -26,10 +34,32 @@ struct GpuDevice;
 struct GpuThreadFramePools
 {
   VkCommandPool vulkanCommandPool = nullptr;
+  // Per-frame scratch memory of the thread recording from this pool.
+  Framework::LinearAllocator* frameArena = nullptr;
 
   // TODO: Add query pools
 }; // struct GpuThreadFramePools
 
+//---------------------------------------------------------------------------//
+struct ShaderCacheStatistics
+{
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+  uint32_t evictions = 0;
+  size_t sizeInBytes = 0; // Current size of the on-disk cache
+
+  double compileTimeMs = 0.0; // Time spent in glslangValidator/spirv-opt for misses
+  double lookupTimeMs = 0.0;  // Time spent reading cached binaries for hits
+}; // struct ShaderCacheStatistics
+//---------------------------------------------------------------------------//
+// A single glsl stage to compile, used by the batch compilation api.
+struct ShaderCompileRequest
+{
+  const char* code = nullptr;
+  uint32_t codeSize = 0;
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+  const char* name = nullptr;
+}; // struct ShaderCompileRequest
 //---------------------------------------------------------------------------//
 struct DeviceCreation
 {
@@ -41,10 +71,18 @@ struct DeviceCreation
   uint16_t numThreads = 1;
   bool forceDisableDynamicRendering = false;
 
+  // SPIR-V cache, 0 means unbounded.
+  bool enableShaderCache = true;
+  size_t shaderCacheMaxSize = 64 * 1024 * 1024;
+  // Run spirv-opt on compiled shaders, part of the cache key.
+  bool optimizeShaders = false;
+
   DeviceCreation& setWindow(uint32_t p_Width, uint32_t p_Height, void* p_Handle);
   DeviceCreation& setAllocator(Framework::Allocator* p_Allocator);
   DeviceCreation& setTemporaryAllocator(Framework::StackAllocator* p_Allocator);
   DeviceCreation& setNumThreads(uint32_t p_NumThreads);
+  DeviceCreation& setShaderCache(bool p_Enable, size_t p_MaxSize);
+  DeviceCreation& setOptimizeShaders(bool p_Optimize);
 };
 //---------------------------------------------------------------------------//
 struct GpuDevice : public Framework::Service
@@ -58,8 +96,7 @@ struct GpuDevice : public Framework::Service
   // Creation/Destruction of resources
   BufferHandle createBuffer(const BufferCreation& p_Creation);
   TextureHandle createTexture(const TextureCreation& p_Creation);
-  PipelineHandle
-  createPipeline(const PipelineCreation& p_Creation, const char* p_CachePath = nullptr);
+  PipelineHandle createPipeline(const PipelineCreation& p_Creation);
   SamplerHandle createSampler(const SamplerCreation& p_Creation);
   DescriptorSetLayoutHandle
   createDescriptorSetLayout(const DescriptorSetLayoutCreation& p_Creation);
@@ -80,6 +117,13 @@ struct GpuDevice : public Framework::Service
 
   void releaseResource(ResourceUpdate& p_ResourceDeletion);
 
+  // Raw memory, for textures created with TextureCreation::setAliasMemory. Freeing is deferred
+  // like resource destruction, after the textures bound to it.
+  void getTextureMemoryRequirements(
+      const TextureCreation& p_Creation, VkMemoryRequirements& p_Requirements);
+  VmaAllocation allocateMemory(const VkMemoryRequirements& p_Requirements);
+  void freeMemory(VmaAllocation p_Allocation);
+
   // Instant methods
   void destroyBufferInstant(ResourceHandle buffer);
   void destroyTextureInstant(ResourceHandle texture);
@@ -117,6 +161,9 @@ struct GpuDevice : public Framework::Service
   void querySampler(SamplerHandle p_Sampler, SamplerDescription& p_OutDescription);
   void queryTexture(TextureHandle p_Texture, TextureDescription& p_OutDescription);
   void queryBuffer(BufferHandle p_Buffer, BufferDescription& p_OutDescription);
+  // False for invalid handles and handles to destroyed resources.
+  bool isValid(BufferHandle p_Buffer) const;
+  bool isValid(TextureHandle p_Texture) const;
 
   // Compute
   void submitComputeLoad(CommandBuffer* p_CommandBuffer);
@@ -127,8 +174,23 @@ struct GpuDevice : public Framework::Service
   void popMarker(VkCommandBuffer commandBuffer);
 
   VkRenderPass getVulkanRenderPass(const RenderPassOutput& p_Output, const char* p_Name);
+  // Returns a null pCode if the stage failed to compile.
   VkShaderModuleCreateInfo compileShader(
       const char* p_Code, uint32_t p_CodeSize, VkShaderStageFlagBits p_Stage, const char* p_Name);
+  // Compile all requests, running cache misses concurrently on the task scheduler if present.
+  // Output binaries are allocated from the temporary allocator, in request order.
+  // Returns false if a stage failed: its create info has a null pCode, the compiler output is
+  // logged and nothing is written to the shader cache for it.
+  bool compileShaders(
+      const ShaderCompileRequest* p_Requests,
+      uint32_t p_Count,
+      VkShaderModuleCreateInfo* p_OutShaderCis,
+      enki::TaskScheduler* p_TaskScheduler);
+  void trimShaderCache();
+  // Merge caches filled by other threads/loaders into the device pipeline cache.
+  void mergePipelineCaches(const VkPipelineCache* p_Caches, uint32_t p_Count);
+  void savePipelineCache();
+  VkPipelineCache loadPipelineCache(const char* p_Path);
   void frameCountersAdvance();
   void resize(uint16_t p_Width, uint16_t p_Height)
   {
@@ -218,12 +280,17 @@ struct GpuDevice : public Framework::Service
   PFN_vkCmdEndRenderingKHR m_CmdEndRendering;
   PFN_vkQueueSubmit2KHR m_QueueSubmit2;
   PFN_vkCmdPipelineBarrier2KHR m_CmdPipelineBarrier2;
+  PFN_vkCmdDrawIndexedIndirectCountKHR m_CmdDrawIndexedIndirectCount;
 
   Framework::Array<ResourceUpdate> m_ResourceDeletionQueue;
+  Framework::Array<MemoryRelease> m_MemoryReleaseQueue;
   Framework::Array<DescriptorSetUpdate> m_DescriptorSetUpdates;
 
   Framework::Array<GpuThreadFramePools> m_ThreadFramePools;
   Framework::Array<GpuThreadFramePools> m_ComputeFramePools;
+  // Recording scratch memory, indexed by enkiTS thread number and frame in flight. The arena
+  // after the last thread belongs to the compute pools.
+  Framework::ThreadFrameArenas m_FrameArenas;
 
   // Per-frame synchronization
   VkSemaphore m_VulkanRenderCompleteSemaphore[kMaxSwapchainImages];
@@ -265,12 +332,43 @@ struct GpuDevice : public Framework::Service
   bool m_DynamicRenderingExtensionPresent = false;
   bool m_TimelineSemaphoreExtensionPresent = false;
   bool m_Synchronization2ExtensionPresent = false;
+  bool m_DrawIndirectCountExtensionPresent = false;
+
+  // Multi draw indirect needs both: more than one draw per command, and the first instance
+  // selecting the instance data of each draw.
+  bool m_MultiDrawIndirectSupported = false;
+  bool m_DrawIndirectFirstInstanceSupported = false;
 
   size_t m_UboAlignment = 256;
   size_t m_SboAlignment = 256;
 
   char m_VulkanBinariesPath[512];
 
+  // SPIR-V cache, keyed by a hash of source, stage, defines, compiler version and options.
+  bool m_ShaderCacheEnabled = true;
+  bool m_OptimizeShaders = false;
+  uint64_t m_ShaderCompilerHash = 0;
+  size_t m_ShaderCacheMaxSize = 0;
+  char m_ShaderCachePath[512];
+  ShaderCacheStatistics m_ShaderCacheStats;
+
+  // Device wide pipeline cache, loaded in init and saved at shutdown.
+  // Pipeline creation shares the cache and takes the lock shared, merges need it externally
+  // synchronized and take it exclusive, like saves.
+  VkPipelineCache m_VulkanPipelineCache = VK_NULL_HANDLE;
+  std::shared_timed_mutex m_PipelineCacheMutex;
+  char m_PipelineCachePath[512];
+
+  // Guards the deletion queue and bindless update list, resources can be created and destroyed
+  // from task threads.
+  std::mutex m_ResourceUpdateMutex;
+
+  // Guards the pipeline, shader state and descriptor set layout pools and the render pass cache,
+  // so pipelines can be created on task threads while other resources are created. Recursive as
+  // createPipeline holds it while creating its shader state, layouts and render pass.
+  // The driver side of pipeline creation runs outside of the lock.
+  std::recursive_mutex m_PipelineCreationMutex;
+
   Framework::Directory m_Cwd;
 
   // Bindless stuff
@@ -149,6 +149,13 @@ TextureCreation& TextureCreation::setAlias(TextureHandle p_Alias)
   alias = p_Alias;
   return *this;
 }
+
+TextureCreation& TextureCreation::setAliasMemory(VmaAllocation p_Memory, VkDeviceSize p_Offset)
+{
+  aliasMemory = p_Memory;
+  aliasOffset = p_Offset;
+  return *this;
+}
 //---------------------------------------------------------------------------//
 /// SamplerCreation
 SamplerCreation& SamplerCreation::setMinMagMip(VkFilter min, VkFilter mag, VkSamplerMipmapMode mip)
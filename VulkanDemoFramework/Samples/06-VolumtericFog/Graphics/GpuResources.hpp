@@ -25,25 +25,38 @@ struct ParseResult;
 
 static const uint32_t kInvalidIndex = 0xffffffff;
 
+// Size of the bindless texture array, indexed by texture pool index.
+static const uint32_t kMaxBindlessResources = 1024u;
+
 static const uint32_t kBuffersPoolSize = 16384;
-static const uint32_t kTexturesPoolSize = 512;
-static const uint32_t kRenderPassesPoolSize = 256;
-static const uint32_t kDescriptorSetLayoutsPoolSize = 128;
-static const uint32_t kPipelinesPoolSize = 128;
-static const uint32_t kShadersPoolSize = 128;
+// Textures are bound by their pool index, the pool can't outgrow the bindless array.
+static const uint32_t kTexturesPoolSize = kMaxBindlessResources;
+static const uint32_t kRenderPassesPoolSize = 4096;
+static const uint32_t kFramebuffersPoolSize = 4096;
+static const uint32_t kDescriptorSetLayoutsPoolSize = 4096;
+static const uint32_t kPipelinesPoolSize = 4096;
+static const uint32_t kShadersPoolSize = 4096;
 static const uint32_t kDescriptorSetsPoolSize = 4096;
-static const uint32_t kSamplersPoolSize = 32;
+static const uint32_t kSamplersPoolSize = 1024;
+// Growable pools allocate slots in pages of this size, up to the pool sizes above. Only the page
+// table is allocated upfront, so the sizes are limits rather than memory reserved.
+static const uint32_t kResourcePoolPageSize = 64;
 
 typedef uint32_t ResourceHandle;
 
+// Buffers and textures also keep the generation of their pool slot, so the device can reject
+// handles to destroyed resources. Generation 0 is never issued: only kInvalidBuffer and
+// kInvalidTexture carry it, the device asserts on any other handle without a generation.
 struct BufferHandle
 {
   ResourceHandle index;
+  uint32_t generation;
 }; // struct BufferHandle
 
 struct TextureHandle
 {
   ResourceHandle index;
+  uint32_t generation;
 }; // struct TextureHandle
 
 struct ShaderStateHandle
@@ -253,6 +266,10 @@ struct TextureCreation
 
   TextureHandle alias = kInvalidTexture;
 
+  // Bind the image at an offset of an existing allocation instead of allocating its own memory.
+  VmaAllocation aliasMemory = nullptr;
+  VkDeviceSize aliasOffset = 0;
+
   const char* name = nullptr;
 
   TextureCreation& setSize(uint16_t width, uint16_t height, uint16_t depth);
@@ -261,6 +278,7 @@ struct TextureCreation
   TextureCreation& setName(const char* name);
   TextureCreation& setData(void* data);
   TextureCreation& setAlias(TextureHandle alias);
+  TextureCreation& setAliasMemory(VmaAllocation memory, VkDeviceSize offset);
 
 }; // struct TextureCreation
 
@@ -676,6 +694,12 @@ struct ResourceUpdate
   uint32_t currentFrame;
   uint32_t deleting;
 }; // struct ResourceUpdate
+
+struct MemoryRelease
+{
+  VmaAllocation allocation;
+  uint32_t currentFrame;
+}; // struct MemoryRelease
 //---------------------------------------------------------------------------//
 // Device Resources:
 //---------------------------------------------------------------------------//
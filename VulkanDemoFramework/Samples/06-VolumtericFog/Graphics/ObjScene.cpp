@@ -19,15 +19,18 @@
 namespace Graphics
 {
 
-static bool isSharedVertex(PhysicsVertex* vertices, PhysicsVertex& src, uint32_t dst)
+static bool isSharedVertex(PhysicsVertices& vertices, uint32_t srcIndex, uint32_t dstIndex)
 {
+  const vec3s* startPositions = vertices.column<PhysicsVertexField::kStartPosition>();
+  const PhysicsVertexJoints& src = vertices.get<PhysicsVertexField::kJoints>(srcIndex);
+  const vec3s& srcPosition = startPositions[srcIndex];
+
   float maxDistance = 0.0f;
   float minDistance = 10000.0f;
 
   for (uint32_t j = 0; j < src.jointCount; ++j)
   {
-    PhysicsVertex& jointVertex = vertices[src.joints[j].vertexIndex];
-    float distance = glms_vec3_distance(src.startPosition, jointVertex.startPosition);
+    float distance = glms_vec3_distance(srcPosition, startPositions[src.joints[j].vertexIndex]);
 
     maxDistance = (distance > maxDistance) ? distance : maxDistance;
     minDistance = (distance < minDistance) ? distance : minDistance;
@@ -38,8 +41,7 @@ static bool isSharedVertex(PhysicsVertex* vertices, PhysicsVertex& src, uint32_t
   minDistance *= 2;
   maxDistance = (minDistance > maxDistance) ? minDistance : maxDistance;
 
-  PhysicsVertex& dstVertex = vertices[dst];
-  float distance = glms_vec3_distance(src.startPosition, dstVertex.startPosition);
+  float distance = glms_vec3_distance(srcPosition, startPositions[dstIndex]);
 
   // NOTE: this only works if we work with a plane with equal size subdivision
   return (distance <= maxDistance);
@@ -197,13 +199,6 @@ void ObjScene::init(
 
       positions.push(position);
 
-      PhysicsVertex physicsVertex{};
-      physicsVertex.startPosition = position;
-      physicsVertex.previousPosition = position;
-      physicsVertex.position = position;
-      physicsVertex.mass = 1.0f;
-      physicsVertex.fixed = false;
-
       vec3s normal = vec3s{
           mesh->mNormals[vertexIndex].x,
           mesh->mNormals[vertexIndex].y,
@@ -211,8 +206,6 @@ void ObjScene::init(
 
       normals.push(normal);
 
-      physicsVertex.normal = normal;
-
       tangents.push(vec3s{
           mesh->mTangents[vertexIndex].x,
           mesh->mTangents[vertexIndex].y,
@@ -223,9 +216,21 @@ void ObjScene::init(
           mesh->mTextureCoords[0][vertexIndex].y,
       });
 
-      physicsMesh->vertices.push(physicsVertex);
+      physicsMesh->vertices.push(
+          position,
+          position,
+          position,
+          normal,
+          vec3s{},
+          vec3s{},
+          PhysicsVertexJoints{},
+          1.0f,
+          false);
     }
 
+    ArrayView<PhysicsVertexJoints> joints =
+        physicsMesh->vertices.view<PhysicsVertexField::kJoints>();
+
     for (uint32_t faceIndex = 0; faceIndex < mesh->mNumFaces; ++faceIndex)
     {
       assert(mesh->mFaces[faceIndex].mNumIndices == 3);
@@ -240,17 +245,14 @@ void ObjScene::init(
 
       // NOTE: compute cloth joints
 
-      PhysicsVertex& vertexA = physicsMesh->vertices[indexA];
-      vertexA.addJoint(indexB);
-      vertexA.addJoint(indexC);
+      joints[indexA].addJoint(indexB);
+      joints[indexA].addJoint(indexC);
 
-      PhysicsVertex& vertexB = physicsMesh->vertices[indexB];
-      vertexB.addJoint(indexA);
-      vertexB.addJoint(indexC);
+      joints[indexB].addJoint(indexA);
+      joints[indexB].addJoint(indexC);
 
-      PhysicsVertex& vertexC = physicsMesh->vertices[indexC];
-      vertexC.addJoint(indexA);
-      vertexC.addJoint(indexB);
+      joints[indexC].addJoint(indexA);
+      joints[indexC].addJoint(indexB);
     }
 
     for (uint32_t faceIndex = 0; faceIndex < mesh->mNumFaces; ++faceIndex)
@@ -259,12 +261,6 @@ void ObjScene::init(
       uint32_t indexB = mesh->mFaces[faceIndex].mIndices[1];
       uint32_t indexC = mesh->mFaces[faceIndex].mIndices[2];
 
-      PhysicsVertex& vertexA = physicsMesh->vertices[indexA];
-
-      PhysicsVertex& vertexB = physicsMesh->vertices[indexB];
-
-      PhysicsVertex& vertexC = physicsMesh->vertices[indexC];
-
       // NOTE: check for adjacent triangles to get diagonal joints
       for (uint32_t otherFaceIndex = 0; otherFaceIndex < mesh->mNumFaces; ++otherFaceIndex)
       {
@@ -280,133 +276,133 @@ void ObjScene::init(
         // check for vertexA
         if (otherIndexA == indexB && otherIndexB == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexC))
           {
-            vertexA.addJoint(otherIndexC);
+            joints[indexA].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexC && otherIndexB == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexC))
           {
-            vertexA.addJoint(otherIndexC);
+            joints[indexA].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexB && otherIndexC == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexB))
           {
-            vertexA.addJoint(otherIndexB);
+            joints[indexA].addJoint(otherIndexB);
           }
         }
         if (otherIndexA == indexC && otherIndexC == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexB))
           {
-            vertexA.addJoint(otherIndexB);
+            joints[indexA].addJoint(otherIndexB);
           }
         }
         if (otherIndexC == indexB && otherIndexB == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexA))
           {
-            vertexA.addJoint(otherIndexA);
+            joints[indexA].addJoint(otherIndexA);
           }
         }
         if (otherIndexC == indexC && otherIndexB == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexA, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexA, otherIndexA))
           {
-            vertexA.addJoint(otherIndexA);
+            joints[indexA].addJoint(otherIndexA);
           }
         }
 
         // check for vertexB
         if (otherIndexA == indexA && otherIndexB == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexC))
           {
-            vertexB.addJoint(otherIndexC);
+            joints[indexB].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexC && otherIndexB == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexC))
           {
-            vertexB.addJoint(otherIndexC);
+            joints[indexB].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexA && otherIndexC == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexB))
           {
-            vertexB.addJoint(otherIndexB);
+            joints[indexB].addJoint(otherIndexB);
           }
         }
         if (otherIndexA == indexC && otherIndexC == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexB))
           {
-            vertexB.addJoint(otherIndexB);
+            joints[indexB].addJoint(otherIndexB);
           }
         }
         if (otherIndexC == indexA && otherIndexB == indexC)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexA))
           {
-            vertexB.addJoint(otherIndexA);
+            joints[indexB].addJoint(otherIndexA);
           }
         }
         if (otherIndexC == indexC && otherIndexB == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexB, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexB, otherIndexA))
           {
-            vertexB.addJoint(otherIndexA);
+            joints[indexB].addJoint(otherIndexA);
           }
         }
 
         // check for vertexC
         if (otherIndexA == indexA && otherIndexB == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexC))
           {
-            vertexC.addJoint(otherIndexC);
+            joints[indexC].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexB && otherIndexB == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexC))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexC))
           {
-            vertexC.addJoint(otherIndexC);
+            joints[indexC].addJoint(otherIndexC);
           }
         }
         if (otherIndexA == indexA && otherIndexC == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexB))
           {
-            vertexC.addJoint(otherIndexB);
+            joints[indexC].addJoint(otherIndexB);
           }
         }
         if (otherIndexA == indexB && otherIndexC == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexB))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexB))
           {
-            vertexC.addJoint(otherIndexB);
+            joints[indexC].addJoint(otherIndexB);
           }
         }
 
         if (otherIndexC == indexA && otherIndexB == indexB)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexA))
           {
-            vertexC.addJoint(otherIndexA);
+            joints[indexC].addJoint(otherIndexA);
           }
         }
         if (otherIndexC == indexB && otherIndexB == indexA)
         {
-          if (isSharedVertex(physicsMesh->vertices.m_Data, vertexC, otherIndexA))
+          if (isSharedVertex(physicsMesh->vertices, indexC, otherIndexA))
           {
-            vertexC.addJoint(otherIndexA);
+            joints[indexC].addJoint(otherIndexA);
           }
         }
       }
@@ -473,29 +469,30 @@ void ObjScene::init(
           residentAllocator, physicsMesh->vertices.m_Size, physicsMesh->vertices.m_Size);
 
       // TODO: some of these might change at runtime
-      for (uint32_t vertexIndex = 0; vertexIndex < physicsMesh->vertices.m_Size; ++vertexIndex)
+      PhysicsVertices& vertices = physicsMesh->vertices;
+      for (uint32_t vertexIndex = 0; vertexIndex < vertices.m_Size; ++vertexIndex)
       {
-        PhysicsVertex& cpuData = physicsMesh->vertices[vertexIndex];
+        const PhysicsVertexJoints& vertexJoints = joints[vertexIndex];
 
         VkDrawIndirectCommand& indirectCommand = indirectCommands[vertexIndex];
 
         PhysicsVertexGpuData gpuData{};
-        gpuData.position = cpuData.position;
-        gpuData.startPosition = cpuData.startPosition;
-        gpuData.previousPosition = cpuData.previousPosition;
-        gpuData.normal = cpuData.normal;
-        gpuData.jointCount = cpuData.jointCount;
-        gpuData.velocity = cpuData.velocity;
-        gpuData.mass = cpuData.mass;
-        gpuData.force = cpuData.force;
-
-        for (uint32_t j = 0; j < cpuData.jointCount; ++j)
+        gpuData.position = vertices.get<PhysicsVertexField::kPosition>(vertexIndex);
+        gpuData.startPosition = vertices.get<PhysicsVertexField::kStartPosition>(vertexIndex);
+        gpuData.previousPosition = vertices.get<PhysicsVertexField::kPreviousPosition>(vertexIndex);
+        gpuData.normal = vertices.get<PhysicsVertexField::kNormal>(vertexIndex);
+        gpuData.jointCount = vertexJoints.jointCount;
+        gpuData.velocity = vertices.get<PhysicsVertexField::kVelocity>(vertexIndex);
+        gpuData.mass = vertices.get<PhysicsVertexField::kMass>(vertexIndex);
+        gpuData.force = vertices.get<PhysicsVertexField::kForce>(vertexIndex);
+
+        for (uint32_t j = 0; j < vertexJoints.jointCount; ++j)
         {
-          gpuData.joints[j] = cpuData.joints[j].vertexIndex;
+          gpuData.joints[j] = vertexJoints.joints[j].vertexIndex;
         }
 
         indirectCommand.vertexCount = 2;
-        indirectCommand.instanceCount = cpuData.jointCount;
+        indirectCommand.instanceCount = vertexJoints.jointCount;
         indirectCommand.firstVertex = 0;
         indirectCommand.firstInstance = 0;
 
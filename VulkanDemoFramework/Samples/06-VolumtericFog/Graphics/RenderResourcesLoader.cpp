@@ -426,22 +426,42 @@ static void parseGpuPipeline(
 void Graphics::RenderResourcesLoader::init(
     Graphics::RendererUtil::Renderer* p_Renderer,
     Framework::StackAllocator* p_TempAllocator,
-    Graphics::FrameGraph* p_FrameGraph)
+    Graphics::FrameGraph* p_FrameGraph,
+    enki::TaskScheduler* p_TaskScheduler)
 {
   renderer = p_Renderer;
   tempAllocator = p_TempAllocator;
   frameGraph = p_FrameGraph;
+  taskScheduler = p_TaskScheduler;
 }
 //---------------------------------------------------------------------------//
 void Graphics::RenderResourcesLoader::shutdown() {}
 //---------------------------------------------------------------------------//
+void Graphics::GpuTechniqueBuild::ExecuteRange(
+    enki::TaskSetPartition p_Range, uint32_t p_ThreadNum)
+{
+  for (uint32_t i = p_Range.start; i < p_Range.end; ++i)
+  {
+    renderer->createTechniquePass(technique, creation, i);
+  }
+}
+//---------------------------------------------------------------------------//
 Graphics::RendererUtil::GpuTechnique*
 Graphics::RenderResourcesLoader::loadGpuTechnique(const char* p_JsonPath)
+{
+  GpuTechniqueBuild build;
+  loadGpuTechniqueAsync(p_JsonPath, build);
+
+  return finishGpuTechnique(build);
+}
+//---------------------------------------------------------------------------//
+Graphics::RendererUtil::GpuTechnique* Graphics::RenderResourcesLoader::loadGpuTechniqueAsync(
+    const char* p_JsonPath, GpuTechniqueBuild& p_OutBuild)
 {
   using namespace Framework;
   size_t allocatedMarker = tempAllocator->getMarker();
 
-  FileReadResult readResult = fileReadText(p_JsonPath, tempAllocator);
+  ScopedFileMapping jsonFile(p_JsonPath, FileAccessHint::kSequential);
 
   StringBuffer path_buffer;
   path_buffer.init(1024, tempAllocator);
@@ -454,7 +474,8 @@ Graphics::RenderResourcesLoader::loadGpuTechnique(const char* p_JsonPath)
 
   using json = nlohmann::json;
 
-  json jsonData = json::parse(readResult.data);
+  const uint8_t* jsonText = jsonFile.m_Mapping.data;
+  json jsonData = json::parse(jsonText, jsonText + jsonFile.m_Mapping.size);
 
   // parse 1 pipeline
   json name = jsonData["name"];
@@ -520,19 +541,144 @@ Graphics::RenderResourcesLoader::loadGpuTechnique(const char* p_JsonPath)
     }
   }
 
-  // Create technique and cache it.
-  Graphics::RendererUtil::GpuTechnique* technique = renderer->createTechnique(techniqueCreation);
+  // Compile all stages of all passes in one batch, so that they can run in parallel.
+  {
+    static const uint32_t kMaxRequests =
+        sizeof(techniqueCreation.creations) / sizeof(techniqueCreation.creations[0]) *
+        kMaxShaderStages;
+    ShaderCompileRequest requests[kMaxRequests];
+    VkShaderModuleCreateInfo shaderCis[kMaxRequests];
+    uint32_t numRequests = 0;
+
+    for (uint32_t p = 0; p < techniqueCreation.numCreations; ++p)
+    {
+      const ShaderStateCreation& shaders = techniqueCreation.creations[p].shaders;
+      if (shaders.spvInput)
+        continue;
+
+      for (uint32_t s = 0; s < shaders.stagesCount; ++s)
+      {
+        const ShaderStage& stage = shaders.stages[s];
+        requests[numRequests++] = {stage.code, stage.codeSize, stage.type, shaders.name};
+      }
+    }
+
+    // Binaries live in the temporary allocator and are released with the marker below.
+    // Failed stages are left without code, the creation of their pipeline fails.
+    if (!renderer->m_GpuDevice->compileShaders(requests, numRequests, shaderCis, taskScheduler))
+    {
+      printf("Technique %s has shaders that failed to compile\n", p_JsonPath);
+    }
+
+    uint32_t requestIndex = 0;
+    for (uint32_t p = 0; p < techniqueCreation.numCreations; ++p)
+    {
+      ShaderStateCreation& shaders = techniqueCreation.creations[p].shaders;
+      if (shaders.spvInput)
+        continue;
+
+      for (uint32_t s = 0; s < shaders.stagesCount; ++s)
+      {
+        ShaderStage& stage = shaders.stages[s];
+        stage.code = reinterpret_cast<const char*>(shaderCis[requestIndex].pCode);
+        stage.codeSize = uint32_t(shaderCis[requestIndex].codeSize);
+        ++requestIndex;
+      }
+      shaders.setSpvInput(true);
+    }
+  }
+
+  // Move everything the pipelines reference out of the temporary allocator, so it can be
+  // released while the build runs.
+  p_OutBuild.creation = techniqueCreation;
+  size_t storageSize = 0;
+  for (uint32_t p = 0; p < techniqueCreation.numCreations; ++p)
+  {
+    const PipelineCreation& pc = techniqueCreation.creations[p];
+    for (uint32_t s = 0; s < pc.shaders.stagesCount; ++s)
+    {
+      storageSize += memoryAlign(pc.shaders.stages[s].codeSize, 4);
+    }
+    storageSize += pc.name ? strlen(pc.name) + 1 : 0;
+  }
+
+  p_OutBuild.storage = renderer->m_ResidentAllocator->allocate(storageSize, 4);
+  uint8_t* storage = (uint8_t*)p_OutBuild.storage;
+  for (uint32_t p = 0; p < techniqueCreation.numCreations; ++p)
+  {
+    PipelineCreation& pc = p_OutBuild.creation.creations[p];
+    for (uint32_t s = 0; s < pc.shaders.stagesCount; ++s)
+    {
+      ShaderStage& stage = pc.shaders.stages[s];
+      memoryCopy(storage, (void*)stage.code, stage.codeSize);
+      stage.code = (const char*)storage;
+      storage += memoryAlign(stage.codeSize, 4);
+    }
+    if (pc.name)
+    {
+      const size_t nameLength = strlen(pc.name) + 1;
+      memoryCopy(storage, (void*)pc.name, nameLength);
+      pc.name = (const char*)storage;
+      storage += nameLength;
+    }
+  }
 
   tempAllocator->freeMarker(allocatedMarker);
 
-  return technique;
+  // Create technique and cache it, pipelines are filled by the build.
+  p_OutBuild.renderer = renderer;
+  p_OutBuild.technique = renderer->createTechniqueDeferred(p_OutBuild.creation);
+  p_OutBuild.m_SetSize = p_OutBuild.technique ? p_OutBuild.creation.numCreations : 0;
+  p_OutBuild.m_MinRange = 1;
+
+  if (taskScheduler && p_OutBuild.m_SetSize > 0)
+  {
+    taskScheduler->AddTaskSetToPipe(&p_OutBuild);
+  }
+  else if (p_OutBuild.m_SetSize > 0)
+  {
+    p_OutBuild.ExecuteRange({0, p_OutBuild.m_SetSize}, 0);
+  }
+
+  return p_OutBuild.technique;
+}
+//---------------------------------------------------------------------------//
+bool Graphics::RenderResourcesLoader::isComplete(const GpuTechniqueBuild& p_Build) const
+{
+  return p_Build.GetIsComplete();
+}
+//---------------------------------------------------------------------------//
+Graphics::RendererUtil::GpuTechnique*
+Graphics::RenderResourcesLoader::finishGpuTechnique(GpuTechniqueBuild& p_Build)
+{
+  if (taskScheduler)
+  {
+    taskScheduler->WaitforTask(&p_Build);
+  }
+
+  if (p_Build.storage)
+  {
+    renderer->m_ResidentAllocator->deallocate(p_Build.storage);
+    p_Build.storage = nullptr;
+  }
+
+  return p_Build.technique;
 }
 //---------------------------------------------------------------------------//
 Graphics::RendererUtil::TextureResource*
 Graphics::RenderResourcesLoader::loadTexture(const char* p_Path, bool p_GenerateMipMaps)
 {
   int comp, width, height;
-  uint8_t* imageData = stbi_load(p_Path, &width, &height, &comp, 4);
+  uint8_t* imageData = nullptr;
+  {
+    // stb decodes from the mapped file instead of reading it in its own buffer.
+    ScopedFileMapping imageFile(p_Path, FileAccessHint::kSequential);
+    if (imageFile.m_Mapping.data)
+    {
+      imageData = stbi_load_from_memory(
+          imageFile.m_Mapping.data, (int)imageFile.m_Mapping.size, &width, &height, &comp, 4);
+    }
+  }
   if (!imageData)
   {
     printf("Error loading texture %s", p_Path);
@@ -2,26 +2,54 @@
 
 #include "Graphics/Renderer.hpp"
 
+#include "Externals/enkiTS/TaskScheduler.h"
+
 namespace Graphics
 {
 //---------------------------------------------------------------------------//
 struct FrameGraph;
 //---------------------------------------------------------------------------//
+// Pipeline-build phase of a technique, each pass pipeline is created by a task.
+// Owned by the caller, see RenderResourcesLoader::loadGpuTechniqueAsync.
+struct GpuTechniqueBuild : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition p_Range, uint32_t p_ThreadNum) override;
+
+  RendererUtil::Renderer* renderer = nullptr;
+  RendererUtil::GpuTechnique* technique = nullptr;
+  RendererUtil::GpuTechniqueCreation creation;
+
+  // Holds the SPIR-V and names referenced by creation until the build is finished.
+  void* storage = nullptr;
+};
+//---------------------------------------------------------------------------//
 struct RenderResourcesLoader
 {
   void init(
       RendererUtil::Renderer* p_Renderer,
       Framework::StackAllocator* p_TempAllocator,
-      FrameGraph* p_FrameGraph);
+      FrameGraph* p_FrameGraph,
+      enki::TaskScheduler* p_TaskScheduler = nullptr);
   void shutdown();
 
   Graphics::RendererUtil::GpuTechnique* loadGpuTechnique(const char* p_JsonPath);
+  // Parses the technique and compiles its shaders on the calling thread, then creates the pass
+  // pipelines on task threads. Poll the build with isComplete() and call finishGpuTechnique.
+  // Until then the calling thread is free to load other techniques and create other resources.
+  Graphics::RendererUtil::GpuTechnique*
+  loadGpuTechniqueAsync(const char* p_JsonPath, GpuTechniqueBuild& p_OutBuild);
+  bool isComplete(const GpuTechniqueBuild& p_Build) const;
+  // Waits for all pipelines of the technique and releases the build memory.
+  Graphics::RendererUtil::GpuTechnique* finishGpuTechnique(GpuTechniqueBuild& p_Build);
+
   Graphics::RendererUtil::TextureResource*
   loadTexture(const char* p_Path, bool p_GenerateMipMaps = true);
 
   RendererUtil::Renderer* renderer;
   FrameGraph* frameGraph;
   Framework::StackAllocator* tempAllocator;
+  // Optional, used to compile shaders and build pipelines in parallel.
+  enki::TaskScheduler* taskScheduler;
 };
 //---------------------------------------------------------------------------//
 } // namespace Graphics
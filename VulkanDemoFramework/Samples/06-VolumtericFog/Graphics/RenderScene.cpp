@@ -15,6 +15,7 @@
 #include "Externals/cglm/struct/mat4.h"
 #include "Externals/cglm/struct/vec3.h"
 #include "Externals/cglm/struct/quat.h"
+#include "Externals/cglm/struct/frustum.h"
 
 #include "Externals/stb_image.h"
 
@@ -23,6 +24,7 @@
 #include <assimp/postprocess.h>
 
 #include <math.h>
+#include <stddef.h>
 
 #if !defined(DATA_FOLDER)
 #  define DATA_FOLDER "\\Data\\"
@@ -96,8 +98,42 @@ static void copyGpuMeshMatrix(
 }
 
 //
-// PhysicsVertex ///////////////////////////////////////////////////////
-void PhysicsVertex::addJoint(uint32_t p_VertexIndex)
+// Material of the indirect draws, see mesh_indirect.h.
+static void copyGpuMaterialData(
+    GpuMaterialData& p_GpuMaterialData, const Mesh& p_Mesh, uint32_t p_MeshIndex)
+{
+  const PBRMaterial& material = p_Mesh.pbrMaterial;
+  const bool phong = (material.flags & DrawFlagsPhong) != 0;
+
+  p_GpuMaterialData = {};
+  p_GpuMaterialData.textures[0] = material.diffuseTextureIndex;
+  p_GpuMaterialData.textures[1] = material.roughnessTextureIndex;
+  p_GpuMaterialData.textures[2] = material.normalTextureIndex;
+  p_GpuMaterialData.textures[3] = material.occlusionTextureIndex;
+
+  p_GpuMaterialData.emissive = {
+      material.emissiveFactor.x,
+      material.emissiveFactor.y,
+      material.emissiveFactor.z,
+      (float)material.emissiveTextureIndex};
+
+  // Phong materials have no base colour, the shaders read their diffuse colour instead.
+  p_GpuMaterialData.base_color_factor = phong ? material.diffuseColour : material.baseColorFactor;
+  p_GpuMaterialData.metallic_roughness_occlusion_factor = {
+      material.metallicRoughnessOcclusionFactor.x,
+      material.metallicRoughnessOcclusionFactor.y,
+      material.metallicRoughnessOcclusionFactor.z,
+      material.specularExp};
+
+  p_GpuMaterialData.flags = material.flags;
+  p_GpuMaterialData.alpha_cutoff = material.alphaCutoff;
+  p_GpuMaterialData.vertex_offset = p_Mesh.mega_first_vertex;
+  p_GpuMaterialData.mesh_index = p_MeshIndex;
+}
+
+//
+// PhysicsVertexJoints /////////////////////////////////////////////////
+void PhysicsVertexJoints::addJoint(uint32_t p_VertexIndex)
 {
   for (uint32_t j = 0; j < jointCount; ++j)
   {
@@ -113,27 +149,19 @@ void PhysicsVertex::addJoint(uint32_t p_VertexIndex)
 
 //
 // DepthPrePass ///////////////////////////////////////////////////////
-void DepthPrePass::render(CommandBuffer* gpuCommands, RenderScene* renderScene)
+void DepthPrePass::pre_render(
+    uint32_t current_frame_index,
+    CommandBuffer* gpu_commands,
+    FrameGraph* frame_graph,
+    RenderScene* render_scene)
 {
+  render_scene->draw_queues[CullingList::kDepthPrePass].generate_gpu_commands(gpu_commands);
+}
 
-  RendererUtil::Material* lastMaterial = nullptr;
-  for (uint32_t meshIndex = 0; meshIndex < meshInstances.m_Size; ++meshIndex)
-  {
-    MeshInstance& meshInstance = meshInstances[meshIndex];
-    Mesh& mesh = *meshInstance.mesh;
-
-    if (mesh.pbrMaterial.material != lastMaterial)
-    {
-      PipelineHandle pipeline =
-          renderer->getPipeline(mesh.pbrMaterial.material, meshInstance.materialPassIndex);
-
-      gpuCommands->bindPipeline(pipeline);
-
-      lastMaterial = mesh.pbrMaterial.material;
-    }
-
-    renderScene->drawMesh(gpuCommands, mesh);
-  }
+void DepthPrePass::render(
+    uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene)
+{
+  render_scene->draw_queues[CullingList::kDepthPrePass].submit(gpu_commands, render_scene, false);
 }
 
 void DepthPrePass::prepareDraws(
@@ -195,27 +223,19 @@ void DepthPrePass::freeGpuResources()
 
 //
 // GBufferPass ////////////////////////////////////////////////////////
-void GBufferPass::render(CommandBuffer* gpuCommands, RenderScene* renderScene)
+void GBufferPass::pre_render(
+    uint32_t current_frame_index,
+    CommandBuffer* gpu_commands,
+    FrameGraph* frame_graph,
+    RenderScene* render_scene)
 {
+  render_scene->draw_queues[CullingList::kGBuffer].generate_gpu_commands(gpu_commands);
+}
 
-  RendererUtil::Material* lastMaterial = nullptr;
-  for (uint32_t meshIndex = 0; meshIndex < meshInstances.m_Size; ++meshIndex)
-  {
-    MeshInstance& meshInstance = meshInstances[meshIndex];
-    Mesh& mesh = *meshInstance.mesh;
-
-    if (mesh.pbrMaterial.material != lastMaterial)
-    {
-      PipelineHandle pipeline =
-          renderer->getPipeline(mesh.pbrMaterial.material, meshInstance.materialPassIndex);
-
-      gpuCommands->bindPipeline(pipeline);
-
-      lastMaterial = mesh.pbrMaterial.material;
-    }
-
-    renderScene->drawMesh(gpuCommands, mesh);
-  }
+void GBufferPass::render(
+    uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene)
+{
+  render_scene->draw_queues[CullingList::kGBuffer].submit(gpu_commands, render_scene, false);
 }
 
 void GBufferPass::prepareDraws(
@@ -410,27 +430,10 @@ void LighPass::freeGpuResources()
 
 //
 // TransparentPass ////////////////////////////////////////////////////////
-void TransparentPass::render(CommandBuffer* gpuCommands, RenderScene* renderScene)
+void TransparentPass::render(
+    uint32_t current_frame_index, CommandBuffer* gpu_commands, RenderScene* render_scene)
 {
-
-  RendererUtil::Material* lastMaterial = nullptr;
-  for (uint32_t meshIndex = 0; meshIndex < meshInstances.m_Size; ++meshIndex)
-  {
-    MeshInstance& meshInstance = meshInstances[meshIndex];
-    Mesh& mesh = *meshInstance.mesh;
-
-    if (mesh.pbrMaterial.material != lastMaterial)
-    {
-      PipelineHandle pipeline =
-          renderer->getPipeline(mesh.pbrMaterial.material, meshInstance.materialPassIndex);
-
-      gpuCommands->bindPipeline(pipeline);
-
-      lastMaterial = mesh.pbrMaterial.material;
-    }
-
-    renderScene->drawMesh(gpuCommands, mesh);
-  }
+  render_scene->draw_queues[CullingList::kTransparent].submit(gpu_commands, render_scene, true);
 }
 
 void TransparentPass::prepareDraws(
@@ -1220,6 +1223,8 @@ void RenderScene::uploadGpuData()
       renderer->m_GpuDevice->unmapBuffer(cbMap);
     }
   }
+
+  upload_mesh_instances(renderer->m_GpuDevice->m_AbsoluteFrameIndex % k_max_frames);
 }
 
 void RenderScene::drawMesh(CommandBuffer* gpuCommands, Mesh& mesh)
@@ -1260,128 +1265,1623 @@ void RenderScene::drawMesh(CommandBuffer* gpuCommands, Mesh& mesh)
   gpuCommands->drawIndexed(TopologyType::kTriangle, mesh.primitiveCount, 1, 0, 0, 0);
 }
 
-// DrawTask ///////////////////////////////////////////////////////////////
-void DrawTask::init(
-    Graphics::GpuDevice* p_Gpu,
-    FrameGraph* p_FrameGraph,
-    RendererUtil::Renderer* p_Renderer,
-    Graphics::ImguiUtil::ImguiService* p_Imgui,
-    RenderScene* p_Scene,
-    FrameRenderer* p_FrameRenderer)
+void RenderScene::draw_mesh_instance(
+    CommandBuffer* gpu_commands, uint32_t mesh_instance_index, bool transparent)
 {
-  gpu = p_Gpu;
-  frameGraph = p_FrameGraph;
-  renderer = p_Renderer;
-  imgui = p_Imgui;
-  scene = p_Scene;
-  frameRenderer = p_FrameRenderer;
+  Mesh& mesh = *mesh_instances.get<MeshInstanceField::kMesh>(mesh_instance_index);
+
+  BufferHandle buffers[]{
+      mesh.positionBuffer,
+      mesh.tangentBuffer,
+      mesh.normalBuffer,
+      mesh.texcoordBuffer,
+      mesh.jointsBuffer,
+      mesh.weightsBuffer};
+  uint32_t offsets[]{
+      mesh.positionOffset,
+      mesh.tangentOffset,
+      mesh.normalOffset,
+      mesh.texcoordOffset,
+      mesh.jointsOffset,
+      mesh.weightsOffset};
+  gpu_commands->bindVertexBuffers(buffers, 0, mesh.hasSkinning() ? 6 : 4, offsets);
+
+  gpu_commands->bindIndexBuffer(mesh.indexBuffer, mesh.indexOffset, mesh.indexType);
+
+  if (g_RecreatePerThreadDescriptors)
+  {
+    DescriptorSetCreation ds_creation{};
+    ds_creation.buffer(scene_cb, 0).buffer(mesh.pbrMaterial.materialBuffer, 1);
+    DescriptorSetHandle descriptor_set =
+        renderer->createDescriptorSet(gpu_commands, mesh.pbrMaterial.material, ds_creation);
+
+    gpu_commands->bindLocalDescriptorSet(&descriptor_set, 1, nullptr, 0);
+  }
+  else
+  {
+    DescriptorSetHandle descriptor_set = transparent ? mesh.pbrMaterial.descriptor_set_transparent
+                                                     : mesh.pbrMaterial.descriptor_set_main;
+    gpu_commands->bindDescriptorSet(&descriptor_set, 1, nullptr, 0);
+  }
 
-  currentFrameIndex = gpu->m_CurrentFrameIndex;
-  currentFramebuffer = gpu->getCurrentFramebuffer();
+  gpu_commands->drawIndexed(
+      TopologyType::kTriangle,
+      mesh.primitiveCount,
+      1,
+      0,
+      0,
+      mesh_instances.get<MeshInstanceField::kGpuMeshInstanceIndex>(mesh_instance_index));
 }
 
-void DrawTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+void RenderScene::prepare_indirect_draws(Renderer* p_Renderer)
 {
-  using namespace Graphics;
+  GpuDevice& gpu = *p_Renderer->m_GpuDevice;
 
-  threadId = threadnum_;
+  const uint32_t* gpu_mesh_instance_indices =
+      mesh_instances.column<MeshInstanceField::kGpuMeshInstanceIndex>();
+  uint32_t gpu_mesh_instance_count = 0;
+  for (uint32_t i = 0; i < mesh_instances.m_Size; ++i)
+  {
+    const uint32_t count = gpu_mesh_instance_indices[i] + 1;
+    gpu_mesh_instance_count = count > gpu_mesh_instance_count ? count : gpu_mesh_instance_count;
+  }
 
-  // printf( "Executing draw task from thread %u\n", threadnum_ );
-  // TODO: improve getting a command buffer/pool
-  CommandBuffer* gpuCommands = gpu->getCommandBuffer(threadnum_, currentFrameIndex, true);
-  gpuCommands->pushMarker("Frame");
+  // The first instance of each command selects its instance data.
+  if (mega_buffers.index_buffer.index == kInvalidIndex || gpu_mesh_instance_count == 0 ||
+      !gpu.m_MultiDrawIndirectSupported || !gpu.m_DrawIndirectFirstInstanceSupported)
+  {
+    use_indirect_draws = false;
+    return;
+  }
+
+  BufferCreation buffer_creation{};
+  buffer_creation
+      .set(
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          ResourceUsageType::kDynamic,
+          sizeof(GpuMaterialData) * meshes.m_Size)
+      .setName("meshes_sb");
+  meshes_sb = gpu.createBuffer(buffer_creation);
+
+  // Instances are written every frame, each frame in flight reads its own copy.
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    buffer_creation.reset()
+        .set(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            ResourceUsageType::kDynamic,
+            sizeof(GpuMeshInstanceData) * gpu_mesh_instance_count)
+        .setName("mesh_instances_sb");
+    mesh_instances_sb[f] = gpu.createBuffer(buffer_creation);
+  }
 
-  frameGraph->render(currentFrameIndex, gpuCommands, scene);
+  if (gpu.m_DrawIndirectCountExtensionPresent)
+  {
+    buffer_creation.reset()
+        .set(
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            ResourceUsageType::kDynamic,
+            sizeof(GpuIndirectCullConstants))
+        .setName("indirect_cull_cb");
+    indirect_cull_cb = gpu.createBuffer(buffer_creation);
+  }
 
-  gpuCommands->pushMarker("Fullscreen");
-  gpuCommands->clear(0.3f, 0.3f, 0.3f, 1.f, 0);
-  gpuCommands->clearDepthStencil(1.0f, 0);
-  gpuCommands->bindPass(gpu->m_SwapchainRenderPass, currentFramebuffer, false);
-  gpuCommands->setScissor(nullptr);
-  gpuCommands->setViewport(nullptr);
+  // Materials do not change after loading.
+  MapBufferParameters materials_map = {meshes_sb, 0, 0};
+  GpuMaterialData* materials = (GpuMaterialData*)gpu.mapBuffer(materials_map);
+  if (materials)
+  {
+    for (uint32_t mesh_index = 0; mesh_index < meshes.m_Size; ++mesh_index)
+    {
+      copyGpuMaterialData(materials[mesh_index], meshes[mesh_index], mesh_index);
+    }
 
-  // Apply fullscreen material
-  FrameGraphResource* texture = frameGraph->getResource("final");
-  assert(texture != nullptr);
+    gpu.unmapBuffer(materials_map);
+  }
 
-  gpuCommands->bindPipeline(frameRenderer->fullscreenTech->passes[0].pipeline);
-  gpuCommands->bindDescriptorSet(&frameRenderer->fullscreenDS, 1, nullptr, 0);
-  gpuCommands->draw(
-      TopologyType::kTriangle,
-      0,
-      3,
-      texture->resourceInfo.texture.handle[currentFrameIndex].index,
-      1);
+  // Double sided and back face culled variants, of the opaque queues only: transparent packets
+  // are drawn one by one to keep them back to front.
+  static const char* k_indirect_pass_names[CullingList::kTransparent][2] = {
+      {"depth_pre_indirect", "depth_pre_indirect_cull"},
+      {"gbuffer_indirect", "gbuffer_indirect_cull"}};
 
-  imgui->render(*gpuCommands, false);
+  RendererUtil::GpuTechnique* main_technique =
+      p_Renderer->m_ResourceCache.m_Techniques.get(hashCalculate("main"));
 
-  gpuCommands->popMarker();
-  gpuCommands->popMarker();
+  for (uint32_t l = 0; l < CullingList::kTransparent; ++l)
+  {
+    DrawPacketQueue& queue = draw_queues[l];
+
+    uint32_t pass_index =
+        main_technique->nameHashToIndex.get(hashCalculate(k_indirect_pass_names[l][0]));
+    queue.indirect_pipeline = main_technique->passes[pass_index].pipeline;
+    pass_index = main_technique->nameHashToIndex.get(hashCalculate(k_indirect_pass_names[l][1]));
+    queue.indirect_cull_pipeline = main_technique->passes[pass_index].pipeline;
 
-  // Send commands to GPU
-  gpu->queueCommandBuffer(gpuCommands);
+    for (uint32_t f = 0; f < k_max_frames; ++f)
+    {
+      DescriptorSetCreation ds_creation{};
+      // mesh_indirect.h declares the materials for every pass, the depth pre pass included.
+      ds_creation.buffer(scene_cb, 0).buffer(mesh_instances_sb[f], 2).buffer(meshes_sb, 3);
+      ds_creation
+          .setLayout(
+              gpu.getDescriptorSetLayout(queue.indirect_pipeline, kMaterialDescriptorSetIndex))
+          .setName(k_indirect_pass_names[l][0]);
+      queue.indirect_descriptor_set[f] = gpu.createDescriptorSet(ds_creation);
+    }
+  }
 }
 
-// FrameRenderer //////////////////////////////////////////////////////////
-void FrameRenderer::init(
-    Framework::Allocator* p_ResidentAllocator,
-    RendererUtil::Renderer* p_Renderer,
-    FrameGraph* p_FrameGraph,
-    SceneGraph* p_SceneGraph,
-    RenderScene* p_Scene)
+void RenderScene::upload_mesh_instances(uint32_t frame_index)
 {
-  residentAllocator = p_ResidentAllocator;
-  renderer = p_Renderer;
-  frameGraph = p_FrameGraph;
-  sceneGraph = p_SceneGraph;
-  scene = p_Scene;
+  if (mesh_instances_sb[frame_index].index == kInvalidIndex)
+  {
+    return;
+  }
 
-  frameGraph->builder->registerRenderPass("depth_pre_pass", &depthPrePass);
-  frameGraph->builder->registerRenderPass("gbuffer_pass", &gbufferPass);
-  frameGraph->builder->registerRenderPass("lighting_pass", &lightPass);
-  frameGraph->builder->registerRenderPass("transparent_pass", &transparentPass);
-  frameGraph->builder->registerRenderPass("depth_of_field_pass", &dofPass);
-  frameGraph->builder->registerRenderPass("debug_pass", &debugPass);
+  GpuDevice& gpu = *renderer->m_GpuDevice;
+
+  MapBufferParameters instances_map = {mesh_instances_sb[frame_index], 0, 0};
+  GpuMeshInstanceData* instances = (GpuMeshInstanceData*)gpu.mapBuffer(instances_map);
+  if (instances == nullptr)
+  {
+    return;
+  }
+
+  Mesh* const* instance_meshes = mesh_instances.column<MeshInstanceField::kMesh>();
+  const uint32_t* gpu_mesh_instance_indices =
+      mesh_instances.column<MeshInstanceField::kGpuMeshInstanceIndex>();
+  const uint32_t* scene_graph_node_indices =
+      mesh_instances.column<MeshInstanceField::kSceneGraphNodeIndex>();
+
+  // NOTE: same global scale and Z flip as the per mesh uniforms.
+  const mat4s scale_matrix = glms_scale_make({global_scale, global_scale, -global_scale});
+
+  for (uint32_t i = 0; i < mesh_instances.m_Size; ++i)
+  {
+    GpuMeshInstanceData& instance = instances[gpu_mesh_instance_indices[i]];
+    instance.world =
+        glms_mat4_mul(scale_matrix, scene_graph->worldMatrices[scene_graph_node_indices[i]]);
+    instance.inverse_world = glms_mat4_inv(glms_mat4_transpose(instance.world));
+    instance.mesh_index = (uint32_t)(instance_meshes[i] - meshes.m_Data);
+  }
+
+  gpu.unmapBuffer(instances_map);
 }
 
-void FrameRenderer::shutdown()
+void RenderScene::free_indirect_draws(GpuDevice& gpu)
 {
-  depthPrePass.freeGpuResources();
-  gbufferPass.freeGpuResources();
-  lightPass.freeGpuResources();
-  transparentPass.freeGpuResources();
-  // TODO: check that node is enabled before calling
-  // dofPass.freeGpuResources();
-  debugPass.freeGpuResources();
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    DrawPacketQueue& queue = draw_queues[l];
+    queue.free_gpu_commands(gpu);
 
-  renderer->m_GpuDevice->destroyDescriptorSet(fullscreenDS);
+    for (uint32_t f = 0; f < k_max_frames; ++f)
+    {
+      if (queue.indirect_commands_sb[f].index != kInvalidIndex)
+      {
+        gpu.destroyBuffer(queue.indirect_commands_sb[f]);
+        queue.indirect_commands_sb[f] = kInvalidBuffer;
+      }
+    }
+    queue.indirect_command_capacity = 0;
+    queue.indirect_command_count = 0;
+    queue.indirect_cull_count = 0;
+
+    for (uint32_t f = 0; f < k_max_frames; ++f)
+    {
+      if (queue.indirect_descriptor_set[f].index != kInvalidIndex)
+      {
+        gpu.destroyDescriptorSet(queue.indirect_descriptor_set[f]);
+        queue.indirect_descriptor_set[f] = kInvalidSet;
+      }
+    }
+  }
+
+  if (meshes_sb.index != kInvalidIndex)
+  {
+    gpu.destroyBuffer(meshes_sb);
+    meshes_sb = kInvalidBuffer;
+  }
+  if (indirect_cull_cb.index != kInvalidIndex)
+  {
+    gpu.destroyBuffer(indirect_cull_cb);
+    indirect_cull_cb = kInvalidBuffer;
+  }
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    if (mesh_instances_sb[f].index != kInvalidIndex)
+    {
+      gpu.destroyBuffer(mesh_instances_sb[f]);
+      mesh_instances_sb[f] = kInvalidBuffer;
+    }
+  }
 }
 
-void FrameRenderer::uploadGpuData()
+// MeshMegaBuffers ////////////////////////////////////////////////////////
+static const uint32_t k_mesh_stream_strides[MeshStream::kCount] = {12, 16, 12, 8};
+static const char* k_mesh_stream_names[MeshStream::kCount] = {
+    "mega_positions", "mega_tangents", "mega_normals", "mega_texcoords"};
+
+void MeshMegaBuffers::init(Allocator* allocator, uint32_t vertex_capacity, uint32_t index_capacity)
 {
-  lightPass.uploadGpuData();
-  // dof_pass.uploadGpuData();
+  for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+  {
+    stream_data[s].init(allocator, vertex_capacity * k_mesh_stream_strides[s]);
+    streams[s] = kInvalidBuffer;
+  }
+  index_data.init(allocator, index_capacity);
 
-  scene->uploadGpuData();
+  vertex_count = 0;
+  index_count = 0;
+  index_buffer = kInvalidBuffer;
 }
 
-void FrameRenderer::render(CommandBuffer* gpuCommands, RenderScene* renderScene) {}
+void MeshMegaBuffers::shutdown(GpuDevice& gpu)
+{
+  for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+  {
+    stream_data[s].shutdown();
+    if (streams[s].index != kInvalidIndex)
+    {
+      gpu.destroyBuffer(streams[s]);
+      streams[s] = kInvalidBuffer;
+    }
+  }
+  index_data.shutdown();
 
-void FrameRenderer::prepareDraws(Framework::StackAllocator* scratchAllocator)
+  if (index_buffer.index != kInvalidIndex)
+  {
+    gpu.destroyBuffer(index_buffer);
+    index_buffer = kInvalidBuffer;
+  }
+}
+
+void MeshMegaBuffers::add_mesh(
+    const MeshStreamSource* sources,
+    uint32_t mesh_vertex_count,
+    const void* indices,
+    VkIndexType index_type,
+    uint32_t mesh_index_count,
+    uint32_t& out_first_vertex,
+    uint32_t& out_first_index)
 {
+  out_first_vertex = vertex_count;
+  out_first_index = index_count;
 
-  scene->prepareDraws(renderer, scratchAllocator, sceneGraph);
+  for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+  {
+    const uint32_t stride = k_mesh_stream_strides[s];
+    Array<uint8_t>& data = stream_data[s];
+    data.setSize((vertex_count + mesh_vertex_count) * stride);
 
-  depthPrePass.prepareDraws(
-      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
-  gbufferPass.prepareDraws(
-      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
-  lightPass.prepareDraws(*scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
-  transparentPass.prepareDraws(
-      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
-  // dofPass.prepareDraws( *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator
-  // );
-  debugPass.prepareDraws(*scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+    uint8_t* destination = data.m_Data + vertex_count * stride;
+    const MeshStreamSource& source = sources[s];
+    if (source.data == nullptr)
+    {
+      memset(destination, 0, mesh_vertex_count * stride);
+      continue;
+    }
+
+    const uint32_t copy_size = source.element_size < stride ? source.element_size : stride;
+    const uint8_t* source_data = (const uint8_t*)source.data;
+    for (uint32_t v = 0; v < mesh_vertex_count; ++v)
+    {
+      memcpy(destination, source_data, copy_size);
+      memset(destination + copy_size, 0, stride - copy_size);
+
+      destination += stride;
+      source_data += source.stride;
+    }
+  }
+
+  index_data.setSize(index_count + mesh_index_count);
+  uint32_t* destination_indices = index_data.m_Data + index_count;
+  if (index_type == VK_INDEX_TYPE_UINT16)
+  {
+    const uint16_t* source_indices = (const uint16_t*)indices;
+    for (uint32_t i = 0; i < mesh_index_count; ++i)
+    {
+      destination_indices[i] = source_indices[i];
+    }
+  }
+  else
+  {
+    memcpy(destination_indices, indices, mesh_index_count * sizeof(uint32_t));
+  }
+
+  vertex_count += mesh_vertex_count;
+  index_count += mesh_index_count;
+}
+
+void MeshMegaBuffers::create_gpu_buffers(Renderer* renderer)
+{
+  GpuDevice& gpu = *renderer->m_GpuDevice;
+
+  if (index_count > 0)
+  {
+    BufferCreation creation{};
+    for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+    {
+      creation.reset()
+          .set(
+              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+              ResourceUsageType::kImmutable,
+              stream_data[s].m_Size)
+          .setData(stream_data[s].m_Data)
+          .setName(k_mesh_stream_names[s]);
+      streams[s] = gpu.createBuffer(creation);
+    }
+
+    creation.reset()
+        .set(
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            ResourceUsageType::kImmutable,
+            index_data.m_Size * sizeof(uint32_t))
+        .setData(index_data.m_Data)
+        .setName("mega_indices");
+    index_buffer = gpu.createBuffer(creation);
+  }
+
+  for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+  {
+    stream_data[s].shutdown();
+  }
+  index_data.shutdown();
+}
+
+void MeshMegaBuffers::bind_mesh(Mesh& mesh) const
+{
+  BufferHandle* mesh_buffers[MeshStream::kCount] = {
+      &mesh.positionBuffer, &mesh.tangentBuffer, &mesh.normalBuffer, &mesh.texcoordBuffer};
+  uint32_t* mesh_offsets[MeshStream::kCount] = {
+      &mesh.positionOffset, &mesh.tangentOffset, &mesh.normalOffset, &mesh.texcoordOffset};
+  for (uint32_t s = 0; s < MeshStream::kCount; ++s)
+  {
+    *mesh_buffers[s] = streams[s];
+    *mesh_offsets[s] = mesh.mega_first_vertex * k_mesh_stream_strides[s];
+  }
+
+  mesh.indexBuffer = index_buffer;
+  mesh.indexOffset = mesh.mega_first_index * sizeof(uint32_t);
+  mesh.indexType = VK_INDEX_TYPE_UINT32;
+}
+
+// FrustumCulling /////////////////////////////////////////////////////////
+struct FrustumCullingTask : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override;
+
+  FrustumCulling* culling = nullptr;
+  const MeshInstances* mesh_instances = nullptr;
+  const SceneGraph* scene_graph = nullptr;
+  mat4s scale_matrix;
+}; // struct FrustumCullingTask
+
+void FrustumCullingTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+{
+  static const uint32_t k_batch_size = FrustumCulling::k_batch_size;
+
+  Mesh* const* meshes = mesh_instances->column<MeshInstanceField::kMesh>();
+  const uint32_t* nodes = mesh_instances->column<MeshInstanceField::kSceneGraphNodeIndex>();
+  const uint32_t instance_count = mesh_instances->m_Size;
+
+  // Spheres of a batch as columns, so every plane is tested against four of them at once.
+  alignas(16) float center_x[k_batch_size];
+  alignas(16) float center_y[k_batch_size];
+  alignas(16) float center_z[k_batch_size];
+  alignas(16) float radius[k_batch_size];
+
+  // Depths are still needed for sorting when culling is disabled.
+  const __m128 force_visible =
+      culling->enabled ? _mm_setzero_ps() : _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+  for (uint32_t batch = range_.start; batch < range_.end; ++batch)
+  {
+    const uint32_t first = batch * k_batch_size;
+    const uint32_t count =
+        instance_count - first < k_batch_size ? instance_count - first : k_batch_size;
+    const uint32_t padded_count = (count + 3) & ~3u;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const Mesh* mesh = meshes[first + i];
+      const mat4s world =
+          scene_graph ? glms_mat4_mul(scale_matrix, scene_graph->worldMatrices[nodes[first + i]])
+                      : scale_matrix;
+
+      const vec4s sphere = mesh->bounding_sphere;
+      const vec3s center = glms_mat4_mulv3(world, {sphere.x, sphere.y, sphere.z}, 1.f);
+      // Largest axis scale, so non uniform scales keep the sphere conservative.
+      const float scale_x = glms_vec3_norm(glms_vec3(world.col[0]));
+      const float scale_y = glms_vec3_norm(glms_vec3(world.col[1]));
+      const float scale_z = glms_vec3_norm(glms_vec3(world.col[2]));
+      const float scale = glm_max(scale_x, glm_max(scale_y, scale_z));
+
+      center_x[i] = center.x;
+      center_y[i] = center.y;
+      center_z[i] = center.z;
+      // Skinned and cloth meshes move away from their bind pose bounds: always visible.
+      radius[i] = (mesh->hasSkinning() || mesh->isCloth()) ? FLT_MAX : sphere.w * scale;
+    }
+
+    for (uint32_t i = count; i < padded_count; ++i)
+    {
+      center_x[i] = center_y[i] = center_z[i] = radius[i] = 0.f;
+    }
+
+    uint8_t* visible = culling->instance_visible.m_Data + first;
+    float* depth = culling->instance_depth.m_Data + first;
+    uint32_t visible_count = 0;
+
+    for (uint32_t i = 0; i < count; i += 4)
+    {
+      const __m128 x = _mm_load_ps(center_x + i);
+      const __m128 y = _mm_load_ps(center_y + i);
+      const __m128 z = _mm_load_ps(center_z + i);
+      const __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(radius + i));
+
+      // Inside when the signed distance to every plane is above minus the radius.
+      __m128 inside = _mm_cmpeq_ps(x, x);
+      __m128 near_distance = _mm_setzero_ps();
+      for (uint32_t p = 0; p < 6; ++p)
+      {
+        const vec4s& plane = culling->planes[p];
+
+        __m128 distance = _mm_mul_ps(x, _mm_set1_ps(plane.x));
+        distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+        distance = _mm_add_ps(distance, _mm_set1_ps(plane.w));
+
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+        near_distance = p == 4 ? distance : near_distance;
+      }
+      inside = _mm_or_ps(inside, force_visible);
+
+      alignas(16) float lane_depth[4];
+      _mm_store_ps(lane_depth, near_distance);
+
+      const uint32_t mask = (uint32_t)_mm_movemask_ps(inside);
+      const uint32_t lanes = count - i < 4 ? count - i : 4;
+      for (uint32_t l = 0; l < lanes; ++l)
+      {
+        visible[i + l] = (mask >> l) & 1;
+        visible_count += (mask >> l) & 1;
+        depth[i + l] = lane_depth[l];
+      }
+    }
+
+    culling->batch_visible_counts[batch] = visible_count;
+  }
+}
+
+void FrustumCulling::init(Allocator* allocator)
+{
+  instance_visible.init(allocator, 64);
+  instance_depth.init(allocator, 64);
+  batch_visible_counts.init(allocator, 16);
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    visible_draws[l].init(allocator, 64);
+  }
+}
+
+void FrustumCulling::shutdown()
+{
+  instance_visible.shutdown();
+  instance_depth.shutdown();
+  batch_visible_counts.shutdown();
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    visible_draws[l].shutdown();
+  }
+}
+
+void FrustumCulling::cull(
+    const MeshInstances& mesh_instances,
+    const SceneGraph* scene_graph,
+    float global_scale,
+    const mat4s& view_projection,
+    enki::TaskScheduler* task_scheduler)
+{
+  const uint32_t instance_count = mesh_instances.m_Size;
+  instance_visible.setSize(instance_count);
+  instance_depth.setSize(instance_count);
+
+  glms_frustum_planes(view_projection, planes);
+
+  if (instance_count == 0)
+  {
+    instance_stats = {0, 0};
+    return;
+  }
+
+  const uint32_t batch_count = (instance_count + k_batch_size - 1) / k_batch_size;
+  batch_visible_counts.setSize(batch_count);
+
+  FrustumCullingTask culling_task;
+  culling_task.culling = this;
+  culling_task.mesh_instances = &mesh_instances;
+  culling_task.scene_graph = scene_graph;
+  // Same global scale as the mesh matrices, see copyGpuMeshMatrix.
+  culling_task.scale_matrix = glms_scale_make({global_scale, global_scale, -global_scale});
+  culling_task.m_SetSize = batch_count;
+  culling_task.m_MinRange = 1;
+
+  task_scheduler->AddTaskSetToPipe(&culling_task);
+  task_scheduler->WaitforTask(&culling_task);
+
+  uint32_t visible_count = 0;
+  for (uint32_t b = 0; b < batch_count; ++b)
+  {
+    visible_count += batch_visible_counts[b];
+  }
+  instance_stats = {visible_count, instance_count - visible_count};
+}
+
+void FrustumCulling::compact_draws(CullingList::Enum list, const Array<MeshInstanceDraw>& draws)
+{
+  Array<uint32_t>& visible = visible_draws[list];
+  visible.setSize(draws.m_Size);
+
+  // Branchless: every index is written, and kept only when its instance is visible.
+  uint32_t count = 0;
+  for (uint32_t d = 0; d < draws.m_Size; ++d)
+  {
+    visible[count] = d;
+    count += instance_visible[draws[d].mesh_instance_index];
+  }
+  visible.setSize(count);
+
+  list_stats[list] = {count, draws.m_Size - count};
+}
+
+// DrawPacketQueue ////////////////////////////////////////////////////////
+struct DrawPacketSortTask : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override;
+
+  DrawPacketQueue* queue = nullptr;
+  const DrawPacket* source = nullptr;
+  DrawPacket* destination = nullptr;
+  uint32_t shift = 0;
+  bool scatter = false;
+}; // struct DrawPacketSortTask
+
+void DrawPacketSortTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+{
+  static const uint32_t k_radix_size = DrawPacketQueue::k_radix_size;
+  const uint32_t packet_count = queue->packets.m_Size;
+  const uint32_t chunk_size = queue->chunk_size;
+
+  for (uint32_t chunk = range_.start; chunk < range_.end; ++chunk)
+  {
+    const uint32_t first = chunk * chunk_size;
+    const uint32_t last = first + chunk_size < packet_count ? first + chunk_size : packet_count;
+    uint32_t* offsets = queue->chunk_offsets.m_Data + chunk * k_radix_size;
+
+    if (!scatter)
+    {
+      memset(offsets, 0, k_radix_size * sizeof(uint32_t));
+      for (uint32_t p = first; p < last; ++p)
+      {
+        ++offsets[(source[p].sort_key >> shift) & (k_radix_size - 1)];
+      }
+      continue;
+    }
+
+    // Chunks keep their order and so do packets inside a chunk: the sort is stable.
+    for (uint32_t p = first; p < last; ++p)
+    {
+      const uint32_t digit = (source[p].sort_key >> shift) & (k_radix_size - 1);
+      destination[offsets[digit]++] = source[p];
+    }
+  }
+}
+
+// Jobs over a single chunk run on the calling thread.
+static void run_chunk_task(enki::ITaskSet& task, enki::TaskScheduler* task_scheduler)
+{
+  if (task.m_SetSize > 1)
+  {
+    task_scheduler->AddTaskSetToPipe(&task);
+    task_scheduler->WaitforTask(&task);
+  }
+  else
+  {
+    task.ExecuteRange({0, 1}, 0);
+  }
+}
+
+struct DrawPacketBuildTask : public enki::ITaskSet
+{
+  void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override;
+
+  DrawPacketQueue* queue = nullptr;
+  const Array<MeshInstanceDraw>* draws = nullptr;
+  const FrustumCulling* culling = nullptr;
+  Mesh* const* meshes = nullptr;
+  Renderer* renderer = nullptr;
+  float inverse_depth_range = 0.f;
+  CullingList::Enum pass = CullingList::kCount;
+  bool transparent = false;
+}; // struct DrawPacketBuildTask
+
+// Depth is normalized to the near and far planes.
+static uint64_t compute_sort_key(
+    DrawSortOrder::Enum order,
+    uint32_t pass,
+    PipelineHandle pipeline,
+    DescriptorSetHandle descriptor_set,
+    const Mesh& mesh,
+    float depth)
+{
+  using namespace DrawSortKey;
+
+  depth = depth < 0.f ? 0.f : (depth > 1.f ? 1.f : depth);
+  uint64_t key = field(pass, k_pass_bits, k_pass_shift);
+
+  if (order == DrawSortOrder::kState)
+  {
+    const uint32_t depth_bucket = (uint32_t)(depth * (float)((1u << k_depth_bits) - 1));
+
+    key |= field(pipeline.index, k_pipeline_bits, k_pipeline_shift);
+    key |= field(descriptor_set.index, k_descriptor_set_bits, k_descriptor_set_shift);
+    key |= field(mesh.positionBuffer.index, k_vertex_buffer_bits, k_vertex_buffer_shift);
+    key |= field(mesh.indexBuffer.index, k_index_buffer_bits, k_index_buffer_shift);
+    key |= field(depth_bucket, k_depth_bits, k_depth_shift);
+    return key;
+  }
+
+  const uint32_t max_depth = (1u << k_sorted_depth_bits) - 1;
+  uint32_t sorted_depth = (uint32_t)((double)depth * max_depth);
+  sorted_depth = order == DrawSortOrder::kBackToFront ? max_depth - sorted_depth : sorted_depth;
+
+  key |= field(sorted_depth, k_sorted_depth_bits, k_sorted_depth_shift);
+  key |= field(pipeline.index, k_sorted_pipeline_bits, k_sorted_pipeline_shift);
+  key |= field(descriptor_set.index, k_sorted_descriptor_set_bits, k_sorted_descriptor_set_shift);
+  key |= field(
+      mesh.positionBuffer.index, k_sorted_vertex_buffer_bits, k_sorted_vertex_buffer_shift);
+  return key;
+}
+
+void DrawPacketBuildTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+{
+  const Array<uint32_t>& visible_draws = culling->visible_draws[pass];
+  const uint32_t packet_count = visible_draws.m_Size;
+  const uint32_t chunk_size = queue->chunk_size;
+
+  for (uint32_t chunk = range_.start; chunk < range_.end; ++chunk)
+  {
+    const uint32_t first = chunk * chunk_size;
+    const uint32_t last = first + chunk_size < packet_count ? first + chunk_size : packet_count;
+
+    // Draws of the same material come in runs, so the pipeline lookup is done once per run.
+    RendererUtil::Material* last_material = nullptr;
+    uint32_t last_material_pass_index = UINT32_MAX;
+    PipelineHandle pipeline = kInvalidPipeline;
+
+    uint64_t key_or = 0;
+    uint64_t key_and = ~0ull;
+
+    for (uint32_t v = first; v < last; ++v)
+    {
+      const MeshInstanceDraw& draw = (*draws)[visible_draws[v]];
+      const Mesh& mesh = *meshes[draw.mesh_instance_index];
+
+      if (mesh.pbrMaterial.material != last_material ||
+          draw.material_pass_index != last_material_pass_index)
+      {
+        pipeline = renderer->getPipeline(mesh.pbrMaterial.material, draw.material_pass_index);
+        last_material = mesh.pbrMaterial.material;
+        last_material_pass_index = draw.material_pass_index;
+      }
+
+      const DescriptorSetHandle descriptor_set = transparent
+                                                     ? mesh.pbrMaterial.descriptor_set_transparent
+                                                     : mesh.pbrMaterial.descriptor_set_main;
+      const float depth = culling->instance_depth[draw.mesh_instance_index] * inverse_depth_range;
+
+      DrawPacket& packet = queue->packets[v];
+      packet.sort_key =
+          compute_sort_key(queue->order, pass, pipeline, descriptor_set, mesh, depth);
+      packet.mesh_instance_index = draw.mesh_instance_index;
+      packet.pipeline = pipeline;
+
+      key_or |= packet.sort_key;
+      key_and &= packet.sort_key;
+    }
+
+    queue->chunk_key_or[chunk] = key_or;
+    queue->chunk_key_and[chunk] = key_and;
+  }
+}
+
+void DrawPacketQueue::init(Allocator* allocator)
+{
+  packets.init(allocator, 64);
+  scratch_packets.init(allocator, 64);
+  chunk_offsets.init(allocator, k_radix_size);
+  cpu_draws.init(allocator, 16);
+
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    indirect_commands_sb[f] = kInvalidBuffer;
+    indirect_descriptor_set[f] = kInvalidSet;
+    generated_commands_sb[f] = kInvalidBuffer;
+    generated_counts_sb[f] = kInvalidBuffer;
+    generate_descriptor_set[f] = kInvalidSet;
+  }
+  indirect_command_capacity = 0;
+  indirect_command_count = 0;
+  indirect_cull_count = 0;
+}
+
+void DrawPacketQueue::shutdown()
+{
+  packets.shutdown();
+  scratch_packets.shutdown();
+  chunk_offsets.shutdown();
+  cpu_draws.shutdown();
+}
+
+void DrawPacketQueue::build(
+    CullingList::Enum pass,
+    const Array<MeshInstanceDraw>& draws,
+    const FrustumCulling& culling,
+    const MeshInstances& mesh_instances,
+    Renderer* renderer,
+    bool transparent,
+    enki::TaskScheduler* task_scheduler)
+{
+  const uint32_t packet_count = culling.visible_draws[pass].m_Size;
+  packets.setSize(packet_count);
+
+  chunk_count = (packet_count + k_sort_chunk_size - 1) / k_sort_chunk_size;
+  chunk_count = chunk_count > 0 ? chunk_count : 1;
+  if (chunk_count > k_max_sort_chunks)
+  {
+    chunk_count = k_max_sort_chunks;
+  }
+  chunk_size = (packet_count + chunk_count - 1) / chunk_count;
+
+  const float depth_range = culling.depth_range();
+
+  DrawPacketBuildTask build_task;
+  build_task.queue = this;
+  build_task.draws = &draws;
+  build_task.culling = &culling;
+  build_task.meshes = mesh_instances.column<MeshInstanceField::kMesh>();
+  build_task.renderer = renderer;
+  build_task.inverse_depth_range = depth_range > 0.f ? 1.f / depth_range : 0.f;
+  build_task.pass = pass;
+  build_task.transparent = transparent;
+  build_task.m_SetSize = chunk_count;
+  build_task.m_MinRange = 1;
+
+  run_chunk_task(build_task, task_scheduler);
+
+  uint64_t key_or = 0;
+  uint64_t key_and = ~0ull;
+  for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+  {
+    key_or |= chunk_key_or[chunk];
+    key_and &= chunk_key_and[chunk];
+  }
+  key_difference = key_or & ~key_and;
+}
+
+void DrawPacketQueue::sort(enki::TaskScheduler* task_scheduler)
+{
+  const uint32_t packet_count = packets.m_Size;
+  sort_passes = 0;
+  if (packet_count < 2 || key_difference == 0)
+  {
+    return;
+  }
+
+  scratch_packets.setSize(packet_count);
+  chunk_offsets.setSize(chunk_count * k_radix_size);
+
+  DrawPacketSortTask sort_task;
+  sort_task.queue = this;
+  sort_task.m_SetSize = chunk_count;
+  sort_task.m_MinRange = 1;
+
+  DrawPacket* source = packets.m_Data;
+  DrawPacket* destination = scratch_packets.m_Data;
+
+  for (uint32_t shift = 0; shift < 64; shift += 8)
+  {
+    // Digits equal in every key would only copy the packets around.
+    if (((key_difference >> shift) & (k_radix_size - 1)) == 0)
+    {
+      continue;
+    }
+
+    sort_task.source = source;
+    sort_task.destination = destination;
+    sort_task.shift = shift;
+
+    sort_task.scatter = false;
+    run_chunk_task(sort_task, task_scheduler);
+
+    // Digit major prefix sum turns the per chunk counts into scatter offsets.
+    uint32_t offset = 0;
+    for (uint32_t digit = 0; digit < k_radix_size; ++digit)
+    {
+      for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+      {
+        uint32_t& digit_offset = chunk_offsets[chunk * k_radix_size + digit];
+        const uint32_t digit_count = digit_offset;
+        digit_offset = offset;
+        offset += digit_count;
+      }
+    }
+
+    sort_task.scatter = true;
+    run_chunk_task(sort_task, task_scheduler);
+
+    DrawPacket* sorted = destination;
+    destination = source;
+    source = sorted;
+    ++sort_passes;
+  }
+
+  if (source != packets.m_Data)
+  {
+    memcpy(packets.m_Data, source, packet_count * sizeof(DrawPacket));
+  }
+}
+
+void DrawPacketQueue::fill_indirect_commands(RenderScene& scene, uint32_t frame_index)
+{
+  indirect_command_count = 0;
+  indirect_cull_count = 0;
+  indirect_frame_index = frame_index;
+  if (indirect_descriptor_set[frame_index].index == kInvalidIndex || packets.m_Size == 0)
+  {
+    return;
+  }
+
+  GpuDevice& gpu = *scene.renderer->m_GpuDevice;
+
+  if (packets.m_Size > indirect_command_capacity)
+  {
+    uint32_t new_capacity = indirect_command_capacity * 2;
+    new_capacity = new_capacity > packets.m_Size ? new_capacity : packets.m_Size;
+
+    BufferCreation creation{};
+    for (uint32_t f = 0; f < k_max_frames; ++f)
+    {
+      if (indirect_commands_sb[f].index != kInvalidIndex)
+      {
+        gpu.destroyBuffer(indirect_commands_sb[f]);
+      }
+
+      creation.reset()
+          .set(
+              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+              ResourceUsageType::kDynamic,
+              sizeof(GpuMeshDrawCommand) * new_capacity)
+          .setName("indirect_commands_sb");
+      indirect_commands_sb[f] = gpu.createBuffer(creation);
+    }
+    indirect_command_capacity = new_capacity;
+  }
+
+  MapBufferParameters commands_map = {indirect_commands_sb[frame_index], 0, 0};
+  GpuMeshDrawCommand* commands = (GpuMeshDrawCommand*)gpu.mapBuffer(commands_map);
+  if (commands == nullptr)
+  {
+    return;
+  }
+
+  Mesh* const* meshes = scene.mesh_instances.column<MeshInstanceField::kMesh>();
+  const uint32_t* gpu_mesh_instance_indices =
+      scene.mesh_instances.column<MeshInstanceField::kGpuMeshInstanceIndex>();
+
+  // Single sided meshes first, then the double sided ones, each group keeping the sort order.
+  for (uint32_t group = 0; group < 2; ++group)
+  {
+    const bool double_sided = group == 1;
+
+    for (uint32_t p = 0; p < packets.m_Size; ++p)
+    {
+      const DrawPacket& packet = packets[p];
+      const Mesh& mesh = *meshes[packet.mesh_instance_index];
+      if (!mesh.hasMegaGeometry() || mesh.isDoubleSided() != double_sided)
+      {
+        continue;
+      }
+
+      // The first instance selects the mesh instance data in the shaders.
+      GpuMeshDrawCommand& command = commands[indirect_command_count++];
+      command.drawId = packet.mesh_instance_index;
+      command.indirect.indexCount = mesh.primitiveCount;
+      command.indirect.instanceCount = 1;
+      command.indirect.firstIndex = mesh.mega_first_index;
+      command.indirect.vertexOffset = (int32_t)mesh.mega_first_vertex;
+      command.indirect.firstInstance = gpu_mesh_instance_indices[packet.mesh_instance_index];
+      command.indirectMS = {};
+    }
+
+    if (!double_sided)
+    {
+      indirect_cull_count = indirect_command_count;
+    }
+  }
+
+  gpu.unmapBuffer(commands_map);
+}
+
+void DrawPacketQueue::prepare_gpu_commands(RenderScene& scene, const Array<MeshInstanceDraw>& draws)
+{
+  GpuDevice& gpu = *scene.renderer->m_GpuDevice;
+
+  Mesh* const* meshes = scene.mesh_instances.column<MeshInstanceField::kMesh>();
+  const uint32_t* gpu_mesh_instance_indices =
+      scene.mesh_instances.column<MeshInstanceField::kGpuMeshInstanceIndex>();
+
+  cpu_draws.clear();
+  generate_draw_count = 0;
+  generate_single_sided_count = 0;
+  for (uint32_t d = 0; d < draws.m_Size; ++d)
+  {
+    const Mesh& mesh = *meshes[draws[d].mesh_instance_index];
+    if (!mesh.hasMegaGeometry())
+    {
+      cpu_draws.push(draws[d]);
+      continue;
+    }
+
+    ++generate_draw_count;
+    generate_single_sided_count += mesh.isDoubleSided() ? 0 : 1;
+  }
+
+  RendererUtil::GpuTechnique* main_technique =
+      scene.renderer->m_ResourceCache.m_Techniques.get(hashCalculate("main"));
+  const uint32_t pass_index =
+      main_technique->nameHashToIndex.get(hashCalculate("indirect_commands"));
+  generate_pipeline = main_technique->passes[pass_index].pipeline;
+
+  if (generate_draw_count == 0 || generate_pipeline.index == kInvalidIndex ||
+      scene.indirect_cull_cb.index == kInvalidIndex)
+  {
+    return;
+  }
+
+  BufferCreation creation{};
+  creation
+      .set(
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          ResourceUsageType::kDynamic,
+          sizeof(GpuIndirectDraws) + sizeof(GpuIndirectDraw) * generate_draw_count)
+      .setName("generate_draws_sb");
+  generate_draws_sb = gpu.createBuffer(creation);
+
+  // Draws do not change after loading, only the instance matrices the compute pass reads do.
+  MapBufferParameters draws_map = {generate_draws_sb, 0, 0};
+  GpuIndirectDraws* header = (GpuIndirectDraws*)gpu.mapBuffer(draws_map);
+  if (header == nullptr)
+  {
+    return;
+  }
+  *header = {generate_draw_count, generate_single_sided_count, 0, 0};
+
+  // Single sided meshes first, like the CPU filled commands.
+  GpuIndirectDraw* gpu_draws = (GpuIndirectDraw*)(header + 1);
+  uint32_t draw_index = 0;
+  for (uint32_t group = 0; group < 2; ++group)
+  {
+    const bool double_sided = group == 1;
+
+    for (uint32_t d = 0; d < draws.m_Size; ++d)
+    {
+      const uint32_t mesh_instance_index = draws[d].mesh_instance_index;
+      const Mesh& mesh = *meshes[mesh_instance_index];
+      if (!mesh.hasMegaGeometry() || mesh.isDoubleSided() != double_sided)
+      {
+        continue;
+      }
+
+      GpuIndirectDraw& draw = gpu_draws[draw_index++];
+      draw = {};
+      draw.bounding_sphere = mesh.bounding_sphere;
+      draw.mesh_instance_index = mesh_instance_index;
+      draw.gpu_mesh_instance_index = gpu_mesh_instance_indices[mesh_instance_index];
+      draw.index_count = mesh.primitiveCount;
+      draw.first_index = mesh.mega_first_index;
+      draw.vertex_offset = (int32_t)mesh.mega_first_vertex;
+      draw.flags = double_sided ? GpuIndirectDrawFlags::kDoubleSided : 0;
+      if (mesh.hasSkinning() || mesh.isCloth())
+      {
+        draw.flags |= GpuIndirectDrawFlags::kAlwaysVisible;
+      }
+    }
+  }
+  gpu.unmapBuffer(draws_map);
+
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    creation.reset()
+        .set(
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            ResourceUsageType::kDynamic,
+            sizeof(GpuMeshDrawCommand) * generate_draw_count)
+        .setName("generated_commands_sb");
+    generated_commands_sb[f] = gpu.createBuffer(creation);
+
+    // One count per culling group.
+    creation.reset()
+        .set(
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            ResourceUsageType::kDynamic,
+            sizeof(uint32_t) * 2)
+        .setName("generated_counts_sb");
+    generated_counts_sb[f] = gpu.createBuffer(creation);
+
+    if (generated_commands_sb[f].index == kInvalidIndex ||
+        generated_counts_sb[f].index == kInvalidIndex)
+    {
+      free_gpu_commands(gpu);
+      return;
+    }
+
+    DescriptorSetCreation ds_creation{};
+    ds_creation.buffer(scene.indirect_cull_cb, 0)
+        .buffer(generate_draws_sb, 1)
+        .buffer(scene.mesh_instances_sb[f], 2)
+        .buffer(generated_commands_sb[f], 3)
+        .buffer(generated_counts_sb[f], 4);
+    ds_creation
+        .setLayout(gpu.getDescriptorSetLayout(generate_pipeline, kMaterialDescriptorSetIndex))
+        .setName("indirect_commands");
+    generate_descriptor_set[f] = gpu.createDescriptorSet(ds_creation);
+  }
+}
+
+void DrawPacketQueue::reset_gpu_commands(GpuDevice& gpu, uint32_t frame_index)
+{
+  indirect_frame_index = frame_index;
+
+  MapBufferParameters counts_map = {generated_counts_sb[frame_index], 0, 0};
+  uint32_t* counts = (uint32_t*)gpu.mapBuffer(counts_map);
+  if (counts == nullptr)
+  {
+    generate_on_gpu = false;
+    return;
+  }
+
+  counts[0] = 0;
+  counts[1] = 0;
+  gpu.unmapBuffer(counts_map);
+}
+
+void DrawPacketQueue::generate_gpu_commands(CommandBuffer* gpu_commands)
+{
+  if (!generate_on_gpu)
+  {
+    return;
+  }
+
+  gpu_commands->pushMarker("indirect_commands");
+
+  gpu_commands->bindPipeline(generate_pipeline);
+  gpu_commands->bindDescriptorSet(&generate_descriptor_set[indirect_frame_index], 1, nullptr, 0);
+  const uint32_t group_count =
+      (generate_draw_count + k_generate_group_size - 1) / k_generate_group_size;
+  gpu_commands->dispatch(group_count, 1, 1);
+
+  // The draws of the pass read the commands and their counts.
+  ExecutionBarrier barrier;
+  barrier.reset()
+      .set(PipelineStage::kComputeShader, PipelineStage::kDrawIndirect)
+      .addMemoryBarrier({generated_commands_sb[indirect_frame_index]})
+      .addMemoryBarrier({generated_counts_sb[indirect_frame_index]});
+  gpu_commands->barrier(barrier);
+
+  gpu_commands->popMarker();
+}
+
+void DrawPacketQueue::free_gpu_commands(GpuDevice& gpu)
+{
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    if (generate_descriptor_set[f].index != kInvalidIndex)
+    {
+      gpu.destroyDescriptorSet(generate_descriptor_set[f]);
+      generate_descriptor_set[f] = kInvalidSet;
+    }
+    if (generated_commands_sb[f].index != kInvalidIndex)
+    {
+      gpu.destroyBuffer(generated_commands_sb[f]);
+      generated_commands_sb[f] = kInvalidBuffer;
+    }
+    if (generated_counts_sb[f].index != kInvalidIndex)
+    {
+      gpu.destroyBuffer(generated_counts_sb[f]);
+      generated_counts_sb[f] = kInvalidBuffer;
+    }
+  }
+
+  if (generate_draws_sb.index != kInvalidIndex)
+  {
+    gpu.destroyBuffer(generate_draws_sb);
+    generate_draws_sb = kInvalidBuffer;
+  }
+  generate_draw_count = 0;
+  generate_single_sided_count = 0;
+  generate_on_gpu = false;
+}
+
+void DrawPacketQueue::submit(
+    CommandBuffer* gpu_commands, RenderScene* render_scene, bool transparent)
+{
+  Mesh* const* meshes = render_scene->mesh_instances.column<MeshInstanceField::kMesh>();
+  const uint32_t* gpu_mesh_instance_indices =
+      render_scene->mesh_instances.column<MeshInstanceField::kGpuMeshInstanceIndex>();
+
+  DrawBindStats frame_stats;
+  frame_stats.draws = packets.m_Size;
+
+  // Mega buffer draws go in a multi draw per culling mode, the rest is drawn one by one below.
+  // GPU written commands only leave the other draws in the packets.
+  const bool indirect = indirect_command_count > 0 || generate_on_gpu;
+  if (indirect)
+  {
+    MeshMegaBuffers& mega_buffers = render_scene->mega_buffers;
+    uint32_t stream_offsets[MeshStream::kCount]{};
+
+    gpu_commands->bindVertexBuffers(mega_buffers.streams, 0, MeshStream::kCount, stream_offsets);
+    gpu_commands->bindIndexBuffer(mega_buffers.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    frame_stats.vertex_buffers = 1;
+    frame_stats.index_buffers = 1;
+
+    // GPU written groups are sized for all their draws, the count buffer has how many were kept.
+    const uint32_t cull_count = generate_on_gpu ? generate_single_sided_count : indirect_cull_count;
+    const uint32_t command_count = generate_on_gpu ? generate_draw_count : indirect_command_count;
+    const BufferHandle commands = generate_on_gpu ? generated_commands_sb[indirect_frame_index]
+                                                  : indirect_commands_sb[indirect_frame_index];
+
+    const PipelineHandle group_pipelines[] = {indirect_cull_pipeline, indirect_pipeline};
+    const uint32_t group_firsts[] = {0, cull_count};
+    const uint32_t group_counts[] = {cull_count, command_count - cull_count};
+
+    for (uint32_t group = 0; group < 2; ++group)
+    {
+      if (group_counts[group] == 0)
+      {
+        continue;
+      }
+
+      const uint32_t offset = (uint32_t)(offsetof(GpuMeshDrawCommand, indirect) +
+                                         group_firsts[group] * sizeof(GpuMeshDrawCommand));
+
+      gpu_commands->bindPipeline(group_pipelines[group]);
+      gpu_commands->bindDescriptorSet(
+          &indirect_descriptor_set[indirect_frame_index], 1, nullptr, 0);
+
+      if (generate_on_gpu)
+      {
+        gpu_commands->drawIndexedIndirectCount(
+            commands,
+            offset,
+            generated_counts_sb[indirect_frame_index],
+            group * sizeof(uint32_t),
+            group_counts[group],
+            sizeof(GpuMeshDrawCommand));
+      }
+      else
+      {
+        gpu_commands->drawIndexedIndirect(
+            commands, group_counts[group], offset, sizeof(GpuMeshDrawCommand));
+      }
+
+      ++frame_stats.pipelines;
+      ++frame_stats.descriptor_sets;
+      ++frame_stats.multi_draws;
+    }
+    frame_stats.indirect_draws = indirect_command_count;
+    frame_stats.gpu_draws = generate_on_gpu ? generate_draw_count : 0;
+  }
+
+  PipelineHandle last_pipeline = kInvalidPipeline;
+  DescriptorSetHandle last_descriptor_set = kInvalidSet;
+  BufferHandle last_buffers[6]{};
+  uint32_t last_offsets[6]{};
+  uint32_t last_buffer_count = 0; // Nothing bound yet
+  BufferHandle last_index_buffer = kInvalidBuffer;
+  uint32_t last_index_offset = 0;
+
+  for (uint32_t p = 0; p < packets.m_Size; ++p)
+  {
+    const DrawPacket& packet = packets[p];
+    Mesh& mesh = *meshes[packet.mesh_instance_index];
+    if (indirect && mesh.hasMegaGeometry())
+    {
+      continue;
+    }
+
+    if (packet.pipeline.index != last_pipeline.index)
+    {
+      gpu_commands->bindPipeline(packet.pipeline);
+      last_pipeline = packet.pipeline;
+      ++frame_stats.pipelines;
+
+      // Pipeline layouts can differ, bind the material set again.
+      last_descriptor_set = kInvalidSet;
+    }
+
+    BufferHandle buffers[]{
+        mesh.positionBuffer,
+        mesh.tangentBuffer,
+        mesh.normalBuffer,
+        mesh.texcoordBuffer,
+        mesh.jointsBuffer,
+        mesh.weightsBuffer};
+    uint32_t offsets[]{
+        mesh.positionOffset,
+        mesh.tangentOffset,
+        mesh.normalOffset,
+        mesh.texcoordOffset,
+        mesh.jointsOffset,
+        mesh.weightsOffset};
+    const uint32_t buffer_count = mesh.hasSkinning() ? 6 : 4;
+
+    bool same_buffers = buffer_count <= last_buffer_count;
+    for (uint32_t b = 0; b < buffer_count && same_buffers; ++b)
+    {
+      same_buffers = buffers[b].index == last_buffers[b].index && offsets[b] == last_offsets[b];
+    }
+    if (!same_buffers)
+    {
+      gpu_commands->bindVertexBuffers(buffers, 0, buffer_count, offsets);
+      memcpy(last_buffers, buffers, sizeof(buffers));
+      memcpy(last_offsets, offsets, sizeof(offsets));
+      last_buffer_count = buffer_count;
+      ++frame_stats.vertex_buffers;
+    }
+
+    if (mesh.indexBuffer.index != last_index_buffer.index || mesh.indexOffset != last_index_offset)
+    {
+      gpu_commands->bindIndexBuffer(mesh.indexBuffer, mesh.indexOffset, mesh.indexType);
+      last_index_buffer = mesh.indexBuffer;
+      last_index_offset = mesh.indexOffset;
+      ++frame_stats.index_buffers;
+    }
+
+    if (g_RecreatePerThreadDescriptors)
+    {
+      DescriptorSetCreation ds_creation{};
+      ds_creation.buffer(render_scene->scene_cb, 0).buffer(mesh.pbrMaterial.materialBuffer, 1);
+      DescriptorSetHandle descriptor_set = render_scene->renderer->createDescriptorSet(
+          gpu_commands, mesh.pbrMaterial.material, ds_creation);
+
+      gpu_commands->bindLocalDescriptorSet(&descriptor_set, 1, nullptr, 0);
+      ++frame_stats.descriptor_sets;
+    }
+    else
+    {
+      DescriptorSetHandle descriptor_set = transparent
+                                               ? mesh.pbrMaterial.descriptor_set_transparent
+                                               : mesh.pbrMaterial.descriptor_set_main;
+      if (descriptor_set.index != last_descriptor_set.index)
+      {
+        gpu_commands->bindDescriptorSet(&descriptor_set, 1, nullptr, 0);
+        last_descriptor_set = descriptor_set;
+        ++frame_stats.descriptor_sets;
+      }
+    }
+
+    gpu_commands->drawIndexed(
+        TopologyType::kTriangle,
+        mesh.primitiveCount,
+        1,
+        0,
+        0,
+        gpu_mesh_instance_indices[packet.mesh_instance_index]);
+  }
+
+  stats = frame_stats;
+}
+
+// DrawTask ///////////////////////////////////////////////////////////////
+void DrawTask::init(
+    Graphics::GpuDevice* p_Gpu,
+    FrameGraph* p_FrameGraph,
+    RendererUtil::Renderer* p_Renderer,
+    Graphics::ImguiUtil::ImguiService* p_Imgui,
+    RenderScene* p_Scene,
+    FrameRenderer* p_FrameRenderer)
+{
+  gpu = p_Gpu;
+  frame_graph = p_FrameGraph;
+  renderer = p_Renderer;
+  imgui = p_Imgui;
+  scene = p_Scene;
+  frame_renderer = p_FrameRenderer;
+
+  current_frame_index = gpu->m_CurrentFrameIndex;
+  current_framebuffer = gpu->getCurrentFramebuffer();
+  render_frame_graph = true;
+  gpu_commands = nullptr;
+}
+
+void DrawTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+{
+  using namespace Graphics;
+
+  thread_id = threadnum_;
+
+  // printf( "Executing draw task from thread %u\n", threadnum_ );
+  // TODO: improve getting a command buffer/pool
+  gpu_commands = gpu->getCommandBuffer(threadnum_, current_frame_index, true);
+  gpu_commands->pushMarker("Frame");
+
+  if (render_frame_graph)
+  {
+    frame_graph->render(current_frame_index, gpu_commands, scene);
+  }
+
+  gpu_commands->pushMarker("Fullscreen");
+  gpu_commands->clear(0.3f, 0.3f, 0.3f, 1.f, 0);
+  gpu_commands->clearDepthStencil(1.0f, 0);
+  gpu_commands->bindPass(gpu->m_SwapchainRenderPass, current_framebuffer, false);
+  gpu_commands->setScissor(nullptr);
+  gpu_commands->setViewport(nullptr);
+
+  // Apply fullscreen material
+  FrameGraphResource* texture = frame_graph->get_resource("final");
+  assert(texture != nullptr);
+
+  gpu_commands->bindPipeline(frame_renderer->fullscreen_tech->passes[0].pipeline);
+  gpu_commands->bindDescriptorSet(&frame_renderer->fullscreen_ds, 1, nullptr, 0);
+  gpu_commands->draw(TopologyType::kTriangle, 0, 3, texture->resourceInfo.texture.handle.index, 1);
+
+  imgui->render(*gpu_commands, false);
+
+  gpu_commands->popMarker();
+  gpu_commands->popMarker();
+}
+
+// FrameGraphRecordTask ///////////////////////////////////////////////////
+void FrameGraphRecordTask::init(
+    GpuDevice* gpu_, FrameGraph* frame_graph_, RenderScene* scene_, uint32_t num_threads)
+{
+  gpu = gpu_;
+  frame_graph = frame_graph_;
+  scene = scene_;
+  current_frame_index = gpu->m_CurrentFrameIndex;
+
+  // Contiguous ranges keep the submission order equal to the topological order.
+  const uint32_t num_nodes = frame_graph->nodes.m_Size;
+  num_ranges = num_threads < k_max_ranges ? num_threads : k_max_ranges;
+  num_ranges = num_nodes < num_ranges ? num_nodes : num_ranges;
+
+  for (uint32_t r = 0; r <= num_ranges; ++r)
+  {
+    range_first_node[r] = num_ranges ? (num_nodes * r) / num_ranges : 0;
+  }
+
+  m_SetSize = num_ranges;
+  m_MinRange = 1;
+}
+
+void FrameGraphRecordTask::ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_)
+{
+  for (uint32_t r = range_.start; r < range_.end; ++r)
+  {
+    CommandBuffer* gpu_commands = gpu->getCommandBuffer(threadnum_, current_frame_index, true);
+    gpu_commands->pushMarker("Frame graph");
+
+    frame_graph->render_range(
+        current_frame_index,
+        gpu_commands,
+        scene,
+        range_first_node[r],
+        range_first_node[r + 1] - range_first_node[r]);
+
+    gpu_commands->popMarker();
+
+    range_commands[r] = gpu_commands;
+  }
+}
+
+void FrameGraphRecordTask::queue_command_buffers()
+{
+  for (uint32_t r = 0; r < num_ranges; ++r)
+  {
+    gpu->queueCommandBuffer(range_commands[r]);
+  }
+}
+
+// FrameRenderer //////////////////////////////////////////////////////////
+void FrameRenderer::init(
+    Framework::Allocator* p_ResidentAllocator,
+    RendererUtil::Renderer* p_Renderer,
+    FrameGraph* p_FrameGraph,
+    SceneGraph* p_SceneGraph,
+    RenderScene* p_Scene)
+{
+  residentAllocator = p_ResidentAllocator;
+  renderer = p_Renderer;
+  frameGraph = p_FrameGraph;
+  sceneGraph = p_SceneGraph;
+  scene = p_Scene;
+
+  scene->frustum_culling.init(p_ResidentAllocator);
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    scene->draw_queues[l].init(p_ResidentAllocator);
+  }
+  for (uint32_t f = 0; f < k_max_frames; ++f)
+  {
+    scene->mesh_instances_sb[f] = kInvalidBuffer;
+  }
+
+  frameGraph->builder->registerRenderPass("depth_pre_pass", &depthPrePass);
+  frameGraph->builder->registerRenderPass("gbuffer_pass", &gbufferPass);
+  frameGraph->builder->registerRenderPass("lighting_pass", &lightPass);
+  frameGraph->builder->registerRenderPass("transparent_pass", &transparentPass);
+  frameGraph->builder->registerRenderPass("depth_of_field_pass", &dofPass);
+  frameGraph->builder->registerRenderPass("debug_pass", &debugPass);
+}
+
+void FrameRenderer::shutdown()
+{
+  depthPrePass.freeGpuResources();
+  gbufferPass.freeGpuResources();
+  lightPass.freeGpuResources();
+  transparentPass.freeGpuResources();
+  // TODO: check that node is enabled before calling
+  // dofPass.freeGpuResources();
+  debugPass.freeGpuResources();
+
+  scene->frustum_culling.shutdown();
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    scene->draw_queues[l].shutdown();
+  }
+  scene->free_indirect_draws(*renderer->m_GpuDevice);
+
+  renderer->m_GpuDevice->destroyDescriptorSet(fullscreenDS);
+}
+
+void FrameRenderer::uploadGpuData()
+{
+  lightPass.uploadGpuData();
+  // dof_pass.uploadGpuData();
+
+  scene->uploadGpuData();
+}
+
+void FrameRenderer::render(CommandBuffer* gpuCommands, RenderScene* renderScene) {}
+
+void FrameRenderer::cull_draws(const mat4s& view_projection, enki::TaskScheduler* task_scheduler)
+{
+  // Chosen once per frame: culling, sorting and recording have to agree on it.
+  for (uint32_t l = 0; l < CullingList::kTransparent; ++l)
+  {
+    DrawPacketQueue& queue = scene->draw_queues[l];
+    queue.generate_on_gpu =
+        scene->use_indirect_draws && scene->gpu_indirect_commands && queue.gpu_commands_prepared();
+  }
+
+  FrustumCulling& culling = scene->frustum_culling;
+  culling.cull(
+      scene->mesh_instances, scene_graph, scene->global_scale, view_projection, task_scheduler);
+
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    culling.compact_draws((CullingList::Enum)l, cpu_draws((CullingList::Enum)l));
+  }
+}
+
+const Array<MeshInstanceDraw>& FrameRenderer::cpu_draws(CullingList::Enum list) const
+{
+  const Array<MeshInstanceDraw>* draws[CullingList::kCount]{
+      &depth_pre_pass.mesh_instance_draws,
+      &gbuffer_pass_early.mesh_instance_draws,
+      &transparent_pass.mesh_instance_draws};
+
+  const DrawPacketQueue& queue = scene->draw_queues[list];
+  return queue.generate_on_gpu ? queue.cpu_draws : *draws[list];
+}
+
+void FrameRenderer::sort_draws(enki::TaskScheduler* task_scheduler)
+{
+  GpuDevice& gpu = *renderer->m_GpuDevice;
+  const FrustumCulling& culling = scene->frustum_culling;
+  const uint32_t frame_index = gpu.m_AbsoluteFrameIndex % k_max_frames;
+
+  // Frustum of the compute passes writing the commands, the same planes as the CPU culling.
+  if (scene->draw_queues[CullingList::kDepthPrePass].generate_on_gpu ||
+      scene->draw_queues[CullingList::kGBuffer].generate_on_gpu)
+  {
+    MapBufferParameters cull_map = {scene->indirect_cull_cb, 0, 0};
+    GpuIndirectCullConstants* constants = (GpuIndirectCullConstants*)gpu.mapBuffer(cull_map);
+    if (constants)
+    {
+      *constants = {};
+      memcpy(constants->frustum_planes, culling.planes, sizeof(culling.planes));
+      constants->culling_enabled = culling.enabled ? 1 : 0;
+
+      gpu.unmapBuffer(cull_map);
+    }
+  }
+
+  for (uint32_t l = 0; l < CullingList::kCount; ++l)
+  {
+    const CullingList::Enum list = (CullingList::Enum)l;
+    DrawPacketQueue& queue = scene->draw_queues[l];
+
+    const bool transparent = list == CullingList::kTransparent;
+
+    if (transparent)
+    {
+      queue.order = DrawSortOrder::kBackToFront;
+    }
+    else
+    {
+      queue.order =
+          scene->opaque_front_to_back ? DrawSortOrder::kFrontToBack : DrawSortOrder::kState;
+    }
+
+    queue.build(
+        list,
+        cpu_draws(list),
+        culling,
+        scene->mesh_instances,
+        renderer,
+        transparent,
+        task_scheduler);
+    if (transparent || scene->sort_draw_packets)
+    {
+      queue.sort(task_scheduler);
+    }
+
+    // Transparent packets stay on the direct path, drawn one by one in back to front order.
+    if (queue.generate_on_gpu)
+    {
+      queue.indirect_command_count = 0;
+      queue.reset_gpu_commands(gpu, frame_index);
+    }
+    else if (scene->use_indirect_draws && !transparent)
+    {
+      queue.fill_indirect_commands(*scene, frame_index);
+    }
+    else
+    {
+      queue.indirect_command_count = 0;
+    }
+  }
+}
+
+void FrameRenderer::prepareDraws(Framework::StackAllocator* scratchAllocator)
+{
+
+  scene->prepareDraws(renderer, scratchAllocator, sceneGraph);
+
+  depthPrePass.prepareDraws(
+      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+  gbufferPass.prepareDraws(
+      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+  lightPass.prepareDraws(*scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+  transparentPass.prepareDraws(
+      *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+  // dofPass.prepareDraws( *scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator
+  // );
+  debugPass.prepareDraws(*scene, frameGraph, renderer->m_GpuDevice->m_Allocator, scratchAllocator);
+
+  scene->prepare_indirect_draws(renderer);
+  if (scene->use_indirect_draws)
+  {
+    scene->draw_queues[CullingList::kDepthPrePass].prepare_gpu_commands(
+        *scene, depth_pre_pass.mesh_instance_draws);
+    scene->draw_queues[CullingList::kGBuffer].prepare_gpu_commands(
+        *scene, gbuffer_pass_early.mesh_instance_draws);
+  }
 
   // Handle fullscreen pass.
   fullscreenTech = renderer->m_ResourceCache.m_Techniques.get(hashCalculate("fullscreen"));
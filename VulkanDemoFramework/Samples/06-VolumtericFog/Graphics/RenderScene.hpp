@@ -1,5 +1,6 @@
 #pragma once
 #include "Foundation/Array.hpp"
+#include "Foundation/SoaArray.hpp"
 #include "Foundation/Prerequisites.hpp"
 #include "Foundation/Color.hpp"
 
@@ -212,24 +213,43 @@ struct PhysicsJoint
 
 //
 //
-struct PhysicsVertex
+struct PhysicsVertexJoints
 {
   void addJoint(uint32_t vertexIndex);
 
-  vec3s startPosition;
-  vec3s previousPosition;
-  vec3s position;
-  vec3s normal;
-
-  vec3s velocity;
-  vec3s force;
-
   PhysicsJoint joints[kMaxJointCount];
   uint32_t jointCount;
+};
 
-  float mass;
-  bool fixed;
+//
+// Columns of PhysicsMesh::vertices.
+namespace PhysicsVertexField
+{
+enum Enum : uint32_t
+{
+  kStartPosition,
+  kPreviousPosition,
+  kPosition,
+  kNormal,
+  kVelocity,
+  kForce,
+  kJoints,
+  kMass,
+  kFixed
 };
+} // namespace PhysicsVertexField
+
+// Simulation loops only read the columns they need, the joint tables are the bulk of the data.
+using PhysicsVertices = SoaArray<
+    vec3s, // start position
+    vec3s, // previous position
+    vec3s, // position
+    vec3s, // normal
+    vec3s, // velocity
+    vec3s, // force
+    PhysicsVertexJoints,
+    float, // mass
+    bool>; // fixed
 
 //
 //
@@ -286,7 +306,7 @@ struct PhysicsMesh
 {
   uint32_t meshIndex;
 
-  Array<PhysicsVertex> vertices;
+  PhysicsVertices vertices;
 
   Graphics::BufferHandle gpuBuffer;
   Graphics::BufferHandle drawIndirectBuffer;
@@ -332,11 +352,16 @@ struct Mesh
 
   uint32_t gpu_mesh_index = UINT32_MAX;
 
+  // Location in the scene mega buffers, for indirect draws.
+  uint32_t mega_first_vertex = UINT32_MAX;
+  uint32_t mega_first_index = 0;
+
   int skinIndex = INT_MAX;
 
   vec4s bounding_sphere;
 
   bool hasSkinning() const { return skinIndex != INT_MAX; }
+  bool hasMegaGeometry() const { return mega_first_vertex != UINT32_MAX; }
   bool isTransparent() const
   {
     return (pbrMaterial.flags & (DrawFlagsAlphaMask | DrawFlagsTransparent)) != 0;
@@ -348,25 +373,306 @@ struct Mesh
   bool isCloth() const { return (pbrMaterial.flags & DrawFlagsCloth) == DrawFlagsCloth; }
 }; // struct Mesh
 
+// Mega buffers ///////////////////////////////////////////////////////
 //
+// Vertex streams of the mega buffers, in the binding order of the pipelines.
+namespace MeshStream
+{
+enum Enum : uint32_t
+{
+  kPosition, // float3
+  kTangent,  // float4
+  kNormal,   // float3
+  kTexcoord, // float2
+  kCount
+};
+} // namespace MeshStream
+
 //
-struct MeshInstance
+// Where a mesh stream is read from while packing. Elements smaller than the stream are padded
+// with zeros, a null source leaves the whole stream zeroed.
+struct MeshStreamSource
 {
+  const void* data = nullptr;
+  uint32_t stride = 0;
+  uint32_t element_size = 0;
+}; // struct MeshStreamSource
 
-  Mesh* mesh;
-  uint32_t gpu_mesh_instance_index = UINT32_MAX;
-  uint32_t scene_graph_node_index = UINT32_MAX;
+//
+// Static meshes of a scene packed in shared vertex and index buffers. Every stream of a mesh
+// starts at the same vertex and indices are 32 bits, so draws only differ by their first index
+// and vertex offset, and a single indirect command can issue all the draws of a pipeline.
+struct MeshMegaBuffers
+{
+  void init(Allocator* allocator, uint32_t vertex_capacity, uint32_t index_capacity);
+  void shutdown(GpuDevice& gpu);
+
+  // Appends the vertices and indices of a mesh, returning its first vertex and index.
+  void add_mesh(
+      const MeshStreamSource* sources,
+      uint32_t mesh_vertex_count,
+      const void* indices,
+      VkIndexType index_type,
+      uint32_t mesh_index_count,
+      uint32_t& out_first_vertex,
+      uint32_t& out_first_index);
+  // Creates the gpu buffers from the packed data, then frees it.
+  void create_gpu_buffers(Renderer* renderer);
+  // Points the vertex and index buffers of a packed mesh at the mega buffers, for the passes that
+  // draw it one by one.
+  void bind_mesh(Mesh& mesh) const;
+
+  Array<uint8_t> stream_data[MeshStream::kCount];
+  Array<uint32_t> index_data;
+  uint32_t vertex_count = 0;
+  uint32_t index_count = 0;
+
+  BufferHandle streams[MeshStream::kCount];
+  BufferHandle index_buffer = kInvalidBuffer;
+}; // struct MeshMegaBuffers
+
+//
+// Columns of RenderScene::mesh_instances.
+namespace MeshInstanceField
+{
+enum Enum : uint32_t
+{
+  kMesh,
+  kGpuMeshInstanceIndex,
+  kSceneGraphNodeIndex
+};
+} // namespace MeshInstanceField
 
-}; // struct MeshInstance
+using MeshInstances = SoaArray<
+    Mesh*,
+    uint32_t,  // gpu mesh instance index
+    uint32_t>; // scene graph node index
 
 //
 //
 struct MeshInstanceDraw
 {
-  MeshInstance* mesh_instance;
+  // Instances are stored as columns, draws refer to them by index.
+  uint32_t mesh_instance_index = UINT32_MAX;
   uint32_t material_pass_index = UINT32_MAX;
 };
 
+// Frustum culling ////////////////////////////////////////////////////
+//
+// Passes drawing from a list of visible draws.
+namespace CullingList
+{
+enum Enum : uint32_t
+{
+  kDepthPrePass,
+  kGBuffer,
+  kTransparent,
+  kCount
+};
+} // namespace CullingList
+
+//
+//
+struct FrustumCullingStats
+{
+  uint32_t visible = 0;
+  uint32_t culled = 0;
+}; // struct FrustumCullingStats
+
+//
+// Visibility of the mesh instances against the camera frustum, computed by jobs on the task
+// threads before recording. Passes then draw from compact lists of their visible draws.
+struct FrustumCulling
+{
+  // Instances tested by a single job, a multiple of the SIMD width.
+  static const uint32_t k_batch_size = 256;
+
+  void init(Allocator* allocator);
+  void shutdown();
+
+  // Tests the world space bounding spheres, four at a time, against the frustum planes.
+  void cull(
+      const MeshInstances& mesh_instances,
+      const SceneGraph* scene_graph,
+      float global_scale,
+      const mat4s& view_projection,
+      enki::TaskScheduler* task_scheduler);
+  // Writes the indices of the visible draws into the list.
+  void compact_draws(CullingList::Enum list, const Array<MeshInstanceDraw>& draws);
+
+  // Distance between the near and far planes: signed distances of any point to both add up to it.
+  float depth_range() const { return planes[4].w + planes[5].w; }
+
+  Array<uint8_t> instance_visible;
+  Array<float> instance_depth; // Signed distance of the bounding sphere center to the near plane
+  Array<uint32_t> batch_visible_counts;
+  Array<uint32_t> visible_draws[CullingList::kCount];
+
+  FrustumCullingStats instance_stats;
+  FrustumCullingStats list_stats[CullingList::kCount];
+
+  vec4s planes[6];
+  bool enabled = true;
+}; // struct FrustumCulling
+
+// Draw packets ///////////////////////////////////////////////////////
+//
+// Orders a queue can be sorted in.
+namespace DrawSortOrder
+{
+enum Enum : uint32_t
+{
+  kState,       // Draws sharing state next to each other, front to back inside a group
+  kFrontToBack, // Nearest first, so depth testing rejects more of the hidden fragments
+  kBackToFront, // Farthest first, as blending needs
+  kCount
+};
+} // namespace DrawSortOrder
+
+//
+// Sort key fields, from the least significant bit. Indices wider than their field only weaken
+// the grouping, submission compares the real handles.
+namespace DrawSortKey
+{
+// State order.
+static const uint32_t k_depth_bits = 12;
+static const uint32_t k_index_buffer_bits = 10;
+static const uint32_t k_vertex_buffer_bits = 10;
+static const uint32_t k_descriptor_set_bits = 16;
+static const uint32_t k_pipeline_bits = 12;
+static const uint32_t k_pass_bits = 4;
+
+static const uint32_t k_depth_shift = 0;
+static const uint32_t k_index_buffer_shift = k_depth_shift + k_depth_bits;
+static const uint32_t k_vertex_buffer_shift = k_index_buffer_shift + k_index_buffer_bits;
+static const uint32_t k_descriptor_set_shift = k_vertex_buffer_shift + k_vertex_buffer_bits;
+static const uint32_t k_pipeline_shift = k_descriptor_set_shift + k_descriptor_set_bits;
+static const uint32_t k_pass_shift = k_pipeline_shift + k_pipeline_bits;
+
+// Depth orders, the pass stays in the top bits. Draws at the same depth are grouped by material.
+static const uint32_t k_sorted_vertex_buffer_bits = 8;
+static const uint32_t k_sorted_descriptor_set_bits = 16;
+static const uint32_t k_sorted_pipeline_bits = 12;
+static const uint32_t k_sorted_depth_bits = 24;
+
+static const uint32_t k_sorted_vertex_buffer_shift = 0;
+static const uint32_t k_sorted_descriptor_set_shift =
+    k_sorted_vertex_buffer_shift + k_sorted_vertex_buffer_bits;
+static const uint32_t k_sorted_pipeline_shift =
+    k_sorted_descriptor_set_shift + k_sorted_descriptor_set_bits;
+static const uint32_t k_sorted_depth_shift = k_sorted_pipeline_shift + k_sorted_pipeline_bits;
+
+inline uint64_t field(uint32_t value, uint32_t bits, uint32_t shift)
+{
+  return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+}
+} // namespace DrawSortKey
+
+//
+//
+struct DrawPacket
+{
+  uint64_t sort_key;
+  uint32_t mesh_instance_index;
+  PipelineHandle pipeline;
+}; // struct DrawPacket
+
+//
+// State changes recorded by a queue submission, against the number of draws.
+struct DrawBindStats
+{
+  uint32_t draws = 0;
+  uint32_t pipelines = 0;
+  uint32_t descriptor_sets = 0;
+  uint32_t vertex_buffers = 0;
+  uint32_t index_buffers = 0;
+  uint32_t indirect_draws = 0; // Draws issued by multi draw indirect commands
+  uint32_t multi_draws = 0;
+  uint32_t gpu_draws = 0; // Draws culled and written by the GPU, counted before culling
+}; // struct DrawBindStats
+
+//
+// Visible draws of a pass as sort keyed packets. Built and radix sorted on the task threads after
+// culling, then submitted binding only the state that differs from the previous packet.
+struct DrawPacketQueue
+{
+  // Packets keyed and sorted by a single job, smaller queues are processed inline.
+  static const uint32_t k_sort_chunk_size = 2048;
+  static const uint32_t k_max_sort_chunks = 32;
+  static const uint32_t k_radix_size = 256;
+  // Draws tested by a workgroup of indirect_commands.glsl.
+  static const uint32_t k_generate_group_size = 64;
+
+  void init(Allocator* allocator);
+  void shutdown();
+
+  // Keys the visible draws for the queue order, with this frame's view depths.
+  void build(
+      CullingList::Enum pass,
+      const Array<MeshInstanceDraw>& draws,
+      const FrustumCulling& culling,
+      const MeshInstances& mesh_instances,
+      Renderer* renderer,
+      bool transparent,
+      enki::TaskScheduler* task_scheduler);
+  // Least significant digit first, only over the key bytes that differ between packets.
+  void sort(enki::TaskScheduler* task_scheduler);
+  // Writes an indirect command per packet drawing from the mega buffers, in sort order. This is
+  // the CPU fallback: commands are filled after culling and sorting, not by a compute pass.
+  // Opaque queues only, the multi draw would break the order of the transparent packets.
+  void fill_indirect_commands(RenderScene& scene, uint32_t frame_index);
+  // Mega buffer draws of the pass culled and written by a compute pass instead, see
+  // indirect_commands.glsl. Keeps the other draws for the CPU culling and packets.
+  void prepare_gpu_commands(RenderScene& scene, const Array<MeshInstanceDraw>& draws);
+  // Clears the draw counts of the frame slot, call it after GpuDevice::newFrame.
+  void reset_gpu_commands(GpuDevice& gpu, uint32_t frame_index);
+  // Records the compute pass writing the commands, outside of the render pass.
+  void generate_gpu_commands(CommandBuffer* gpu_commands);
+  void free_gpu_commands(GpuDevice& gpu);
+  bool gpu_commands_prepared() const { return generate_descriptor_set[0].index != kInvalidIndex; }
+  void submit(CommandBuffer* gpu_commands, RenderScene* render_scene, bool transparent);
+
+  Array<DrawPacket> packets;
+  Array<DrawPacket> scratch_packets;
+  Array<uint32_t> chunk_offsets; // Per chunk digit counts, then scatter offsets
+
+  // Bits set and cleared in every key of a chunk.
+  uint64_t chunk_key_or[k_max_sort_chunks];
+  uint64_t chunk_key_and[k_max_sort_chunks];
+  uint32_t chunk_count = 0;
+  uint32_t chunk_size = 0;
+
+  uint64_t key_difference = 0; // Bits that are not the same in every key
+  uint32_t sort_passes = 0;
+  DrawSortOrder::Enum order = DrawSortOrder::kState;
+
+  // Indirect draws, GpuMeshDrawCommand entries. Single sided meshes come first and are drawn with
+  // back face culling, like the direct path does, then the double sided ones.
+  BufferHandle indirect_commands_sb[k_max_frames];
+  uint32_t indirect_command_capacity = 0;
+  uint32_t indirect_command_count = 0;
+  uint32_t indirect_cull_count = 0;
+  uint32_t indirect_frame_index = 0;
+  PipelineHandle indirect_pipeline = kInvalidPipeline;
+  PipelineHandle indirect_cull_pipeline = kInvalidPipeline;
+  // Layout of indirect_pipeline, reading the mesh instances of the frame.
+  DescriptorSetHandle indirect_descriptor_set[k_max_frames];
+
+  // GPU written commands, single sided first like the CPU ones. Both groups have room for all of
+  // their draws and the count buffer holds the number the compute pass kept in each.
+  bool generate_on_gpu = false; // This frame, set before culling
+  Array<MeshInstanceDraw> cpu_draws; // Draws without mega geometry, culled by the CPU
+  BufferHandle generate_draws_sb = kInvalidBuffer; // GpuIndirectDraws, written once
+  BufferHandle generated_commands_sb[k_max_frames];
+  BufferHandle generated_counts_sb[k_max_frames];
+  DescriptorSetHandle generate_descriptor_set[k_max_frames];
+  PipelineHandle generate_pipeline = kInvalidPipeline;
+  uint32_t generate_draw_count = 0;
+  uint32_t generate_single_sided_count = 0;
+
+  DrawBindStats stats;
+}; // struct DrawPacketQueue
+
 //
 //
 struct alignas(16) GpuMeshlet
@@ -457,6 +763,54 @@ struct alignas(16) GpuMeshDrawCommand
   VkDrawMeshTasksIndirectCommandNV indirectMS; // 2 uint32_t
 };                                             // struct GpuMeshDrawCommand
 
+//
+// Mega buffer draw tested by indirect_commands.glsl.
+namespace GpuIndirectDrawFlags
+{
+enum Enum : uint32_t
+{
+  kDoubleSided = 1 << 0,
+  kAlwaysVisible = 1 << 1 // Skinned and cloth meshes leave their bind pose bounds
+};
+} // namespace GpuIndirectDrawFlags
+
+struct alignas(16) GpuIndirectDraw
+{
+  vec4s bounding_sphere; // Mesh space
+
+  uint32_t mesh_instance_index;
+  uint32_t gpu_mesh_instance_index;
+  uint32_t index_count;
+  uint32_t first_index;
+
+  int32_t vertex_offset;
+  uint32_t flags;
+  uint32_t pad000;
+  uint32_t pad001;
+}; // struct GpuIndirectDraw
+
+//
+// Header of the draws buffer, the draws follow it.
+struct alignas(16) GpuIndirectDraws
+{
+  uint32_t draw_count;
+  uint32_t single_sided_count; // Double sided draws start here, in the draws and the commands
+  uint32_t pad000;
+  uint32_t pad001;
+}; // struct GpuIndirectDraws
+
+//
+//
+struct alignas(16) GpuIndirectCullConstants
+{
+  vec4s frustum_planes[6];
+
+  uint32_t culling_enabled;
+  uint32_t pad000;
+  uint32_t pad001;
+  uint32_t pad002;
+}; // struct GpuIndirectCullConstants
+
 //
 //
 struct alignas(16) GpuMeshDrawCounts
@@ -568,25 +922,36 @@ struct Transform
 
 // Light //////////////////////////////////////////////////////////////
 
-//
-struct alignas(16) Light
+// Columns of RenderScene::lights.
+namespace LightField
 {
-
-  vec3s world_position;
-  float radius;
-
-  vec3s color;
-  float intensity;
-
-  vec4s aabb_min;
-  vec4s aabb_max;
-
-  float shadow_map_resolution;
-  uint32_t tile_x;
-  uint32_t tile_y;
-  float solid_angle;
-
-}; // struct Light
+enum Enum : uint32_t
+{
+  kWorldPosition,
+  kRadius,
+  kColor,
+  kIntensity,
+  kAabbMin,
+  kAabbMax,
+  kShadowMapResolution,
+  kTileX,
+  kTileY,
+  kSolidAngle
+};
+} // namespace LightField
+
+// Culling and tiling loops only touch positions and bounds, not the shading parameters.
+using Lights = SoaArray<
+    vec3s,    // world position
+    float,    // radius
+    vec3s,    // color
+    float,    // intensity
+    vec4s,    // aabb min
+    vec4s,    // aabb max
+    float,    // shadow map resolution
+    uint32_t, // tile x
+    uint32_t, // tile y
+    float>;   // solid angle
 
 // Separated from Light struct as it could contain unpacked data.
 struct alignas(16) GpuLight
@@ -697,6 +1062,11 @@ struct alignas(16) GpuTaaConstants
 //
 struct DepthPrePass : public FrameGraphRenderPass
 {
+  void pre_render(
+      uint32_t current_frame_index,
+      CommandBuffer* gpu_commands,
+      FrameGraph* frame_graph,
+      RenderScene* render_scene) override;
   void render(
       uint32_t current_frame_index,
       Graphics::CommandBuffer* gpu_commands,
@@ -1144,6 +1514,8 @@ struct DoFPass : public FrameGraphRenderPass
       override;
   void on_resize(
       GpuDevice& gpu, FrameGraph* frame_graph, uint32_t new_width, uint32_t new_height) override;
+  // Copies the lighting texture into the scene mips before rendering.
+  bool changes_texture_states() const override { return true; }
 
   void prepare_draws(
       RenderScene& scene,
@@ -1370,7 +1742,13 @@ struct RenderScene
 
   void upload_gpu_data(UploadGpuDataContext& context);
   void
-  draw_mesh_instance(CommandBuffer* gpu_commands, MeshInstance& mesh_instance, bool transparent);
+  draw_mesh_instance(CommandBuffer* gpu_commands, uint32_t mesh_instance_index, bool transparent);
+
+  // Materials and mesh instances storage buffers and the descriptor sets of the indirect
+  // pipelines, which read them.
+  void prepare_indirect_draws(Renderer* renderer);
+  void upload_mesh_instances(uint32_t frame_index);
+  void free_indirect_draws(GpuDevice& gpu);
 
   // Helpers based on shaders. Ideally this would be coming from generated cpp files.
   void add_scene_descriptors(
@@ -1394,7 +1772,16 @@ struct RenderScene
 
   // Mesh and MeshInstances
   Array<Mesh> meshes;
-  Array<MeshInstance> mesh_instances;
+  MeshInstances mesh_instances;
+  FrustumCulling frustum_culling;
+  DrawPacketQueue draw_queues[CullingList::kCount];
+  MeshMegaBuffers mega_buffers;
+  bool use_indirect_draws = true;
+  // Opaque mega buffer draws culled and written by a compute pass. Needs draw indirect count,
+  // the CPU filled commands are the fallback.
+  bool gpu_indirect_commands = true;
+  bool sort_draw_packets = true;     // Opaque queues only, transparent ones are always sorted
+  bool opaque_front_to_back = false; // Depth first instead of state first for opaque queues
   Array<uint32_t> gltf_mesh_to_mesh_offset;
 
   // Meshlet data
@@ -1408,7 +1795,7 @@ struct RenderScene
   Array<Skin> skins;
 
   // Lights
-  Array<Light> lights;
+  Lights lights;
   Array<uint32_t> lights_lut;
   vec3s mesh_aabb[2]; // 0 min, 1 max
   uint32_t active_lights = 1;
@@ -1424,7 +1811,8 @@ struct RenderScene
   BufferHandle scene_cb = k_invalid_buffer;
   BufferHandle meshes_sb = k_invalid_buffer;
   BufferHandle mesh_bounds_sb = k_invalid_buffer;
-  BufferHandle mesh_instances_sb = k_invalid_buffer;
+  BufferHandle mesh_instances_sb[k_max_frames]; // Written every frame, indirect draws only
+  BufferHandle indirect_cull_cb = kInvalidBuffer; // Frustum of the GPU written commands
   BufferHandle physics_cb = k_invalid_buffer;
   BufferHandle meshlets_sb = k_invalid_buffer;
   BufferHandle meshlets_vertex_pos_sb = k_invalid_buffer;
@@ -1568,6 +1956,14 @@ struct FrameRenderer
 
   void upload_gpu_data(UploadGpuDataContext& context);
   void render(CommandBuffer* gpu_commands, RenderScene* render_scene);
+  // Culls the mesh instances and compacts the draws of the passes, before recording.
+  void cull_draws(const mat4s& view_projection, enki::TaskScheduler* task_scheduler);
+  // Builds the draw packet queues of the passes from their visible draws and sorts them. Fills the
+  // indirect commands of the current frame slot, call it after GpuDevice::newFrame.
+  void sort_draws(enki::TaskScheduler* task_scheduler);
+  // Draws of a pass culled and sorted on the CPU: all of them, or those left out of the GPU
+  // written commands.
+  const Array<MeshInstanceDraw>& cpu_draws(CullingList::Enum list) const;
 
   void prepare_draws(Framework::StackAllocator* scratch_allocator);
   void update_dependent_resources();
@@ -1627,6 +2023,10 @@ struct DrawTask : public enki::ITaskSet
   // NOTE: gpu state might change between init and execute!
   uint32_t current_frame_index = 0;
   FramebufferHandle current_framebuffer = {kInvalidIndex};
+  // Off when the frame graph is recorded by a FrameGraphRecordTask.
+  bool render_frame_graph = true;
+  // Recorded commands, queued by the caller after the ones of the frame graph ranges.
+  CommandBuffer* gpu_commands = nullptr;
 
   void init(
       GpuDevice* gpu_,
@@ -1640,6 +2040,35 @@ struct DrawTask : public enki::ITaskSet
 
 }; // struct DrawTask
 
+//
+// Records the frame graph on several threads: the sorted nodes are split in contiguous ranges, each
+// recorded into its own command buffer. Barriers of a range use the states planned by the frame
+// graph, so FrameGraph::prepare_render has to run before and apply_barrier_states after the task.
+// Only for graphs where FrameGraph::can_record_in_parallel holds: a pass changing texture states
+// itself would leave the planned old states of the following ranges wrong.
+struct FrameGraphRecordTask : public enki::ITaskSet
+{
+  // A thread can run every range, the draw task and the texture updates within its buffers.
+  static constexpr uint32_t k_max_ranges = 6;
+
+  GpuDevice* gpu = nullptr;
+  FrameGraph* frame_graph = nullptr;
+  RenderScene* scene = nullptr;
+  uint32_t current_frame_index = 0;
+
+  uint32_t num_ranges = 0;
+  uint32_t range_first_node[k_max_ranges + 1];
+  CommandBuffer* range_commands[k_max_ranges];
+
+  void init(GpuDevice* gpu_, FrameGraph* frame_graph_, RenderScene* scene_, uint32_t num_threads);
+
+  void ExecuteRange(enki::TaskSetPartition range_, uint32_t threadnum_) override;
+
+  // Queues the recorded ranges in node order.
+  void queue_command_buffers();
+
+}; // struct FrameGraphRecordTask
+
 // Math utils /////////////////////////////////////////////////////////
 void get_bounds_for_axis(const vec3s& a, const vec3s& C, float r, float nearZ, vec3s& L, vec3s& U);
 vec3s project(const mat4s& P, const vec3s& Q);
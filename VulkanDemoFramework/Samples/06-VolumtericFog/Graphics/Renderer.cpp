@@ -277,11 +277,11 @@ void Renderer::init(const RendererCreation& p_Creation)
   m_Width = m_GpuDevice->m_SwapchainWidth;
   m_Height = m_GpuDevice->m_SwapchainHeight;
 
-  m_Textures.init(p_Creation.alloc, kTexturesPoolSize);
-  m_Buffers.init(p_Creation.alloc, kBuffersPoolSize);
-  m_Samplers.init(p_Creation.alloc, kSamplersPoolSize);
-  m_Materials.init(p_Creation.alloc, 128);
-  m_Techniques.init(p_Creation.alloc, 128);
+  m_Textures.initGrowable(p_Creation.alloc, kResourcePoolPageSize, kTexturesPoolSize);
+  m_Buffers.initGrowable(p_Creation.alloc, kResourcePoolPageSize, kBuffersPoolSize);
+  m_Samplers.initGrowable(p_Creation.alloc, kResourcePoolPageSize, kSamplersPoolSize);
+  m_Materials.initGrowable(p_Creation.alloc, kResourcePoolPageSize, kPipelinesPoolSize);
+  m_Techniques.initGrowable(p_Creation.alloc, kResourcePoolPageSize, kPipelinesPoolSize);
 
   m_ResourceCache.init(p_Creation.alloc);
 
@@ -331,6 +331,50 @@ void Renderer::imguiDraw()
   }
 
   ImGui::Text("GPU Memory Total: %lluMB", totalMemoryUsed / (1024 * 1024));
+
+  const ShaderCacheStatistics& shaderCache = m_GpuDevice->m_ShaderCacheStats;
+  ImGui::Separator();
+  ImGui::Text(
+      "Shader cache: %u hits, %u misses, %u evicted, %lluKB",
+      shaderCache.hits,
+      shaderCache.misses,
+      shaderCache.evictions,
+      shaderCache.sizeInBytes / 1024);
+  ImGui::Text(
+      "Shader compile %.2fms, cache lookup %.2fms",
+      shaderCache.compileTimeMs,
+      shaderCache.lookupTimeMs);
+
+  ImGui::Separator();
+  const Framework::ResourcePool* pools[] = {
+      &m_GpuDevice->m_Buffers,
+      &m_GpuDevice->m_Textures,
+      &m_GpuDevice->m_Pipelines,
+      &m_GpuDevice->m_DescriptorSets};
+  const char* poolNames[] = {"Buffers", "Textures", "Pipelines", "Descriptor sets"};
+  for (uint32_t i = 0; i < arrayCount32(pools); ++i)
+  {
+    ImGui::Text(
+        "%s pool: %u/%u used, %u pages (%.0f%%)",
+        poolNames[i],
+        (uint32_t)pools[i]->m_UsedIndices,
+        (uint32_t)pools[i]->m_PoolSize,
+        pools[i]->getPageCount(),
+        pools[i]->getOccupancy() * 100.0f);
+  }
+
+  ImGui::Separator();
+  const Framework::ThreadFrameArenas& arenas = m_GpuDevice->m_FrameArenas;
+  for (uint32_t t = 0; t < arenas.m_NumThreads; ++t)
+  {
+    const uint64_t peak = arenas.getHighWaterMark(t) / 1024;
+    const uint64_t total = arenas.m_Arenas[t].allocator.m_TotalSize / 1024;
+    // The last arena is the compute pools one.
+    if (t == m_GpuDevice->m_NumThreads)
+      ImGui::Text("Compute frame arena peak: %lluKB/%lluKB", peak, total);
+    else
+      ImGui::Text("Thread %u frame arena peak: %lluKB/%lluKB", t, peak, total);
+  }
 }
 //---------------------------------------------------------------------------//
 void Renderer::setPresentationMode(PresentMode::Enum value)
@@ -358,6 +402,11 @@ BufferResource* Renderer::createBuffer(const BufferCreation& p_Creation)
   if (buffer)
   {
     BufferHandle handle = m_GpuDevice->createBuffer(p_Creation);
+    if (handle.index == kInvalidIndex)
+    {
+      m_Buffers.release(buffer);
+      return nullptr;
+    }
     buffer->m_Handle = handle;
     buffer->m_Name = p_Creation.name;
     m_GpuDevice->queryBuffer(handle, buffer->m_Desc);
@@ -392,6 +441,11 @@ TextureResource* Renderer::createTexture(const TextureCreation& creation)
   if (texture)
   {
     TextureHandle handle = m_GpuDevice->createTexture(creation);
+    if (handle.index == kInvalidIndex)
+    {
+      m_Textures.release(texture);
+      return nullptr;
+    }
     texture->m_Handle = handle;
     m_GpuDevice->queryTexture(handle, texture->m_Desc);
     texture->m_References = 1;
@@ -412,6 +466,11 @@ SamplerResource* Renderer::createSampler(const SamplerCreation& p_Creation)
   if (sampler)
   {
     SamplerHandle handle = m_GpuDevice->createSampler(p_Creation);
+    if (handle.index == kInvalidIndex)
+    {
+      m_Samplers.release(sampler);
+      return nullptr;
+    }
     sampler->m_Handle = handle;
     sampler->m_Name = p_Creation.name;
     m_GpuDevice->querySampler(handle, sampler->m_Desc);
@@ -429,6 +488,19 @@ SamplerResource* Renderer::createSampler(const SamplerCreation& p_Creation)
 }
 //---------------------------------------------------------------------------//
 GpuTechnique* Renderer::createTechnique(const GpuTechniqueCreation& creation)
+{
+  GpuTechnique* technique = createTechniqueDeferred(creation);
+  if (technique)
+  {
+    for (uint32_t i = 0; i < creation.numCreations; ++i)
+    {
+      createTechniquePass(technique, creation, i);
+    }
+  }
+  return technique;
+}
+//---------------------------------------------------------------------------//
+GpuTechnique* Renderer::createTechniqueDeferred(const GpuTechniqueCreation& creation)
 {
   GpuTechnique* technique = m_Techniques.obtain();
   if (technique)
@@ -437,33 +509,15 @@ GpuTechnique* Renderer::createTechnique(const GpuTechniqueCreation& creation)
     technique->nameHashToIndex.init(m_ResidentAllocator, creation.numCreations);
     technique->m_Name = creation.name;
 
-    m_TemporaryAllocator.clear();
-
-    Framework::StringBuffer pipelineCachePath;
-    pipelineCachePath.init(2048, &m_TemporaryAllocator);
-
     for (uint32_t i = 0; i < creation.numCreations; ++i)
     {
-      GpuTechniquePass& pass = technique->passes[i];
       const PipelineCreation& passCreation = creation.creations[i];
-      if (passCreation.name != nullptr)
-      {
-        char* cachePath = pipelineCachePath.appendUseFormatted(
-            "%s%s%s.cache", m_GpuDevice->m_Cwd.path, SHADER_FOLDER, passCreation.name);
-
-        pass.pipeline = m_GpuDevice->createPipeline(passCreation, cachePath);
-      }
-      else
-      {
-        pass.pipeline = m_GpuDevice->createPipeline(passCreation);
-      }
+      technique->passes[i].pipeline = {kInvalidIndex};
 
       assert(passCreation.name);
       technique->nameHashToIndex.insert(Framework::hashCalculate(passCreation.name), (uint32_t)i);
     }
 
-    m_TemporaryAllocator.clear();
-
     if (creation.name != nullptr)
     {
       m_ResourceCache.m_Techniques.insert(Framework::hashCalculate(creation.name), technique);
@@ -474,6 +528,13 @@ GpuTechnique* Renderer::createTechnique(const GpuTechniqueCreation& creation)
   return technique;
 }
 //---------------------------------------------------------------------------//
+void Renderer::createTechniquePass(
+    GpuTechnique* technique, const GpuTechniqueCreation& creation, uint32_t passIndex)
+{
+  technique->passes[passIndex].pipeline =
+      m_GpuDevice->createPipeline(creation.creations[passIndex]);
+}
+//---------------------------------------------------------------------------//
 Material* Renderer::createMaterial(const MaterialCreation& creation)
 {
   Material* material = m_Materials.obtain();
@@ -157,6 +157,11 @@ struct Renderer : public Framework::Service
   TextureResource* createTexture(const TextureCreation& p_Creation);
 
   GpuTechnique* createTechnique(const GpuTechniqueCreation& creation);
+  // Two step technique creation: passes are registered first and their pipelines can then be
+  // created separately, from any thread.
+  GpuTechnique* createTechniqueDeferred(const GpuTechniqueCreation& creation);
+  void createTechniquePass(
+      GpuTechnique* technique, const GpuTechniqueCreation& creation, uint32_t passIndex);
   Material* createMaterial(const MaterialCreation& creation);
   Material* createMaterial(GpuTechnique* technique, const char* name);
 
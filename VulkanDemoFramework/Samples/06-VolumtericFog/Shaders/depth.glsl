@@ -5,6 +5,8 @@
 layout(location=0) in vec3 position;
 
 void main() {
+    write_mesh_instance_index();
+
     gl_Position = view_projection * model * vec4(position, 1.0);
 }
 
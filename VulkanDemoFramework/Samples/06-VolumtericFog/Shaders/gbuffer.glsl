@@ -14,6 +14,8 @@ layout (location = 3) out vec3 vBiTangent;
 layout (location = 4) out vec3 vPosition;
 
 void main() {
+    write_mesh_instance_index();
+
     gl_Position = view_projection * model * vec4(position, 1.0);
     vec4 worldPosition = model * vec4(position, 1.0);
     vPosition = worldPosition.xyz / worldPosition.w;
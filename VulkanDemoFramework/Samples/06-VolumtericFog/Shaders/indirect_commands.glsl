@@ -0,0 +1,127 @@
+
+// Culls the mega buffer draws of a pass against the camera frustum and writes an indirect command
+// for each visible one. Single sided draws go to the first group of commands, double sided ones
+// after them, and the count buffer holds how many of each were written.
+
+struct IndirectDraw {
+    // Mesh space bounding sphere.
+    vec4        bounding_sphere;
+
+    uint        mesh_instance_index;
+    uint        gpu_mesh_instance_index;
+    uint        index_count;
+    uint        first_index;
+
+    int         vertex_offset;
+    uint        flags;
+    uint        pad000;
+    uint        pad001;
+};
+
+struct MeshInstanceData {
+    mat4        world;
+    mat4        inverse_world;
+
+    uint        mesh_index;
+    uint        pad000;
+    uint        pad001;
+    uint        pad002;
+};
+
+// Same layout as GpuMeshDrawCommand.
+struct MeshDrawCommand {
+    uint        draw_id;
+
+    uint        index_count;
+    uint        instance_count;
+    uint        first_index;
+    int         vertex_offset;
+    uint        first_instance;
+
+    uint        task_count;
+    uint        first_task;
+};
+
+uint IndirectDrawFlags_DoubleSided      = 1 << 0;
+uint IndirectDrawFlags_AlwaysVisible    = 1 << 1;
+
+layout ( std140, set = MATERIAL_SET, binding = 0 ) uniform CullConstants {
+    vec4        frustum_planes[6];
+
+    uint        culling_enabled;
+    uint        pad000;
+    uint        pad001;
+    uint        pad002;
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 1 ) readonly buffer IndirectDraws {
+    uint        draw_count;
+    // Double sided draws start here, in the draws and in the commands.
+    uint        single_sided_count;
+    uint        pad003;
+    uint        pad004;
+
+    IndirectDraw draws[];
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 2 ) readonly buffer MeshInstances {
+    MeshInstanceData mesh_instances[];
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 3 ) writeonly buffer Commands {
+    MeshDrawCommand commands[];
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 4 ) buffer Counts {
+    uint        counts[2];
+};
+
+#if defined(COMPUTE)
+
+// DrawPacketQueue::k_generate_group_size
+#define GROUP_SIZE 64
+
+layout (local_size_x = GROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+void main() {
+    uint draw_index = gl_GlobalInvocationID.x;
+    if ( draw_index >= draw_count ) {
+        return;
+    }
+
+    IndirectDraw draw = draws[ draw_index ];
+    mat4 world = mesh_instances[ draw.gpu_mesh_instance_index ].world;
+
+    vec3 center = ( world * vec4( draw.bounding_sphere.xyz, 1.0 ) ).xyz;
+    // Largest axis scale, so non uniform scales keep the sphere conservative.
+    float scale = max( length( world[ 0 ].xyz ), max( length( world[ 1 ].xyz ), length( world[ 2 ].xyz ) ) );
+    float radius = draw.bounding_sphere.w * scale;
+
+    bool visible = true;
+    if ( culling_enabled != 0 && ( draw.flags & IndirectDrawFlags_AlwaysVisible ) == 0 ) {
+        for ( uint p = 0; p < 6; ++p ) {
+            visible = visible && ( dot( frustum_planes[ p ].xyz, center ) + frustum_planes[ p ].w >= -radius );
+        }
+    }
+
+    if ( !visible ) {
+        return;
+    }
+
+    uint group = ( draw.flags & IndirectDrawFlags_DoubleSided ) != 0 ? 1 : 0;
+    uint command_index = atomicAdd( counts[ group ], 1 ) + ( group * single_sided_count );
+
+    // The first instance selects the mesh instance data in the draw shaders.
+    MeshDrawCommand command;
+    command.draw_id = draw.mesh_instance_index;
+    command.index_count = draw.index_count;
+    command.instance_count = 1;
+    command.first_index = draw.first_index;
+    command.vertex_offset = draw.vertex_offset;
+    command.first_instance = draw.gpu_mesh_instance_index;
+    command.task_count = 0;
+    command.first_task = 0;
+
+    commands[ command_index ] = command;
+}
+
+#endif // COMPUTE
@@ -30,3 +30,6 @@ layout ( std140, set = MATERIAL_SET, binding = 2 ) uniform Mesh {
     float       specular_exp;
     vec4        ambient_colour;
 };
+
+// Indirect draws pass the mesh instance to the fragment stage, see mesh_indirect.h.
+#define write_mesh_instance_index()
@@ -0,0 +1,79 @@
+
+// Mesh data for indirect draws: instances and materials are read from storage buffers indexed by
+// the instance index, so the same descriptor set serves every draw of a multi draw command.
+
+uint DrawFlags_AlphaMask    = 1 << 0;
+uint DrawFlags_Phong        = 1 << 3;
+uint DrawFlags_HasNormals   = 1 << 4;
+uint DrawFlags_TexCoords    = 1 << 5;
+uint DrawFlags_HasTangents  = 1 << 6;
+uint DrawFlags_HasJoints    = 1 << 7;
+uint DrawFlags_HasWeights   = 1 << 8;
+uint DrawFlags_AlphaDither  = 1 << 9;
+
+struct MeshInstanceData {
+    mat4        world;
+    mat4        inverse_world;
+
+    uint        mesh_index;
+    uint        pad000;
+    uint        pad001;
+    uint        pad002;
+};
+
+struct MaterialData {
+    // x = diffuse index, y = roughness index, z = normal index, w = occlusion index.
+    uvec4       textures;
+    vec4        emissive;
+    vec4        base_color_factor;
+    // w = specular exponent for phong materials
+    vec4        metallic_roughness_occlusion_factor;
+
+    uint        flags;
+    float       alpha_cutoff;
+    uint        vertex_offset;
+    uint        mesh_index;
+
+    uint        meshlet_offset;
+    uint        meshlet_count;
+    uint        meshlet_index_count;
+    uint        padding1_;
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 2 ) readonly buffer MeshInstances {
+    MeshInstanceData mesh_instances[];
+};
+
+layout ( std430, set = MATERIAL_SET, binding = 3 ) readonly buffer Materials {
+    MaterialData materials[];
+};
+
+// The first instance of the indirect command is the mesh instance index.
+#if defined(VERTEX)
+layout (location = 7) flat out uint mesh_instance_index;
+#define current_mesh_instance gl_InstanceIndex
+#define write_mesh_instance_index() mesh_instance_index = gl_InstanceIndex
+#endif // VERTEX
+
+#if defined(FRAGMENT)
+layout (location = 7) flat in uint mesh_instance_index;
+#define current_mesh_instance mesh_instance_index
+#define write_mesh_instance_index()
+#endif // FRAGMENT
+
+#define mesh_instance_data mesh_instances[current_mesh_instance]
+#define material_data materials[mesh_instance_data.mesh_index]
+
+#define model mesh_instance_data.world
+#define model_inverse mesh_instance_data.inverse_world
+
+#define textures material_data.textures
+#define emissive material_data.emissive
+#define base_color_factor material_data.base_color_factor
+#define metallic_roughness_occlusion_factor material_data.metallic_roughness_occlusion_factor
+#define flags material_data.flags
+#define alpha_cutoff material_data.alpha_cutoff
+
+// Phong materials store their diffuse colour as base colour.
+#define diffuse material_data.base_color_factor
+#define specular_exp material_data.metallic_roughness_occlusion_factor.w
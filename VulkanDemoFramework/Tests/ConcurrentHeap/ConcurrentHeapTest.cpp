@@ -0,0 +1,98 @@
+// Checks of the concurrent HeapAllocator:
+// - it keeps handing out chunks after a request that does not fit in the rest of the heap: the
+//   failed request must not use up the unreserved memory, so a small allocation on another thread
+//   still succeeds.
+// - a trim returns the memory freed across threads, also to the sub-heaps of threads that exited.
+
+#include "Foundation/Memory.hpp"
+
+#include "Tests/TestHelpers.hpp"
+
+#include <stdio.h>
+
+#include <thread>
+
+using namespace Framework;
+//---------------------------------------------------------------------------//
+static const size_t kHeapSize = FRAMEWORK_MEGA(32);
+static const uint32_t kMaxThreads = 4;
+static const uint32_t kCrossThreadBlocks = 256;
+//---------------------------------------------------------------------------//
+static void testFailedChunkRequest()
+{
+  HeapAllocator heap;
+  heap.initConcurrent(kHeapSize, kMaxThreads);
+
+  // The first chunk of this thread, the rest of the heap is left unreserved.
+  void* small = heap.allocate(1024, 1);
+  check(small != nullptr, "first small allocation failed");
+
+  // Needs a chunk bigger than what is left of the heap.
+  void* large = heap.allocate(kHeapSize - FRAMEWORK_MEGA(2), 1);
+  check(large == nullptr, "allocation larger than the remaining heap succeeded");
+
+  // Bigger than the whole heap.
+  void* huge = heap.allocate(kHeapSize * 2, 1);
+  check(huge == nullptr, "allocation larger than the heap succeeded");
+
+  // Another thread has no chunk yet and must still be able to reserve one.
+  bool otherThreadAllocated = false;
+  std::thread other([&heap, &otherThreadAllocated]() {
+    void* memory = heap.allocate(1024, 16);
+    otherThreadAllocated = memory != nullptr;
+    heap.deallocate(memory);
+  });
+  other.join();
+  check(otherThreadAllocated, "small allocation on another thread failed after a failed one");
+
+  heap.deallocate(small);
+  heap.shutdown();
+}
+//---------------------------------------------------------------------------//
+static void testCrossThreadFrees()
+{
+  HeapAllocator heap;
+  heap.initConcurrent(kHeapSize, kMaxThreads);
+
+  // Every worker allocates from its own sub-heap and exits, so none of them drains its queue.
+  static const uint32_t kWorkers = kMaxThreads - 1;
+  void* blocks[kWorkers][kCrossThreadBlocks] = {};
+  std::thread workers[kWorkers];
+  for (uint32_t w = 0; w < kWorkers; ++w)
+  {
+    workers[w] = std::thread([&heap, &blocks, w]() {
+      for (uint32_t b = 0; b < kCrossThreadBlocks; ++b)
+        blocks[w][b] = heap.allocate(64 + b, 16);
+    });
+  }
+  for (uint32_t w = 0; w < kWorkers; ++w)
+    workers[w].join();
+
+  // Freed by this thread, the blocks are queued to the sub-heaps of the workers.
+  for (uint32_t w = 0; w < kWorkers; ++w)
+  {
+    for (uint32_t b = 0; b < kCrossThreadBlocks; ++b)
+    {
+      check(blocks[w][b] != nullptr, "worker %u allocation %u failed", w, b);
+      heap.deallocate(blocks[w][b]);
+    }
+  }
+  check(heap.m_AllocatedSize.load() > 0, "cross thread frees were returned before the trim");
+
+  heap.trim();
+  check(
+      heap.m_AllocatedSize.load() == 0,
+      "%llu bytes still allocated after the trim",
+      (unsigned long long)heap.m_AllocatedSize.load());
+
+  heap.shutdown();
+}
+//---------------------------------------------------------------------------//
+int main(int argc, char** argv)
+{
+  testFailedChunkRequest();
+  testCrossThreadFrees();
+
+  return reportChecks();
+}
+//---------------------------------------------------------------------------//
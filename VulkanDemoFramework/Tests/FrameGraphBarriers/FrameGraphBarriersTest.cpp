@@ -0,0 +1,253 @@
+// Parses the frame graph of the volumetric fog sample, checks the barriers planned for it against
+// the states its nodes access their resources in, then times the planning. Only the CPU side of the
+// graph is used, no device is created.
+
+#include "Graphics/FrameGraph.hpp"
+#include "Graphics/GpuDevice.hpp"
+
+#include "Foundation/Memory.hpp"
+#include "Foundation/Time.hpp"
+
+#include "Tests/TestHelpers.hpp"
+
+#include <stdio.h>
+
+using namespace Framework;
+using namespace Graphics;
+//---------------------------------------------------------------------------//
+static const char* kDefaultGraphPath = "..\\..\\Samples\\06-VolumtericFog\\graph.json";
+static const uint32_t kIterations = 1000;
+//---------------------------------------------------------------------------//
+// State a node uses a resource in, written from the access rules and not from the planner.
+static ResourceState expectedState(
+    const FrameGraphNode* p_Node,
+    FrameGraphResourceType p_AccessType,
+    const FrameGraphResource* p_Resource,
+    bool p_Output)
+{
+  switch (p_AccessType)
+  {
+  case kFrameGraphResourceTypeTexture:
+    if (p_Output)
+      return RESOURCE_STATE_UNDEFINED;
+    return p_Node->compute ? RESOURCE_STATE_SHADER_RESOURCE : RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+  case kFrameGraphResourceTypeAttachment:
+    if (p_Node->compute)
+      return RESOURCE_STATE_UNORDERED_ACCESS;
+    return TextureFormat::hasDepthOrStencil(p_Resource->resourceInfo.texture.format)
+               ? RESOURCE_STATE_DEPTH_WRITE
+               : RESOURCE_STATE_RENDER_TARGET;
+  case kFrameGraphResourceTypeBuffer:
+    return p_Output ? RESOURCE_STATE_UNORDERED_ACCESS : RESOURCE_STATE_SHADER_RESOURCE;
+  default:
+    return RESOURCE_STATE_UNDEFINED;
+  }
+}
+//---------------------------------------------------------------------------//
+static bool isReadOnly(ResourceState p_State)
+{
+  return p_State != RESOURCE_STATE_UNDEFINED &&
+         (p_State & ~(RESOURCE_STATE_GENERIC_READ | RESOURCE_STATE_DEPTH_READ)) == 0;
+}
+//---------------------------------------------------------------------------//
+static bool isNodeOutput(const FrameGraphNode* p_Node, FrameGraphResourceHandle p_Handle)
+{
+  for (uint32_t o = 0; o < p_Node->outputs.m_Size; ++o)
+  {
+    if (p_Node->outputs[o].index == p_Handle.index)
+      return true;
+  }
+  return false;
+}
+//---------------------------------------------------------------------------//
+static bool isNodeResource(
+    FrameGraphBuilder* p_Builder, const FrameGraphNode* p_Node, FrameGraphResourceHandle p_Handle)
+{
+  for (uint32_t i = 0; i < p_Node->inputs.m_Size; ++i)
+  {
+    if (p_Builder->access_resource(p_Node->inputs[i])->outputHandle.index == p_Handle.index)
+      return true;
+  }
+  return isNodeOutput(p_Node, p_Handle);
+}
+//---------------------------------------------------------------------------//
+static void checkBarriers(FrameGraph& p_FrameGraph, Allocator* p_Allocator)
+{
+  FrameGraphBuilder* builder = p_FrameGraph.builder;
+  const uint32_t resourceCount = builder->resource_cache.resources.m_UsedIndices;
+
+  check(
+      p_FrameGraph.validation_errors == 0,
+      "%u validation errors",
+      p_FrameGraph.validation_errors);
+  check(p_FrameGraph.nodes.m_Size > 0, "no node left after sorting");
+
+  // Resources start a frame in the state the previous one left them in, the last one planned.
+  Array<ResourceState> states;
+  states.init(p_Allocator, resourceCount, resourceCount);
+  Array<uint8_t> accessed;
+  accessed.init(p_Allocator, resourceCount, resourceCount);
+  for (uint32_t r = 0; r < resourceCount; ++r)
+  {
+    states[r] = RESOURCE_STATE_UNDEFINED;
+    accessed[r] = 0;
+  }
+  for (uint32_t b = 0; b < p_FrameGraph.barriers.m_Size; ++b)
+  {
+    const FrameGraphBarrier& barrier = p_FrameGraph.barriers[b];
+    states[barrier.resource.index] = barrier.new_state;
+  }
+
+  uint32_t barrierOffset = 0;
+  for (uint32_t n = 0; n < p_FrameGraph.nodes.m_Size; ++n)
+  {
+    FrameGraphNode* node = builder->access_node(p_FrameGraph.nodes[n]);
+
+    check(
+        node->barrier_offset == barrierOffset,
+        "%s: barriers start at %u instead of %u",
+        node->name,
+        node->barrier_offset,
+        barrierOffset);
+    barrierOffset = node->barrier_offset + node->barrier_count;
+
+    if (node->ray_tracing)
+    {
+      check(node->barrier_count == 0, "%s: ray tracing pass with barriers", node->name);
+      continue;
+    }
+
+    for (uint32_t b = 0; b < node->barrier_count; ++b)
+    {
+      const FrameGraphBarrier& barrier = p_FrameGraph.barriers[node->barrier_offset + b];
+      const uint32_t index = barrier.resource.index;
+      FrameGraphResource* resource = builder->access_resource(barrier.resource);
+
+      check(
+          isNodeResource(builder, node, barrier.resource),
+          "%s: barrier on %s, which the node doesn't use",
+          node->name,
+          resource->m_Name);
+      check(
+          barrier.old_state == (barrier.discard ? RESOURCE_STATE_UNDEFINED : states[index]),
+          "%s: %s transitions from 0x%x, it is in 0x%x",
+          node->name,
+          resource->m_Name,
+          barrier.old_state,
+          states[index]);
+      check(
+          barrier.first_use == !accessed[index],
+          "%s: %s first use flag is wrong",
+          node->name,
+          resource->m_Name);
+      check(
+          barrier.first_use || barrier.old_state != barrier.new_state ||
+              !isReadOnly(barrier.new_state),
+          "%s: redundant read barrier on %s",
+          node->name,
+          resource->m_Name);
+      check(
+          barrier.buffer == (resource->type == kFrameGraphResourceTypeBuffer),
+          "%s: %s buffer flag is wrong",
+          node->name,
+          resource->m_Name);
+
+      states[index] = barrier.new_state;
+      accessed[index] = 1;
+    }
+
+    // After its barriers every resource of the node is in the state the node uses it in. Outputs
+    // win over inputs of the same resource.
+    for (uint32_t i = 0; i < node->inputs.m_Size; ++i)
+    {
+      FrameGraphResource* input = builder->access_resource(node->inputs[i]);
+      FrameGraphResource* resource = builder->access_resource(input->outputHandle);
+      if (resource == nullptr || resource->resourceInfo.external ||
+          isNodeOutput(node, input->outputHandle))
+        continue;
+
+      const ResourceState state = expectedState(node, input->type, resource, false);
+      check(
+          state == RESOURCE_STATE_UNDEFINED || states[input->outputHandle.index] == state,
+          "%s: input %s is in 0x%x instead of 0x%x",
+          node->name,
+          input->m_Name,
+          states[input->outputHandle.index],
+          state);
+    }
+
+    for (uint32_t o = 0; o < node->outputs.m_Size; ++o)
+    {
+      FrameGraphResource* output = builder->access_resource(node->outputs[o]);
+
+      const ResourceState state = expectedState(node, output->type, output, true);
+      check(
+          state == RESOURCE_STATE_UNDEFINED || states[node->outputs[o].index] == state,
+          "%s: output %s is in 0x%x instead of 0x%x",
+          node->name,
+          output->m_Name,
+          states[node->outputs[o].index],
+          state);
+    }
+  }
+
+  check(
+      barrierOffset == p_FrameGraph.barriers.m_Size,
+      "%u barriers belong to no node",
+      p_FrameGraph.barriers.m_Size - barrierOffset);
+
+  accessed.shutdown();
+  states.shutdown();
+}
+//---------------------------------------------------------------------------//
+int main(int argc, char** argv)
+{
+  const char* graphPath = argc > 1 ? argv[1] : kDefaultGraphPath;
+
+  Time::serviceInit();
+
+  MemoryServiceConfiguration memoryConfiguration;
+  MemoryService::instance()->init(&memoryConfiguration);
+  Allocator* allocator = &MemoryService::instance()->m_SystemAllocator;
+
+  StackAllocator scratchAllocator;
+  scratchAllocator.init(FRAMEWORK_MEGA(8));
+
+  // The builder only takes its allocator from the device, which is never initialized.
+  GpuDevice gpu;
+  gpu.m_Allocator = allocator;
+
+  FrameGraphBuilder frameGraphBuilder;
+  frameGraphBuilder.init(&gpu);
+
+  FrameGraph frameGraph;
+  frameGraph.init(&frameGraphBuilder);
+
+  frameGraph.parse_json(graphPath, &scratchAllocator);
+  frameGraph.compute_node_edges();
+  frameGraph.sort_nodes();
+  frameGraph.plan_barriers(&frameGraph.compile_allocator);
+
+  printf(
+      "%s: %u nodes, %u barriers\n",
+      graphPath,
+      frameGraph.nodes.m_Size,
+      frameGraph.barriers.m_Size);
+  checkBarriers(frameGraph, allocator);
+
+  const int64_t start = Time::getCurrentTime();
+  for (uint32_t i = 0; i < kIterations; ++i)
+  {
+    frameGraph.compile_allocator.clear();
+    frameGraph.plan_barriers(&frameGraph.compile_allocator);
+  }
+  printf(
+      "plan_barriers: %.3f us per call over %u calls\n",
+      Time::deltaFromStartMicroseconds(start) / kIterations,
+      kIterations);
+
+  // Nothing is shut down: releasing the graph destroys its render passes through the device, which
+  // was never created.
+  return reportChecks();
+}
+//---------------------------------------------------------------------------//
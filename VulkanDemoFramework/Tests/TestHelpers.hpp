@@ -0,0 +1,58 @@
+#pragma once
+
+// Helpers shared by the test and benchmark programs.
+
+#include "Foundation/Time.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+//---------------------------------------------------------------------------//
+inline uint32_t& checkFailureCount()
+{
+  static uint32_t failures = 0;
+  return failures;
+}
+//---------------------------------------------------------------------------//
+// Prints the message and counts a failure when the condition is false, the program carries on.
+inline void check(bool p_Condition, const char* p_Format, ...)
+{
+  if (p_Condition)
+    return;
+
+  va_list args;
+  va_start(args, p_Format);
+  printf("FAILED: ");
+  vprintf(p_Format, args);
+  printf("\n");
+  va_end(args);
+
+  ++checkFailureCount();
+}
+//---------------------------------------------------------------------------//
+// Prints the outcome of the checks, returns the exit code of the program.
+inline int reportChecks()
+{
+  const uint32_t failures = checkFailureCount();
+  if (failures > 0)
+    printf("%u checks failed\n", failures);
+  else
+    printf("All checks passed\n");
+
+  return failures > 0 ? 1 : 0;
+}
+//---------------------------------------------------------------------------//
+// Best time of the iterations, in milliseconds.
+template <typename Function> inline double measure(uint32_t p_Iterations, Function p_Function)
+{
+  double best = 0.0;
+  for (uint32_t i = 0; i < p_Iterations; ++i)
+  {
+    const int64_t start = Framework::Time::getCurrentTime();
+    p_Function();
+    const double elapsed = Framework::Time::deltaFromStartMilliseconds(start);
+    if (i == 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+//---------------------------------------------------------------------------//